@@ -0,0 +1,178 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark/backendbench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "neural/factory.h"
+#include "neural/loader.h"
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+const char* kNetFileStr = "Network weights file path";
+const char* kNnBackendStr = "NN backend to use";
+const char* kNnBackendOptionsStr = "NN backend parameters";
+const char* kBatchesStr = "Batch sizes to sweep (comma separated)";
+const char* kIterationsStr = "Iterations per batch size";
+
+// Value for network autodiscover.
+const char* kAutoDiscover = "<autodiscover>";
+
+std::vector<int> ParseBatchSizes(const std::string& str) {
+  std::vector<int> sizes;
+  std::istringstream iss(str);
+  std::string token;
+  while (std::getline(iss, token, ',')) {
+    const int size = std::stoi(token);
+    if (size < 1) throw Exception("Invalid batch size: " + token);
+    sizes.push_back(size);
+  }
+  if (sizes.empty()) throw Exception("Empty batch size list.");
+  return sizes;
+}
+
+// Returns plausible but meaningless positions; the backend does the same
+// arithmetic regardless of what the planes encode. A fixed seed keeps runs
+// comparable.
+std::vector<InputPlanes> MakeSyntheticBatch(int size) {
+  std::mt19937_64 rng(67);
+  std::vector<InputPlanes> batch;
+  batch.reserve(size);
+  for (int i = 0; i < size; ++i) {
+    InputPlanes planes(kInputPlanes);
+    for (auto& plane : planes) {
+      plane.mask = rng() & rng() & rng();  // ~8 bits set, like real planes.
+      plane.value = 1.0f;
+    }
+    batch.push_back(std::move(planes));
+  }
+  return batch;
+}
+
+struct SweepPoint {
+  int batch_size;
+  double evals_per_sec;
+  double latency_avg_ms;
+  double latency_p50_ms;
+  double latency_p95_ms;
+};
+
+SweepPoint MeasureBatchSize(Network* network, int batch_size, int iterations) {
+  const auto batch = MakeSyntheticBatch(batch_size);
+
+  auto run_once = [&]() {
+    auto computation = network->NewComputation();
+    for (const auto& planes : batch) {
+      computation->AddInput(InputPlanes(planes));
+    }
+    computation->ComputeBlocking();
+  };
+
+  // Warmup covers lazy allocations, JIT and clock ramp-up.
+  run_once();
+  run_once();
+
+  std::vector<double> latencies_ms;
+  latencies_ms.reserve(iterations);
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    run_once();
+    latencies_ms.push_back(std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+  }
+
+  SweepPoint point;
+  point.batch_size = batch_size;
+  double total_ms = 0.0;
+  for (double ms : latencies_ms) total_ms += ms;
+  point.evals_per_sec = batch_size * iterations * 1000.0 / total_ms;
+  point.latency_avg_ms = total_ms / iterations;
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  point.latency_p50_ms = latencies_ms[latencies_ms.size() / 2];
+  point.latency_p95_ms = latencies_ms[latencies_ms.size() * 95 / 100];
+  return point;
+}
+}  // namespace
+
+BackendBenchmark::BackendBenchmark() {
+  options_.Add<StringOption>(kNetFileStr, "weights", 'w') = kAutoDiscover;
+  const auto backends = NetworkFactory::Get()->GetBackendsList();
+  options_.Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
+      backends.empty() ? "<none>" : backends[0];
+  options_.Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+  options_.Add<StringOption>(kBatchesStr, "batches") =
+      "1,2,4,8,16,32,64,128,256,512";
+  options_.Add<IntOption>(kIterationsStr, 1, 10000, "iterations") = 20;
+}
+
+void BackendBenchmark::Run() {
+  if (!options_.ProcessAllFlags()) return;
+  const OptionsDict& option_dict = options_.GetOptionsDict();
+
+  std::string net_path = option_dict.Get<std::string>(kNetFileStr);
+  if (net_path == kAutoDiscover) net_path = DiscoverWeightsFile();
+  Weights weights = LoadWeightsFromFile(net_path);
+  OptionsDict network_options = OptionsDict::FromString(
+      option_dict.Get<std::string>(kNnBackendOptionsStr), &option_dict);
+  auto network = NetworkFactory::Get()->Create(
+      option_dict.Get<std::string>(kNnBackendStr), weights, network_options);
+
+  const auto batch_sizes =
+      ParseBatchSizes(option_dict.Get<std::string>(kBatchesStr));
+  const int iterations = option_dict.Get<int>(kIterationsStr);
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::vector<SweepPoint> sweep;
+  for (const int batch_size : batch_sizes) {
+    const auto point = MeasureBatchSize(network.get(), batch_size, iterations);
+    std::cout << "batch " << std::setw(4) << point.batch_size << ": "
+              << std::setw(8) << point.evals_per_sec << " evals/s"
+              << std::setprecision(2) << "  latency avg "
+              << point.latency_avg_ms << "ms p50 " << point.latency_p50_ms
+              << "ms p95 " << point.latency_p95_ms << "ms"
+              << std::setprecision(1) << std::endl;
+    sweep.push_back(point);
+  }
+
+  // The knee: the smallest batch that gets within 5% of peak throughput.
+  // Larger batches only add latency (and search width) for little gain.
+  const auto peak = *std::max_element(
+      sweep.begin(), sweep.end(), [](const SweepPoint& a, const SweepPoint& b) {
+        return a.evals_per_sec < b.evals_per_sec;
+      });
+  for (const auto& point : sweep) {
+    if (point.evals_per_sec >= 0.95 * peak.evals_per_sec) {
+      std::cout << "knee: batch " << point.batch_size << " ("
+                << 100.0 * point.evals_per_sec / peak.evals_per_sec
+                << "% of peak " << peak.evals_per_sec << " evals/s at batch "
+                << peak.batch_size << ")" << std::endl;
+      break;
+    }
+  }
+}
+
+}  // namespace lczero
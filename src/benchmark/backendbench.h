@@ -0,0 +1,41 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "utils/optionsparser.h"
+
+namespace lczero {
+
+// Feeds synthetic batches of a sweep of sizes straight into a backend,
+// without search in the way, and reports evals/sec and latency percentiles
+// per size plus the knee of the throughput curve. Meant for picking
+// minibatch-size and per-device multiplexing parameters without playing
+// full games.
+class BackendBenchmark {
+ public:
+  BackendBenchmark();
+
+  // Parses command line flags and runs the sweep. Blocks.
+  void Run();
+
+ private:
+  OptionsParser options_;
+};
+
+}  // namespace lczero
@@ -0,0 +1,152 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark/benchmark.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include "mcts/search.h"
+#include "neural/factory.h"
+#include "neural/loader.h"
+
+namespace lczero {
+
+namespace {
+const char* kThreadsStr = "Number of CPU threads per position";
+const char* kNnCacheSizeStr = "NNCache size MB";
+const char* kNetFileStr = "Network weights file path";
+const char* kNodesStr = "Number of nodes to search per position";
+const char* kNnBackendStr = "NN backend to use";
+const char* kNnBackendOptionsStr = "NN backend parameters";
+
+// Value for network autodiscover.
+const char* kAutoDiscover = "<autodiscover>";
+
+// Fixed suite: the start position, two typical middlegames, a tactical
+// position and an endgame. Determinism comes from noise and temperature
+// being off by default; results with them enabled are not comparable.
+const char* kBenchmarkFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bq1rk1/pp1nbppp/2p1pn2/3p2B1/2PP4/2N1PN2/PPQ1BPPP/R4RK1 b - - 5 9",
+    "r4rk1/1bqnbppp/p2p1n2/1p2p3/3NP3/1BP2N2/PP2QPPP/R1BR2K1 w - - 0 14",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "8/8/4kpp1/3p1b2/p6P/2B5/6P1/6K1 b - - 2 47",
+};
+
+struct PositionResult {
+  int64_t playouts = 0;
+  int64_t time_ms = 0;
+  WorkerStats stats;
+};
+
+void PrintResult(const std::string& title, const PositionResult& result) {
+  const int64_t lookups = result.stats.cache_hits + result.stats.cache_misses;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << title << ": nodes " << result.playouts << " time "
+            << result.time_ms << "ms nps "
+            << (result.time_ms ? result.playouts * 1000 / result.time_ms : 0)
+            << " avg-batch "
+            << (result.stats.batches ? static_cast<float>(
+                                           result.stats.batch_size_sum) /
+                                           result.stats.batches
+                                     : 0.0f)
+            << " cache-hits "
+            << (lookups ? 100.0f * result.stats.cache_hits / lookups : 0.0f)
+            << "%" << std::endl;
+}
+
+}  // namespace
+
+Benchmark::Benchmark() {
+  options_.Add<StringOption>(kNetFileStr, "weights", 'w') = kAutoDiscover;
+  options_.Add<IntOption>(kThreadsStr, 1, 128, "threads", 't') = 2;
+  options_.Add<IntOption>(kNnCacheSizeStr, 0, 65536, "nncache") = 48;
+  options_.Add<IntOption>(kNodesStr, 1, 999999999, "nodes") = 10000;
+  const auto backends = NetworkFactory::Get()->GetBackendsList();
+  options_.Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
+      backends.empty() ? "<none>" : backends[0];
+  options_.Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+
+  Search::PopulateUciParams(&options_);
+
+  // Match the engine defaults, so that benchmark numbers are representative
+  // of match play. Smart pruning is off as it makes node counts (and thus
+  // NPS) depend on the position.
+  auto defaults = options_.GetMutableDefaultsOptions();
+  defaults->Set<int>(Search::kMiniBatchSizeStr, 256);
+  defaults->Set<float>(Search::kFpuReductionStr, 0.9f);
+  defaults->Set<float>(Search::kCpuctStr, 3.4f);
+  defaults->Set<float>(Search::kPolicySoftmaxTempStr, 2.2f);
+  defaults->Set<int>(Search::kAllowedNodeCollisionsStr, 32);
+  defaults->Set<bool>(Search::kSmartPruningStr, false);
+}
+
+void Benchmark::Run() {
+  if (!options_.ProcessAllFlags()) return;
+  const OptionsDict& option_dict = options_.GetOptionsDict();
+
+  std::string net_path = option_dict.Get<std::string>(kNetFileStr);
+  if (net_path == kAutoDiscover) net_path = DiscoverWeightsFile();
+  Weights weights = LoadWeightsFromFile(net_path);
+  OptionsDict network_options = OptionsDict::FromString(
+      option_dict.Get<std::string>(kNnBackendOptionsStr), &option_dict);
+  auto network = NetworkFactory::Get()->Create(
+      option_dict.Get<std::string>(kNnBackendStr), weights, network_options);
+
+  SearchLimits limits;
+  limits.visits = option_dict.Get<int>(kNodesStr);
+  const int threads = option_dict.Get<int>(kThreadsStr);
+
+  PositionResult total;
+  const int num_positions =
+      sizeof(kBenchmarkFens) / sizeof(kBenchmarkFens[0]);
+  for (int i = 0; i < num_positions; ++i) {
+    // Each position gets a fresh tree and cache, so that earlier positions
+    // don't affect later numbers.
+    NNCache cache(static_cast<int64_t>(option_dict.Get<int>(kNnCacheSizeStr)) *
+                  1024 * 1024);
+    NodeTree tree;
+    tree.ResetToPosition(kBenchmarkFens[i], {});
+
+    const auto start = std::chrono::steady_clock::now();
+    Search search(tree, network.get(), [](const BestMoveInfo&) {},
+                  [](const ThinkingInfo&) {}, limits, option_dict, &cache);
+    search.RunBlocking(threads);
+
+    PositionResult result;
+    result.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    result.playouts = search.GetTotalPlayouts();
+    result.stats = search.GetWorkerStats();
+    PrintResult("position " + std::to_string(i + 1) + "/" +
+                    std::to_string(num_positions),
+                result);
+
+    total.playouts += result.playouts;
+    total.time_ms += result.time_ms;
+    total.stats.batches += result.stats.batches;
+    total.stats.batch_size_sum += result.stats.batch_size_sum;
+    total.stats.cache_hits += result.stats.cache_hits;
+    total.stats.cache_misses += result.stats.cache_misses;
+  }
+  PrintResult("total", total);
+}
+
+}  // namespace lczero
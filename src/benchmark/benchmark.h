@@ -0,0 +1,40 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "utils/optionsparser.h"
+
+namespace lczero {
+
+// Measures search throughput over a fixed suite of positions, without UCI
+// I/O in the way. Prints NPS, average batch size and cache hit rate per
+// position, plus aggregates. Meant for A/B comparison of hardware, backends
+// and search changes.
+class Benchmark {
+ public:
+  Benchmark();
+
+  // Parses command line flags and runs the benchmark. Blocks.
+  void Run();
+
+ private:
+  OptionsParser options_;
+};
+
+}  // namespace lczero
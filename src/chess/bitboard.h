@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "utils/bititer.h"
+#include "utils/smallvector.h"
 
 namespace lczero {
 
@@ -117,6 +118,9 @@ class BitBoard {
   // Returns whether all bits of a board are set to 0.
   bool empty() const { return board_ == 0; }
 
+  // Returns the number of set bits.
+  int count() const { return CountSetBits(board_); }
+
   // Checks whether two bitboards have common bits set.
   bool intersects(const BitBoard& other) const { return board_ & other.board_; }
 
@@ -190,18 +194,22 @@ class Move {
  public:
   enum class Promotion : std::uint8_t { None, Queen, Rook, Bishop, Knight };
   Move() = default;
-  Move(BoardSquare from, BoardSquare to)
+  constexpr Move(BoardSquare from, BoardSquare to)
       : data_(to.as_int() + (from.as_int() << 6)) {}
-  Move(BoardSquare from, BoardSquare to, Promotion promotion)
+  constexpr Move(BoardSquare from, BoardSquare to, Promotion promotion)
       : data_(to.as_int() + (from.as_int() << 6) +
               (static_cast<uint8_t>(promotion) << 12)) {}
   Move(const std::string& str, bool black = false);
   Move(const char* str, bool black = false) : Move(std::string(str), black) {}
 
-  BoardSquare to() const { return BoardSquare(data_ & kToMask); }
-  BoardSquare from() const { return BoardSquare((data_ & kFromMask) >> 6); }
-  Promotion promotion() const { return Promotion((data_ & kPromoMask) >> 12); }
-  bool castling() const { return (data_ & kCastleMask) != 0; }
+  constexpr BoardSquare to() const { return BoardSquare(data_ & kToMask); }
+  constexpr BoardSquare from() const {
+    return BoardSquare((data_ & kFromMask) >> 6);
+  }
+  constexpr Promotion promotion() const {
+    return Promotion((data_ & kPromoMask) >> 12);
+  }
+  constexpr bool castling() const { return (data_ & kCastleMask) != 0; }
   void SetCastling() { data_ |= kCastleMask; }
 
   void SetTo(BoardSquare to) { data_ = (data_ & ~kToMask) | to.as_int(); }
@@ -212,7 +220,12 @@ class Move {
     data_ = (data_ & ~kPromoMask) | (static_cast<uint8_t>(promotion) << 12);
   }
   // 0 .. 16384, knight promotion and no promotion is the same.
-  uint16_t as_packed_int() const;
+  constexpr uint16_t as_packed_int() const {
+    return promotion() == Promotion::Knight
+               ? from().as_int() * 64 + to().as_int()
+               : static_cast<int>(promotion()) * 64 * 64 +
+                     from().as_int() * 64 + to().as_int();
+  }
 
   // 0 .. 1857, to use in neural networks.
   uint16_t as_nn_index() const;
@@ -263,6 +276,8 @@ class Move {
   };
 };
 
-using MoveList = std::vector<Move>;
+// Inline capacity covers the move count of almost every position, so filling
+// a move list normally doesn't allocate.
+using MoveList = SmallVector<Move, 48>;
 
 }  // namespace lczero
@@ -54,71 +54,23 @@ void ChessBoard::Mirror() {
 }
 
 namespace {
-static const BitBoard kPawnMask = 0x00FFFFFFFFFFFF00ULL;
+static constexpr BitBoard kPawnMask = 0x00FFFFFFFFFFFF00ULL;
 
-static const std::pair<int, int> kKingMoves[] = {
+static constexpr std::pair<int, int> kKingMoves[] = {
     {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
 
-static const std::pair<int, int> kRookDirections[] = {
+static constexpr std::pair<int, int> kRookDirections[] = {
     {1, 0}, {-1, 0}, {0, 1}, {0, -1}};
 
-static const std::pair<int, int> kBishopDirections[] = {
+static constexpr std::pair<int, int> kBishopDirections[] = {
     {1, 1}, {-1, 1}, {1, -1}, {-1, -1}};
 
 // If those squares are attacked, king cannot castle.
-static const int k00Attackers[] = {4, 5, 6};
-static const int k000Attackers[] = {2, 3, 4};
-
-// Which squares can rook attack from every of squares.
-static const BitBoard kRookAttacks[] = {
-    0x01010101010101FEULL, 0x02020202020202FDULL, 0x04040404040404FBULL,
-    0x08080808080808F7ULL, 0x10101010101010EFULL, 0x20202020202020DFULL,
-    0x40404040404040BFULL, 0x808080808080807FULL, 0x010101010101FE01ULL,
-    0x020202020202FD02ULL, 0x040404040404FB04ULL, 0x080808080808F708ULL,
-    0x101010101010EF10ULL, 0x202020202020DF20ULL, 0x404040404040BF40ULL,
-    0x8080808080807F80ULL, 0x0101010101FE0101ULL, 0x0202020202FD0202ULL,
-    0x0404040404FB0404ULL, 0x0808080808F70808ULL, 0x1010101010EF1010ULL,
-    0x2020202020DF2020ULL, 0x4040404040BF4040ULL, 0x80808080807F8080ULL,
-    0x01010101FE010101ULL, 0x02020202FD020202ULL, 0x04040404FB040404ULL,
-    0x08080808F7080808ULL, 0x10101010EF101010ULL, 0x20202020DF202020ULL,
-    0x40404040BF404040ULL, 0x808080807F808080ULL, 0x010101FE01010101ULL,
-    0x020202FD02020202ULL, 0x040404FB04040404ULL, 0x080808F708080808ULL,
-    0x101010EF10101010ULL, 0x202020DF20202020ULL, 0x404040BF40404040ULL,
-    0x8080807F80808080ULL, 0x0101FE0101010101ULL, 0x0202FD0202020202ULL,
-    0x0404FB0404040404ULL, 0x0808F70808080808ULL, 0x1010EF1010101010ULL,
-    0x2020DF2020202020ULL, 0x4040BF4040404040ULL, 0x80807F8080808080ULL,
-    0x01FE010101010101ULL, 0x02FD020202020202ULL, 0x04FB040404040404ULL,
-    0x08F7080808080808ULL, 0x10EF101010101010ULL, 0x20DF202020202020ULL,
-    0x40BF404040404040ULL, 0x807F808080808080ULL, 0xFE01010101010101ULL,
-    0xFD02020202020202ULL, 0xFB04040404040404ULL, 0xF708080808080808ULL,
-    0xEF10101010101010ULL, 0xDF20202020202020ULL, 0xBF40404040404040ULL,
-    0x7F80808080808080ULL};
-// Which squares can bishop attack.
-static const BitBoard kBishopAttacks[] = {
-    0x8040201008040200ULL, 0x0080402010080500ULL, 0x0000804020110A00ULL,
-    0x0000008041221400ULL, 0x0000000182442800ULL, 0x0000010204885000ULL,
-    0x000102040810A000ULL, 0x0102040810204000ULL, 0x4020100804020002ULL,
-    0x8040201008050005ULL, 0x00804020110A000AULL, 0x0000804122140014ULL,
-    0x0000018244280028ULL, 0x0001020488500050ULL, 0x0102040810A000A0ULL,
-    0x0204081020400040ULL, 0x2010080402000204ULL, 0x4020100805000508ULL,
-    0x804020110A000A11ULL, 0x0080412214001422ULL, 0x0001824428002844ULL,
-    0x0102048850005088ULL, 0x02040810A000A010ULL, 0x0408102040004020ULL,
-    0x1008040200020408ULL, 0x2010080500050810ULL, 0x4020110A000A1120ULL,
-    0x8041221400142241ULL, 0x0182442800284482ULL, 0x0204885000508804ULL,
-    0x040810A000A01008ULL, 0x0810204000402010ULL, 0x0804020002040810ULL,
-    0x1008050005081020ULL, 0x20110A000A112040ULL, 0x4122140014224180ULL,
-    0x8244280028448201ULL, 0x0488500050880402ULL, 0x0810A000A0100804ULL,
-    0x1020400040201008ULL, 0x0402000204081020ULL, 0x0805000508102040ULL,
-    0x110A000A11204080ULL, 0x2214001422418000ULL, 0x4428002844820100ULL,
-    0x8850005088040201ULL, 0x10A000A010080402ULL, 0x2040004020100804ULL,
-    0x0200020408102040ULL, 0x0500050810204080ULL, 0x0A000A1120408000ULL,
-    0x1400142241800000ULL, 0x2800284482010000ULL, 0x5000508804020100ULL,
-    0xA000A01008040201ULL, 0x4000402010080402ULL, 0x0002040810204080ULL,
-    0x0005081020408000ULL, 0x000A112040800000ULL, 0x0014224180000000ULL,
-    0x0028448201000000ULL, 0x0050880402010000ULL, 0x00A0100804020100ULL,
-    0x0040201008040201ULL};
+static constexpr int k00Attackers[] = {4, 5, 6};
+static constexpr int k000Attackers[] = {2, 3, 4};
+
 // Which squares can knight attack.
-static const BitBoard kKnightAttacks[] = {
+static constexpr BitBoard kKnightAttacks[] = {
     0x0000000000020400ULL, 0x0000000000050800ULL, 0x00000000000A1100ULL,
     0x0000000000142200ULL, 0x0000000000284400ULL, 0x0000000000508800ULL,
     0x0000000000A01000ULL, 0x0000000000402000ULL, 0x0000000002040004ULL,
@@ -142,7 +94,7 @@ static const BitBoard kKnightAttacks[] = {
     0x0044280000000000ULL, 0x0088500000000000ULL, 0x0010A00000000000ULL,
     0x0020400000000000ULL};
 // Opponent pawn attacks
-static const BitBoard kPawnAttacks[] = {
+static constexpr BitBoard kPawnAttacks[] = {
     0x0000000000000200ULL, 0x0000000000000500ULL, 0x0000000000000A00ULL,
     0x0000000000001400ULL, 0x0000000000002800ULL, 0x0000000000005000ULL,
     0x000000000000A000ULL, 0x0000000000004000ULL, 0x0000000000020000ULL,
@@ -173,6 +125,158 @@ static const Move::Promotion kPromotions[] = {
     Move::Promotion::Knight,
 };
 
+// Magic bitboards for sliding piece attacks: the attack set of a rook or
+// bishop on a given square is a table lookup indexed by
+// ((occupancy & mask) * magic) >> shift, replacing the square-by-square ray
+// walks. Tables are built once at startup from the magic multipliers below
+// (the classic published constants).
+
+struct MagicParams {
+  // Relevant occupancy mask: blocker squares that affect the attack set
+  // (ray squares except the board edge in the ray direction).
+  uint64_t mask;
+  // Magic multiplier.
+  uint64_t magic;
+  // Index shift: 64 minus the number of bits in the mask.
+  uint8_t shift;
+  // Pointer into the shared attacks table.
+  BitBoard* attacks;
+};
+
+static MagicParams rook_magic_params[64];
+static MagicParams bishop_magic_params[64];
+
+// The classic total sizes: 800kB for rooks, 41kB for bishops.
+static BitBoard rook_attacks_table[102400];
+static BitBoard bishop_attacks_table[5248];
+
+static constexpr uint64_t kRookMagicNumbers[64] = {
+    0x0080001020400080ULL, 0x0040001000200040ULL, 0x0080081000200080ULL,
+    0x0080040800100080ULL, 0x0080020400080080ULL, 0x0080010200040080ULL,
+    0x0080008001000200ULL, 0x0080002040800100ULL, 0x0000800020400080ULL,
+    0x0000400020005000ULL, 0x0000801000200080ULL, 0x0000800800100080ULL,
+    0x0000800400080080ULL, 0x0000800200040080ULL, 0x0000800100020080ULL,
+    0x0000800040800100ULL, 0x0000208000400080ULL, 0x0000404000201000ULL,
+    0x0000808010002000ULL, 0x0000808008001000ULL, 0x0000808004000800ULL,
+    0x0000808002000400ULL, 0x0000010100020004ULL, 0x0000020000408104ULL,
+    0x0000208080004000ULL, 0x0000200040005000ULL, 0x0000100080200080ULL,
+    0x0000080080100080ULL, 0x0000040080080080ULL, 0x0000020080040080ULL,
+    0x0000010080800200ULL, 0x0000800080004100ULL, 0x0000204000800080ULL,
+    0x0000200040401000ULL, 0x0000100080802000ULL, 0x0000080080801000ULL,
+    0x0000040080800800ULL, 0x0000020080800400ULL, 0x0000020001010004ULL,
+    0x0000800040800100ULL, 0x0000204000808000ULL, 0x0000200040008080ULL,
+    0x0000100020008080ULL, 0x0000080010008080ULL, 0x0000040008008080ULL,
+    0x0000020004008080ULL, 0x0000010002008080ULL, 0x0000004081020004ULL,
+    0x0000204000800080ULL, 0x0000200040008080ULL, 0x0000100020008080ULL,
+    0x0000080010008080ULL, 0x0000040008008080ULL, 0x0000020004008080ULL,
+    0x0000800100020080ULL, 0x0000800041000080ULL, 0x00FFFCDDFCED714AULL,
+    0x007FFCDDFCED714AULL, 0x003FFFCDFFD88096ULL, 0x0000040810002101ULL,
+    0x0001000204080011ULL, 0x0001000204000801ULL, 0x0001000082000401ULL,
+    0x0001FFFAABFAD1A2ULL};
+
+static constexpr uint64_t kBishopMagicNumbers[64] = {
+    0x0002020202020200ULL, 0x0002020202020000ULL, 0x0004010202000000ULL,
+    0x0004040080000000ULL, 0x0001104000000000ULL, 0x0000821040000000ULL,
+    0x0000410410400000ULL, 0x0000104104104000ULL, 0x0000040404040400ULL,
+    0x0000020202020200ULL, 0x0000040102020000ULL, 0x0000040400800000ULL,
+    0x0000011040000000ULL, 0x0000008210400000ULL, 0x0000004104104000ULL,
+    0x0000002082082000ULL, 0x0004000808080800ULL, 0x0002000404040400ULL,
+    0x0001000202020200ULL, 0x0000800802004000ULL, 0x0000800400A00000ULL,
+    0x0000200100884000ULL, 0x0000400082082000ULL, 0x0000200041041000ULL,
+    0x0002080010101000ULL, 0x0001040008080800ULL, 0x0000208004010400ULL,
+    0x0000404004010200ULL, 0x0000840000802000ULL, 0x0000404002011000ULL,
+    0x0000808001041000ULL, 0x0000404000820800ULL, 0x0001041000202000ULL,
+    0x0000820800101000ULL, 0x0000104400080800ULL, 0x0000020080080080ULL,
+    0x0000404040040100ULL, 0x0000808100020100ULL, 0x0001010100020800ULL,
+    0x0000808080010400ULL, 0x0000820820004000ULL, 0x0000410410002000ULL,
+    0x0000082088001000ULL, 0x0000002011000800ULL, 0x0000080100400400ULL,
+    0x0001010101000200ULL, 0x0002020202000400ULL, 0x0001010101000200ULL,
+    0x0000410410400000ULL, 0x0000208208200000ULL, 0x0000002084100000ULL,
+    0x0000000020880000ULL, 0x0000001002020000ULL, 0x0000040408020000ULL,
+    0x0004040404040000ULL, 0x0002020202020000ULL, 0x0000104104104000ULL,
+    0x0000002082082000ULL, 0x0000000020841000ULL, 0x0000000000208800ULL,
+    0x0000000010020200ULL, 0x0000000404080200ULL, 0x0000040404040400ULL,
+    0x0002020202020200ULL};
+
+// Computes the attack set from @square by walking @directions until the
+// first blocker in @occupied (which is attacked) or the board edge.
+static uint64_t WalkSlidingAttacks(BoardSquare square,
+                                   const std::pair<int, int>* directions,
+                                   uint64_t occupied) {
+  uint64_t attacks = 0;
+  for (int d = 0; d < 4; ++d) {
+    int dst_row = square.row();
+    int dst_col = square.col();
+    while (true) {
+      dst_row += directions[d].first;
+      dst_col += directions[d].second;
+      if (!BoardSquare::IsValid(dst_row, dst_col)) break;
+      const BoardSquare destination(dst_row, dst_col);
+      attacks |= 1ULL << destination.as_int();
+      if (occupied & (1ULL << destination.as_int())) break;
+    }
+  }
+  return attacks;
+}
+
+static void BuildMagicTable(MagicParams* params, BitBoard* table,
+                            const uint64_t* magics,
+                            const std::pair<int, int>* directions) {
+  int offset = 0;
+  for (int square = 0; square < 64; ++square) {
+    const BoardSquare sq(square);
+    // Relevant occupancy: ray squares whose successor in the same direction
+    // is still on the board (an edge blocker changes nothing).
+    uint64_t mask = 0;
+    int bits = 0;
+    for (int d = 0; d < 4; ++d) {
+      int row = sq.row() + directions[d].first;
+      int col = sq.col() + directions[d].second;
+      while (BoardSquare::IsValid(row, col) &&
+             BoardSquare::IsValid(row + directions[d].first,
+                                  col + directions[d].second)) {
+        mask |= 1ULL << BoardSquare(row, col).as_int();
+        ++bits;
+        row += directions[d].first;
+        col += directions[d].second;
+      }
+    }
+    params[square].mask = mask;
+    params[square].magic = magics[square];
+    params[square].shift = 64 - bits;
+    params[square].attacks = table + offset;
+    offset += 1 << bits;
+    // Enumerate all subsets of the mask (Carry-Rippler) and fill the table.
+    uint64_t occupied = 0;
+    do {
+      params[square].attacks[(occupied * magics[square]) >>
+                             params[square].shift] =
+          WalkSlidingAttacks(sq, directions, occupied);
+      occupied = (occupied - mask) & mask;
+    } while (occupied);
+  }
+}
+
+// Builds the attack tables once at startup.
+static struct MagicTablesInitializer {
+  MagicTablesInitializer() {
+    BuildMagicTable(rook_magic_params, rook_attacks_table, kRookMagicNumbers,
+                    kRookDirections);
+    BuildMagicTable(bishop_magic_params, bishop_attacks_table,
+                    kBishopMagicNumbers, kBishopDirections);
+  }
+} magic_tables_initializer;
+
+inline BitBoard GetRookAttacks(BoardSquare square, BitBoard occupied) {
+  const MagicParams& p = rook_magic_params[square.as_int()];
+  return p.attacks[((occupied.as_int() & p.mask) * p.magic) >> p.shift];
+}
+
+inline BitBoard GetBishopAttacks(BoardSquare square, BitBoard occupied) {
+  const MagicParams& p = bishop_magic_params[square.as_int()];
+  return p.attacks[((occupied.as_int() & p.mask) * p.magic) >> p.shift];
+}
+
 }  // namespace
 
 BitBoard ChessBoard::pawns() const { return pawns_ * kPawnMask; }
@@ -240,35 +344,19 @@ MoveList ChessBoard::GeneratePseudolegalMoves() const {
     // Rook (and queen)
     if (rooks_.get(source)) {
       processed_piece = true;
-      for (const auto& direction : kRookDirections) {
-        auto dst_row = source.row();
-        auto dst_col = source.col();
-        while (true) {
-          dst_row += direction.first;
-          dst_col += direction.second;
-          if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-          const BoardSquare destination(dst_row, dst_col);
-          if (our_pieces_.get(destination)) break;
-          result.emplace_back(source, destination);
-          if (their_pieces_.get(destination)) break;
-        }
+      const BitBoard attacked =
+          GetRookAttacks(source, our_pieces_ + their_pieces_) - our_pieces_;
+      for (const auto& destination : attacked) {
+        result.emplace_back(source, destination);
       }
     }
     // Bishop (and queen)
     if (bishops_.get(source)) {
       processed_piece = true;
-      for (const auto& direction : kBishopDirections) {
-        auto dst_row = source.row();
-        auto dst_col = source.col();
-        while (true) {
-          dst_row += direction.first;
-          dst_col += direction.second;
-          if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-          const BoardSquare destination(dst_row, dst_col);
-          if (our_pieces_.get(destination)) break;
-          result.emplace_back(source, destination);
-          if (their_pieces_.get(destination)) break;
-        }
+      const BitBoard attacked =
+          GetBishopAttacks(source, our_pieces_ + their_pieces_) - our_pieces_;
+      for (const auto& destination : attacked) {
+        result.emplace_back(source, destination);
       }
     }
     if (processed_piece) continue;
@@ -442,6 +530,10 @@ bool ChessBoard::ApplyMove(Move move) {
 }
 
 bool ChessBoard::IsUnderAttack(BoardSquare square) const {
+  return IsUnderAttackWith(square, our_pieces_ + their_pieces_);
+}
+
+bool ChessBoard::IsUnderAttackWith(BoardSquare square, BitBoard occupied) const {
   const int row = square.row();
   const int col = square.col();
   // Check king
@@ -451,40 +543,12 @@ bool ChessBoard::IsUnderAttack(BoardSquare square) const {
     if (std::abs(krow - row) <= 1 && std::abs(kcol - col) <= 1) return true;
   }
   // Check Rooks (and queen)
-  if (kRookAttacks[square.as_int()].intersects(their_pieces_ * rooks_)) {
-    for (const auto& direction : kRookDirections) {
-      auto dst_row = row;
-      auto dst_col = col;
-      while (true) {
-        dst_row += direction.first;
-        dst_col += direction.second;
-        if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-        const BoardSquare destination(dst_row, dst_col);
-        if (our_pieces_.get(destination)) break;
-        if (their_pieces_.get(destination)) {
-          if (rooks_.get(destination)) return true;
-          break;
-        }
-      }
-    }
+  if (GetRookAttacks(square, occupied).intersects(their_pieces_ * rooks_)) {
+    return true;
   }
   // Check Bishops
-  if (kBishopAttacks[square.as_int()].intersects(their_pieces_ * bishops_)) {
-    for (const auto& direction : kBishopDirections) {
-      auto dst_row = row;
-      auto dst_col = col;
-      while (true) {
-        dst_row += direction.first;
-        dst_col += direction.second;
-        if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-        const BoardSquare destination(dst_row, dst_col);
-        if (our_pieces_.get(destination)) break;
-        if (their_pieces_.get(destination)) {
-          if (bishops_.get(destination)) return true;
-          break;
-        }
-      }
-    }
+  if (GetBishopAttacks(square, occupied).intersects(their_pieces_ * bishops_)) {
+    return true;
   }
   // Check pawns
   if (kPawnAttacks[square.as_int()].intersects(their_pieces_ * pawns_)) {
@@ -501,18 +565,25 @@ bool ChessBoard::IsUnderAttack(BoardSquare square) const {
   return false;
 }
 
+BitBoard ChessBoard::GetCheckers() const {
+  const BitBoard occupied = our_pieces_ + their_pieces_;
+  BitBoard checkers =
+      GetRookAttacks(our_king_, occupied) * (their_pieces_ * rooks_);
+  checkers = checkers +
+             GetBishopAttacks(our_king_, occupied) * (their_pieces_ * bishops_);
+  checkers =
+      checkers + kPawnAttacks[our_king_.as_int()] * (their_pieces_ * pawns_);
+  checkers = checkers +
+             kKnightAttacks[our_king_.as_int()] *
+                 (their_pieces_ - their_king_ - rooks_ - bishops_ -
+                  (pawns_ * kPawnMask));
+  return checkers;
+}
+
 bool ChessBoard::IsLegalMove(Move move, bool was_under_check) const {
   const auto& from = move.from();
   const auto& to = move.to();
 
-  // If we are already under check, also apply move and check if valid.
-  // TODO(mooskagh) Optimize this case
-  if (was_under_check) {
-    ChessBoard board(*this);
-    board.ApplyMove(move);
-    return !board.IsUnderCheck();
-  }
-
   // En passant. Complex but rare. Just apply
   // and check that we are not under check.
   if (from.row() == 4 && pawns_.get(from) && from.col() != to.col() &&
@@ -522,13 +593,39 @@ bool ChessBoard::IsLegalMove(Move move, bool was_under_check) const {
     return !board.IsUnderCheck();
   }
 
-  // If it's kings move, check that destination
-  // is not under attack.
+  // If it's kings move, check that destination is not under attack.
+  // Occupancy with the source square vacated is used so that moves along a
+  // checking slider's ray are correctly seen as attacked.
   if (from == our_king_) {
-    // Castlings were checked earlier.
+    // Castlings were checked earlier. (Also not generated under check.)
     if (std::abs(static_cast<int>(from.col()) - static_cast<int>(to.col())) > 1)
       return true;
-    return !IsUnderAttack(to);
+    return !IsUnderAttackWith(to, our_pieces_ + their_pieces_ - from);
+  }
+
+  if (was_under_check) {
+    const BitBoard checkers = GetCheckers();
+    auto iter = checkers.begin();
+    const BoardSquare checker = *iter;
+    // Double check can only be answered by a king move.
+    if (!(checkers - checker).empty()) return false;
+    // Other pieces can only capture the checker or block the check line.
+    BitBoard targets(0);
+    targets.set(checker);
+    if (rooks_.get(checker) || bishops_.get(checker)) {
+      const int dcol = checker.col() - our_king_.col();
+      const int drow = checker.row() - our_king_.row();
+      const int dx = (dcol > 0) - (dcol < 0);
+      const int dy = (drow > 0) - (drow < 0);
+      for (BoardSquare square(our_king_.row() + dy, our_king_.col() + dx);
+           square != checker;
+           square = BoardSquare(square.row() + dy, square.col() + dx)) {
+        targets.set(square);
+      }
+    }
+    if (!targets.get(to)) return false;
+    // Fall through: the capturing/blocking piece must not itself be pinned
+    // on another line.
   }
 
   // Not check that piece was pinned. And it was, check that after the move
@@ -582,19 +679,18 @@ MoveList ChessBoard::GenerateLegalMoves() const {
 }
 
 std::vector<MoveExecution> ChessBoard::GenerateLegalMovesAndPositions() const {
-  MoveList move_list = GeneratePseudolegalMoves();
+  const bool was_under_check = IsUnderCheck();
   std::vector<MoveExecution> result;
 
-  for (const auto& move : move_list) {
+  for (const auto& move : GeneratePseudolegalMoves()) {
+    // Filter before applying, so that boards are only materialized for
+    // moves which are actually legal.
+    if (!IsLegalMove(move, was_under_check)) continue;
     result.emplace_back();
+    result.back().move = move;
     auto& newboard = result.back().board;
     newboard = *this;
     result.back().reset_50_moves = newboard.ApplyMove(move);
-    if (newboard.IsUnderCheck()) {
-      result.pop_back();
-      continue;
-    }
-    result.back().move = move;
   }
   return result;
 }
@@ -697,14 +793,7 @@ bool ChessBoard::HasMatingMaterial() const {
     return true;
   }
 
-#ifdef _MSC_VER
-  int our = _mm_popcnt_u64(our_pieces_.as_int());
-  int their = _mm_popcnt_u64(their_pieces_.as_int());
-#else
-  int our = __builtin_popcountll(our_pieces_.as_int());
-  int their = __builtin_popcountll(their_pieces_.as_int());
-#endif
-  if (our + their < 4) {
+  if (our_pieces_.count() + their_pieces_.count() < 4) {
     // K v K, K+B v K, K+N v K.
     return false;
   }
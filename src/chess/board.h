@@ -142,6 +142,12 @@ class ChessBoard {
   bool operator!=(const ChessBoard& other) const { return !operator==(other); }
 
  private:
+  // Checks whether the square is attacked by "theirs" (black), with the
+  // given occupancy used for sliding attacks.
+  bool IsUnderAttackWith(BoardSquare square, BitBoard occupied) const;
+  // Returns a bitboard of "their" (black) pieces which give check.
+  BitBoard GetCheckers() const;
+
   // All white pieces.
   BitBoard our_pieces_;
   // All black pieces.
@@ -50,6 +50,8 @@ struct ThinkingInfo {
   int depth = -1;
   // Maximum depth.
   int seldepth = -1;
+  // Which PV line this is (1-based), when several are reported.
+  int multipv = -1;
   // Time since start of thinking.
   int64_t time = -1;
   // Nodes visited.
@@ -66,6 +68,8 @@ struct ThinkingInfo {
   std::string comment;
 
   // Those are extensions and not really UCI protocol.
+  // Bytes consumed by the search tree, or -1 when not reported.
+  int64_t tree_bytes = -1;
   // 1 if it's "player1", 2 if it's "player2"
   int player = -1;
   // Index of the game in the tournament (0-based).
@@ -92,10 +96,30 @@ struct GameInfo {
   // if resign had of been enabled.
   // Only provided if the game wasn't played with resign enabled.
   optional<float> min_false_positive_threshold;
+  // How the game ended early ("resign", "win_adjudication",
+  // "draw_adjudication"), empty when it was played out.
+  std::string termination;
 
   using Callback = std::function<void(const GameInfo&)>;
 };
 
+// Periodic selfplay performance sample, for capacity planning. Rates are
+// measured over the interval since the previous sample.
+struct SelfPlayPerfInfo {
+  float interval_seconds = 0.0f;
+  int games_in_flight = 0;
+  // Games finished since the tournament started.
+  int games_finished = 0;
+  float moves_per_sec = 0.0f;
+  // Positions actually evaluated by the NN (cache misses).
+  float nn_evals_per_sec = 0.0f;
+  float avg_batch_size = 0.0f;
+  // Finished games queued behind the background training data writer.
+  int writer_backlog = 0;
+
+  using Callback = std::function<void(const SelfPlayPerfInfo&)>;
+};
+
 // Is sent in the end of tournament and also during the tournament.
 struct TournamentInfo {
   // Did tournament finish, so those results are final.
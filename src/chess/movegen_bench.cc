@@ -0,0 +1,115 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark for the chess layer: reports throughput of
+// GeneratePseudolegalMoves(), GenerateLegalMoves() and IsUnderAttack() over
+// a corpus of positions sampled from random playouts. Built as a separate
+// binary (meson benchmark target "MoveGen") so that movegen performance can
+// be tracked independently of search and NN code.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "chess/board.h"
+
+namespace {
+
+using namespace lczero;
+
+const char* kBenchFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+// Gathers a deterministic corpus of positions by random playouts from the
+// positions above, so all three benchmarks see the same mix of openings,
+// middlegames and endgames.
+std::vector<ChessBoard> GatherPositions() {
+  std::vector<ChessBoard> result;
+  std::mt19937 rng(53298);
+  for (const char* fen : kBenchFens) {
+    for (int game = 0; game < 20; ++game) {
+      ChessBoard board;
+      board.SetFromFen(fen);
+      for (int ply = 0; ply < 80; ++ply) {
+        result.push_back(board);
+        auto moves = board.GenerateLegalMoves();
+        if (moves.empty()) break;
+        board.ApplyMove(moves[rng() % moves.size()]);
+        board.Mirror();
+      }
+    }
+  }
+  return result;
+}
+
+template <typename Func>
+void RunBenchmark(const char* name, const std::vector<ChessBoard>& positions,
+                  int rounds, Func func) {
+  // One warmup round to populate caches.
+  std::uint64_t items = 0;
+  for (const auto& board : positions) items += func(board);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::uint64_t total_items = 0;
+  for (int i = 0; i < rounds; ++i) {
+    for (const auto& board : positions) total_items += func(board);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const auto duration_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count();
+
+  std::cout << name << ": " << total_items * 1000000 / duration_us
+            << " items/sec (" << positions.size() * rounds * 1000000ull /
+                                     duration_us
+            << " positions/sec)" << std::endl;
+  (void)items;
+}
+
+}  // namespace
+
+int main() {
+  const auto positions = GatherPositions();
+  std::cout << "Corpus: " << positions.size() << " positions" << std::endl;
+
+  RunBenchmark("GeneratePseudolegalMoves (moves)", positions, 200,
+               [](const ChessBoard& board) {
+                 return board.GeneratePseudolegalMoves().size();
+               });
+  RunBenchmark("GenerateLegalMoves (moves)", positions, 200,
+               [](const ChessBoard& board) {
+                 return board.GenerateLegalMoves().size();
+               });
+  RunBenchmark("IsUnderAttack (all 64 squares)", positions, 200,
+               [](const ChessBoard& board) {
+                 std::uint64_t attacked = 0;
+                 for (int square = 0; square < 64; ++square) {
+                   attacked += board.IsUnderAttack(square);
+                 }
+                 return attacked;
+               });
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chess/perft.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "chess/board.h"
+
+namespace lczero {
+namespace {
+
+struct PerftPosition {
+  const char* name;
+  const char* fen;
+  int depth;
+  std::uint64_t expected_nodes;
+};
+
+// Standard perft positions with well known node counts.
+const PerftPosition kPerftPositions[] = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5,
+     4865609},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4,
+     4085603},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    {"position 4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4,
+     422333},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     4, 2103487},
+    {"position 6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     4, 3894594},
+};
+
+std::uint64_t CountNodes(const ChessBoard& board, int depth) {
+  auto moves = board.GenerateLegalMoves();
+  if (depth == 1) return moves.size();
+  std::uint64_t nodes = 0;
+  for (Move move : moves) {
+    ChessBoard new_board = board;
+    new_board.ApplyMove(move);
+    new_board.Mirror();
+    nodes += CountNodes(new_board, depth - 1);
+  }
+  return nodes;
+}
+
+}  // namespace
+
+void Perft::Run() {
+  std::uint64_t total_nodes = 0;
+  std::uint64_t total_time_ms = 0;
+  bool all_passed = true;
+
+  for (const auto& position : kPerftPositions) {
+    ChessBoard board;
+    board.SetFromFen(position.fen);
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::uint64_t nodes = CountNodes(board, position.depth);
+    const auto end = std::chrono::steady_clock::now();
+    const auto time_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+            .count();
+
+    const bool passed = (nodes == position.expected_nodes);
+    all_passed &= passed;
+    total_nodes += nodes;
+    total_time_ms += time_ms;
+
+    std::cout << position.name << " depth " << position.depth << ": " << nodes
+              << " nodes, " << time_ms << "ms"
+              << (time_ms > 0
+                      ? ", " + std::to_string(nodes * 1000 / time_ms) + " nps"
+                      : "")
+              << (passed ? "" : " FAILED, expected " +
+                                    std::to_string(position.expected_nodes))
+              << std::endl;
+  }
+
+  std::cout << "===========================" << std::endl;
+  std::cout << "Total: " << total_nodes << " nodes, " << total_time_ms << "ms"
+            << (total_time_ms > 0
+                    ? ", " + std::to_string(total_nodes * 1000 / total_time_ms) +
+                          " nps"
+                    : "")
+            << (all_passed ? "" : ", SOME POSITIONS FAILED") << std::endl;
+}
+
+}  // namespace lczero
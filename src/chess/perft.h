@@ -0,0 +1,33 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace lczero {
+
+// Runs perft over a fixed suite of standard positions, checking node counts
+// against known values and reporting nodes per second. Exercises only the
+// chess layer (move generation and make move), so regressions and wins there
+// are visible without NN noise.
+class Perft {
+ public:
+  // Runs the suite. Blocks.
+  void Run();
+};
+
+}  // namespace lczero
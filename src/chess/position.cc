@@ -20,6 +20,10 @@
 #include <cassert>
 
 namespace lczero {
+namespace {
+// Initial size of the repetition hash table. Must be a power of two.
+const size_t kRepetitionTableSize = 512;
+}  // namespace
 
 Position::Position(const Position& parent, Move m)
     : no_capture_ply_(parent.no_capture_ply_ + 1),
@@ -29,6 +33,7 @@ Position::Position(const Position& parent, Move m)
   us_board_ = them_board_;
   us_board_.Mirror();
   if (capture) no_capture_ply_ = 0;
+  board_hash_ = us_board_.Hash();
 }
 
 Position::Position(const ChessBoard& board, int no_capture_ply, int game_ply)
@@ -36,10 +41,11 @@ Position::Position(const ChessBoard& board, int no_capture_ply, int game_ply)
   us_board_ = board;
   them_board_ = board;
   them_board_.Mirror();
+  board_hash_ = us_board_.Hash();
 }
 
 uint64_t Position::Hash() const {
-  return HashCat({us_board_.Hash(), static_cast<unsigned long>(repetitions_)});
+  return HashCat({board_hash_, static_cast<unsigned long>(repetitions_)});
 }
 
 bool Position::CanCastle(Castling castling) const {
@@ -84,6 +90,9 @@ void PositionHistory::Reset(const ChessBoard& board, int no_capture_ply,
                             int game_ply) {
   positions_.clear();
   positions_.emplace_back(board, no_capture_ply, game_ply);
+  rep_table_.assign(kRepetitionTableSize, RepetitionEntry{0, -1});
+  rep_slots_.clear();
+  InsertIntoRepetitionTable(0);
 }
 
 void PositionHistory::Append(Move m) {
@@ -91,22 +100,52 @@ void PositionHistory::Append(Move m) {
   //                has a bug in implementation of emplace_back, when
   //                reallocation happens. (it also reallocates Last())
   positions_.push_back(Position(Last(), m));
+  AddLastToRepetitionTable();
+}
+
+void PositionHistory::AddLastToRepetitionTable() {
+  // Grow to keep the load factor at most 1/2.
+  if (positions_.size() * 2 > rep_table_.size()) {
+    rep_table_.assign(rep_table_.size() * 2, RepetitionEntry{0, -1});
+    rep_slots_.clear();
+    for (size_t idx = 0; idx + 1 < positions_.size(); ++idx) {
+      InsertIntoRepetitionTable(idx);
+    }
+  }
   positions_.back().SetRepetitions(ComputeLastMoveRepetitions());
+  InsertIntoRepetitionTable(positions_.size() - 1);
+}
+
+void PositionHistory::InsertIntoRepetitionTable(int idx) {
+  const uint64_t hash = positions_[idx].GetBoardHash();
+  const size_t mask = rep_table_.size() - 1;
+  size_t slot = hash & mask;
+  while (rep_table_[slot].idx >= 0) slot = (slot + 1) & mask;
+  rep_table_[slot] = RepetitionEntry{hash, idx};
+  rep_slots_.push_back(slot);
 }
 
 int PositionHistory::ComputeLastMoveRepetitions() const {
   const auto& last = positions_.back();
-  // TODO(crem) implement hash/cache based solution.
+  // A repetition needs at least 4 reversible plies.
   if (last.GetNoCapturePly() < 4) return 0;
 
-  for (int idx = positions_.size() - 3; idx >= 0; idx -= 2) {
-    const auto& pos = positions_[idx];
-    if (pos.GetBoard() == last.GetBoard()) {
-      return 1 + pos.GetRepetitions();
+  const uint64_t hash = last.GetBoardHash();
+  const size_t mask = rep_table_.size() - 1;
+  int repetitions = 0;
+  for (size_t slot = hash & mask; rep_table_[slot].idx >= 0;
+       slot = (slot + 1) & mask) {
+    const auto& entry = rep_table_[slot];
+    // Full board comparison guards against hash collisions (and takes care
+    // of side to move, which is part of the board).
+    if (entry.hash == hash &&
+        positions_[entry.idx].GetBoard() == last.GetBoard()) {
+      // Same-hash entries appear along the probe chain in insertion order,
+      // so the last match is the most recent occurrence.
+      repetitions = positions_[entry.idx].GetRepetitions() + 1;
     }
-    if (pos.GetNoCapturePly() < 2) return 0;
   }
-  return 0;
+  return repetitions;
 }
 
 uint64_t PositionHistory::HashLast(int positions) const {
@@ -33,6 +33,8 @@ class Position {
   enum Castling { WE_CAN_OOO, WE_CAN_OO, THEY_CAN_OOO, THEY_CAN_OO };
 
   uint64_t Hash() const;
+  // Hash of the board alone, without repetition counter. Cached, so cheap.
+  uint64_t GetBoardHash() const { return board_hash_; }
   bool IsBlackToMove() const { return us_board_.flipped(); }
 
   // Number of half-moves since beginning of the game.
@@ -64,6 +66,10 @@ class Position {
   // The board from the point of view of opponent.
   ChessBoard them_board_;
 
+  // Hash of us_board_, computed once at construction so that Hash() calls in
+  // the search hot path don't rehash the full bitboard set every time.
+  uint64_t board_hash_ = 0;
+
   // How many half-moves without capture or pawn move was there.
   int no_capture_ply_ = 0;
   // How many repetitions this position had before. For new positions it's 0.
@@ -90,7 +96,7 @@ class PositionHistory {
 
   // Trims position to a given size.
   void Trim(int size) {
-    positions_.erase(positions_.begin() + size, positions_.end());
+    while (static_cast<int>(positions_.size()) > size) Pop();
   }
 
   // Number of positions in history.
@@ -103,7 +109,11 @@ class PositionHistory {
   void Append(Move m);
 
   // Pops last move from history.
-  void Pop() { positions_.pop_back(); }
+  void Pop() {
+    rep_table_[rep_slots_.back()] = RepetitionEntry{0, -1};
+    rep_slots_.pop_back();
+    positions_.pop_back();
+  }
 
   // Finds the endgame state (win/lose/draw/nothing) for the last position.
   GameResult ComputeGameResult() const;
@@ -116,8 +126,26 @@ class PositionHistory {
 
  private:
   int ComputeLastMoveRepetitions() const;
+  // Computes the repetition counter for the last position and adds it to the
+  // repetition table.
+  void AddLastToRepetitionTable();
+  void InsertIntoRepetitionTable(int idx);
 
   std::vector<Position> positions_;
+
+  // Open-addressed table of board hashes of all positions in the history,
+  // so that the repetition check on Append() is a probe instead of a
+  // backward scan over the history. Equal boards can never straddle an
+  // irreversible move (captures and pawn moves are one-way, castling rights
+  // only shrink), so no boundary tracking is needed.
+  struct RepetitionEntry {
+    uint64_t hash;
+    int idx;  // Index in positions_, or -1 for an empty slot.
+  };
+  std::vector<RepetitionEntry> rep_table_;
+  // Table slot used by each position. Pop() removes entries in reverse
+  // insertion order, which keeps linear probe chains intact.
+  std::vector<int> rep_slots_;
 };
 
 }  // namespace lczero
\ No newline at end of file
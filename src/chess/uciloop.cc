@@ -20,9 +20,11 @@
 
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -33,6 +35,15 @@
 namespace lczero {
 
 namespace {
+// Serializes writes to std::cout and to the debug log, which are made both
+// from the dispatch thread and from the input reader thread.
+std::mutex output_mutex;
+
+// Commands that jump ahead of whatever is still waiting in the queue, so
+// that e.g. "stop" is not stuck behind a blocking "isready".
+const std::unordered_set<std::string> kUrgentCommands = {"stop", "ponderhit",
+                                                         "quit"};
+
 const std::unordered_map<std::string, std::unordered_set<std::string>>
     kKnownCommands = {
         {{"uci"}, {}},
@@ -42,9 +53,12 @@ const std::unordered_map<std::string, std::unordered_set<std::string>>
         {{"position"}, {"fen", "startpos", "moves"}},
         {{"go"},
          {"infinite", "wtime", "btime", "winc", "binc", "movestogo", "depth",
-          "nodes", "movetime", "searchmoves"}},
+          "nodes", "movetime", "searchmoves", "ponder"}},
+        {{"ponderhit"}, {}},
         {{"start"}, {}},
         {{"stop"}, {}},
+        {{"savetree"}, {"file"}},
+        {{"loadtree"}, {"file"}},
         {{"quit"}, {}},
 };
 
@@ -115,18 +129,87 @@ bool ContainsKey(const std::unordered_map<std::string, std::string>& params,
 
 void UciLoop::RunLoop() {
   std::cout.setf(std::ios::unitbuf);
+  std::thread reader([this]() { ReaderLoop(); });
+  ParsedCommand command;
+  while (WaitForCommand(&command)) {
+    try {
+      if (!DispatchCommand(command.name, command.params)) break;
+    } catch (Exception& ex) {
+      SendResponse(std::string("error ") + ex.what());
+    }
+  }
+  reader.join();
+}
+
+bool UciLoop::ProcessCommand(const std::string& line) {
+  try {
+    auto parsed = ParseCommand(line);
+    // Ignore empty line.
+    if (parsed.first.empty()) return true;
+    return DispatchCommand(parsed.first, parsed.second);
+  } catch (Exception& ex) {
+    SendResponse(std::string("error ") + ex.what());
+  }
+  return true;
+}
+
+void UciLoop::ReaderLoop() {
   std::string line;
   while (std::getline(std::cin, line)) {
-    if (debug_log_) debug_log_ << '>' << line << std::endl << std::flush;
+    {
+      std::lock_guard<std::mutex> lock(output_mutex);
+      if (debug_log_) debug_log_ << '>' << line << std::endl << std::flush;
+    }
+    ParsedCommand command;
     try {
-      auto command = ParseCommand(line);
+      auto parsed = ParseCommand(line);
       // Ignore empty line.
-      if (command.first.empty()) continue;
-      if (!DispatchCommand(command.first, command.second)) break;
+      if (parsed.first.empty()) continue;
+      command.name = parsed.first;
+      command.params = std::move(parsed.second);
     } catch (Exception& ex) {
+      // Report parse errors from here so they don't wait in the queue.
       SendResponse(std::string("error ") + ex.what());
+      continue;
     }
+    const bool urgent = kUrgentCommands.count(command.name) != 0;
+    const bool quit = command.name == "quit";
+    EnqueueCommand(std::move(command), urgent);
+    // Stop reading after "quit" so the thread is joinable even if the GUI
+    // keeps stdin open.
+    if (quit) return;
+  }
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  reader_done_ = true;
+  queue_cv_.notify_one();
+}
+
+void UciLoop::EnqueueCommand(ParsedCommand command, bool urgent) {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  if (urgent) {
+    // Jump ahead of everything still queued except a "go" that hasn't been
+    // dispatched yet (stop/ponderhit refer to the most recently issued
+    // search and must not overtake it) and earlier urgent commands, whose
+    // relative order has to be kept.
+    auto iter = queue_.end();
+    while (iter != queue_.begin() && std::prev(iter)->name != "go" &&
+           kUrgentCommands.count(std::prev(iter)->name) == 0) {
+      --iter;
+    }
+    queue_.insert(iter, std::move(command));
+  } else {
+    queue_.push_back(std::move(command));
   }
+  queue_cv_.notify_one();
+}
+
+bool UciLoop::WaitForCommand(ParsedCommand* command) {
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  queue_cv_.wait(lock, [this]() { return !queue_.empty() || reader_done_; });
+  if (queue_.empty()) return false;
+  *command = std::move(queue_.front());
+  queue_.pop_front();
+  return true;
 }
 
 bool UciLoop::DispatchCommand(
@@ -156,6 +239,12 @@ bool UciLoop::DispatchCommand(
       }
       go_params.infinite = true;
     }
+    if (ContainsKey(params, "ponder")) {
+      if (!GetOrEmpty(params, "ponder").empty()) {
+        throw Exception("Unexpected token " + GetOrEmpty(params, "ponder"));
+      }
+      go_params.ponder = true;
+    }
     if (ContainsKey(params, "searchmoves")) {
       go_params.searchmoves =
           StrSplitAtWhitespace(GetOrEmpty(params, "searchmoves"));
@@ -176,6 +265,12 @@ bool UciLoop::DispatchCommand(
     CmdGo(go_params);
   } else if (command == "stop") {
     CmdStop();
+  } else if (command == "ponderhit") {
+    CmdPonderHit();
+  } else if (command == "savetree") {
+    CmdSaveTree(GetOrEmpty(params, "file"));
+  } else if (command == "loadtree") {
+    CmdLoadTree(GetOrEmpty(params, "file"));
   } else if (command == "start") {
     CmdStart();
   } else if (command == "quit") {
@@ -199,7 +294,6 @@ void UciLoop::SendResponse(const std::string& response) {
 }
 
 void UciLoop::SendResponses(const std::vector<std::string>& responses) {
-  static std::mutex output_mutex;
   std::lock_guard<std::mutex> lock(output_mutex);
   for (auto& response : responses) {
     if (debug_log_) debug_log_ << '<' << response << std::endl << std::flush;
@@ -230,6 +324,7 @@ void UciLoop::SendInfo(const ThinkingInfo& info) {
     res += " side " + std::string(*info.is_black ? "black" : "white");
   if (info.depth >= 0) res += " depth " + std::to_string(info.depth);
   if (info.seldepth >= 0) res += " seldepth " + std::to_string(info.seldepth);
+  if (info.multipv >= 0) res += " multipv " + std::to_string(info.multipv);
   if (info.time >= 0) res += " time " + std::to_string(info.time);
   if (info.nodes >= 0) res += " nodes " + std::to_string(info.nodes);
   if (info.score) res += " score cp " + std::to_string(*info.score);
@@ -240,7 +335,13 @@ void UciLoop::SendInfo(const ThinkingInfo& info) {
     res += " pv";
     for (const auto& move : info.pv) res += " " + move.as_string();
   }
-  if (!info.comment.empty()) res += " string " + info.comment;
+  // Both go into the "string" segment so that GUIs which only understand
+  // the standard tokens are not confused.
+  if (!info.comment.empty()) {
+    res += " string " + info.comment;
+  } else if (info.tree_bytes >= 0) {
+    res += " string tree " + std::to_string(info.tree_bytes >> 20) + "mb";
+  }
   SendResponse(res);
 }
 
@@ -18,7 +18,10 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -37,6 +40,7 @@ struct GoParams {
   int nodes = -1;
   std::int64_t movetime = -1;
   bool infinite = false;
+  bool ponder = false;
   std::vector<std::string> searchmoves;
 };
 
@@ -45,6 +49,11 @@ class UciLoop {
   virtual ~UciLoop() {}
   virtual void RunLoop();
 
+  // Parses and dispatches a single command line, reporting errors the same
+  // way RunLoop() does. Returns false after "quit". For callers that drive
+  // the loop from their own input source instead of stdin.
+  bool ProcessCommand(const std::string& line);
+
   // Sends response to host.
   void SendResponse(const std::string& response);
   // Sends responses to host ensuring they are received as a block.
@@ -70,16 +79,42 @@ class UciLoop {
     throw Exception("Not supported");
   }
   virtual void CmdStop() { throw Exception("Not supported"); }
+  virtual void CmdPonderHit() { throw Exception("Not supported"); }
   virtual void CmdStart() { throw Exception("Not supported"); }
+  virtual void CmdSaveTree(const std::string& /*file*/) {
+    throw Exception("Not supported");
+  }
+  virtual void CmdLoadTree(const std::string& /*file*/) {
+    throw Exception("Not supported");
+  }
 
   void SetLogFilename(const std::string& filename);
 
  private:
+  struct ParsedCommand {
+    std::string name;
+    std::unordered_map<std::string, std::string> params;
+  };
+
   bool DispatchCommand(
       const std::string& command,
       const std::unordered_map<std::string, std::string>& params);
 
+  // Runs on a separate thread: reads and parses stdin, feeding the command
+  // queue. Returns after enqueueing "quit" or on EOF so that it can be
+  // joined without interrupting a blocking read.
+  void ReaderLoop();
+  void EnqueueCommand(ParsedCommand command, bool urgent);
+  // Blocks until a command is available. Returns false when the input is
+  // exhausted and the queue has been drained.
+  bool WaitForCommand(ParsedCommand* command);
+
   std::ofstream debug_log_;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<ParsedCommand> queue_;
+  bool reader_done_ = false;
 };
 
 }  // namespace lczero
@@ -19,11 +19,14 @@
 #include <algorithm>
 #include <cmath>
 #include <functional>
+#include <iostream>
 
 #include "engine.h"
 #include "mcts/search.h"
+#include "neural/autotune.h"
 #include "neural/factory.h"
 #include "neural/loader.h"
+#include "utils/slabpool.h"
 
 namespace lczero {
 namespace {
@@ -37,6 +40,10 @@ const char* kDebugLogStr = "Do debug logging into file";
 const char* kWeightsStr = "Network weights file path";
 const char* kNnBackendStr = "NN backend to use";
 const char* kNnBackendOptionsStr = "NN backend parameters";
+const char* kNnBackendSpecStr = "NN backend composition spec";
+const char* kNnCacheFileStr = "NNCache save/restore file";
+const char* kSyzygyTablebaseStr = "List of Syzygy tablebase directories";
+const char* kTreeMemModeStr = "Memory backing the search tree";
 const char* kSlowMoverStr = "Scale thinking time";
 const char* kMoveOverheadStr = "Move time overhead in milliseconds";
 const char* kTimeCurvePeak = "Time weight curve peak ply";
@@ -60,6 +67,7 @@ EngineController::EngineController(BestMoveInfo::Callback best_move_callback,
                                    ThinkingInfo::Callback info_callback,
                                    const OptionsDict& options)
     : options_(options),
+      search_options_(&options),
       best_move_callback_(best_move_callback),
       info_callback_(info_callback) {}
 
@@ -70,13 +78,24 @@ void EngineController::PopulateOptions(OptionsParser* options) {
   options->Add<IntOption>(kThreadsOption, 1, 128, "threads", 't') =
       kDefaultThreads;
   options->Add<IntOption>(
-      "NNCache size", 0, 999999999, "nncache", '\0',
-      std::bind(&EngineController::SetCacheSize, this, _1)) = 200000;
+      "NNCache size MB", 0, 65536, "nncache", '\0',
+      std::bind(&EngineController::SetCacheSize, this, _1)) = 48;
+  options->Add<StringOption>(kNnCacheFileStr, "nncache-file");
+  options->Add<StringOption>(kSyzygyTablebaseStr, "syzygy-paths", 's');
+  // How node/edge slabs are allocated, see SlabPool::MemoryMode. The
+  // huge-page modes help on NUMA machines; Linux only.
+  options->Add<ChoiceOption>(
+      kTreeMemModeStr,
+      std::vector<std::string>{"malloc", "huge-pages", "huge-pages-interleave"},
+      "tree-mem-mode", '\0', SlabPool::SetMemoryModeByName) = "malloc";
 
   const auto backends = NetworkFactory::Get()->GetBackendsList();
   options->Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
       backends.empty() ? "<none>" : backends[0];
   options->Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+  // When set, overrides --backend/--backend-opts with a composition spec,
+  // see NetworkFactory::CreateFromSpec.
+  options->Add<StringOption>(kNnBackendSpecStr, "backend-spec");
   options->Add<FloatOption>(kSlowMoverStr, 0.0f, 100.0f, "slowmover") = 1.95f;
   options->Add<IntOption>(kMoveOverheadStr, 0, 10000, "move-overhead") = 100;
   options->Add<FloatOption>(kTimeCurvePeak, -1000.0f, 1000.0f,
@@ -155,19 +174,39 @@ SearchLimits EngineController::PopulateSearchLimits(int ply, bool is_black,
   return limits;
 }
 
+void EngineController::UpdateTablebases() {
+  const std::string paths = options_.Get<std::string>(kSyzygyTablebaseStr);
+  if (paths == syzygy_paths_) return;
+  syzygy_paths_ = paths;
+  syzygy_tb_.reset();
+  if (paths.empty()) return;
+  auto tb = std::make_unique<SyzygyTablebase>();
+  if (!tb->Init(paths)) {
+    std::cerr << "No Syzygy tablebases found in " << paths << "." << std::endl;
+    return;
+  }
+  syzygy_tb_ = std::move(tb);
+}
+
 void EngineController::UpdateNetwork() {
   SharedLock lock(busy_mutex_);
+  UpdateTablebases();
+  // With a shared backend the weights/backend options belong to the hosting
+  // server, not to this session.
+  if (shared_network_) return;
   std::string network_path = options_.Get<std::string>(kWeightsStr);
   std::string backend = options_.Get<std::string>(kNnBackendStr);
   std::string backend_options = options_.Get<std::string>(kNnBackendOptionsStr);
+  std::string backend_spec = options_.Get<std::string>(kNnBackendSpecStr);
 
   if (network_path == network_path_ && backend == backend_ &&
-      backend_options == backend_options_)
+      backend_options == backend_options_ && backend_spec == backend_spec_)
     return;
 
   network_path_ = network_path;
   backend_ = backend;
   backend_options_ = backend_options;
+  backend_spec_ = backend_spec;
 
   std::string net_path = network_path;
   if (net_path == kAutoDiscover) {
@@ -175,37 +214,150 @@ void EngineController::UpdateNetwork() {
   }
   Weights weights = LoadWeightsFromFile(net_path);
 
-  OptionsDict network_options =
-      OptionsDict::FromString(backend_options, &options_);
+  if (!backend_spec.empty()) {
+    network_ =
+        NetworkFactory::Get()->CreateFromSpec(backend_spec, weights, &options_);
+  } else {
+    OptionsDict network_options =
+        OptionsDict::FromString(backend_options, &options_);
+    network_ = NetworkFactory::Get()->Create(backend, weights, network_options);
+  }
+  weights_hash_ = HashWeights(weights);
+
+  // minibatch-size 0 means auto: probe the freshly loaded backend for its
+  // throughput knee and override what the search will read. max-prefetch
+  // scales along, keeping the 256:32 proportion of the tuned defaults.
+  if (options_.Get<int>(Search::kMiniBatchSizeStr) == 0) {
+    const int batch_size = AutotuneMiniBatchSize(network_.get());
+    search_options_.Set<int>(Search::kMiniBatchSizeStr, batch_size);
+    search_options_.Set<int>(Search::kMaxPrefetchBatchStr,
+                             std::max(1, batch_size / 8));
+    std::cerr << "Autotuned minibatch size " << batch_size << "." << std::endl;
+  }
+
+  // Warm-start the NN cache from disk if a cache file is configured. A
+  // missing file (first run) or one saved with a different net is not an
+  // error; a fresh file is written on shutdown.
+  const std::string cache_file = options_.Get<std::string>(kNnCacheFileStr);
+  if (!cache_file.empty() && !cache_file_loaded_) {
+    cache_file_loaded_ = true;
+    try {
+      LoadCacheFromFile(&cache_, cache_file, weights_hash_);
+    } catch (Exception& ex) {
+      std::cerr << "Not restoring NN cache: " << ex.what() << std::endl;
+    }
+  }
+}
+
+void EngineController::WarmupNetwork() {
+  if (!network_) return;
+  auto computation = network_->NewComputation();
+  computation->AddInput(InputPlanes(kInputPlanes));
+  computation->ComputeBlocking();
+}
+
+void EngineController::PreloadNetwork() {
+  preload_ = std::async(std::launch::async, [this]() {
+    try {
+      UpdateNetwork();
+      WarmupNetwork();
+    } catch (std::exception& ex) {
+      // Not fatal: the GUI may still configure a usable weights path or
+      // backend. Reset the change tracking so that the next
+      // UpdateNetwork() retries from scratch.
+      std::cerr << "Network preload failed: " << ex.what() << std::endl;
+      network_path_.clear();
+      backend_.clear();
+      backend_options_.clear();
+      backend_spec_.clear();
+      network_.reset();
+    }
+  });
+}
 
-  network_ = NetworkFactory::Get()->Create(backend, weights, network_options);
+void EngineController::WaitForPreload() {
+  // The preload catches its own errors, so this never throws.
+  if (preload_.valid()) preload_.get();
 }
 
-void EngineController::SetCacheSize(int size) { cache_.SetCapacity(size); }
+void EngineController::SaveCacheFile() {
+  const std::string cache_file = options_.Get<std::string>(kNnCacheFileStr);
+  if (cache_file.empty() || !weights_hash_) return;
+  try {
+    SaveCacheToFile(cache_, cache_file, weights_hash_);
+  } catch (Exception& ex) {
+    std::cerr << "Not saving NN cache: " << ex.what() << std::endl;
+  }
+}
+
+void EngineController::SetCacheSize(int size_mb) {
+  // A shared cache is sized by its owner; one session must not resize it
+  // under the others.
+  if (shared_cache_) return;
+  cache_.SetCapacity(static_cast<int64_t>(size_mb) * 1024 * 1024);
+}
+
+void EngineController::SetSharedContext(Network* network, NNCache* cache,
+                                        int minibatch_size) {
+  shared_network_ = network;
+  shared_cache_ = cache;
+  // The shared path skips UpdateNetwork(), and with it the minibatch
+  // autotuning, so the server injects the size it probed once at startup
+  // the same way the autotune path would.
+  if (minibatch_size > 0) {
+    search_options_.Set<int>(Search::kMiniBatchSizeStr, minibatch_size);
+    search_options_.Set<int>(Search::kMaxPrefetchBatchStr,
+                             std::max(1, minibatch_size / 8));
+  }
+}
 
 void EngineController::EnsureReady() {
+  WaitForPreload();
   UpdateNetwork();
   std::unique_lock<RpSharedMutex> lock(busy_mutex_);
 }
 
 void EngineController::NewGame() {
+  WaitForPreload();
   SharedLock lock(busy_mutex_);
-  cache_.Clear();
+  // The shared cache outlives games on purpose: popular openings stay warm
+  // across all sessions.
+  if (!shared_cache_) cache_.Clear();
   search_.reset();
   tree_.reset();
+  last_position_fen_.clear();
+  last_position_moves_.clear();
   UpdateNetwork();
 }
 
 void EngineController::SetPosition(const std::string& fen,
                                    const std::vector<std::string>& moves_str) {
+  WaitForPreload();
   SharedLock lock(busy_mutex_);
   search_.reset();
 
   if (!tree_) tree_ = std::make_unique<NodeTree>();
 
-  std::vector<Move> moves;
-  for (const auto& move : moves_str) moves.emplace_back(move);
-  tree_->ResetToPosition(fen, moves);
+  // GUIs resend the position before every search, with the same starting fen
+  // and a move list one or two plies longer than the previous command. If the
+  // new command extends the previous one, apply only the new moves instead of
+  // replaying (and re-hashing) the whole game, which is quadratic over a long
+  // game.
+  if (tree_->GetGameBeginNode() && fen == last_position_fen_ &&
+      moves_str.size() >= last_position_moves_.size() &&
+      std::equal(last_position_moves_.begin(), last_position_moves_.end(),
+                 moves_str.begin())) {
+    for (auto iter = moves_str.begin() + last_position_moves_.size();
+         iter != moves_str.end(); ++iter) {
+      tree_->MakeMove(Move(*iter));
+    }
+  } else {
+    std::vector<Move> moves;
+    for (const auto& move : moves_str) moves.emplace_back(move);
+    tree_->ResetToPosition(fen, moves);
+  }
+  last_position_fen_ = fen;
+  last_position_moves_ = moves_str;
   UpdateNetwork();
 }
 
@@ -214,16 +366,39 @@ void EngineController::Go(const GoParams& params) {
     SetPosition(ChessBoard::kStartingFen, {});
   }
 
-  auto limits = PopulateSearchLimits(tree_->GetPlyCount(),
-                                     tree_->IsBlackToMove(), params);
+  last_go_params_ = params;
+  pondering_ = params.ponder;
+
+  SearchLimits limits;
+  if (params.ponder) {
+    // A ponder search runs unbounded; PonderHit() applies the real limits
+    // to the running search. The GUI has already sent the position with the
+    // expected move appended.
+    limits.infinite = true;
+  } else {
+    limits = PopulateSearchLimits(tree_->GetPlyCount(), tree_->IsBlackToMove(),
+                                  params);
+  }
 
-  search_ =
-      std::make_unique<Search>(*tree_, network_.get(), best_move_callback_,
-                               info_callback_, limits, options_, &cache_);
+  search_ = std::make_unique<Search>(
+      *tree_, shared_network_ ? shared_network_ : network_.get(),
+      best_move_callback_, info_callback_, limits, search_options_,
+      shared_cache_ ? shared_cache_ : &cache_, syzygy_tb_.get());
 
   search_->StartThreads(options_.Get<int>(kThreadsOption));
 }
 
+void EngineController::PonderHit() {
+  if (!search_ || !pondering_) return;
+  pondering_ = false;
+  GoParams params = last_go_params_;
+  params.ponder = false;
+  // Same search, same tree, batches in flight and all; only the limits and
+  // the clock change.
+  search_->SetLimits(PopulateSearchLimits(tree_->GetPlyCount(),
+                                          tree_->IsBlackToMove(), params));
+}
+
 void EngineController::Stop() {
   if (search_) {
     search_->Stop();
@@ -231,6 +406,30 @@ void EngineController::Stop() {
   }
 }
 
+void EngineController::SaveTree(const std::string& filename) {
+  SharedLock lock(busy_mutex_);
+  if (filename.empty()) throw Exception("savetree requires a file name");
+  Stop();
+  if (!tree_) throw Exception("No tree to save, search something first");
+  tree_->SaveToFile(filename);
+}
+
+void EngineController::LoadTree(const std::string& filename) {
+  SharedLock lock(busy_mutex_);
+  if (filename.empty()) throw Exception("loadtree requires a file name");
+  Stop();
+  search_.reset();
+  if (!tree_) {
+    tree_ = std::make_unique<NodeTree>();
+    tree_->ResetToPosition(ChessBoard::kStartingFen, {});
+    // The tree no longer corresponds to the last position command, so the
+    // next one must not take the incremental path.
+    last_position_fen_.clear();
+    last_position_moves_.clear();
+  }
+  tree_->LoadFromFile(filename);
+}
+
 EngineLoop::EngineLoop()
     : engine_(std::bind(&UciLoop::SendBestMove, this, std::placeholders::_1),
               std::bind(&UciLoop::SendInfo, this, std::placeholders::_1),
@@ -243,6 +442,10 @@ EngineLoop::EngineLoop()
 
 void EngineLoop::RunLoop() {
   if (!options_.ProcessAllFlags()) return;
+  // Start loading the network now, so the handshake below overlaps the
+  // multi-second weight loading, backend build and (OpenCL) tuning, and
+  // "isready" only waits for whatever is left of it.
+  engine_.PreloadNetwork();
   UciLoop::RunLoop();
 }
 
@@ -261,6 +464,10 @@ void EngineLoop::CmdIsReady() {
 
 void EngineLoop::CmdSetOption(const std::string& name, const std::string& value,
                               const std::string& context) {
+  // The preload reads options on its thread; let it finish before
+  // mutating them. A GUI that reconfigures the backend invalidates the
+  // preloaded one anyway.
+  engine_.WaitForPreload();
   options_.SetOption(name, value, context);
   if (options_sent_) {
     options_.SendOption(name);
@@ -292,6 +499,19 @@ void EngineLoop::CmdGo(const GoParams& params) {
   engine_.Go(params);
 }
 
+void EngineLoop::CmdPonderHit() { engine_.PonderHit(); }
+
 void EngineLoop::CmdStop() { engine_.Stop(); }
 
+void EngineLoop::CmdSaveTree(const std::string& file) {
+  engine_.SaveTree(file);
+  SendResponse("savetree ok");
+}
+
+void EngineLoop::CmdLoadTree(const std::string& file) {
+  EnsureOptionsSent();
+  engine_.LoadTree(file);
+  SendResponse("loadtree ok");
+}
+
 }  // namespace lczero
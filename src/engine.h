@@ -18,10 +18,13 @@
 
 #pragma once
 
+#include <future>
+
 #include "chess/uciloop.h"
 #include "mcts/search.h"
 #include "neural/cache.h"
 #include "neural/network.h"
+#include "syzygy/syzygy.h"
 #include "utils/mutex.h"
 #include "utils/optionsparser.h"
 
@@ -38,13 +41,31 @@ class EngineController {
                    const OptionsDict& options);
 
   ~EngineController() {
+    WaitForPreload();
     // Make sure search is destructed first, and it still may be running in
     // a separate thread.
     search_.reset();
+    SaveCacheFile();
   }
 
   void PopulateOptions(OptionsParser* options);
 
+  // Serves searches from an externally owned network and cache instead of
+  // loading its own, for a server hosting several sessions in one process.
+  // @minibatch_size, when positive, overrides the minibatch/prefetch search
+  // settings the way startup autotuning would. Must be called before the
+  // first search.
+  void SetSharedContext(Network* network, NNCache* cache, int minibatch_size);
+
+  // Starts loading the weights, building the backend and warming it up on
+  // a background thread, so that the UCI handshake overlaps the
+  // multi-second startup work. Called once, after command line flags are
+  // processed.
+  void PreloadNetwork();
+  // Blocks until a pending preload is finished. Failures are logged by the
+  // preload itself and retried by the next UpdateNetwork().
+  void WaitForPreload();
+
   // Blocks.
   void EnsureReady();
 
@@ -57,23 +78,44 @@ class EngineController {
 
   // Must not block.
   void Go(const GoParams& params);
+  // Must not block. Converts a running ponder search into a normal one.
+  void PonderHit();
   // Must not block.
   void Stop();
-  void SetCacheSize(int size);
+  void SetCacheSize(int size_mb);
+
+  // Blocks. Writes the tree under the current position to @filename.
+  void SaveTree(const std::string& filename);
+  // Blocks. Restores a tree saved from the current position.
+  void LoadTree(const std::string& filename);
 
   SearchLimits PopulateSearchLimits(int ply, bool is_black,
                                     const GoParams& params);
 
  private:
   void UpdateNetwork();
+  // Runs one inference so that lazy per-thread allocations and kernel
+  // selection happen at startup and not on the first real search.
+  void WarmupNetwork();
+  // (Re)loads the Syzygy tablebases when the configured paths change.
+  void UpdateTablebases();
+  // Saves the NN cache to the configured cache file, if any. Called on
+  // destruction; load happens in UpdateNetwork, when the net hash is known.
+  void SaveCacheFile();
 
   const OptionsDict& options_;
+  // Overlay over options_ holding values resolved at runtime (e.g. the
+  // autotuned minibatch size); searches read through this.
+  OptionsDict search_options_;
 
   BestMoveInfo::Callback best_move_callback_;
   ThinkingInfo::Callback info_callback_;
 
   NNCache cache_;
   std::unique_ptr<Network> network_;
+  // Non-null only when tablebases were found at the configured paths.
+  std::unique_ptr<SyzygyTablebase> syzygy_tb_;
+  std::string syzygy_paths_;
 
   // Locked means that there is some work to wait before responding readyok.
   RpSharedMutex busy_mutex_;
@@ -82,11 +124,36 @@ class EngineController {
   std::unique_ptr<Search> search_;
   std::unique_ptr<NodeTree> tree_;
 
+  // Whether the current search is a ponder search, and the "go" parameters
+  // to derive real limits from when ponderhit arrives.
+  bool pondering_ = false;
+  GoParams last_go_params_;
+
+  // The previous position command, so that a command extending it by a few
+  // moves can be applied incrementally instead of replaying the whole game.
+  std::string last_position_fen_;
+  std::vector<std::string> last_position_moves_;
+
   // Store current network settings to track when they change so that they
   // are reloaded.
   std::string network_path_;
   std::string backend_;
   std::string backend_options_;
+  std::string backend_spec_;
+
+  // Hash of the loaded weights, keying the cache file; 0 until a network
+  // has been loaded. The file is only restored once per process.
+  uint64_t weights_hash_ = 0;
+  bool cache_file_loaded_ = false;
+
+  // Externally owned network and cache (see SetSharedContext). When set,
+  // the controller neither loads a network nor resizes or persists the
+  // cache.
+  Network* shared_network_ = nullptr;
+  NNCache* shared_cache_ = nullptr;
+
+  // The background startup initialization, valid while it is in flight.
+  std::future<void> preload_;
 };
 
 class EngineLoop : public UciLoop {
@@ -102,13 +169,20 @@ class EngineLoop : public UciLoop {
   void CmdPosition(const std::string& position,
                    const std::vector<std::string>& moves) override;
   void CmdGo(const GoParams& params) override;
+  void CmdPonderHit() override;
   void CmdStop() override;
+  void CmdSaveTree(const std::string& file) override;
+  void CmdLoadTree(const std::string& file) override;
 
  private:
   void EnsureOptionsSent();
 
   OptionsParser options_;
   bool options_sent_ = false;
+
+ protected:
+  // Declared after options_: the constructor hands the engine a reference
+  // to the parsed options.
   EngineController engine_;
 };
 
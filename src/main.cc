@@ -17,11 +17,38 @@
 */
 
 #include <iostream>
+#include "benchmark/backendbench.h"
+#include "benchmark/benchmark.h"
+#include "chess/perft.h"
 #include "engine.h"
+#include "neural/evaluator.h"
+#include "neural/repacker.h"
+#include "neural/loader.h"
+#ifndef _WIN32
+#include "neural/network_shm.h"
+#endif
 #include "selfplay/loop.h"
+#include "server.h"
 #include "utils/commandline.h"
+#include "utils/optionsparser.h"
 #include "version.h"
 
+namespace {
+const char* kInputWeightsStr = "Input network weights file path";
+const char* kOutputWeightsStr = "Output binary weights file path";
+
+void RunConvertMode() {
+  using namespace lczero;
+  OptionsParser options;
+  options.Add<StringOption>(kInputWeightsStr, "input", 'i');
+  options.Add<StringOption>(kOutputWeightsStr, "output", 'o');
+  if (!options.ProcessAllFlags()) return;
+  const auto& option_dict = options.GetOptionsDict();
+  ConvertWeightsToBinaryFile(option_dict.Get<std::string>(kInputWeightsStr),
+                             option_dict.Get<std::string>(kOutputWeightsStr));
+}
+}  // namespace
+
 int main(int argc, const char** argv) {
   std::cerr << "       _" << std::endl;
   std::cerr << "|   _ | |" << std::endl;
@@ -30,11 +57,65 @@ int main(int argc, const char** argv) {
   CommandLine::Init(argc, argv);
   CommandLine::RegisterMode("uci", "(default) Act as UCI engine");
   CommandLine::RegisterMode("selfplay", "Play games with itself");
+  CommandLine::RegisterMode("benchmark",
+                            "Measure search speed on fixed positions");
+  CommandLine::RegisterMode("backendbench",
+                            "Measure raw NN backend speed over batch sizes");
+  CommandLine::RegisterMode("perft",
+                            "Check and time move generation on standard "
+                            "perft positions");
+  CommandLine::RegisterMode("eval",
+                            "Evaluate positions from a file with the NN");
+  CommandLine::RegisterMode("server",
+                            "Host multiple analysis sessions sharing one "
+                            "backend and cache");
+  CommandLine::RegisterMode("repack",
+                            "Validate, dedup and repack training chunks "
+                            "into shards");
+  CommandLine::RegisterMode("convert",
+                            "Convert a weights file to the binary format");
+#ifndef _WIN32
+  CommandLine::RegisterMode("backendserver",
+                            "Serve NN evals to local processes using the "
+                            "\"shm\" backend");
+#endif
 
   if (CommandLine::ConsumeCommand("selfplay")) {
     // Selfplay mode.
     SelfPlayLoop loop;
     loop.RunLoop();
+  } else if (CommandLine::ConsumeCommand("benchmark")) {
+    // Benchmark mode.
+    Benchmark benchmark;
+    benchmark.Run();
+  } else if (CommandLine::ConsumeCommand("backendbench")) {
+    // Raw backend benchmark mode.
+    BackendBenchmark backendbench;
+    backendbench.Run();
+  } else if (CommandLine::ConsumeCommand("perft")) {
+    // Perft mode.
+    Perft perft;
+    perft.Run();
+  } else if (CommandLine::ConsumeCommand("eval")) {
+    // Bulk offline evaluation mode.
+    BulkEvaluator evaluator;
+    evaluator.Run();
+  } else if (CommandLine::ConsumeCommand("server")) {
+    // Multi-session analysis server mode.
+    AnalysisServer server;
+    server.RunLoop();
+  } else if (CommandLine::ConsumeCommand("repack")) {
+    // Training chunk repacking mode.
+    ChunkRepacker repacker;
+    repacker.Run();
+  } else if (CommandLine::ConsumeCommand("convert")) {
+    // Weights conversion mode.
+    RunConvertMode();
+#ifndef _WIN32
+  } else if (CommandLine::ConsumeCommand("backendserver")) {
+    // Shared memory NN serving mode.
+    RunBackendServer();
+#endif
   } else {
     // Consuming optional "uci" mode.
     CommandLine::ConsumeCommand("uci");
@@ -22,15 +22,79 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <new>
 #include <sstream>
 #include <thread>
 #include "neural/encoder.h"
 #include "neural/network.h"
+#include "utils/exception.h"
 #include "utils/hashcat.h"
+#include "utils/slabpool.h"
 
 namespace lczero {
 
+// The tree is the dominant memory consumer during analysis, so keep the
+// compact layout from regressing by accident.
+static_assert(sizeof(Edge) == 4, "Edge should be 4 bytes");
+static_assert(sizeof(Node) == 64, "Node should fit into one cache line");
+
+/////////////////////////////////////////////////////////////////////////
+// Slab pools for nodes and edges
+/////////////////////////////////////////////////////////////////////////
+
+namespace {
+// Pools are process-wide rather than owned by NodeTree, as subtrees are
+// detached and released on the GC thread while the next search is already
+// allocating.
+SlabPool gNodePool(sizeof(Node));
+// Nodes currently alive. Maintained in Node's operator new/delete, so it
+// also covers nodes queued for (but not yet processed by) the GC thread.
+std::atomic<int64_t> gNodeCount{0};
+// Edges currently alive, and bytes currently carved out of the pools for
+// nodes and edge arrays (the pool block is charged, not the requested
+// size, so the numbers match what the tree actually consumes).
+std::atomic<int64_t> gEdgeCount{0};
+std::atomic<int64_t> gTreeBytes{0};
+std::atomic<int64_t> gTreeBytesPeak{0};
+
+// Bytes of the pool block serving an edge array of @count edges. Mirrors
+// the size class selection in GetEdgePool().
+int64_t EdgeBlockBytes(uint16_t count) {
+  int idx = 0;
+  while ((1 << idx) < count) ++idx;
+  return (1 << idx) * static_cast<int64_t>(sizeof(Edge));
+}
+
+void AddTreeBytes(int64_t bytes) {
+  const int64_t now =
+      gTreeBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = gTreeBytesPeak.load(std::memory_order_relaxed);
+  while (now > peak && !gTreeBytesPeak.compare_exchange_weak(
+                           peak, now, std::memory_order_relaxed)) {
+  }
+}
+
+// Edge arrays are pooled by power-of-two size class; index i serves arrays
+// of up to (1 << i) edges. No position has more than 256 legal moves.
+SlabPool* GetEdgePool(uint16_t count) {
+  // Deliberately leaked: this lazy static would otherwise be destroyed before
+  // gNodeGc, whose destructor still returns edge arrays of queued subtrees.
+  static std::vector<std::unique_ptr<SlabPool>>& pools =
+      *new std::vector<std::unique_ptr<SlabPool>>([]() {
+        std::vector<std::unique_ptr<SlabPool>> res;
+        for (int i = 0; (1 << i) <= 256; ++i) {
+          res.push_back(std::make_unique<SlabPool>((1 << i) * sizeof(Edge)));
+        }
+        return res;
+      }());
+  int idx = 0;
+  while ((1 << idx) < count) ++idx;
+  return pools[idx].get();
+}
+}  // namespace
+
 /////////////////////////////////////////////////////////////////////////
 // Node garbage collector
 /////////////////////////////////////////////////////////////////////////
@@ -38,6 +102,8 @@ namespace lczero {
 namespace {
 // Periodicity of garbage collection, milliseconds.
 const int kGCIntervalMs = 100;
+// How many nodes to dismantle per pass before checking the stop flag again.
+const int kGCNodesPerChunk = 100000;
 
 // Every kGCIntervalMs milliseconds release nodes in a separate GC thread.
 class NodeGarbageCollector {
@@ -71,6 +137,31 @@ class NodeGarbageCollector {
         node_to_gc = std::move(subtrees_to_gc_.back());
         subtrees_to_gc_.pop_back();
       }
+      DismantleSubtree(std::move(node_to_gc));
+    }
+  }
+
+  // Destroys a subtree iteratively, in chunks. Letting the unique_ptr chain
+  // destroy it would recurse once per node, and a re-rooted match tree brings
+  // millions of discarded nodes here every move.
+  void DismantleSubtree(std::unique_ptr<Node> root) {
+    std::vector<std::unique_ptr<Node>> stack;
+    stack.push_back(std::move(root));
+    int nodes_in_chunk = 0;
+    while (!stack.empty()) {
+      std::unique_ptr<Node> node = std::move(stack.back());
+      stack.pop_back();
+      if (auto child = node->DetachChild()) stack.push_back(std::move(child));
+      if (auto sibling = node->DetachSibling()) {
+        stack.push_back(std::move(sibling));
+      }
+      // Childless node is destroyed here without recursion.
+      node.reset();
+      // Teardown of huge trees shouldn't delay process shutdown.
+      if (++nodes_in_chunk >= kGCNodesPerChunk) {
+        if (stop_) return;
+        nodes_in_chunk = 0;
+      }
     }
   }
 
@@ -113,16 +204,109 @@ std::string Edge::DebugString() const {
 // EdgeList
 /////////////////////////////////////////////////////////////////////////
 
-EdgeList::EdgeList(MoveList moves)
-    : edges_(std::make_unique<Edge[]>(moves.size())), size_(moves.size()) {
-  auto* edge = edges_.get();
-  for (auto move : moves) edge++->SetMove(move);
+EdgeList::EdgeList(MoveList moves) : size_(moves.size()) {
+  edges_ = static_cast<Edge*>(GetEdgePool(size_)->Allocate());
+  gEdgeCount.fetch_add(size_, std::memory_order_relaxed);
+  AddTreeBytes(EdgeBlockBytes(size_));
+  auto* edge = edges_;
+  for (auto move : moves) (new (edge++) Edge())->SetMove(move);
+}
+
+EdgeList& EdgeList::operator=(EdgeList&& other) {
+  std::swap(edges_, other.edges_);
+  std::swap(size_, other.size_);
+  return *this;
+}
+
+EdgeList::~EdgeList() {
+  if (!edges_) return;
+  gEdgeCount.fetch_sub(size_, std::memory_order_relaxed);
+  gTreeBytes.fetch_sub(EdgeBlockBytes(size_), std::memory_order_relaxed);
+  // Edge is trivially destructible, so the block goes straight back to the
+  // pool.
+  GetEdgePool(size_)->Deallocate(edges_);
 }
 
 /////////////////////////////////////////////////////////////////////////
 // Node
 /////////////////////////////////////////////////////////////////////////
 
+void* Node::operator new(std::size_t size) {
+  assert(size == sizeof(Node));
+  (void)size;
+  gNodeCount.fetch_add(1, std::memory_order_relaxed);
+  AddTreeBytes(sizeof(Node));
+  return gNodePool.Allocate();
+}
+
+void Node::operator delete(void* ptr) {
+  gNodeCount.fetch_sub(1, std::memory_order_relaxed);
+  gTreeBytes.fetch_sub(sizeof(Node), std::memory_order_relaxed);
+  gNodePool.Deallocate(ptr);
+}
+
+int64_t Node::GetAllocatedNodeCount() {
+  return gNodeCount.load(std::memory_order_relaxed);
+}
+
+Node::MemoryStats Node::GetMemoryStats() {
+  MemoryStats stats;
+  stats.nodes = gNodeCount.load(std::memory_order_relaxed);
+  stats.edges = gEdgeCount.load(std::memory_order_relaxed);
+  stats.bytes = gTreeBytes.load(std::memory_order_relaxed);
+  stats.peak_bytes = gTreeBytesPeak.load(std::memory_order_relaxed);
+  return stats;
+}
+
+Node& Node::operator=(Node&& move_from) {
+  edges_ = std::move(move_from.edges_);
+  parent_ = move_from.parent_;
+  child_ = std::move(move_from.child_);
+  sibling_ = std::move(move_from.sibling_);
+  q_.store(move_from.q_.load(std::memory_order_relaxed),
+           std::memory_order_relaxed);
+  n_.store(move_from.n_.load(std::memory_order_relaxed),
+           std::memory_order_relaxed);
+  index_ = move_from.index_;
+  n_in_flight_.store(move_from.n_in_flight_.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  max_depth_.store(move_from.max_depth_.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+  full_depth_.store(move_from.full_depth_.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+  is_terminal_ = move_from.is_terminal_;
+  has_flat_children_ = move_from.has_flat_children_;
+  return *this;
+}
+
+void Node::FlattenChildren() {
+  if (has_flat_children_ || !child_) return;
+  has_flat_children_ = true;
+  // Detach the whole child list first. Allocating all replacement nodes
+  // before any old node is freed is what makes the new blocks come out of
+  // one slab region; interleaving would just recycle each freed block.
+  std::vector<std::unique_ptr<Node>> old_children;
+  std::unique_ptr<Node> child = std::move(child_);
+  while (child) {
+    auto next = child->DetachSibling();
+    old_children.push_back(std::move(child));
+    child = std::move(next);
+  }
+  // Rebuild the list (still in edge-index order) from fresh allocations.
+  std::unique_ptr<Node>* tail = &child_;
+  for (auto& old_child : old_children) {
+    auto fresh = std::make_unique<Node>(this, old_child->index_);
+    *fresh = std::move(*old_child);
+    // Grandchildren still point at the old location.
+    for (Node* grandchild : fresh->ChildNodes()) {
+      grandchild->parent_ = fresh.get();
+    }
+    *tail = std::move(fresh);
+    tail = &(*tail)->sibling_;
+  }
+  // Old child shells are freed when old_children goes out of scope.
+}
+
 Node* Node::CreateSingleChildNode(Move move) {
   assert(!edges_);
   assert(!child_);
@@ -143,7 +327,7 @@ Node::Iterator Node::Edges() { return {edges_, &child_}; }
 float Node::GetVisitedPolicy() const {
   float res = 0.0f;
   for (const auto* node = child_.get(); node; node = node->sibling_.get()) {
-    if (node->n_ > 0) res += edges_[node->index_].GetP();
+    if (node->GetN() > 0) res += edges_[node->index_].GetP();
   }
   return res;
 }
@@ -158,49 +342,74 @@ std::string Node::DebugString() const {
   std::ostringstream oss;
   oss << " Term:" << is_terminal_ << " This:" << this << " Parent:" << parent_
       << " Index:" << index_ << " Child:" << child_.get()
-      << " Sibling:" << sibling_.get() << " Q:" << q_ << " N:" << n_
-      << " N_:" << n_in_flight_ << " Edges:" << edges_.size();
+      << " Sibling:" << sibling_.get() << " Q:" << GetQ() << " N:" << GetN()
+      << " N_:" << GetNInFlight() << " Edges:" << edges_.size();
   return oss.str();
 }
 
 void Node::MakeTerminal(GameResult result) {
   is_terminal_ = true;
-  q_ = (result == GameResult::DRAW) ? 0.0f : 1.0f;
+  // @result is from the perspective of the player who moved into this node:
+  // WHITE_WON means they won (e.g. delivered checkmate), BLACK_WON that the
+  // side to move here wins (e.g. a tablebase win).
+  q_.store(result == GameResult::DRAW
+               ? 0.0f
+               : result == GameResult::WHITE_WON ? 1.0f : -1.0f,
+           std::memory_order_relaxed);
+}
+
+void Node::MakeSolved(float q) {
+  is_terminal_ = true;
+  q_.store(q, std::memory_order_relaxed);
 }
 
 bool Node::TryStartScoreUpdate() {
-  if (n_ == 0 && n_in_flight_ > 0) return false;
-  ++n_in_flight_;
+  if (GetN() == 0 && GetNInFlight() > 0) return false;
+  n_in_flight_.fetch_add(1, std::memory_order_relaxed);
   return true;
 }
 
-void Node::CancelScoreUpdate() { --n_in_flight_; }
+void Node::CancelScoreUpdate() {
+  n_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+}
 
 void Node::FinalizeScoreUpdate(float v) {
-  // Recompute Q.
-  q_ += (v - q_) / (n_ + 1);
-  // Increment N.
-  ++n_;
+  // Recompute Q through a CAS loop, as several threads may arrive here
+  // concurrently holding only the shared nodes lock. The visit is claimed by
+  // the N increment; the matching Q contribution uses the claimed visit
+  // number as the averaging weight.
+  const uint32_t n = n_.fetch_add(1, std::memory_order_relaxed);
+  float q = q_.load(std::memory_order_relaxed);
+  while (!q_.compare_exchange_weak(q, q + (v - q) / (n + 1),
+                                   std::memory_order_relaxed)) {
+  }
   // Decrement virtual loss.
-  --n_in_flight_;
+  n_in_flight_.fetch_sub(1, std::memory_order_relaxed);
 }
 
 void Node::UpdateMaxDepth(int depth) {
-  if (depth > max_depth_) max_depth_ = depth;
+  // CAS-max, as concurrent backups may report different depths.
+  uint16_t cur = max_depth_.load(std::memory_order_relaxed);
+  while (depth > cur && !max_depth_.compare_exchange_weak(
+                            cur, depth, std::memory_order_relaxed)) {
+  }
 }
 
 bool Node::UpdateFullDepth(uint16_t* depth) {
   // TODO(crem) If this function won't be needed, consider also killing
   //            ChildNodes/NodeRange/Nodes_Iterator.
-  if (full_depth_ > *depth) return false;
+  if (GetFullDepth() > *depth) return false;
   for (Node* child : ChildNodes()) {
-    if (*depth > child->full_depth_) *depth = child->full_depth_;
+    if (*depth > child->GetFullDepth()) *depth = child->GetFullDepth();
   }
-  if (*depth >= full_depth_) {
-    full_depth_ = ++*depth;
-    return true;
+  // CAS-max, same as in UpdateMaxDepth().
+  uint16_t cur = full_depth_.load(std::memory_order_relaxed);
+  if (*depth < cur) return false;
+  ++*depth;
+  while (!full_depth_.compare_exchange_weak(cur, std::max(cur, *depth),
+                                            std::memory_order_relaxed)) {
   }
-  return false;
+  return true;
 }
 
 Node::NodeRange Node::ChildNodes() const { return child_.get(); }
@@ -356,6 +565,142 @@ void NodeTree::ResetToPosition(const std::string& starting_fen,
   }
 }
 
+namespace {
+// "LCT1": Leela Chess Tree, format version 1.
+const uint32_t kTreeFileMagic = 0x4c435431;
+
+// Per-node flags in the tree file.
+enum TreeFileFlags : uint8_t {
+  kFlagTerminal = 1,
+  kFlagHasChild = 2,
+  kFlagHasSibling = 4,
+};
+
+template <typename T>
+void WritePod(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T ReadPod(std::ifstream& in) {
+  T value;
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return value;
+}
+
+// Moves are stored in the same bit layout Move uses internally, rebuilt
+// through the public interface.
+uint16_t PackMove(Move m) {
+  uint16_t data = m.to().as_int() + (m.from().as_int() << 6) +
+                  (static_cast<uint8_t>(m.promotion()) << 12);
+  if (m.castling()) data |= 0x8000;
+  return data;
+}
+
+Move UnpackMove(uint16_t data) {
+  Move m(BoardSquare((data >> 6) & 63), BoardSquare(data & 63),
+         Move::Promotion((data >> 12) & 7));
+  if (data & 0x8000) m.SetCastling();
+  return m;
+}
+}  // namespace
+
+void NodeTree::SaveToFile(const std::string& filename) const {
+  if (!current_head_) throw Exception("No tree to save");
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) throw Exception("Cannot open tree file for writing: " + filename);
+  WritePod(out, kTreeFileMagic);
+  WritePod(out, history_.Last().Hash());
+
+  // Pre-order traversal over the (child, sibling) representation, iterative
+  // to cope with trees millions of plies' worth of nodes deep.
+  std::vector<const Node*> stack = {current_head_};
+  while (!stack.empty()) {
+    const Node* node = stack.back();
+    stack.pop_back();
+    uint8_t flags = 0;
+    if (node->is_terminal_) flags |= kFlagTerminal;
+    if (node->child_) flags |= kFlagHasChild;
+    // The head is serialized without siblings: they belong to other moves.
+    if (node != current_head_ && node->sibling_) flags |= kFlagHasSibling;
+    WritePod(out, flags);
+    WritePod(out, node->index_);
+    WritePod(out, node->GetN());
+    WritePod(out, node->GetQ());
+    WritePod(out, node->edges_.size());
+    for (uint16_t i = 0; i < node->edges_.size(); ++i) {
+      WritePod(out, PackMove(node->edges_[i].GetMove()));
+      WritePod(out, node->edges_[i].GetP());
+    }
+    if (flags & kFlagHasSibling) stack.push_back(node->sibling_.get());
+    if (flags & kFlagHasChild) stack.push_back(node->child_.get());
+  }
+  if (!out) throw Exception("Error writing tree file: " + filename);
+}
+
+void NodeTree::LoadFromFile(const std::string& filename) {
+  if (!current_head_) throw Exception("Set a position before loading a tree");
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) throw Exception("Cannot open tree file: " + filename);
+  if (ReadPod<uint32_t>(in) != kTreeFileMagic) {
+    throw Exception("Not a tree file: " + filename);
+  }
+  if (ReadPod<uint64_t>(in) != history_.Last().Hash()) {
+    throw Exception("Tree file was saved from a different position: " +
+                    filename);
+  }
+  // Drop whatever is under the head; the checkpoint replaces it.
+  TrimTreeAtHead();
+
+  // Where the next deserialized node is to be attached.
+  struct Slot {
+    std::unique_ptr<Node>* ptr;
+    Node* parent;
+  };
+  std::vector<Slot> stack;
+  bool is_head = true;
+  while (is_head || !stack.empty()) {
+    Node* node;
+    if (is_head) {
+      // The first record describes the head itself; stats are applied to
+      // the existing node in place.
+      node = current_head_;
+    } else {
+      Slot slot = stack.back();
+      stack.pop_back();
+      *slot.ptr = std::make_unique<Node>(slot.parent, 0);
+      node = slot.ptr->get();
+    }
+    const uint8_t flags = ReadPod<uint8_t>(in);
+    node->index_ = ReadPod<uint16_t>(in);
+    node->n_.store(ReadPod<uint32_t>(in), std::memory_order_relaxed);
+    node->q_.store(ReadPod<float>(in), std::memory_order_relaxed);
+    node->is_terminal_ = (flags & kFlagTerminal) != 0;
+    const uint16_t num_edges = ReadPod<uint16_t>(in);
+    if (num_edges) {
+      MoveList moves;
+      std::vector<float> probs;
+      moves.reserve(num_edges);
+      probs.reserve(num_edges);
+      for (uint16_t i = 0; i < num_edges; ++i) {
+        moves.push_back(UnpackMove(ReadPod<uint16_t>(in)));
+        probs.push_back(ReadPod<float>(in));
+      }
+      node->CreateEdges(moves);
+      for (uint16_t i = 0; i < num_edges; ++i) node->edges_[i].SetP(probs[i]);
+    }
+    if (!in) throw Exception("Corrupted tree file: " + filename);
+    if (is_head && (flags & kFlagHasSibling)) {
+      throw Exception("Corrupted tree file (head has sibling): " + filename);
+    }
+    // Push sibling below child, so that the child's record, written right
+    // after its parent, is matched with the right slot.
+    if (flags & kFlagHasSibling) stack.push_back({&node->sibling_, node->parent_});
+    if (flags & kFlagHasChild) stack.push_back({&node->child_, node});
+    is_head = false;
+  }
+}
+
 void NodeTree::DeallocateTree() {
   // Same as gamebegin_node_.reset(), but actual deallocation will happen in
   // GC thread.
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cassert>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -70,11 +72,16 @@ class Edge {
   Move GetMove(bool as_opponent = false) const;
 
   // Returns value of Move probability returned from the neural net
-  // (but can be changed by adding Dirichlet noise).
-  float GetP() const { return p_; }
-
-  // Sets move probability.
-  void SetP(float val) { p_ = val; }
+  // (but can be changed by adding Dirichlet noise). The probability is
+  // stored in 16-bit fixed point, so the value read back is the stored one
+  // rounded to the nearest 1/65535.
+  float GetP() const { return p_ * (1.0f / 65535.0f); }
+
+  // Sets move probability. Must be within [0, 1].
+  void SetP(float val) {
+    assert(0.0f <= val && val <= 1.0f);
+    p_ = static_cast<uint16_t>(val * 65535.0f + 0.5f);
+  }
 
   // Debug information about the edge.
   std::string DebugString() const;
@@ -88,24 +95,30 @@ class Edge {
   Move move_;
 
   // Probability that this move will be made. From policy head of the neural
-  // network.
-  float p_ = 0.0;
+  // network. Stored in 16-bit fixed point to keep the whole Edge at 4 bytes;
+  // the quantization error (at most 1/131070) is far below policy head noise.
+  uint16_t p_ = 0;
 
   friend class EdgeList;
 };
 
-// Array of Edges.
+// Array of Edges. Storage comes from a slab pool (see SlabPool) rather than
+// the heap, so that building and tearing down large trees doesn't do millions
+// of small allocations.
 class EdgeList {
  public:
   EdgeList() {}
   EdgeList(MoveList moves);
-  Edge* get() const { return edges_.get(); }
+  EdgeList(EdgeList&& other) { *this = std::move(other); }
+  EdgeList& operator=(EdgeList&& other);
+  ~EdgeList();
+  Edge* get() const { return edges_; }
   Edge& operator[](size_t idx) const { return edges_[idx]; }
-  operator bool() const { return static_cast<bool>(edges_); }
+  operator bool() const { return edges_ != nullptr; }
   uint16_t size() const { return size_; }
 
  private:
-  std::unique_ptr<Edge[]> edges_;
+  Edge* edges_ = nullptr;
   uint16_t size_ = 0;
 };
 
@@ -119,7 +132,32 @@ class Node {
   using ConstIterator = Edge_Iterator<true>;
 
   // Takes pointer to a parent node and own index in a parent.
-  Node(Node* parent, uint16_t index) : index_(index), parent_(parent) {}
+  Node(Node* parent, uint16_t index) : parent_(parent), index_(index) {}
+
+  // Nodes are carved out of slabs (see SlabPool) instead of being allocated
+  // from the heap one by one.
+  static void* operator new(std::size_t size);
+  static void operator delete(void* ptr);
+
+  // Number of Node objects currently alive in the process. Used to enforce
+  // the tree memory budget.
+  static int64_t GetAllocatedNodeCount();
+
+  // Process-wide tree allocation counters, maintained on every node and
+  // edge (de)allocation. They cover all trees in the process (both players
+  // in selfplay) including subtrees queued for garbage collection.
+  struct MemoryStats {
+    int64_t nodes;       // Node objects alive.
+    int64_t edges;       // Edge objects alive.
+    int64_t bytes;       // Bytes currently carved out of the slab pools.
+    int64_t peak_bytes;  // High-water mark of bytes over the process life.
+  };
+  static MemoryStats GetMemoryStats();
+
+  // Atomic counters make the node non-movable by default. Explicit move
+  // assignment is needed by NodeTree::TrimTreeAtHead() to reset a node in
+  // place; it is not thread safe and may only run when no search is active.
+  Node& operator=(Node&& move_from);
 
   // Allocates a new edge and a new node. The node has to be no edges before
   // that.
@@ -136,36 +174,52 @@ class Node {
 
   // Returns sum of policy priors which have had at least one playout.
   float GetVisitedPolicy() const;
-  uint32_t GetN() const { return n_; }
-  uint32_t GetNInFlight() const { return n_in_flight_; }
-  uint32_t GetChildrenVisits() const { return n_ > 0 ? n_ - 1 : 0; }
+  uint32_t GetN() const { return n_.load(std::memory_order_relaxed); }
+  uint32_t GetNInFlight() const {
+    return n_in_flight_.load(std::memory_order_relaxed);
+  }
+  uint32_t GetChildrenVisits() const {
+    const uint32_t n = GetN();
+    return n > 0 ? n - 1 : 0;
+  }
   // Returns n = n_if_flight.
-  int GetNStarted() const { return n_ + n_in_flight_; }
+  int GetNStarted() const { return GetN() + GetNInFlight(); }
   // Returns node eval, i.e. average subtree V for non-terminal node and -1/0/1
   // for terminal nodes.
-  float GetQ() const { return q_; }
+  float GetQ() const { return q_.load(std::memory_order_relaxed); }
 
   // Returns whether the node is known to be draw/lose/win.
   bool IsTerminal() const { return is_terminal_; }
-  uint16_t GetFullDepth() const { return full_depth_; }
-  uint16_t GetMaxDepth() const { return max_depth_; }
+  uint16_t GetFullDepth() const {
+    return full_depth_.load(std::memory_order_relaxed);
+  }
+  uint16_t GetMaxDepth() const {
+    return max_depth_.load(std::memory_order_relaxed);
+  }
   uint16_t GetNumEdges() const { return edges_.size(); }
 
   // Makes the node terminal and sets it's score.
   void MakeTerminal(GameResult result);
+  // Makes the node proven with exact value @q (from the perspective of the
+  // player who moved into it), while keeping its edges. Used by the solver
+  // to stop spending visits on decided subtrees.
+  void MakeSolved(float q);
 
   // If this node is not in the process of being expanded by another thread
   // (which can happen only if n==0 and n-in-flight==1), mark the node as
   // "being updated" by incrementing n-in-flight, and return true.
   // Otherwise return false.
+  // Requires the exclusive nodes lock (selection holds it anyway).
   bool TryStartScoreUpdate();
-  // Decrements n-in-flight back.
+  // Decrements n-in-flight back. Safe to call under the shared nodes lock.
   void CancelScoreUpdate();
   // Updates the node with newly computed value v.
   // Updates:
   // * Q (weighted average of all V in a subtree)
   // * N (+=1)
   // * N-in-flight (-=1)
+  // All counters are atomic, so several threads may back up into the same
+  // node concurrently while holding only the shared nodes lock.
   void FinalizeScoreUpdate(float v);
 
   // Updates max depth, if new depth is larger.
@@ -187,6 +241,24 @@ class Node {
   // without nodes, which will be skipped by this iteration.
   NodeRange ChildNodes() const;
 
+  // Detaches and returns the first child / next sibling. Used by the garbage
+  // collector to dismantle discarded subtrees iteratively: destroying a deep
+  // subtree through the unique_ptr chain directly recurses once per node and
+  // can blow the stack on overnight analysis trees.
+  std::unique_ptr<Node> DetachChild() { return std::move(child_); }
+  std::unique_ptr<Node> DetachSibling() { return std::move(sibling_); }
+
+  // Relocates the child nodes into freshly pooled (and therefore typically
+  // consecutive) blocks, in edge-index order, so that iterating children of
+  // this node touches only a few cache lines instead of chasing pointers
+  // across the heap. One-shot per node; children spawned afterwards go into
+  // the list at their sorted position as usual. The caller must guarantee
+  // that no other thread holds pointers below this node (i.e. this node's
+  // only in-flight visit is the caller's own descent) and must refresh any
+  // cached child pointers of its own.
+  void FlattenChildren();
+  bool HasFlatChildren() const { return has_flat_children_; }
+
   // Deletes all children.
   void ReleaseChildren();
 
@@ -200,33 +272,47 @@ class Node {
   std::string DebugString() const;
 
  private:
+  // Fields are ordered by size so that the whole node packs into a single
+  // 64-byte cache line. When adding a field, place it into a matching
+  // section and keep sizeof(Node) == 64.
+
+  // 8(+) byte fields.
   // List of edges.
   EdgeList edges_;
-  // Index of this node is parent's edge list.
-  uint16_t index_;
+  // Pointer to a parent node. nullptr for the root.
+  Node* parent_ = nullptr;
+  // Pointer to a first child. nullptr for a leaf node.
+  std::unique_ptr<Node> child_;
+  // Pointer to a next sibling. nullptr if there are no further siblings.
+  std::unique_ptr<Node> sibling_;
+
+  // 4 byte fields.
+  // Visit accumulators are atomic so that backup can run under the shared
+  // nodes lock; the exclusive lock is reserved for structural changes
+  // (spawning nodes, trimming the tree).
   // Average value (from value head of neural network) of all visited nodes in
   // subtree. For terminal nodes, eval is stored.
-  float q_ = 0.0f;
+  std::atomic<float> q_{0.0f};
   // How many completed visits this node had.
-  uint32_t n_ = 0;
+  std::atomic<uint32_t> n_{0};
+
+  // 2 byte fields.
+  // Index of this node is parent's edge list.
+  uint16_t index_;
   // (aka virtual loss). How many threads currently process this node (started
   // but not finished). This value is added to n during selection which node
   // to pick in MCTS, and also when selecting the best move.
-  uint16_t n_in_flight_ = 0;
-
+  std::atomic<uint16_t> n_in_flight_{0};
   // Maximum depth any subnodes of this node were looked at.
-  uint16_t max_depth_ = 0;
+  std::atomic<uint16_t> max_depth_{0};
   // Complete depth all subnodes of this node were fully searched.
-  uint16_t full_depth_ = 0;
+  std::atomic<uint16_t> full_depth_{0};
+
+  // 1 byte fields.
   // Does this node end game (with a winning of either sides or draw).
   bool is_terminal_ = false;
-
-  // Pointer to a parent node. nullptr for the root.
-  Node* parent_ = nullptr;
-  // Pointer to a first child. nullptr for a leaf node.
-  std::unique_ptr<Node> child_;
-  // Pointer to a next sibling. nullptr if there are no further siblings.
-  std::unique_ptr<Node> sibling_;
+  // Whether children have been relocated into a contiguous block.
+  bool has_flat_children_ = false;
 
   // TODO(mooskagh) Unfriend NodeTree.
   friend class NodeTree;
@@ -257,6 +343,18 @@ class EdgeAndNode {
   float GetQ(float default_q) const {
     return (node_ && node_->GetN() > 0) ? node_->GetQ() : default_q;
   }
+  // Returns Q with virtual losses applied: every visit which is still in
+  // flight counts as a loss. Used during selection so that concurrent (or
+  // batched) descents diverge to distinct leaves instead of piling onto the
+  // leaf that looked best before any of them were evaluated.
+  float GetQWithVirtualLoss(float default_q) const {
+    if (!node_) return default_q;
+    const uint32_t n = node_->GetN();
+    const uint32_t vl = node_->GetNInFlight();
+    if (n + vl == 0) return default_q;
+    const float q = n > 0 ? node_->GetQ() : default_q;
+    return (n * q - static_cast<float>(vl)) / (n + vl);
+  }
   // N-related getters, from Node (if exists).
   uint32_t GetN() const { return node_ ? node_->GetN() : 0; }
   int GetNStarted() const { return node_ ? node_->GetNStarted() : 0; }
@@ -432,6 +530,15 @@ class NodeTree {
   Node* GetGameBeginNode() const { return gamebegin_node_.get(); }
   const PositionHistory& GetPositionHistory() const { return history_; }
 
+  // Saves the subtree under the current head (structure, edges with priors,
+  // visit statistics) into a compact binary file, together with the head
+  // position hash, so that hours of accumulated search survive a restart.
+  void SaveToFile(const std::string& filename) const;
+  // Restores a tree previously written by SaveToFile() under the current
+  // head. The head must be at the same position the file was saved from.
+  // Throws Exception on I/O errors, format or position mismatch.
+  void LoadFromFile(const std::string& filename);
+
  private:
   void DeallocateTree();
   // A node which to start search from.
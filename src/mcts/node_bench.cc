@@ -0,0 +1,107 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark for tree building blocks: EdgeList construction and
+// teardown over realistic move lists, and Node allocation, both backed by
+// the slab pools. Built as a separate binary (meson benchmark target
+// "NodeTree"); the corpus is seeded, so runs are comparable.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "chess/board.h"
+#include "mcts/node.h"
+
+namespace {
+
+using namespace lczero;
+
+// Move lists sampled from seeded random playouts, so edge counts are
+// distributed like in a real tree rather than all equal.
+std::vector<MoveList> GatherMoveLists() {
+  std::vector<MoveList> result;
+  std::mt19937 rng(30119);
+  for (int game = 0; game < 32; ++game) {
+    ChessBoard board;
+    board.SetFromFen(ChessBoard::kStartingFen);
+    for (int ply = 0; ply < 120; ++ply) {
+      auto moves = board.GenerateLegalMoves();
+      if (moves.empty()) break;
+      result.push_back(moves);
+      board.ApplyMove(moves[rng() % moves.size()]);
+      board.Mirror();
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  const auto move_lists = GatherMoveLists();
+  std::uint64_t edges = 0;
+  for (const auto& moves : move_lists) edges += moves.size();
+  std::cout << "Corpus: " << move_lists.size() << " move lists, " << edges
+            << " edges" << std::endl;
+
+  {
+    const int kRounds = 2000;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+      // Lists live in a window, so construction interleaves with teardown
+      // and the pool free lists stay in play, like during tree reuse + GC.
+      std::vector<EdgeList> window(64);
+      size_t idx = 0;
+      for (const auto& moves : move_lists) {
+        window[idx] = EdgeList(moves);
+        idx = (idx + 1) % window.size();
+      }
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    std::cout << "EdgeList construction: "
+              << move_lists.size() * kRounds * 1000000ull / us
+              << " lists/sec (" << edges * kRounds * 1000000ull / us
+              << " edges/sec)" << std::endl;
+  }
+
+  {
+    const int kRounds = 500;
+    const int kNodes = 1 << 14;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+      std::vector<std::unique_ptr<Node>> nodes;
+      nodes.reserve(kNodes);
+      for (int i = 0; i < kNodes; ++i) {
+        nodes.push_back(std::make_unique<Node>(nullptr, 0));
+      }
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    std::cout << "Node allocation: "
+              << static_cast<std::uint64_t>(kNodes) * kRounds * 1000000ull / us
+              << " nodes/sec" << std::endl;
+  }
+  return 0;
+}
@@ -29,7 +29,9 @@
 #include "mcts/node.h"
 #include "neural/cache.h"
 #include "neural/encoder.h"
+#include "utils/fastmath.h"
 #include "utils/random.h"
+#include "utils/trace.h"
 
 namespace lczero {
 
@@ -47,12 +49,41 @@ const char* Search::kCacheHistoryLengthStr =
 const char* Search::kPolicySoftmaxTempStr = "Policy softmax temperature";
 const char* Search::kAllowedNodeCollisionsStr =
     "Allowed node collisions, per batch";
+const char* Search::kTranspositionSharingStr =
+    "Share NN evaluations between transpositions";
+const char* Search::kMaxTreeNodesStr = "Maximum number of tree nodes";
+const char* Search::kTreeMemSoftLimitStr = "Tree memory soft limit, MB";
+const char* Search::kPipelineBatchesStr = "Pipeline minibatch NN evaluation";
+const char* Search::kAdaptiveTimeManagerStr = "Midsearch time reallocation";
+const char* Search::kUciInfoMinIntervalStr =
+    "Minimum interval between uci info lines, ms";
+const char* Search::kMultiPvStr = "MultiPV";
 
 namespace {
 const int kSmartPruningToleranceNodes = 100;
 const int kSmartPruningToleranceMs = 200;
 // Maximum delay between outputting "uci info" when nothing interesting happens.
 const int kUciInfoMinimumFrequencyMs = 5000;
+// Placeholder Q for moves excluded from selection (searchmoves, smart
+// pruning); keeps scratch buffers index-aligned while never winning argmax.
+const float kExcludedMoveScore = -1e6f;
+// Nodes with at least this many visits get their children relocated into a
+// contiguous block (see Node::FlattenChildren).
+const uint32_t kFlattenVisitThreshold = 32;
+// After this many prefetched evaluations the prefetch budget is re-evaluated
+// against the fraction of them which the search consumed from the cache.
+const int kPrefetchAdjustWindow = 128;
+const float kPrefetchGrowThreshold = 0.6f;
+const float kPrefetchShrinkThreshold = 0.2f;
+// Fraction of the original time budget granted as a one-off extension when
+// the best move is overtaken late in the search.
+const float kTimeExtensionFactor = 0.5f;
+
+int64_t ElapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
 }  // namespace
 
 void Search::PopulateUciParams(OptionsParser* options) {
@@ -60,7 +91,8 @@ void Search::PopulateUciParams(OptionsParser* options) {
   // Many of them are overridden with optimized defaults in engine.cc and
   // tournament.cc
 
-  options->Add<IntOption>(kMiniBatchSizeStr, 1, 1024, "minibatch-size") = 1;
+  // 0 = autotune against the backend at startup (see neural/autotune.h).
+  options->Add<IntOption>(kMiniBatchSizeStr, 0, 1024, "minibatch-size") = 1;
   options->Add<IntOption>(kMaxPrefetchBatchStr, 0, 1024, "max-prefetch") = 32;
   options->Add<FloatOption>(kCpuctStr, 0.0f, 100.0f, "cpuct") = 1.2f;
   options->Add<FloatOption>(kTemperatureStr, 0.0f, 100.0f, "temperature") =
@@ -77,14 +109,30 @@ void Search::PopulateUciParams(OptionsParser* options) {
                             "policy-softmax-temp") = 1.0f;
   options->Add<IntOption>(kAllowedNodeCollisionsStr, 0, 1024,
                           "allowed-node-collisions") = 0;
+  options->Add<BoolOption>(kTranspositionSharingStr,
+                           "transposition-sharing") = false;
+  // A node costs 64 bytes plus 4 bytes per edge; 0 means no limit.
+  options->Add<IntOption>(kMaxTreeNodesStr, 0, 2000000000, "max-tree-nodes") =
+      0;
+  // Unlike the node budget above this only warns; 0 means no warning.
+  options->Add<IntOption>(kTreeMemSoftLimitStr, 0, 1 << 20,
+                          "tree-mem-soft-limit-mb") = 0;
+  options->Add<BoolOption>(kPipelineBatchesStr, "pipeline-batches") = false;
+  options->Add<BoolOption>(kAdaptiveTimeManagerStr, "adaptive-time-manager") =
+      false;
+  options->Add<IntOption>(kUciInfoMinIntervalStr, 0, 60000,
+                          "uci-info-min-interval") = 100;
+  options->Add<IntOption>(kMultiPvStr, 1, 500, "multipv") = 1;
 }
 
 Search::Search(const NodeTree& tree, Network* network,
                BestMoveInfo::Callback best_move_callback,
                ThinkingInfo::Callback info_callback, const SearchLimits& limits,
-               const OptionsDict& options, NNCache* cache)
+               const OptionsDict& options, NNCache* cache,
+               SyzygyTablebase* syzygy_tb)
     : root_node_(tree.GetCurrentHead()),
       cache_(cache),
+      syzygy_tb_(syzygy_tb),
       played_history_(tree.GetPositionHistory()),
       network_(network),
       limits_(limits),
@@ -92,7 +140,9 @@ Search::Search(const NodeTree& tree, Network* network,
       initial_visits_(root_node_->GetN()),
       best_move_callback_(best_move_callback),
       info_callback_(info_callback),
-      kMiniBatchSize(options.Get<int>(kMiniBatchSizeStr)),
+      // 0 (auto) is resolved by the caller before the search starts; clamp
+      // in case a caller passes it through unresolved.
+      kMiniBatchSize(std::max(1, options.Get<int>(kMiniBatchSizeStr))),
       kMaxPrefetchBatch(options.Get<int>(kMaxPrefetchBatchStr)),
       kCpuct(options.Get<float>(kCpuctStr)),
       kTemperature(options.Get<float>(kTemperatureStr)),
@@ -103,7 +153,21 @@ Search::Search(const NodeTree& tree, Network* network,
       kFpuReduction(options.Get<float>(kFpuReductionStr)),
       kCacheHistoryLength(options.Get<int>(kCacheHistoryLengthStr)),
       kPolicySoftmaxTemp(options.Get<float>(kPolicySoftmaxTempStr)),
-      kAllowedNodeCollisions(options.Get<int>(kAllowedNodeCollisionsStr)) {}
+      kAllowedNodeCollisions(options.Get<int>(kAllowedNodeCollisionsStr)),
+      kTranspositionSharing(options.Get<bool>(kTranspositionSharingStr)),
+      kMaxTreeNodes(options.Get<int>(kMaxTreeNodesStr)),
+      kTreeMemSoftLimitMb(options.Get<int>(kTreeMemSoftLimitStr)),
+      kPipelineBatches(options.Get<bool>(kPipelineBatchesStr)),
+      kAdaptiveTimeManager(options.Get<bool>(kAdaptiveTimeManagerStr)),
+      kUciInfoMinInterval(options.Get<int>(kUciInfoMinIntervalStr)),
+      kMultiPv(options.Get<int>(kMultiPvStr)) {
+  adjusted_time_budget_ms_ = limits_.time_ms;
+  // Info and bestmove lines are formatted and written by a dedicated thread,
+  // so a GUI reading its pipe slowly never stalls search threads (which may
+  // hold nodes_mutex_ while producing output).
+  last_info_time_ = start_time_ - std::chrono::milliseconds(kUciInfoMinInterval);
+  output_thread_ = std::thread([this]() { OutputThreadLoop(); });
+}
 
 namespace {
 void ApplyDirichletNoise(Node* node, float eps, double alpha) {
@@ -124,6 +188,8 @@ void ApplyDirichletNoise(Node* node, float eps, double alpha) {
     edge->SetP(edge->GetP() * (1 - eps) + eps * noise[noise_idx++] / total);
   }
 }
+
+int ScoreFromQ(float q) { return 290.680623072 * tan(1.548090806 * q); }
 }  // namespace
 
 void Search::SendUciInfo() REQUIRES(nodes_mutex_) {
@@ -134,20 +200,127 @@ void Search::SendUciInfo() REQUIRES(nodes_mutex_) {
   uci_info_.time = GetTimeSinceStart();
   uci_info_.nodes = total_playouts_ + initial_visits_;
   uci_info_.hashfull =
-      cache_->GetSize() * 1000LL / std::max(cache_->GetCapacity(), 1);
+      cache_->GetSize() * 1000 / std::max<int64_t>(cache_->GetCapacity(), 1);
   uci_info_.nps =
       uci_info_.time ? (total_playouts_ * 1000 / uci_info_.time) : 0;
-  uci_info_.score = 290.680623072 * tan(1.548090806 * best_move_edge_.GetQ(0));
+  uci_info_.tree_bytes = Node::GetMemoryStats().bytes;
+  uci_info_.comment.clear();
+  if (kMultiPv == 1) {
+    uci_info_.score = ScoreFromQ(best_move_edge_.GetQ(0));
+    // The PV is maintained by UpdatePv() at backup time; output is a copy.
+    uci_info_.pv = pv_;
+    EnqueueInfo(uci_info_);
+    return;
+  }
+  // All lines come from the one shared tree; non-best lines only have the
+  // visits PUCT gave them, which MultiPV keeps meaningful by disabling the
+  // root catch-up pruning (see PickNodeToExtend).
   uci_info_.pv.clear();
+  const auto edges = GetBestChildrenNoTemperature(root_node_, kMultiPv);
+  std::vector<ThinkingInfo> infos;
+  infos.reserve(edges.size());
+  for (const auto& edge : edges) {
+    infos.push_back(uci_info_);
+    ThinkingInfo& info = infos.back();
+    info.multipv = infos.size();
+    info.score = ScoreFromQ(edge.GetQ(0));
+    bool flip = played_history_.IsBlackToMove();
+    for (auto iter = edge; iter;
+         iter = GetBestChildNoTemperature(iter.node()), flip = !flip) {
+      info.pv.push_back(iter.GetMove(flip));
+      if (!iter.node()) break;  // Last edge was dangling, cannot continue.
+    }
+  }
+  EnqueueInfos(std::move(infos));
+}
+
+namespace {
+// Bound on the output queue; beyond it the oldest plain info line is dropped.
+// Verbose stats lines and bestmove are never dropped.
+const size_t kMaxOutputQueueSize = 128;
+}  // namespace
+
+void Search::EnqueueInfo(const ThinkingInfo& info) const {
+  EnqueueInfos({info});
+}
+
+void Search::EnqueueInfos(std::vector<ThinkingInfo> infos) const {
+  {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (output_queue_.size() >= kMaxOutputQueueSize) {
+      for (auto iter = output_queue_.begin(); iter != output_queue_.end();
+           ++iter) {
+        if (!iter->is_best_move && iter->infos.front().comment.empty()) {
+          output_queue_.erase(iter);
+          break;
+        }
+      }
+    }
+    output_queue_.push_back({false, std::move(infos), {Move()}});
+  }
+  output_cv_.notify_one();
+}
 
+void Search::EnqueueBestMove(const BestMoveInfo& info) const {
+  {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    output_queue_.push_back({true, {}, info});
+  }
+  output_cv_.notify_one();
+}
+
+void Search::OutputThreadLoop() {
+  std::unique_lock<std::mutex> lock(output_mutex_);
+  while (true) {
+    if (output_queue_.empty()) {
+      if (output_shutdown_) return;
+      output_cv_.wait(lock);
+      continue;
+    }
+    OutputItem item = std::move(output_queue_.front());
+    output_queue_.pop_front();
+    if (!item.is_best_move && item.infos.front().comment.empty()) {
+      // Plain stats lines supersede each other: only the newest queued one
+      // matters, and at most one is emitted per kUciInfoMinInterval. The wait
+      // is cut short when something non-droppable queues up behind (verbose
+      // stats, bestmove) or at shutdown, so those are never delayed.
+      while (!output_queue_.empty() && !output_queue_.front().is_best_move &&
+             output_queue_.front().infos.front().comment.empty()) {
+        item = std::move(output_queue_.front());
+        output_queue_.pop_front();
+      }
+      const auto due =
+          last_info_time_ + std::chrono::milliseconds(kUciInfoMinInterval);
+      while (!output_shutdown_ && output_queue_.empty() &&
+             std::chrono::steady_clock::now() < due) {
+        output_cv_.wait_until(lock, due);
+        while (!output_queue_.empty() && !output_queue_.front().is_best_move &&
+               output_queue_.front().infos.front().comment.empty()) {
+          item = std::move(output_queue_.front());
+          output_queue_.pop_front();
+        }
+      }
+      last_info_time_ = std::chrono::steady_clock::now();
+    }
+    lock.unlock();
+    if (item.is_best_move) {
+      best_move_callback_(item.best_move);
+    } else {
+      for (const auto& info : item.infos) info_callback_(info);
+    }
+    lock.lock();
+  }
+}
+
+void Search::UpdatePv() REQUIRES(nodes_mutex_) {
+  pv_.clear();
+  if (!best_move_edge_) return;
   bool flip = played_history_.IsBlackToMove();
   for (auto iter = best_move_edge_; iter;
        iter = GetBestChildNoTemperature(iter.node()), flip = !flip) {
-    uci_info_.pv.push_back(iter.GetMove(flip));
+    pv_.push_back(iter.GetMove(flip));
     if (!iter.node()) break;  // Last edge was dangling, cannot continue.
   }
-  uci_info_.comment.clear();
-  info_callback_(uci_info_);
 }
 
 // Decides whether anything important changed in stats and new info should be
@@ -164,12 +337,34 @@ void Search::MaybeOutputInfo() {
   }
 }
 
+void Search::SetLimits(const SearchLimits& limits) {
+  Mutex::Lock lock(counters_mutex_);
+  limits_ = limits;
+  // The new budget is counted from now; the time pondered was free.
+  start_time_ = std::chrono::steady_clock::now();
+  adjusted_time_budget_ms_ = limits.time_ms;
+  time_mgr_best_edge_ = nullptr;
+  time_mgr_last_change_ms_ = 0;
+  time_extended_ = false;
+}
+
 int64_t Search::GetTimeSinceStart() const {
   return std::chrono::duration_cast<std::chrono::milliseconds>(
              std::chrono::steady_clock::now() - start_time_)
       .count();
 }
 
+void Search::SendTreeMemStats() const {
+  const Node::MemoryStats stats = Node::GetMemoryStats();
+  ThinkingInfo info;
+  std::ostringstream oss;
+  oss << "Tree memory: " << stats.nodes << " nodes, " << stats.edges
+      << " edges, " << (stats.bytes >> 20) << "mb (peak "
+      << (stats.peak_bytes >> 20) << "mb)";
+  info.comment = oss.str();
+  EnqueueInfo(info);
+}
+
 void Search::SendMovesStats() const {
   const float parent_q =
       -root_node_->GetQ() -
@@ -230,7 +425,41 @@ void Search::SendMovesStats() const {
     oss << ") ";
 
     info.comment = oss.str();
-    info_callback_(info);
+    EnqueueInfo(info);
+  }
+}
+
+int Search::RegisterWorkerStats() {
+  Mutex::Lock lock(counters_mutex_);
+  worker_stats_.emplace_back();
+  return worker_stats_.size() - 1;
+}
+
+void Search::ReportWorkerStats(int idx, const WorkerStats& stats) {
+  Mutex::Lock lock(counters_mutex_);
+  worker_stats_[idx] = stats;
+}
+
+void Search::SendWorkerStats() const REQUIRES(counters_mutex_) {
+  ThinkingInfo info;
+  int idx = 0;
+  for (const auto& stats : worker_stats_) {
+    const int64_t lookups = stats.cache_hits + stats.cache_misses;
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1);
+    oss << "worker " << idx++ << ": batches " << stats.batches;
+    oss << " avg-size "
+        << (stats.batches
+                ? static_cast<float>(stats.batch_size_sum) / stats.batches
+                : 0.0f);
+    oss << " cache-hits "
+        << (lookups ? 100.0f * stats.cache_hits / lookups : 0.0f) << "%";
+    oss << " gather " << stats.gather_us / 1000 << "ms";
+    oss << " nn " << stats.nn_us / 1000 << "ms";
+    oss << " backup " << stats.backup_us / 1000 << "ms";
+    oss << " lock-wait " << stats.lock_wait_us / 1000 << "ms";
+    info.comment = oss.str();
+    EnqueueInfo(info);
   }
 }
 
@@ -267,20 +496,116 @@ void Search::MaybeTriggerStop() {
     stop_ = true;
   }
   // Stop if reached time limit.
-  if (limits_.time_ms >= 0 && GetTimeSinceStart() >= limits_.time_ms) {
-    stop_ = true;
+  if (limits_.time_ms >= 0) {
+    if (kAdaptiveTimeManager && !limits_.infinite) UpdateTimeBudget();
+    if (GetTimeSinceStart() >= adjusted_time_budget_ms_) stop_ = true;
+  }
+  // Warn once per search when the tree outgrows the configured soft limit.
+  // Unlike kMaxTreeNodes this doesn't act on the tree, it only makes the
+  // operator aware.
+  if (kTreeMemSoftLimitMb > 0 && !mem_warning_sent_) {
+    const int64_t bytes = Node::GetMemoryStats().bytes;
+    if (bytes >= static_cast<int64_t>(kTreeMemSoftLimitMb) << 20) {
+      mem_warning_sent_ = true;
+      ThinkingInfo info;
+      info.comment = "WARNING: tree memory " + std::to_string(bytes >> 20) +
+                     "mb exceeds soft limit " +
+                     std::to_string(kTreeMemSoftLimitMb) + "mb";
+      EnqueueInfo(info);
+    }
   }
   // If we are the first to see that stop is needed.
   if (stop_ && !responded_bestmove_) {
     SendUciInfo();
-    if (kVerboseStats) SendMovesStats();
+    SendTreeMemStats();
+    if (kVerboseStats) {
+      SendMovesStats();
+      SendWorkerStats();
+    }
     best_move_ = GetBestMoveInternal();
-    best_move_callback_({best_move_.first, best_move_.second});
+    EnqueueBestMove({best_move_.first, best_move_.second});
     responded_bestmove_ = true;
     best_move_edge_ = EdgeAndNode();
   }
 }
 
+void Search::UpdateTimeBudget() REQUIRES(nodes_mutex_)
+    REQUIRES(counters_mutex_) {
+  const int64_t elapsed = GetTimeSinceStart();
+  const int64_t base = limits_.time_ms;
+
+  if (best_move_edge_.edge() != time_mgr_best_edge_) {
+    time_mgr_best_edge_ = best_move_edge_.edge();
+    time_mgr_last_change_ms_ = elapsed;
+    // A best move overtaken late in the allotted time is evidence that the
+    // position is critical; grant a one-off extension.
+    if (!time_extended_ && elapsed > base / 2) {
+      time_extended_ = true;
+      adjusted_time_budget_ms_ =
+          base + static_cast<int64_t>(base * kTimeExtensionFactor);
+    }
+    return;
+  }
+
+  // Consider cutting the budget only in its second half, when the choice has
+  // been stable since the first quarter, and when no extension was granted.
+  if (time_extended_) return;
+  if (elapsed < base / 2) return;
+  if (time_mgr_last_change_ms_ > base / 4) return;
+
+  // Visits of the top two root edges.
+  uint32_t top_n = 0;
+  uint32_t second_n = 0;
+  for (auto edge : root_node_->Edges()) {
+    const uint32_t n = edge.GetN();
+    if (n > top_n) {
+      second_n = top_n;
+      top_n = n;
+    } else if (n > second_n) {
+      second_n = n;
+    }
+  }
+
+  // If the runner-up cannot catch up even if it received every remaining
+  // playout, further search cannot change the move; stop now.
+  const int64_t nps = elapsed ? total_playouts_ * 1000 / elapsed : 0;
+  const int64_t remaining_playouts =
+      (adjusted_time_budget_ms_ - elapsed) * nps / 1000;
+  if (top_n > second_n + remaining_playouts) {
+    adjusted_time_budget_ms_ = elapsed;
+  }
+}
+
+void Search::MaybeRecycleTreeMemory() {
+  if (kMaxTreeNodes <= 0) return;
+  if (Node::GetAllocatedNodeCount() <= kMaxTreeNodes) return;
+  SharedMutex::Lock lock(nodes_mutex_);
+  // Pick the least-visited root subtree which is safe to recycle:
+  // * Not the current best line.
+  // * No visits in flight below it. The in-flight counter of the subtree
+  //   root covers the whole subtree, as every descent increments it along
+  //   the path.
+  Node* victim = nullptr;
+  uint32_t victim_n = std::numeric_limits<uint32_t>::max();
+  for (auto edge : root_node_->Edges()) {
+    if (!edge.HasNode()) continue;
+    if (edge == best_move_edge_) continue;
+    Node* node = edge.node();
+    if (node->GetNInFlight() > 0) continue;
+    // A subtree of one visit has no child nodes to free.
+    if (node->GetN() <= 1) continue;
+    if (node->GetN() < victim_n) {
+      victim_n = node->GetN();
+      victim = node;
+    }
+  }
+  if (!victim) return;
+  // Child nodes go to the GC thread (and from there back to the slab pools).
+  // Edge priors and the accumulated N/Q of the subtree root are kept, so the
+  // line keeps its statistics and can be re-expanded later.
+  victim->ReleaseChildren();
+}
+
 void Search::UpdateRemainingMoves() {
   if (!kSmartPruning) return;
   SharedMutex::Lock lock(nodes_mutex_);
@@ -339,6 +664,27 @@ std::pair<Move, Move> Search::GetBestMove() const {
   return GetBestMoveInternal();
 }
 
+int64_t Search::GetTotalPlayouts() const {
+  SharedMutex::SharedLock lock(nodes_mutex_);
+  return total_playouts_;
+}
+
+WorkerStats Search::GetWorkerStats() const {
+  Mutex::Lock lock(counters_mutex_);
+  WorkerStats total;
+  for (const auto& stats : worker_stats_) {
+    total.batches += stats.batches;
+    total.batch_size_sum += stats.batch_size_sum;
+    total.cache_hits += stats.cache_hits;
+    total.cache_misses += stats.cache_misses;
+    total.gather_us += stats.gather_us;
+    total.nn_us += stats.nn_us;
+    total.backup_us += stats.backup_us;
+    total.lock_wait_us += stats.lock_wait_us;
+  }
+  return total;
+}
+
 // Returns the best move, maybe with temperature (according to the settings).
 std::pair<Move, Move> Search::GetBestMoveInternal() const
     REQUIRES_SHARED(nodes_mutex_) REQUIRES_SHARED(counters_mutex_) {
@@ -390,6 +736,29 @@ EdgeAndNode Search::GetBestChildNoTemperature(Node* parent) const {
   return best_edge;
 }
 
+std::vector<EdgeAndNode> Search::GetBestChildrenNoTemperature(
+    Node* parent, int count) const {
+  std::vector<std::pair<std::tuple<int, float, float>, EdgeAndNode>> edges;
+  for (auto edge : parent->Edges()) {
+    if (parent == root_node_ && !limits_.searchmoves.empty() &&
+        std::find(limits_.searchmoves.begin(), limits_.searchmoves.end(),
+                  edge.GetMove()) == limits_.searchmoves.end()) {
+      continue;
+    }
+    edges.emplace_back(
+        std::make_tuple(edge.GetN(), edge.GetQ(-10.0), edge.GetP()), edge);
+  }
+  const size_t keep = std::min<size_t>(count, edges.size());
+  std::partial_sort(edges.begin(), edges.begin() + keep, edges.end(),
+                    [](const auto& a, const auto& b) {
+                      return a.first > b.first;
+                    });
+  std::vector<EdgeAndNode> result;
+  result.reserve(keep);
+  for (size_t i = 0; i < keep; ++i) result.push_back(edges[i].second);
+  return result;
+}
+
 // Returns a child chosen according to weighted-by-temperature visit count.
 EdgeAndNode Search::GetBestChildWithTemperature(Node* parent,
                                                 float temperature) const {
@@ -471,6 +840,18 @@ void Search::Wait() {
 Search::~Search() {
   Abort();
   Wait();
+  // The output thread drains what's queued (so a bestmove already decided is
+  // never lost) and exits.
+  {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    output_shutdown_ = true;
+  }
+  output_cv_.notify_one();
+  output_thread_.join();
+#ifdef MUTEX_STATS
+  std::cerr << nodes_mutex_.stats().ToString("nodes_mutex") << std::endl;
+  std::cerr << counters_mutex_.stats().ToString("counters_mutex") << std::endl;
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -482,11 +863,39 @@ void SearchWorker::ExecuteOneIteration() {
   InitializeIteration(search_->network_->NewComputation());
 
   // 2. Gather minibatch.
+  const auto gather_start = std::chrono::steady_clock::now();
   GatherMinibatch();
+  stats_.gather_us += ElapsedUs(gather_start);
+
+  // Batch and cache counters are taken before the prefetch so that
+  // speculative entries don't distort them.
+  ++stats_.batches;
+  stats_.batch_size_sum += computation_->GetBatchSize();
+  stats_.cache_misses += computation_->GetCacheMisses();
+  stats_.cache_hits +=
+      computation_->GetBatchSize() - computation_->GetCacheMisses();
 
   // 3. Prefetch into cache.
   MaybePrefetchIntoCache();
 
+  if (search_->kPipelineBatches) {
+    // Hand the fresh batch to the backend on a helper thread, and complete
+    // the previous batch (which the backend evaluated while this one was
+    // being gathered) in the meantime. Virtual losses of the in-flight batch
+    // stay applied, so the next gather diverges from it.
+    auto batch = std::make_unique<InFlightBatch>();
+    batch->nodes_to_process = std::move(nodes_to_process_);
+    batch->computation = std::move(computation_);
+    auto* computation = batch->computation.get();
+    batch->compute_thread = std::thread([computation]() {
+      TRACE_SCOPE("nn_compute");
+      if (computation->GetBatchSize() != 0) computation->ComputeBlocking();
+    });
+    std::swap(batch, in_flight_);
+    if (batch) CompleteBatch(std::move(*batch));
+    return;
+  }
+
   // 4. Run NN computation.
   RunNNComputation();
 
@@ -500,6 +909,67 @@ void SearchWorker::ExecuteOneIteration() {
   UpdateCounters();
 }
 
+void SearchWorker::BeginAsyncIteration(std::function<void()> on_ready) {
+  // Steps 1-3, same as ExecuteOneIteration().
+  InitializeIteration(search_->network_->NewComputation());
+
+  const auto gather_start = std::chrono::steady_clock::now();
+  GatherMinibatch();
+  stats_.gather_us += ElapsedUs(gather_start);
+
+  ++stats_.batches;
+  stats_.batch_size_sum += computation_->GetBatchSize();
+  stats_.cache_misses += computation_->GetCacheMisses();
+  stats_.cache_hits +=
+      computation_->GetBatchSize() - computation_->GetCacheMisses();
+
+  MaybePrefetchIntoCache();
+
+  // 4. Hand the batch to the backend; the caller's thread is free to step
+  // other searches until the callback fires.
+  computation_->ComputeAsync(std::move(on_ready));
+}
+
+void SearchWorker::CompleteAsyncIteration() {
+  // 5. Retrieve NN computations (and terminal values) into nodes.
+  FetchMinibatchResults();
+
+  // 6. Propagate the new nodes' information to all their parents in the tree.
+  DoBackupUpdate();
+
+  // 7. Update the Search's status and progress information.
+  UpdateCounters();
+}
+
+void SearchWorker::CompleteBatch(InFlightBatch batch) {
+  // 4. (pipelined) Wait for the NN computation to finish. Only the time
+  // actually spent waiting counts as NN time here; the rest overlapped with
+  // gathering.
+  const auto nn_start = std::chrono::steady_clock::now();
+  {
+    TRACE_SCOPE("nn_wait");
+    batch.compute_thread.join();
+  }
+  stats_.nn_us += ElapsedUs(nn_start);
+  nodes_to_process_ = std::move(batch.nodes_to_process);
+  computation_ = std::move(batch.computation);
+
+  // 5. Retrieve NN computations (and terminal values) into nodes.
+  FetchMinibatchResults();
+
+  // 6. Propagate the new nodes' information to all their parents in the tree.
+  DoBackupUpdate();
+
+  // 7. Update the Search's status and progress information.
+  UpdateCounters();
+}
+
+void SearchWorker::FlushPipeline() {
+  if (!in_flight_) return;
+  auto batch = std::move(in_flight_);
+  CompleteBatch(std::move(*batch));
+}
+
 bool SearchWorker::IsSearchActive() const {
   Mutex::Lock lock(search_->counters_mutex_);
   return !search_->stop_;
@@ -510,13 +980,22 @@ bool SearchWorker::IsSearchActive() const {
 void SearchWorker::InitializeIteration(
     std::unique_ptr<NetworkComputation> computation) {
   nodes_to_process_.clear();
-  computation_ = std::make_unique<CachingComputation>(std::move(computation),
-                                                      search_->cache_);
+  if (computation_) {
+    // Reuse the bookkeeping buffers of a completed iteration (batch items,
+    // cached-policy indices) instead of reallocating them for each of the
+    // thousands of iterations per second. With pipelining two computations
+    // rotate: one in flight, one being refilled here.
+    computation_->Reset(std::move(computation));
+  } else {
+    computation_ = std::make_unique<CachingComputation>(std::move(computation),
+                                                        search_->cache_);
+  }
 }
 
 // 2. Gather minibatch.
 // ~~~~~~~~~~~~~~~~~~~~
 void SearchWorker::GatherMinibatch() {
+  TRACE_SCOPE("gather");
   int nodes_found = 0;
   int collisions_found = 0;
 
@@ -563,7 +1042,9 @@ SearchWorker::NodeToProcess SearchWorker::PickNodeToExtend() {
   // Initialize position sequence with pre-move position.
   history_.Trim(search_->played_history_.GetLength());
 
+  const auto lock_start = std::chrono::steady_clock::now();
   SharedMutex::Lock lock(search_->nodes_mutex_);
+  stats_.lock_wait_us += ElapsedUs(lock_start);
 
   // Fetch the current best root node visits for possible smart pruning.
   int best_node_n = search_->best_move_edge_.GetN();
@@ -582,20 +1063,46 @@ SearchWorker::NodeToProcess SearchWorker::PickNodeToExtend() {
     // n_in_flight_ is incremented. If the method returns false, then there is
     // a search collision, and this node is already being expanded.
     if (!node->TryStartScoreUpdate()) return {node, true};
+    // Proven nodes (true terminals, or interior nodes solved by terminal
+    // bound propagation) end the playout; their exact value is backed up
+    // without an NN evaluation.
+    if (node->IsTerminal()) return {node, false};
     // Unexamined leaf node. We've hit the end of this playout.
     if (!node->HasChildren()) return {node, false};
+
+    // Hot nodes get their children relocated into one contiguous block, so
+    // that the per-child pointer chase of the selection loop below stays
+    // within a few cache lines. Safe only while no other thread is below
+    // this node: our own descent accounts for the single in-flight visit.
+    if (!node->HasFlatChildren() && node->GetNInFlight() == 1 &&
+        node->GetN() >= kFlattenVisitThreshold) {
+      node->FlattenChildren();
+      // Relocation invalidated the node pointer cached in best_move_edge_
+      // if we just flattened the root's children.
+      if (node == search_->root_node_ && search_->best_move_edge_) {
+        search_->best_move_edge_ =
+            search_->GetBestChildNoTemperature(search_->root_node_);
+      }
+    }
     // If we fall through, then n_in_flight_ has been incremented but this
     // playout remains incomplete; we must go deeper.
 
     float puct_mult =
         search_->kCpuct * std::sqrt(std::max(node->GetChildrenVisits(), 1u));
-    float best = -100.0f;
     int possible_moves = 0;
     float parent_q =
         ((is_root_node && search_->kNoise) || !search_->kFpuReduction)
             ? -node->GetQ()
             : -node->GetQ() -
                   search_->kFpuReduction * std::sqrt(node->GetVisitedPolicy());
+    // Gather per-child terms into contiguous scratch buffers first, then
+    // compute all PUCT scores in one tight pass which the compiler can
+    // vectorize. Near-root nodes with dozens of children go through this
+    // millions of times per search, so keeping the math loop free of
+    // pointer chasing and branches pays off.
+    scratch_p_.clear();
+    scratch_q_.clear();
+    scratch_n_started_.clear();
     for (auto child : node->Edges()) {
       if (is_root_node) {
         // If there's no chance to catch up to the current best node with
@@ -603,9 +1110,16 @@ SearchWorker::NodeToProcess SearchWorker::PickNodeToExtend() {
         // best_move_node_ could have changed since best_node_n was retrieved.
         // To ensure we have at least one node to expand, always include
         // current best node.
-        if (child != search_->best_move_edge_ &&
+        // With MultiPV the runner-up lines are wanted output, not dead
+        // weight, so they are never starved this way.
+        if (search_->kMultiPv == 1 && child != search_->best_move_edge_ &&
             search_->remaining_playouts_ <
                 best_node_n - static_cast<int>(child.GetN())) {
+          // Keep the buffers index-aligned with the edge array; the score
+          // of an excluded move stays below any real score.
+          scratch_p_.push_back(0.0f);
+          scratch_q_.push_back(kExcludedMoveScore);
+          scratch_n_started_.push_back(0.0f);
           continue;
         }
         // If searchmoves was sent, restrict the search only in that moves
@@ -613,17 +1127,33 @@ SearchWorker::NodeToProcess SearchWorker::PickNodeToExtend() {
             std::find(search_->limits_.searchmoves.begin(),
                       search_->limits_.searchmoves.end(),
                       child.GetMove()) == search_->limits_.searchmoves.end()) {
+          scratch_p_.push_back(0.0f);
+          scratch_q_.push_back(kExcludedMoveScore);
+          scratch_n_started_.push_back(0.0f);
           continue;
         }
         ++possible_moves;
       }
-      float Q = child.GetQ(parent_q);
-      const float score = child.GetU(puct_mult) + Q;
+      scratch_p_.push_back(child.GetP());
+      // Take virtual losses into account, so that within one gathered batch
+      // (and across worker threads) successive descents pick distinct leaves.
+      scratch_q_.push_back(child.GetQWithVirtualLoss(parent_q));
+      scratch_n_started_.push_back(static_cast<float>(child.GetNStarted()));
+    }
+    // Vectorizable scoring and argmax pass.
+    int best_idx = 0;
+    float best = -std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < scratch_p_.size(); ++i) {
+      const float score =
+          scratch_q_[i] + puct_mult * scratch_p_[i] / (1.0f + scratch_n_started_[i]);
       if (score > best) {
         best = score;
-        best_edge = child;
+        best_idx = i;
       }
     }
+    // Re-seek the forward-only Edge_Iterator to the argmax edge.
+    best_edge = node->Edges();
+    for (int i = 0; i < best_idx; ++i) ++best_edge;
 
     history_.Append(best_edge.GetMove());
     if (is_root_node && possible_moves <= 1 && !search_->limits_.infinite) {
@@ -671,6 +1201,30 @@ void SearchWorker::ExtendNode(Node* node) {
       node->MakeTerminal(GameResult::DRAW);
       return;
     }
+
+    // Tablebase probe. Only when the 50-move counter just reset (i.e. the
+    // move into this node was a capture or pawn move) is the WDL value
+    // exact; deeper in the tree that covers every first entry into
+    // tablebase territory.
+    if (search_->syzygy_tb_ && board.castlings().as_int() == 0 &&
+        history_.Last().GetNoCapturePly() == 0 &&
+        board.ours().count() + board.theirs().count() <=
+            search_->syzygy_tb_->max_cardinality()) {
+      int wdl;
+      if (search_->syzygy_tb_->ProbeWdl(board, &wdl)) {
+        // A win for the side to move is a loss for the player who moved
+        // into this node, and vice versa. Cursed wins and blessed losses
+        // are draws under the 50-move rule.
+        if (wdl == 2) {
+          node->MakeTerminal(GameResult::BLACK_WON);
+        } else if (wdl == -2) {
+          node->MakeTerminal(GameResult::WHITE_WON);
+        } else {
+          node->MakeTerminal(GameResult::DRAW);
+        }
+        return;
+      }
+    }
   }
 
   // Add legal moves as edges of this node.
@@ -680,15 +1234,35 @@ void SearchWorker::ExtendNode(Node* node) {
 // Returns whether node was already in cache.
 bool SearchWorker::AddNodeToComputation(Node* node, bool add_if_cached) {
   auto hash = history_.HashLast(search_->kCacheHistoryLength + 1);
+  // Position-only hash, used to share evaluations between transposed move
+  // orders reaching the same position. 0 when sharing is off, or when the
+  // exact-history hash is already position-only.
+  uint64_t position_hash = 0;
+  if (search_->kTranspositionSharing) {
+    position_hash = history_.HashLast(1);
+    if (position_hash == hash) position_hash = 0;
+  }
   // If already in cache, no need to do anything.
   if (add_if_cached) {
-    if (computation_->AddInputByHash(hash)) return true;
+    if (computation_->AddInputByHash(hash)) {
+      if (prefetched_hashes_.erase(hash)) ++prefetches_consumed_;
+      return true;
+    }
+    // The exact-history key missed, but a transposed move order may have
+    // evaluated the same position already. History planes of that evaluation
+    // may differ slightly, which is an accepted trade-off.
+    if (position_hash && computation_->AddInputByHash(position_hash)) {
+      if (prefetched_hashes_.erase(position_hash)) ++prefetches_consumed_;
+      return true;
+    }
   } else {
     if (search_->cache_->ContainsKey(hash)) return true;
   }
-  auto planes = EncodePositionForNN(history_, 8);
+  auto planes = encoder_.EncodePositionForNN(history_, 8);
 
-  std::vector<uint16_t> moves;
+  // Scratch buffer; AddInput() copies the indices into its own flat storage.
+  auto& moves = moves_scratch_;
+  moves.clear();
 
   if (node && node->HasChildren()) {
     // Legal moves are known, use them.
@@ -706,22 +1280,54 @@ bool SearchWorker::AddNodeToComputation(Node* node, bool add_if_cached) {
     }
   }
 
-  computation_->AddInput(hash, std::move(planes), std::move(moves));
+  computation_->AddInput(hash, std::move(planes), moves.data(), moves.size(),
+                         position_hash);
+  if (!add_if_cached) {
+    prefetched_hashes_.insert(hash);
+    ++prefetches_issued_;
+  }
   return false;
 }
 
 // 3. Prefetch into cache.
 // ~~~~~~~~~~~~~~~~~~~~~~~
 void SearchWorker::MaybePrefetchIntoCache() {
+  TRACE_SCOPE("prefetch");
   // TODO(mooskagh) Remove prefetch into cache if node collisions work well.
   // If there are requests to NN, but the batch is not full, try to prefetch
   // nodes which are likely useful in future.
   if (computation_->GetCacheMisses() > 0 &&
-      computation_->GetCacheMisses() < search_->kMaxPrefetchBatch) {
+      computation_->GetCacheMisses() < prefetch_budget_) {
     history_.Trim(search_->played_history_.GetLength());
     SharedMutex::SharedLock lock(search_->nodes_mutex_);
-    PrefetchIntoCache(search_->root_node_, search_->kMaxPrefetchBatch -
-                                               computation_->GetCacheMisses());
+    PrefetchIntoCache(search_->root_node_,
+                      prefetch_budget_ - computation_->GetCacheMisses());
+  }
+  UpdatePrefetchBudget();
+}
+
+void SearchWorker::UpdatePrefetchBudget() {
+  if (search_->kMaxPrefetchBatch == 0) return;
+  if (prefetches_issued_ < kPrefetchAdjustWindow) return;
+  const float used_fraction =
+      static_cast<float>(prefetches_consumed_) / prefetches_issued_;
+  // Speculation mostly pays off: prefetch more aggressively. Mostly wasted:
+  // back off, but keep at least one slot so that the controller continues to
+  // get samples and can recover when the tree shape changes.
+  if (used_fraction > kPrefetchGrowThreshold) {
+    prefetch_budget_ = std::min(search_->kMaxPrefetchBatch,
+                                prefetch_budget_ + (prefetch_budget_ / 4) + 1);
+  } else if (used_fraction < kPrefetchShrinkThreshold) {
+    prefetch_budget_ =
+        std::max(1, prefetch_budget_ - (prefetch_budget_ / 4) - 1);
+  }
+  prefetches_issued_ = 0;
+  prefetches_consumed_ = 0;
+  // Entries not consumed within the window are unlikely to be consumed at
+  // all; drop them so the bookkeeping stays small.
+  if (prefetched_hashes_.size() >
+      4 * static_cast<size_t>(kPrefetchAdjustWindow)) {
+    prefetched_hashes_.clear();
   }
 }
 
@@ -811,12 +1417,19 @@ int SearchWorker::PrefetchIntoCache(Node* node, int budget) {
 void SearchWorker::RunNNComputation() {
   // This function is so small as to be silly, but its parent function is
   // conceptually cleaner for it.
+  TRACE_SCOPE("nn_compute");
+  const auto nn_start = std::chrono::steady_clock::now();
   if (computation_->GetBatchSize() != 0) computation_->ComputeBlocking();
+  stats_.nn_us += ElapsedUs(nn_start);
 }
 
 // 5. Retrieve NN computations (and terminal values) into nodes.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 void SearchWorker::FetchMinibatchResults() {
+  TRACE_SCOPE("fetch_results");
+  // Scratch for one node's policy row, reused across the batch.
+  std::vector<uint16_t> move_ids;
+  std::vector<float> pvals;
   // Populate NN/cached results, or terminal results, into nodes.
   int idx_in_computation = 0;
   for (auto& node_to_process : nodes_to_process_) {
@@ -830,22 +1443,40 @@ void SearchWorker::FetchMinibatchResults() {
     // For NN results, we need to populate policy as well as value.
     // First the value...
     node_to_process.v = -computation_->GetQVal(idx_in_computation);
-    // ...and secondly, the policy data.
-    float total = 0.0;
+    // ...and secondly, the policy data. Fetch the node's policy row with
+    // one call and post-process it as a dense array: the temperature and
+    // normalization loops then vectorize instead of paying a virtual call
+    // and a libm pow per edge.
+    move_ids.clear();
     for (auto edge : node->Edges()) {
-      float p = computation_->GetPVal(idx_in_computation,
-                                      edge.GetMove().as_nn_index());
-      if (search_->kPolicySoftmaxTemp != 1.0f) {
-        p = pow(p, 1 / search_->kPolicySoftmaxTemp);
+      move_ids.push_back(edge.GetMove().as_nn_index());
+    }
+    const int count = move_ids.size();
+    pvals.resize(count);
+    computation_->GetPVals(idx_in_computation, move_ids.data(), count,
+                           pvals.data());
+    if (search_->kPolicySoftmaxTemp != 1.0f) {
+      const float alpha = 1.0f / search_->kPolicySoftmaxTemp;
+      // FastPow's ~1e-3 error is far below network noise, and the result
+      // is normalized right after anyway. The comparison-as-multiplicand
+      // keeps the loop branch-free: FastPow of an exact zero (possible for
+      // quantized cache entries) is garbage, but guaranteed finite since
+      // FastExp2 flushes underflow to zero, so the mask reliably zeroes it.
+      // (Clamping the base with std::max instead would also work but
+      // defeats gcc's if-conversion for this loop.)
+      for (int i = 0; i < count; ++i) {
+        const float nonzero = pvals[i] > 0.0f;
+        pvals[i] = FastPow(pvals[i], alpha) * nonzero;
       }
-      total += p;
-      edge.edge()->SetP(p);
     }
-    // Normalize P values to add up to 1.0.
+    float total = 0.0f;
+    for (int i = 0; i < count; ++i) total += pvals[i];
     if (total > 0.0f) {
-      float scale = 1.0f / total;
-      for (auto edge : node->Edges()) edge.edge()->SetP(edge.GetP() * scale);
+      const float scale = 1.0f / total;
+      for (int i = 0; i < count; ++i) pvals[i] *= scale;
     }
+    int i = 0;
+    for (auto edge : node->Edges()) edge.edge()->SetP(pvals[i++]);
     // Add Dirichlet noise if enabled and at root.
     if (search_->kNoise && node == search_->root_node_) {
       ApplyDirichletNoise(node, 0.25, 0.3);
@@ -857,54 +1488,103 @@ void SearchWorker::FetchMinibatchResults() {
 // 6. Propagate the new nodes' information to all their parents in the tree.
 // ~~~~~~~~~~~~~~
 void SearchWorker::DoBackupUpdate() {
-  // Update nodes.
+  TRACE_SCOPE("backup");
+  const auto backup_start = std::chrono::steady_clock::now();
+  int playouts_finished = 0;
+  {
+    // Counters along the parent chain are atomic, so backup only needs the
+    // shared lock (which keeps the tree structure stable). The exclusive
+    // lock is reserved for structural changes.
+    const auto lock_start = std::chrono::steady_clock::now();
+    SharedMutex::SharedLock lock(search_->nodes_mutex_);
+    stats_.lock_wait_us += ElapsedUs(lock_start);
+    for (NodeToProcess& node_to_process : nodes_to_process_) {
+      Node* node = node_to_process.node;
+      if (node_to_process.is_collision) {
+        // If it was a collision, just undo counters.
+        for (node = node->GetParent(); node != search_->root_node_->GetParent();
+             node = node->GetParent()) {
+          node->CancelScoreUpdate();
+        }
+        continue;
+      }
+
+      // Backup V value up to a root. After 1 visit, V = Q.
+      float v = node_to_process.v;
+      // Maximum depth the node is explored.
+      uint16_t depth = 0;
+      // If the node is terminal, mark it as fully explored to an "infinite"
+      // depth.
+      uint16_t cur_full_depth = node->IsTerminal() ? 999 : 0;
+      bool full_depth_updated = true;
+      for (Node* n = node; n != search_->root_node_->GetParent();
+           n = n->GetParent()) {
+        ++depth;
+        n->FinalizeScoreUpdate(v);
+        // Q will be flipped for opponent.
+        v = -v;
+
+        // Update the stats.
+        // Max depth.
+        n->UpdateMaxDepth(depth);
+        // Full depth.
+        if (full_depth_updated)
+          full_depth_updated = n->UpdateFullDepth(&cur_full_depth);
+      }
+      ++playouts_finished;
+    }
+  }
+
+  // Search-wide structures are still guarded by the exclusive lock; update
+  // them once per batch rather than once per node.
+  const auto lock_start = std::chrono::steady_clock::now();
   SharedMutex::Lock lock(search_->nodes_mutex_);
+  stats_.lock_wait_us += ElapsedUs(lock_start);
+  // Marking interior nodes as solved changes what selection may touch, so
+  // it happens under the exclusive lock.
   for (NodeToProcess& node_to_process : nodes_to_process_) {
-    Node* node = node_to_process.node;
-    if (node_to_process.is_collision) {
-      // If it was a collision, just undo counters.
-      for (node = node->GetParent(); node != search_->root_node_->GetParent();
-           node = node->GetParent()) {
-        node->CancelScoreUpdate();
-      }
-      continue;
+    if (!node_to_process.is_collision && node_to_process.node->IsTerminal()) {
+      MaybeSolveParents(node_to_process.node);
     }
+  }
+  search_->total_playouts_ += playouts_finished;
+  if (playouts_finished > 0) {
+    search_->best_move_edge_ =
+        search_->GetBestChildNoTemperature(search_->root_node_);
+    search_->UpdatePv();
+  }
+  stats_.backup_us += ElapsedUs(backup_start);
+}
 
-    // Backup V value up to a root. After 1 visit, V = Q.
-    float v = node_to_process.v;
-    // Maximum depth the node is explored.
-    uint16_t depth = 0;
-    // If the node is terminal, mark it as fully explored to an "infinite"
-    // depth.
-    uint16_t cur_full_depth = node->IsTerminal() ? 999 : 0;
-    bool full_depth_updated = true;
-    for (Node* n = node; n != search_->root_node_->GetParent();
-         n = n->GetParent()) {
-      ++depth;
-      n->FinalizeScoreUpdate(v);
-      // Q will be flipped for opponent.
-      v = -v;
-
-      // Update the stats.
-      // Max depth.
-      n->UpdateMaxDepth(depth);
-      // Full depth.
-      if (full_depth_updated)
-        full_depth_updated = n->UpdateFullDepth(&cur_full_depth);
-      // Best move.
-      if (n->GetParent() == search_->root_node_ &&
-          search_->best_move_edge_.GetN() <= n->GetN()) {
-        search_->best_move_edge_ =
-            search_->GetBestChildNoTemperature(search_->root_node_);
+void SearchWorker::MaybeSolveParents(Node* node) {
+  // Node Q values are from the perspective of the player who moved into the
+  // node, so a proven child with Q=1 means the move into it wins for the
+  // side to move at the parent, proving the parent lost. A parent without a
+  // winning child is proven only once every child is proven, and is then
+  // worth the best proven child's value, negated.
+  for (Node* parent = node->GetParent();
+       parent != search_->root_node_->GetParent(); parent = parent->GetParent()) {
+    if (parent->IsTerminal()) return;
+    if (node->GetQ() == 1.0f) {
+      parent->MakeSolved(-1.0f);
+    } else {
+      float best = -1.0f;
+      for (auto edge : parent->Edges()) {
+        if (!edge.node() || !edge.node()->IsTerminal()) return;
+        best = std::max(best, edge.node()->GetQ());
       }
+      parent->MakeSolved(-best);
     }
-    ++search_->total_playouts_;
+    node = parent;
   }
 }
 
 // 7. Update the Search's status and progress information.
 //~~~~~~~~~~~~~~~~~~~~
 void SearchWorker::UpdateCounters() {
+  if (stats_slot_ < 0) stats_slot_ = search_->RegisterWorkerStats();
+  search_->ReportWorkerStats(stats_slot_, stats_);
+  search_->MaybeRecycleTreeMemory();
   search_->UpdateRemainingMoves();  // Updates smart pruning counters.
   search_->MaybeOutputInfo();
   search_->MaybeTriggerStop();
@@ -18,14 +18,19 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <shared_mutex>
 #include <thread>
+#include <unordered_set>
 #include "chess/callbacks.h"
 #include "chess/uciloop.h"
 #include "mcts/node.h"
 #include "neural/cache.h"
+#include "neural/encoder.h"
 #include "neural/network.h"
+#include "syzygy/syzygy.h"
 #include "utils/mutex.h"
 #include "utils/optional.h"
 #include "utils/optionsdict.h"
@@ -41,12 +46,27 @@ struct SearchLimits {
   MoveList searchmoves;
 };
 
+// Per-worker performance counters, for tuning batch sizes and thread counts.
+// Filled in by SearchWorker and periodically published to Search, which
+// reports them together with verbose move stats. All times in microseconds.
+struct WorkerStats {
+  int64_t batches = 0;
+  int64_t batch_size_sum = 0;
+  int64_t cache_hits = 0;
+  int64_t cache_misses = 0;
+  int64_t gather_us = 0;
+  int64_t nn_us = 0;
+  int64_t backup_us = 0;
+  int64_t lock_wait_us = 0;
+};
+
 class Search {
  public:
   Search(const NodeTree& tree, Network* network,
          BestMoveInfo::Callback best_move_callback,
          ThinkingInfo::Callback info_callback, const SearchLimits& limits,
-         const OptionsDict& options, NNCache* cache);
+         const OptionsDict& options, NNCache* cache,
+         SyzygyTablebase* syzygy_tb = nullptr);
 
   ~Search();
 
@@ -62,6 +82,11 @@ class Search {
   // Runs search single-threaded, blocking.
   void RunSingleThreaded();
 
+  // Replaces the search limits while the search is running and restarts the
+  // clock. Used to convert a ponder search into a normal timed one on
+  // ponderhit, without dropping the tree or batches already gathered.
+  void SetLimits(const SearchLimits& limits);
+
   // Stops search. At the end bestmove will be returned. The function is not
   // blocking, so it returns before search is actually done.
   void Stop();
@@ -77,6 +102,10 @@ class Search {
   // from the above function; with temperature enabled, these two functions may
   // return results from different possible moves.
   float GetBestEval() const;
+  // Returns the number of playouts made during this search.
+  int64_t GetTotalPlayouts() const;
+  // Returns the sum of all workers' last published performance counters.
+  WorkerStats GetWorkerStats() const;
 
   // Strings for UCI params. So that others can override defaults.
   // TODO(mooskagh) There are too many options for now. Factor out that into a
@@ -93,6 +122,13 @@ class Search {
   static const char* kCacheHistoryLengthStr;
   static const char* kPolicySoftmaxTempStr;
   static const char* kAllowedNodeCollisionsStr;
+  static const char* kTranspositionSharingStr;
+  static const char* kMaxTreeNodesStr;
+  static const char* kTreeMemSoftLimitStr;
+  static const char* kPipelineBatchesStr;
+  static const char* kAdaptiveTimeManagerStr;
+  static const char* kUciInfoMinIntervalStr;
+  static const char* kMultiPvStr;
 
  private:
   // Returns the best move, maybe with temperature (according to the settings).
@@ -104,18 +140,54 @@ class Search {
   EdgeAndNode GetBestChildNoTemperature(Node* parent) const;
   EdgeAndNode GetBestChildWithTemperature(Node* parent,
                                           float temperature) const;
+  // Returns up to @count best children by the NoTemperature criteria, best
+  // first. Only used for MultiPV output, so not optimized for hot paths.
+  std::vector<EdgeAndNode> GetBestChildrenNoTemperature(Node* parent,
+                                                        int count) const;
 
   int64_t GetTimeSinceStart() const;
   void UpdateRemainingMoves();
   void MaybeTriggerStop();
   void MaybeOutputInfo();
+  // If the tree node budget is exceeded, recycles the least-visited root
+  // subtree so that 'go infinite' keeps running in bounded memory.
+  void MaybeRecycleTreeMemory();
+  // Extends or cuts the remaining time budget depending on best move
+  // stability and the visit gap between the top two root edges. Requires
+  // nodes_mutex_ and counters_mutex_ to be held.
+  void UpdateTimeBudget();
   void SendUciInfo();  // Requires nodes_mutex_ to be held.
+  // Rebuilds the cached principal variation after a backup batch possibly
+  // changed a best-child relationship. Requires nodes_mutex_ to be held.
+  void UpdatePv();
 
   void SendMovesStats() const;
+  // Outputs one info line with the tree allocation counters (see
+  // Node::GetMemoryStats). Called when the search ends.
+  void SendTreeMemStats() const;
+
+  // Registers a worker for stats reporting, returns its slot index.
+  int RegisterWorkerStats();
+  // Publishes the current counters of the worker in slot @idx.
+  void ReportWorkerStats(int idx, const WorkerStats& stats);
+  // Outputs one info line per worker. Requires counters_mutex_ to be held.
+  void SendWorkerStats() const;
 
   // We only need first ply for debug output, but could be easily generalized.
   NNCacheLock GetCachedFirstPlyResult(EdgeAndNode) const;
 
+  // Hands @info to the output thread. Never blocks: when the queue is full,
+  // the oldest plain (comment-less) info line is dropped instead.
+  void EnqueueInfo(const ThinkingInfo& info) const;
+  // Same, for a group of lines (one per PV) which must be published and
+  // coalesced as a unit.
+  void EnqueueInfos(std::vector<ThinkingInfo> infos) const;
+  void EnqueueBestMove(const BestMoveInfo& info) const;
+  // Body of output_thread_. Invokes the callbacks (which format and write)
+  // away from the search threads, coalescing stale plain info lines and
+  // keeping at least kUciInfoMinInterval ms between them.
+  void OutputThreadLoop();
+
   mutable Mutex counters_mutex_ ACQUIRED_AFTER(nodes_mutex_);
   // Tells all threads to stop.
   bool stop_ GUARDED_BY(counters_mutex_) = false;
@@ -127,23 +199,38 @@ class Search {
   // Stored so that in the case of non-zero temperature GetBestMove() returns
   // consistent results.
   std::pair<Move, Move> best_move_ GUARDED_BY(counters_mutex_);
+  // Last published counters of each worker.
+  std::vector<WorkerStats> worker_stats_ GUARDED_BY(counters_mutex_);
+  // Time manager state. The adjusted budget starts at limits_.time_ms and
+  // may be extended or cut by UpdateTimeBudget() mid-search.
+  int64_t adjusted_time_budget_ms_ GUARDED_BY(counters_mutex_) = -1;
+  Edge* time_mgr_best_edge_ GUARDED_BY(counters_mutex_) = nullptr;
+  int64_t time_mgr_last_change_ms_ GUARDED_BY(counters_mutex_) = 0;
+  bool time_extended_ GUARDED_BY(counters_mutex_) = false;
+  // Whether the tree memory soft limit warning was already emitted.
+  bool mem_warning_sent_ GUARDED_BY(counters_mutex_) = false;
 
   Mutex threads_mutex_;
   std::vector<std::thread> threads_ GUARDED_BY(threads_mutex_);
 
   Node* root_node_;
   NNCache* cache_;
+  SyzygyTablebase* syzygy_tb_;
   // Fixed positions which happened before the search.
   const PositionHistory& played_history_;
 
   Network* const network_;
-  const SearchLimits limits_;
-  const std::chrono::steady_clock::time_point start_time_;
+  // Only replaced by SetLimits() (on ponderhit), under counters_mutex_.
+  SearchLimits limits_;
+  std::chrono::steady_clock::time_point start_time_;
   const int64_t initial_visits_;
 
   mutable SharedMutex nodes_mutex_;
   EdgeAndNode best_move_edge_ GUARDED_BY(nodes_mutex_);
   Edge* last_outputted_best_move_edge_ GUARDED_BY(nodes_mutex_) = nullptr;
+  // Cached PV (in UCI orientation), so that info output is a plain copy
+  // rather than a tree walk.
+  std::vector<Move> pv_ GUARDED_BY(nodes_mutex_);
   ThinkingInfo uci_info_ GUARDED_BY(nodes_mutex_);
   int64_t total_playouts_ GUARDED_BY(nodes_mutex_) = 0;
   int remaining_playouts_ GUARDED_BY(nodes_mutex_) =
@@ -152,6 +239,22 @@ class Search {
   BestMoveInfo::Callback best_move_callback_;
   ThinkingInfo::Callback info_callback_;
 
+  // Queue feeding output_thread_. The callbacks do string formatting and
+  // (possibly blocking) writes, so search threads only ever enqueue here;
+  // plain std::mutex as it pairs with a condition variable.
+  struct OutputItem {
+    bool is_best_move;
+    // One entry normally, one per line with MultiPV.
+    std::vector<ThinkingInfo> infos;
+    BestMoveInfo best_move{Move()};
+  };
+  mutable std::mutex output_mutex_;
+  mutable std::condition_variable output_cv_;
+  mutable std::deque<OutputItem> output_queue_;  // Guarded by output_mutex_.
+  bool output_shutdown_ = false;                 // Guarded by output_mutex_.
+  std::chrono::steady_clock::time_point last_info_time_;  // Output thread only.
+  std::thread output_thread_;
+
   // External parameters.
   const int kMiniBatchSize;
   const int kMaxPrefetchBatch;
@@ -165,6 +268,13 @@ class Search {
   const bool kCacheHistoryLength;
   const float kPolicySoftmaxTemp;
   const int kAllowedNodeCollisions;
+  const bool kTranspositionSharing;
+  const int kMaxTreeNodes;
+  const int kTreeMemSoftLimitMb;
+  const bool kPipelineBatches;
+  const bool kAdaptiveTimeManager;
+  const int kUciInfoMinInterval;
+  const int kMultiPv;
 
   friend class SearchWorker;
 };
@@ -175,13 +285,21 @@ class Search {
 class SearchWorker {
  public:
   SearchWorker(Search* search)
-      : search_(search), history_(search_->played_history_) {}
+      : search_(search),
+        prefetch_budget_(search->kMaxPrefetchBatch),
+        history_(search_->played_history_) {
+    // Sized once for the whole search; a batch holds at most kMiniBatchSize
+    // evaluations plus the allowed collisions.
+    nodes_to_process_.reserve(search->kMiniBatchSize +
+                              search->kAllowedNodeCollisions);
+  }
 
   // Runs iterations while needed.
   void RunBlocking() {
     while (IsSearchActive()) {
       ExecuteOneIteration();
     }
+    FlushPipeline();
   }
 
   // Does one full iteration of MCTS search:
@@ -192,11 +310,27 @@ class SearchWorker {
   // 5. Retrieve NN computations (and terminal values) into nodes.
   // 6. Propagate the new nodes' information to all their parents in the tree.
   // 7. Update the Search's status and progress information.
+  // With pipelining on, steps 4-7 for the batch gathered in this call happen
+  // during the next call: the helper thread evaluates it while the worker
+  // gathers the following batch.
   void ExecuteOneIteration();
 
+  // Completes the batch which is still in flight in the backend, if any.
+  // Must be called before the worker is destroyed.
+  void FlushPipeline();
+
   // Returns whether another search iteration is needed (false means exit).
   bool IsSearchActive() const;
 
+  // Asynchronous stepping, used by batched selfplay. Gathers one minibatch
+  // (steps 1-3) and hands it to the backend without blocking; @on_ready
+  // runs (on a backend thread) when the results are in, after which the
+  // owner calls CompleteAsyncIteration() from a thread of its own for
+  // steps 5-7. One thread can thus interleave iterations of many searches.
+  // Must not be mixed with ExecuteOneIteration(); pipelining is bypassed.
+  void BeginAsyncIteration(std::function<void()> on_ready);
+  void CompleteAsyncIteration();
+
   // The same operations one by one:
   // 1. Initialize internal structures.
   // @computation is the computation to use on this iteration.
@@ -231,16 +365,53 @@ class SearchWorker {
     float v;
   };
 
+  // A batch which has been handed to the backend on a helper thread while
+  // the worker gathers the next one. Only used when pipelining is on.
+  struct InFlightBatch {
+    std::vector<NodeToProcess> nodes_to_process;
+    std::unique_ptr<CachingComputation> computation;
+    std::thread compute_thread;
+  };
+
   NodeToProcess PickNodeToExtend();
   void ExtendNode(Node* node);
+  // Converts proven child results into proven parent results (MCTS-solver
+  // style), walking up from @node as far as the results allow.
+  void MaybeSolveParents(Node* node);
   bool AddNodeToComputation(Node* node, bool add_if_cached = true);
   int PrefetchIntoCache(Node* node, int budget);
+  // Grows or shrinks @prefetch_budget_ depending on what fraction of the
+  // speculatively cached entries the search later consumed.
+  void UpdatePrefetchBudget();
+  // Waits for @batch's NN evaluation and runs steps 5-7 for it.
+  void CompleteBatch(InFlightBatch batch);
 
   Search* const search_;
   std::vector<NodeToProcess> nodes_to_process_;
   std::unique_ptr<CachingComputation> computation_;
+  std::unique_ptr<InFlightBatch> in_flight_;
+  // Adaptive prefetch controller. Starts at kMaxPrefetchBatch (which remains
+  // the upper bound) and adapts to how often prefetched evaluations are
+  // actually fetched from the cache afterwards.
+  int prefetch_budget_;
+  std::unordered_set<uint64_t> prefetched_hashes_;
+  int prefetches_issued_ = 0;
+  int prefetches_consumed_ = 0;
+  // Performance counters, published to search_ in UpdateCounters().
+  WorkerStats stats_;
+  int stats_slot_ = -1;
+  // Scratch buffers for the PUCT scoring pass of PickNodeToExtend(), kept
+  // here so their capacity is reused between descents.
+  std::vector<float> scratch_p_;
+  std::vector<float> scratch_q_;
+  std::vector<float> scratch_n_started_;
+  // Scratch for the policy indices handed to AddInput(), reused across all
+  // cache misses of the search.
+  std::vector<uint16_t> moves_scratch_;
   // History is reset and extended by PickNodeToExtend().
   PositionHistory history_;
+  // Reuses shared history planes between encodings of nearby leaves.
+  IncrementalEncoder encoder_;
 };
 
 }  // namespace lczero
@@ -0,0 +1,82 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "neural/autotune.h"
+
+#include <chrono>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace lczero {
+
+namespace {
+const int kMaxBatchSize = 512;
+const int kIterations = 3;
+
+double MeasureEvalsPerSecond(Network* network, int batch_size) {
+  std::mt19937_64 rng(67);
+  std::vector<InputPlanes> batch;
+  batch.reserve(batch_size);
+  for (int i = 0; i < batch_size; ++i) {
+    InputPlanes planes(kInputPlanes);
+    for (auto& plane : planes) {
+      plane.mask = rng() & rng() & rng();  // ~8 bits set, like real planes.
+      plane.value = 1.0f;
+    }
+    batch.push_back(std::move(planes));
+  }
+
+  auto run_once = [&]() {
+    auto computation = network->NewComputation();
+    for (const auto& planes : batch) {
+      computation->AddInput(InputPlanes(planes));
+    }
+    computation->ComputeBlocking();
+  };
+
+  run_once();  // Warmup: lazy allocations, JIT, clock ramp-up.
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) run_once();
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  return batch_size * kIterations / seconds;
+}
+}  // namespace
+
+int AutotuneMiniBatchSize(Network* network) {
+  std::vector<std::pair<int, double>> points;
+  double peak = 0.0;
+  for (int size = 1; size <= kMaxBatchSize; size *= 2) {
+    const double rate = MeasureEvalsPerSecond(network, size);
+    points.emplace_back(size, rate);
+    if (rate > peak) {
+      peak = rate;
+    } else if (rate < 0.9 * peak) {
+      // Clearly past the knee; larger batches only add latency.
+      break;
+    }
+  }
+  for (const auto& point : points) {
+    if (point.second >= 0.95 * peak) return point.first;
+  }
+  return points.back().first;
+}
+
+}  // namespace lczero
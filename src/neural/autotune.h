@@ -0,0 +1,32 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "neural/network.h"
+
+namespace lczero {
+
+// Probes @network with synthetic batches of increasing size and returns the
+// knee of the throughput curve: the smallest batch size within 5% of the
+// best evals/sec measured. Takes a fraction of a second on typical
+// backends; meant to run once at startup when minibatch-size is set to 0
+// (auto).
+int AutotuneMiniBatchSize(Network* network);
+
+}  // namespace lczero
@@ -52,6 +52,48 @@ void Batchnorm::Apply(const size_t batch_size, const size_t channels,
   }
 }
 
+void Batchnorm::ApplyBias(const size_t batch_size, const size_t channels,
+                          float* data, const float* biases,
+                          const float* eltwise) {
+  for (size_t i = 0; i < batch_size; i++) {
+    for (size_t c = 0; c < channels; ++c) {
+      const auto bias = biases[c];
+      auto arr = &data[c * kSquares];
+
+      if (eltwise == nullptr) {
+        for (size_t b = 0; b < kSquares; b++) {
+          float val = arr[b] + bias;
+          arr[b] = val > 0 ? val : 0;
+        }
+      } else {
+        auto res = &eltwise[c * kSquares];
+        for (size_t b = 0; b < kSquares; b++) {
+          float val = res[b] + arr[b] + bias;
+          arr[b] = val > 0 ? val : 0;
+        }
+      }
+    }
+    data += channels * kSquares;
+    if (eltwise != nullptr) eltwise += channels * kSquares;
+  }
+}
+
+void Batchnorm::FoldBatchNorm(Weights::ConvBlock* conv) {
+  const size_t outputs = conv->bn_means.size();
+  const size_t stride = conv->weights.size() / outputs;
+  for (size_t o = 0; o < outputs; o++) {
+    const float scale = 1.0f / std::sqrt(conv->bn_stddivs[o] + kEpsilon);
+    for (size_t i = 0; i < stride; i++) {
+      conv->weights[o * stride + i] *= scale;
+    }
+    conv->biases[o] = (conv->biases[o] - conv->bn_means[o]) * scale;
+    // Make the remaining batch normalization a no-op for code which still
+    // applies it: zero mean, and a variance which inverts to exactly one.
+    conv->bn_means[o] = 0.0f;
+    conv->bn_stddivs[o] = 1.0f - kEpsilon;
+  }
+}
+
 void Batchnorm::InvertStddev(Weights::ConvBlock* conv) {
   std::vector<float>& stddivs = conv->bn_stddivs;
   InvertStddev(stddivs.size(), stddivs.data());
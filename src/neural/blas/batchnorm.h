@@ -36,6 +36,19 @@ class Batchnorm {
                     const float* means, const float* stddivs,
                     const float* eltwise = nullptr);
 
+  // Add the bias and a possible skip connection, and apply a Relu. The
+  // replacement of Apply() for folded weights.
+  static void ApplyBias(const size_t batch_size, const size_t channels,
+                        float* data, const float* biases,
+                        const float* eltwise = nullptr);
+
+  // Folds the batch normalization of a ConvBlock into its convolution
+  // weights and biases (in place). Afterwards the bn_means are zero and the
+  // bn_stddivs invert to a scale of exactly one, so code which still applies
+  // batch normalization stays correct, while backends aware of the folding
+  // only need to add the biases (ApplyBias).
+  static void FoldBatchNorm(Weights::ConvBlock* conv);
+
   // Invert the bn_stddivs elements of a ConvBlock (in place).
   static void InvertStddev(Weights::ConvBlock* conv);
 
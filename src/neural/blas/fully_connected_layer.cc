@@ -29,7 +29,9 @@ void FullyConnectedLayer::Forward1D(size_t batch_size, const size_t input_size,
                                     const size_t output_size,
                                     const float* inputs, const float* weights,
                                     const float* biases, bool apply_relu,
-                                    float* outputs) {
+                                    float* outputs,
+                                    const size_t input_stride) {
+  const auto stride = input_stride == 0 ? input_size : input_stride;
   if (batch_size == 1) {
     // Just a matrix-vector multiplication
     //
@@ -75,7 +77,7 @@ void FullyConnectedLayer::Forward1D(size_t batch_size, const size_t input_size,
                 weights,            // A
                 (int)input_size,    // lda, leading rank of A
                 inputs,             // B
-                (int)input_size,    // ldb, leading rank of B
+                (int)stride,        // ldb, leading rank of B
                 0.0f,               // beta
                 outputs,            // C
                 (int)output_size);  // ldc, leading rank of C
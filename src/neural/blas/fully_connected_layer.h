@@ -27,11 +27,15 @@ class FullyConnectedLayer {
  public:
   FullyConnectedLayer() = delete;
 
-  // Forward inference, batched, from input_size to output_size
+  // Forward inference, batched, from input_size to output_size.
+  // @input_stride is the distance between consecutive batch entries of the
+  // input, for reading a slice of a wider buffer; 0 means densely packed
+  // (i.e. equal to @input_size).
   static void Forward1D(const size_t batch_size, const size_t input_size,
                         const size_t output_size, const float* input,
                         const float* weights, const float* biases,
-                        bool apply_relu, float* output);
+                        bool apply_relu, float* output,
+                        const size_t input_stride = 0);
 
   // Forward inference, no batched, from input_size to scalar
   static float Forward0D(const size_t input_size, const float* input,
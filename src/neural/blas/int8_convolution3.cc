@@ -0,0 +1,148 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2018 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "neural/blas/int8_convolution3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lczero {
+
+namespace {
+
+std::int8_t QuantizeValue(const float value, const float scale) {
+  const auto scaled = std::lround(value * scale);
+  return static_cast<std::int8_t>(std::max(-127l, std::min(127l, scaled)));
+}
+
+}  // namespace
+
+Int8Convolution3::Int8Convolution3(const size_t max_input_layers,
+                                   const size_t max_output_layers)
+    : input_q_(max_input_layers * kSquares),
+      col_(max_input_layers * kFilterSquares * kSquares),
+      acc_(max_output_layers * kSquares) {}
+
+Int8ConvWeights Int8Convolution3::QuantizeWeights(
+    const std::vector<float>& weights, const size_t output_channels,
+    const size_t input_channels) {
+  const auto filter_values = input_channels * kFilterSquares;
+
+  Int8ConvWeights result;
+  result.weights.resize(output_channels * filter_values);
+  result.scales.resize(output_channels);
+
+  for (size_t o = 0; o < output_channels; o++) {
+    const auto* channel = &weights[o * filter_values];
+    auto max_abs = 0.0f;
+    for (size_t i = 0; i < filter_values; i++) {
+      max_abs = std::max(max_abs, std::abs(channel[i]));
+    }
+    const auto scale = max_abs > 0.0f ? 127.0f / max_abs : 1.0f;
+    result.scales[o] = scale;
+    for (size_t i = 0; i < filter_values; i++) {
+      result.weights[o * filter_values + i] = QuantizeValue(channel[i], scale);
+    }
+  }
+  return result;
+}
+
+float Int8Convolution3::QuantizeInput(const size_t input_channels,
+                                      const float* input) {
+  const auto values = input_channels * kSquares;
+  auto max_abs = 0.0f;
+  for (size_t i = 0; i < values; i++) {
+    max_abs = std::max(max_abs, std::abs(input[i]));
+  }
+  const auto scale = max_abs > 0.0f ? 127.0f / max_abs : 1.0f;
+  for (size_t i = 0; i < values; i++) {
+    input_q_[i] = QuantizeValue(input[i], scale);
+  }
+  return scale;
+}
+
+void Int8Convolution3::Im2Col(const size_t input_channels) {
+  constexpr auto pad = kFilterSize / 2;
+
+  for (size_t c = 0; c < input_channels; c++) {
+    const auto* plane = &input_q_[c * kSquares];
+    for (auto fy = 0; fy < kFilterSize; fy++) {
+      for (auto fx = 0; fx < kFilterSize; fx++) {
+        auto* row =
+            &col_[(c * kFilterSquares + fy * kFilterSize + fx) * kSquares];
+        for (auto y = 0; y < kHeight; y++) {
+          const auto in_y = y + fy - pad;
+          if (in_y < 0 || in_y >= kHeight) {
+            std::memset(&row[y * kWidth], 0, kWidth);
+            continue;
+          }
+          for (auto x = 0; x < kWidth; x++) {
+            const auto in_x = x + fx - pad;
+            row[y * kWidth + x] = (in_x < 0 || in_x >= kWidth)
+                                      ? 0
+                                      : plane[in_y * kWidth + in_x];
+          }
+        }
+      }
+    }
+  }
+}
+
+void Int8Convolution3::Forward(const size_t batch_size,
+                               const size_t input_channels,
+                               const size_t output_channels, const float* input,
+                               const Int8ConvWeights& weights, float* output) {
+  const auto filter_values = input_channels * kFilterSquares;
+
+  for (size_t batch = 0; batch < batch_size; batch++) {
+    const auto* input_batch = input + batch * input_channels * kSquares;
+    auto* output_batch = output + batch * output_channels * kSquares;
+
+    const auto input_scale = QuantizeInput(input_channels, input_batch);
+    Im2Col(input_channels);
+
+    // The inner loop is a multiply-accumulate over 64 contiguous int8
+    // values; plain loops so the compiler can vectorize for whatever SIMD
+    // width the target has.
+    std::memset(acc_.data(), 0, output_channels * kSquares * sizeof(acc_[0]));
+    for (size_t o = 0; o < output_channels; o++) {
+      const auto* filter = &weights.weights[o * filter_values];
+      auto* acc = &acc_[o * kSquares];
+      for (size_t k = 0; k < filter_values; k++) {
+        const auto w = static_cast<std::int32_t>(filter[k]);
+        if (w == 0) continue;
+        const auto* row = &col_[k * kSquares];
+        for (auto i = 0; i < kSquares; i++) {
+          acc[i] += w * row[i];
+        }
+      }
+    }
+
+    for (size_t o = 0; o < output_channels; o++) {
+      const auto dequant = 1.0f / (input_scale * weights.scales[o]);
+      const auto* acc = &acc_[o * kSquares];
+      auto* out = &output_batch[o * kSquares];
+      for (auto i = 0; i < kSquares; i++) {
+        out[i] = acc[i] * dequant;
+      }
+    }
+  }
+}
+
+}  // namespace lczero
@@ -0,0 +1,76 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2018 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lczero {
+
+// A convolution quantized to int8: the weights carry one scale per output
+// channel, chosen at load time so each channel's filter uses the full int8
+// range.
+struct Int8ConvWeights {
+  std::vector<std::int8_t> weights;
+  std::vector<float> scales;
+};
+
+// Convolution 3x3 on an 8x8 board with int8 arithmetic. The input is
+// quantized dynamically with one scale per tensor, the products accumulate
+// in int32, and the output is dequantized back to float. A quarter of the
+// weight traffic of the float path, for memory-bandwidth bound machines.
+class Int8Convolution3 {
+ public:
+  // The samples of a batch are processed one at a time, so the scratch
+  // buffers only depend on the layer sizes.
+  Int8Convolution3(const size_t max_input_layers,
+                   const size_t max_output_layers);
+
+  // Quantize float convolution weights of shape [output][input][3][3] to
+  // int8 with per-output-channel scales.
+  static Int8ConvWeights QuantizeWeights(const std::vector<float>& weights,
+                                         const size_t output_channels,
+                                         const size_t input_channels);
+
+  // Batched forward inference, float in and float out.
+  void Forward(const size_t batch_size, const size_t input_channels,
+               const size_t output_channels, const float* input,
+               const Int8ConvWeights& weights, float* output);
+
+ private:
+  // Quantize one sample of input planes; returns the scale used.
+  float QuantizeInput(const size_t input_channels, const float* input);
+
+  // Lay out the quantized planes of one sample as the im2col matrix
+  // [input_channels * 9][64], with zero padding at the borders.
+  void Im2Col(const size_t input_channels);
+
+  static constexpr auto kWidth = 8;
+  static constexpr auto kHeight = 8;
+  static constexpr auto kSquares = kWidth * kHeight;
+  static constexpr auto kFilterSize = 3;
+  static constexpr auto kFilterSquares = kFilterSize * kFilterSize;
+
+  std::vector<std::int8_t> input_q_;
+  std::vector<std::int8_t> col_;
+  std::vector<std::int32_t> acc_;
+};
+
+}  // namespace lczero
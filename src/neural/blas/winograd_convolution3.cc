@@ -22,11 +22,81 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 
 #include <array>
 
+#if defined(__SSE2__) || (defined(_M_X64) && !defined(__clang__))
+#define USE_SSE2_WINOGRAD
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#define USE_NEON_WINOGRAD
+#include <arm_neon.h>
+#endif
+
 namespace lczero {
 
+namespace {
+// Four-lane float vector for the tile transforms. The Winograd input and
+// output transforms are pure add/sub patterns over the rows and columns of
+// 4x4 tiles, so four lanes capture their full data parallelism.
+#if defined(USE_SSE2_WINOGRAD)
+
+using Vec4 = __m128;
+inline Vec4 Load4(const float* p) { return _mm_loadu_ps(p); }
+inline void Store4(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+inline Vec4 Add4(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Sub4(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline void Transpose4(Vec4* a, Vec4* b, Vec4* c, Vec4* d) {
+  _MM_TRANSPOSE4_PS(*a, *b, *c, *d);
+}
+
+#elif defined(USE_NEON_WINOGRAD)
+
+using Vec4 = float32x4_t;
+inline Vec4 Load4(const float* p) { return vld1q_f32(p); }
+inline void Store4(float* p, Vec4 v) { vst1q_f32(p, v); }
+inline Vec4 Add4(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Sub4(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline void Transpose4(Vec4* a, Vec4* b, Vec4* c, Vec4* d) {
+  const float32x4x2_t ab = vtrnq_f32(*a, *b);
+  const float32x4x2_t cd = vtrnq_f32(*c, *d);
+  *a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+  *b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+  *c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+  *d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#else
+
+struct Vec4 {
+  float v[4];
+};
+inline Vec4 Load4(const float* p) { return Vec4{{p[0], p[1], p[2], p[3]}}; }
+inline void Store4(float* p, Vec4 v) {
+  for (int i = 0; i < 4; i++) p[i] = v.v[i];
+}
+inline Vec4 Add4(Vec4 a, Vec4 b) {
+  return Vec4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2],
+               a.v[3] + b.v[3]}};
+}
+inline Vec4 Sub4(Vec4 a, Vec4 b) {
+  return Vec4{{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2],
+               a.v[3] - b.v[3]}};
+}
+inline void Transpose4(Vec4* a, Vec4* b, Vec4* c, Vec4* d) {
+  Vec4* rows[4] = {a, b, c, d};
+  for (int i = 0; i < 4; i++) {
+    for (int j = i + 1; j < 4; j++) {
+      std::swap(rows[i]->v[j], rows[j]->v[i]);
+    }
+  }
+}
+
+#endif
+}  // namespace
+
 std::vector<float> WinogradConvolution3::ZeropadU(const std::vector<float>& U,
                                                   const size_t outputs,
                                                   const size_t channels,
@@ -107,8 +177,11 @@ void WinogradConvolution3::Forward(const size_t batch_size,
 void WinogradConvolution3::TransformIn(const size_t batch_size,
                                        const float* input,
                                        const size_t channels) {
-  float x[kWinogradAlpha][kWinogradAlpha];
-  float T1[kWinogradAlpha][kWinogradAlpha];
+  // The board with a zero frame, so that every overlapping 4x4 input tile
+  // can be loaded as four rows of four floats without bounds checks.
+  constexpr auto kPadWidth = kWidth + 2;
+  alignas(16) float pad[(kHeight + 2) * kPadWidth];
+  std::memset(pad, 0, sizeof(pad));
 
   for (size_t batch_index = 0; batch_index < batch_size; batch_index++) {
     const float* input_batch =
@@ -119,82 +192,51 @@ void WinogradConvolution3::TransformIn(const size_t batch_size,
       float* V_channel = V_batch + channel;
       const float* input_channel = input_batch + channel * (kWidth * kHeight);
 
+      for (int y = 0; y < kHeight; y++) {
+        std::memcpy(&pad[(y + 1) * kPadWidth + 1], &input_channel[y * kWidth],
+                    kWidth * sizeof(float));
+      }
+
       for (int block_y = 0; block_y < kWtiles; block_y++) {
         for (int block_x = 0; block_x < kWtiles; block_x++) {
-          // Tiles overlap by 2
-          const int yin = 2 * block_y - 1;
-          const int xin = 2 * block_x - 1;
-
-          for (int i = 0; i < kWinogradAlpha; i++) {
-            for (int j = 0; j < kWinogradAlpha; j++) {
-              if ((yin + i) >= 0 && (xin + j) >= 0 && (yin + i) < kHeight &&
-                  (xin + j) < kWidth) {
-                x[i][j] = input_channel[(yin + i) * kWidth + (xin + j)];
-              } else {
-                x[i][j] = 0.0f;
-              }
-            }
-          }
-
-          // Calculates transpose(B).x.B
+          // Tiles overlap by 2.
+          const float* tile = &pad[2 * block_y * kPadWidth + 2 * block_x];
+          const Vec4 x0 = Load4(tile);
+          const Vec4 x1 = Load4(tile + kPadWidth);
+          const Vec4 x2 = Load4(tile + 2 * kPadWidth);
+          const Vec4 x3 = Load4(tile + 3 * kPadWidth);
+
+          // Calculates V = transpose(B).x.B as two passes of the same row
+          // pattern with a transpose in between:
           // B = [[ 1.0,  0.0,  0.0,  0.0],
           //      [ 0.0,  1.0, -1.0,  1.0],
           //      [-1.0,  1.0,  1.0,  0.0],
           //      [ 0.0,  0.0,  0.0, -1.0]]
-
-          //     WinogradTile T1, T2;
-
-          T1[0][0] = x[0][0] - x[2][0];
-          T1[0][1] = x[0][1] - x[2][1];
-          T1[0][2] = x[0][2] - x[2][2];
-          T1[0][3] = x[0][3] - x[2][3];
-          T1[1][0] = x[1][0] + x[2][0];
-          T1[1][1] = x[1][1] + x[2][1];
-          T1[1][2] = x[1][2] + x[2][2];
-          T1[1][3] = x[1][3] + x[2][3];
-          T1[2][0] = x[2][0] - x[1][0];
-          T1[2][1] = x[2][1] - x[1][1];
-          T1[2][2] = x[2][2] - x[1][2];
-          T1[2][3] = x[2][3] - x[1][3];
-          T1[3][0] = x[1][0] - x[3][0];
-          T1[3][1] = x[1][1] - x[3][1];
-          T1[3][2] = x[1][2] - x[3][2];
-          T1[3][3] = x[1][3] - x[3][3];
+          Vec4 t0 = Sub4(x0, x2);
+          Vec4 t1 = Add4(x1, x2);
+          Vec4 t2 = Sub4(x2, x1);
+          Vec4 t3 = Sub4(x1, x3);
+          Transpose4(&t0, &t1, &t2, &t3);
+          const Vec4 s0 = Sub4(t0, t2);
+          const Vec4 s1 = Add4(t1, t2);
+          const Vec4 s2 = Sub4(t2, t1);
+          const Vec4 s3 = Sub4(t1, t3);
+
+          // s[j] holds column j of the result: s[j][i] = V[i][j].
+          alignas(16) float s[kWinogradAlpha][kWinogradAlpha];
+          Store4(s[0], s0);
+          Store4(s[1], s1);
+          Store4(s[2], s2);
+          Store4(s[3], s3);
 
           const auto V_incr = channels * kTiles * batch_size;
           float* wTile_V = V_channel + channels * (block_y * kWtiles + block_x);
-
-          *wTile_V = T1[0][0] - T1[0][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[0][1] + T1[0][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[0][2] - T1[0][1];
-          wTile_V += V_incr;
-          *wTile_V = T1[0][1] - T1[0][3];
-          wTile_V += V_incr;
-          *wTile_V = T1[1][0] - T1[1][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[1][1] + T1[1][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[1][2] - T1[1][1];
-          wTile_V += V_incr;
-          *wTile_V = T1[1][1] - T1[1][3];
-          wTile_V += V_incr;
-          *wTile_V = T1[2][0] - T1[2][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[2][1] + T1[2][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[2][2] - T1[2][1];
-          wTile_V += V_incr;
-          *wTile_V = T1[2][1] - T1[2][3];
-          wTile_V += V_incr;
-          *wTile_V = T1[3][0] - T1[3][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[3][1] + T1[3][2];
-          wTile_V += V_incr;
-          *wTile_V = T1[3][2] - T1[3][1];
-          wTile_V += V_incr;
-          *wTile_V = T1[3][1] - T1[3][3];
+          for (int i = 0; i < kWinogradAlpha; i++) {
+            for (int j = 0; j < kWinogradAlpha; j++) {
+              *wTile_V = s[j][i];
+              wTile_V += V_incr;
+            }
+          }
         }
       }
     }
@@ -280,7 +322,9 @@ void WinogradConvolution3::Sgemm(const size_t batch_size, const float* weights,
 
 void WinogradConvolution3::TransformOut(const size_t batch_size, float* output,
                                         const size_t channels) {
-  float m[kWinogradTile];
+  alignas(16) float m[kWinogradTile];
+  alignas(16) float u[kWinogradAlpha];
+  alignas(16) float v[kWinogradAlpha];
 
   for (size_t batch_index = 0; batch_index < batch_size; batch_index++) {
     const float* M_batch = &M_[channels * kTiles * batch_index];
@@ -309,22 +353,19 @@ void WinogradConvolution3::TransformOut(const size_t batch_size, float* output,
           //        [1.0,  1.0],
           //        [1.0, -1.0],
           //        [0.0, -1.0]]
-
-          auto o11 = m[0 * 4 + 0] + m[0 * 4 + 1] + m[0 * 4 + 2] + m[1 * 4 + 0] +
-                     m[1 * 4 + 1] + m[1 * 4 + 2] + m[2 * 4 + 0] + m[2 * 4 + 1] +
-                     m[2 * 4 + 2];
-
-          auto o12 = m[0 * 4 + 1] - m[0 * 4 + 2] - m[0 * 4 + 3] + m[1 * 4 + 1] -
-                     m[1 * 4 + 2] - m[1 * 4 + 3] + m[2 * 4 + 1] - m[2 * 4 + 2] -
-                     m[2 * 4 + 3];
-
-          auto o21 = m[1 * 4 + 0] + m[1 * 4 + 1] + m[1 * 4 + 2] - m[2 * 4 + 0] -
-                     m[2 * 4 + 1] - m[2 * 4 + 2] - m[3 * 4 + 0] - m[3 * 4 + 1] -
-                     m[3 * 4 + 2];
-
-          auto o22 = m[1 * 4 + 1] - m[1 * 4 + 2] - m[1 * 4 + 3] - m[2 * 4 + 1] +
-                     m[2 * 4 + 2] + m[2 * 4 + 3] - m[3 * 4 + 1] + m[3 * 4 + 2] +
-                     m[3 * 4 + 3];
+          // The row reductions u = m0 + m1 + m2 and v = m1 - m2 - m3 are
+          // vectorized; the remaining column reductions are four scalar ops.
+          const Vec4 m0 = Load4(m);
+          const Vec4 m1 = Load4(m + 4);
+          const Vec4 m2 = Load4(m + 8);
+          const Vec4 m3 = Load4(m + 12);
+          Store4(u, Add4(Add4(m0, m1), m2));
+          Store4(v, Sub4(Sub4(m1, m2), m3));
+
+          const auto o11 = u[0] + u[1] + u[2];
+          const auto o12 = u[1] - u[2] - u[3];
+          const auto o21 = v[0] + v[1] + v[2];
+          const auto o22 = v[1] - v[2] - v[3];
 
           output_channel[(y)*kWidth + (x)] = o11;
           output_channel[(y)*kWidth + (x + 1)] = o12;
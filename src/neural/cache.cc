@@ -17,13 +17,116 @@
 */
 #include "neural/cache.h"
 #include <cassert>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include "utils/exception.h"
+#include "utils/hashcat.h"
 
 namespace lczero {
+namespace {
+// "LCC1": Leela Chess Cache, format version 1.
+const uint32_t kCacheFileMagic = 0x4c434331;
+
+template <typename T>
+void WritePod(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T ReadPod(std::ifstream& in) {
+  T value;
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return value;
+}
+
+uint64_t HashFloats(uint64_t hash, const Weights::Vec& vec) {
+  hash = HashCat(hash, vec.size());
+  for (float x : vec) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    hash = HashCat(hash, bits);
+  }
+  return hash;
+}
+
+uint64_t HashConvBlock(uint64_t hash, const Weights::ConvBlock& block) {
+  hash = HashFloats(hash, block.weights);
+  hash = HashFloats(hash, block.biases);
+  hash = HashFloats(hash, block.bn_means);
+  return HashFloats(hash, block.bn_stddivs);
+}
+}  // namespace
+
+uint64_t HashWeights(const Weights& weights) {
+  uint64_t hash = HashConvBlock(0, weights.input);
+  for (const auto& residual : weights.residual) {
+    hash = HashConvBlock(hash, residual.conv1);
+    hash = HashConvBlock(hash, residual.conv2);
+  }
+  hash = HashConvBlock(hash, weights.policy);
+  hash = HashFloats(hash, weights.ip_pol_w);
+  hash = HashFloats(hash, weights.ip_pol_b);
+  hash = HashConvBlock(hash, weights.value);
+  hash = HashFloats(hash, weights.ip1_val_w);
+  hash = HashFloats(hash, weights.ip1_val_b);
+  hash = HashFloats(hash, weights.ip2_val_w);
+  return HashFloats(hash, weights.ip2_val_b);
+}
+
+void SaveCacheToFile(const NNCache& cache, const std::string& filename,
+                     uint64_t net_hash) {
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) throw Exception("Cannot open cache file for writing: " + filename);
+  WritePod(out, kCacheFileMagic);
+  WritePod(out, net_hash);
+  // The shard lock is held over the entries of each shard in turn; saving
+  // is meant to happen at shutdown, when no search is running.
+  cache.ForEach([&out](uint64_t key, const CachedNNRequest& req) {
+    WritePod(out, key);
+    WritePod(out, req.q);
+    WritePod(out, static_cast<uint16_t>(req.p.size()));
+    for (int i = 0; i < req.p.size(); ++i) WritePod(out, req.p[i]);
+  });
+  if (!out) throw Exception("Error writing cache file: " + filename);
+}
+
+void LoadCacheFromFile(NNCache* cache, const std::string& filename,
+                       uint64_t net_hash) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) throw Exception("Cannot open cache file: " + filename);
+  if (ReadPod<uint32_t>(in) != kCacheFileMagic) {
+    throw Exception("Not a cache file: " + filename);
+  }
+  if (ReadPod<uint64_t>(in) != net_hash) {
+    throw Exception("Cache file was saved with a different network: " +
+                    filename);
+  }
+  while (true) {
+    const uint64_t key = ReadPod<uint64_t>(in);
+    if (in.eof()) break;
+    const float q = ReadPod<float>(in);
+    const uint16_t num_moves = ReadPod<uint16_t>(in);
+    auto req = std::make_unique<CachedNNRequest>(num_moves);
+    req->q = q;
+    for (uint16_t i = 0; i < num_moves; ++i) {
+      req->p[i] = ReadPod<CachedNNRequest::IdxAndProb>(in);
+    }
+    if (!in) throw Exception("Corrupted cache file: " + filename);
+    const auto bytes = req->BytesUsed();
+    cache->Insert(key, std::move(req), bytes);
+  }
+}
 CachingComputation::CachingComputation(
     std::unique_ptr<NetworkComputation> parent, NNCache* cache)
     : parent_(std::move(parent)), cache_(cache) {}
 
+void CachingComputation::Reset(std::unique_ptr<NetworkComputation> parent) {
+  parent_ = std::move(parent);
+  batch_.clear();
+  probabilities_to_cache_.clear();
+}
+
 int CachingComputation::GetCacheMisses() const {
   return parent_->GetBatchSize();
 }
@@ -39,14 +142,20 @@ bool CachingComputation::AddInputByHash(uint64_t hash) {
   return true;
 }
 
-void CachingComputation::AddInput(
-    uint64_t hash, InputPlanes&& input,
-    std::vector<uint16_t>&& probabilities_to_cache) {
+void CachingComputation::AddInput(uint64_t hash, InputPlanes&& input,
+                                  const uint16_t* probabilities_to_cache,
+                                  int num_probabilities,
+                                  uint64_t also_cache_under) {
   if (AddInputByHash(hash)) return;
   batch_.emplace_back();
   batch_.back().hash = hash;
+  if (also_cache_under != hash) batch_.back().extra_hash = also_cache_under;
   batch_.back().idx_in_parent = parent_->GetBatchSize();
-  batch_.back().probabilities_to_cache = probabilities_to_cache;
+  batch_.back().p_begin = probabilities_to_cache_.size();
+  batch_.back().p_count = num_probabilities;
+  probabilities_to_cache_.insert(probabilities_to_cache_.end(),
+                                 probabilities_to_cache,
+                                 probabilities_to_cache + num_probabilities);
   parent_->AddInput(std::move(input));
 }
 
@@ -59,19 +168,41 @@ void CachingComputation::PopLastInputHit() {
 void CachingComputation::ComputeBlocking() {
   if (parent_->GetBatchSize() == 0) return;
   parent_->ComputeBlocking();
+  PopulateCache();
+}
+
+void CachingComputation::ComputeAsync(std::function<void()> callback) {
+  if (parent_->GetBatchSize() == 0) {
+    callback();
+    return;
+  }
+  parent_->ComputeAsync([this, callback]() {
+    PopulateCache();
+    callback();
+  });
+}
 
+void CachingComputation::PopulateCache() {
   // Fill cache with data from NN.
   for (const auto& item : batch_) {
     if (item.idx_in_parent == -1) continue;
-    auto req =
-        std::make_unique<CachedNNRequest>(item.probabilities_to_cache.size());
+    auto req = std::make_unique<CachedNNRequest>(item.p_count);
     req->q = parent_->GetQVal(item.idx_in_parent);
-    int idx = 0;
-    for (auto x : item.probabilities_to_cache) {
-      req->p[idx++] =
-          std::make_pair(x, parent_->GetPVal(item.idx_in_parent, x));
+    for (int i = 0; i < item.p_count; ++i) {
+      const uint16_t x = probabilities_to_cache_[item.p_begin + i];
+      req->p[i] = {x, CachedNNRequest::CompressP(
+                          parent_->GetPVal(item.idx_in_parent, x))};
     }
-    cache_->Insert(item.hash, std::move(req));
+    const auto bytes = req->BytesUsed();
+    // Optionally store a copy under a second key as well, so transposed
+    // move orders can find this evaluation.
+    if (item.extra_hash) {
+      auto copy = std::make_unique<CachedNNRequest>(req->p.size());
+      copy->q = req->q;
+      for (int i = 0; i < req->p.size(); ++i) copy->p[i] = req->p[i];
+      cache_->Insert(item.extra_hash, std::move(copy), bytes);
+    }
+    cache_->Insert(item.hash, std::move(req), bytes);
   }
 }
 
@@ -92,11 +223,31 @@ float CachingComputation::GetPVal(int sample, int move_id) const {
     // Optimization: usually moves are stored in the same order as queried.
     const auto& move = moves[item.last_idx++];
     if (item.last_idx == moves.size()) item.last_idx = 0;
-    if (move.first == move_id) return move.second;
+    if (move.idx == move_id) return CachedNNRequest::DecompressP(move.prob);
     ++total_count;
   }
   assert(false);  // Move not found.
   return 0;
 }
 
+void CachingComputation::GetPVals(int sample, const uint16_t* move_ids,
+                                  int count, float* pvals) const {
+  const auto& item = batch_[sample];
+  if (item.idx_in_parent >= 0) {
+    parent_->GetPVals(item.idx_in_parent, move_ids, count, pvals);
+    return;
+  }
+  const auto& moves = item.lock->p;
+  for (int i = 0; i < count; ++i) {
+    // Cached entries keep the order the probabilities were queried in,
+    // which is normally the edge order used here too; fall back to the
+    // rotating lookup when it isn't.
+    if (i < moves.size() && moves[i].idx == move_ids[i]) {
+      pvals[i] = CachedNNRequest::DecompressP(moves[i].prob);
+    } else {
+      pvals[i] = GetPVal(sample, move_ids[i]);
+    }
+  }
+}
+
 }  // namespace lczero
@@ -25,14 +25,52 @@ namespace lczero {
 
 struct CachedNNRequest {
   CachedNNRequest(size_t size) : p(size) {}
-  typedef std::pair<uint16_t, float> IdxAndProb;
+  // Policy probabilities are stored quantized to 16 bit fixed point. For
+  // values in [0, 1] the rounding error is below 1e-5, well under network
+  // noise, and an entry shrinks to 4 bytes per move.
+  struct IdxAndProb {
+    uint16_t idx;
+    uint16_t prob;  // 0..65535 maps to 0.0..1.0.
+  };
+  static uint16_t CompressP(float prob) {
+    if (prob <= 0.0f) return 0;
+    if (prob >= 1.0f) return 65535;
+    return static_cast<uint16_t>(prob * 65535.0f + 0.5f);
+  }
+  static float DecompressP(uint16_t prob) { return prob * (1.0f / 65535.0f); }
+
+  // Heap footprint in bytes, charged against the cache's byte budget. The
+  // inline policy storage is part of sizeof(CachedNNRequest).
+  size_t BytesUsed() const {
+    return sizeof(CachedNNRequest) +
+           (p.is_inline() ? 0 : p.size() * sizeof(IdxAndProb));
+  }
+
   float q;
   // TODO(mooskagh) Don't really need index if using perfect hash.
-  SmallArray<IdxAndProb> p;
+  // Inline capacity of 40 covers the typical number of legal moves.
+  SmallArray<IdxAndProb, 40> p;
 };
 
-typedef LruCache<uint64_t, CachedNNRequest> NNCache;
-typedef LruCacheLock<uint64_t, CachedNNRequest> NNCacheLock;
+// Sharded to keep lock contention down: every gathered node does cache
+// operations, from all search threads at once.
+typedef ShardedLruCache<uint64_t, CachedNNRequest> NNCache;
+typedef LruCacheLock<uint64_t, CachedNNRequest, NNCache> NNCacheLock;
+
+// Returns a hash over all weights of the network, used to key cache files so
+// that evaluations from a different net are never loaded.
+uint64_t HashWeights(const Weights& weights);
+
+// Writes the contents of @cache to @filename, tagged with @net_hash.
+// Throws Exception on I/O errors.
+void SaveCacheToFile(const NNCache& cache, const std::string& filename,
+                     uint64_t net_hash);
+
+// Loads entries saved by SaveCacheToFile into @cache, preserving their LRU
+// order. Throws Exception if the file cannot be read, is corrupt, or was
+// written with a net whose hash differs from @net_hash.
+void LoadCacheFromFile(NNCache* cache, const std::string& filename,
+                       uint64_t net_hash);
 
 // Wraps around NetworkComputation and caches result.
 // While it mostly repeats NetworkComputation interface, it's not derived
@@ -42,6 +80,11 @@ class CachingComputation {
   CachingComputation(std::unique_ptr<NetworkComputation> parent,
                      NNCache* cache);
 
+  // Rearms this object for a new batch around a fresh wrapped computation.
+  // Bookkeeping buffers keep their capacity, so a worker reusing one
+  // CachingComputation per iteration stops paying allocation churn for it.
+  void Reset(std::unique_ptr<NetworkComputation> parent);
+
   // How many inputs are not found in cache and will be forwarded to a wrapped
   // computation.
   int GetCacheMisses() const;
@@ -52,31 +95,55 @@ class CachingComputation {
   bool AddInputByHash(uint64_t hash);
   // Adds a sample to the batch.
   // @hash is a hash to store/lookup it in the cache.
-  // @probabilities_to_cache is which indices of policy head to store.
+  // @probabilities_to_cache points at @num_probabilities indices of the
+  // policy head to store; the values are copied into an internal flat
+  // buffer, so the caller may reuse its array.
+  // @also_cache_under, if non-zero, is a second key (e.g. a position-only
+  // hash) under which a copy of the result is stored, so that transposed
+  // move orders reaching the same position can find the evaluation.
   void AddInput(uint64_t hash, InputPlanes&& input,
-                std::vector<uint16_t>&& probabilities_to_cache);
+                const uint16_t* probabilities_to_cache, int num_probabilities,
+                uint64_t also_cache_under = 0);
   // Undos last AddInput. If it was a cache miss, the it's actually not removed
   // from parent's batch.
   void PopLastInputHit();
   // Do the computation.
   void ComputeBlocking();
+  // Like ComputeBlocking(), but returns immediately; @callback runs (on the
+  // backend's thread, or inline if everything was cached) once the results
+  // are available. This object must stay alive until the callback fires.
+  void ComputeAsync(std::function<void()> callback);
   // Returns Q value of @sample.
   float GetQVal(int sample) const;
   // Returns P value @move_id of @sample.
   float GetPVal(int sample, int move_id) const;
+  // Copies the P values of @sample for each of @move_ids into @pvals. For
+  // cache hits queried in the stored order this is a straight decompress.
+  void GetPVals(int sample, const uint16_t* move_ids, int count,
+                float* pvals) const;
 
  private:
+  // Stores the freshly computed results into the cache.
+  void PopulateCache();
+
   struct WorkItem {
     uint64_t hash;
+    // Second key to cache the result under, or 0 if none.
+    uint64_t extra_hash = 0;
     NNCacheLock lock;
     int idx_in_parent = -1;
-    std::vector<uint16_t> probabilities_to_cache;
+    // Slice of probabilities_to_cache_ holding the policy indices to store.
+    int p_begin = 0;
+    int p_count = 0;
     mutable int last_idx = 0;
   };
 
   std::unique_ptr<NetworkComputation> parent_;
   NNCache* cache_;
   std::vector<WorkItem> batch_;
+  // Policy indices of all items, back to back; per-item vectors would cost
+  // one allocation per cache miss, every batch.
+  std::vector<uint16_t> probabilities_to_cache_;
 };
 
 }  // namespace lczero
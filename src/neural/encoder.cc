@@ -18,6 +18,9 @@
 
 #include "neural/encoder.h"
 #include <algorithm>
+#include <cstring>
+#include "utils/bititer.h"
+#include "utils/hashcat.h"
 
 namespace lczero {
 
@@ -25,25 +28,69 @@ namespace {
 const int kMoveHistory = 8;
 const int kPlanesPerBoard = 13;
 const int kAuxPlaneBase = kPlanesPerBoard * kMoveHistory;
+
+// Writes the 13 planes of one history entry.
+void EncodeBoardPlanes(const ChessBoard& board, int repetitions,
+                       InputPlane* planes) {
+  planes[0].mask = (board.ours() * board.pawns()).as_int();
+  planes[1].mask = (board.our_knights()).as_int();
+  planes[2].mask = (board.ours() * board.bishops()).as_int();
+  planes[3].mask = (board.ours() * board.rooks()).as_int();
+  planes[4].mask = (board.ours() * board.queens()).as_int();
+  planes[5].mask = (board.our_king()).as_int();
+
+  planes[6].mask = (board.theirs() * board.pawns()).as_int();
+  planes[7].mask = (board.their_knights()).as_int();
+  planes[8].mask = (board.theirs() * board.bishops()).as_int();
+  planes[9].mask = (board.theirs() * board.rooks()).as_int();
+  planes[10].mask = (board.theirs() * board.queens()).as_int();
+  planes[11].mask = (board.their_king()).as_int();
+
+  planes[12] = InputPlane();
+  if (repetitions >= 1) planes[12].SetAll();
+}
+
+// Writes the 8 constant planes describing the position as a whole.
+void EncodeAuxPlanes(const Position& position, InputPlane* planes) {
+  for (int i = 0; i < 8; ++i) planes[i] = InputPlane();
+  const ChessBoard& board = position.GetBoard();
+  if (board.castlings().we_can_000()) planes[0].SetAll();
+  if (board.castlings().we_can_00()) planes[1].SetAll();
+  if (board.castlings().they_can_000()) planes[2].SetAll();
+  if (board.castlings().they_can_00()) planes[3].SetAll();
+  if (board.flipped()) planes[4].SetAll();
+  planes[5].Fill(position.GetNoCapturePly());
+  // Plane 6 used to be movecount plane, now it's all zeros.
+  // Plane 7 is all ones to help NN find board edges.
+  planes[7].SetAll();
+}
+
+// Returns the vertical mirror of a plane mask: the same plane as it appears
+// in the them-board of the position.
+uint64_t MirrorMask(uint64_t mask) {
+  BitBoard board(mask);
+  board.Mirror();
+  return board.as_int();
+}
+
+// Combined hash of up to @count history positions, starting @skip plies
+// below the newest one (fewer if the history is shorter).
+uint64_t HashHistoryPrefix(const PositionHistory& history, int skip,
+                           int count) {
+  uint64_t hash = 0;
+  int hashed = 0;
+  for (int idx = history.GetLength() - 1 - skip; hashed < count && idx >= 0;
+       --idx, ++hashed) {
+    hash = HashCat(hash, history.GetPositionAt(idx).Hash());
+  }
+  return HashCat(hash, hashed);
+}
 }  // namespace
 
 InputPlanes EncodePositionForNN(const PositionHistory& history,
                                 int history_planes) {
   InputPlanes result(kAuxPlaneBase + 8);
-
-  {
-    const ChessBoard& board = history.Last().GetBoard();
-    const bool we_are_black = board.flipped();
-    if (board.castlings().we_can_000()) result[kAuxPlaneBase + 0].SetAll();
-    if (board.castlings().we_can_00()) result[kAuxPlaneBase + 1].SetAll();
-    if (board.castlings().they_can_000()) result[kAuxPlaneBase + 2].SetAll();
-    if (board.castlings().they_can_00()) result[kAuxPlaneBase + 3].SetAll();
-    if (we_are_black) result[kAuxPlaneBase + 4].SetAll();
-    result[kAuxPlaneBase + 5].Fill(history.Last().GetNoCapturePly());
-    // Plane kAuxPlaneBase + 6 used to be movecount plane, now it's all zeros.
-    // Plane kAuxPlaneBase + 7 is all ones to help NN find board edges.
-    result[kAuxPlaneBase + 7].SetAll();
-  }
+  EncodeAuxPlanes(history.Last(), &result[kAuxPlaneBase]);
 
   bool flip = false;
   int history_idx = history.GetLength() - 1;
@@ -53,27 +100,77 @@ InputPlanes EncodePositionForNN(const PositionHistory& history,
     const Position& position = history.GetPositionAt(history_idx);
     const ChessBoard& board =
         flip ? position.GetThemBoard() : position.GetBoard();
+    EncodeBoardPlanes(board, position.GetRepetitions(),
+                      &result[i * kPlanesPerBoard]);
+  }
+
+  return result;
+}
+
+InputPlanes IncrementalEncoder::EncodePositionForNN(
+    const PositionHistory& history, int history_planes) {
+  const int entries = std::min(history_planes, kMoveHistory);
+  const int length = history.GetLength();
+  // Hash of the positions a reusable encoding has to share: everything below
+  // the newest one, as far back as the history planes reach.
+  const uint64_t below_top = HashHistoryPrefix(history, 1, entries - 1);
 
-    const int base = i * kPlanesPerBoard;
-    result[base + 0].mask = (board.ours() * board.pawns()).as_int();
-    result[base + 1].mask = (board.our_knights()).as_int();
-    result[base + 2].mask = (board.ours() * board.bishops()).as_int();
-    result[base + 3].mask = (board.ours() * board.rooks()).as_int();
-    result[base + 4].mask = (board.ours() * board.queens()).as_int();
-    result[base + 5].mask = (board.our_king()).as_int();
-
-    result[base + 6].mask = (board.theirs() * board.pawns()).as_int();
-    result[base + 7].mask = (board.their_knights()).as_int();
-    result[base + 8].mask = (board.theirs() * board.bishops()).as_int();
-    result[base + 9].mask = (board.theirs() * board.rooks()).as_int();
-    result[base + 10].mask = (board.theirs() * board.queens()).as_int();
-    result[base + 11].mask = (board.their_king()).as_int();
-
-    const int repetitions = position.GetRepetitions();
-    if (repetitions >= 1) result[base + 12].SetAll();
+  InputPlanes result;
+  const bool cacheable = cached_history_planes_ == history_planes &&
+                         entries > 1 && length > 1;
+  bool reused = false;
+  if (cacheable && cached_length_ == length && below_top == key_below_top_) {
+    // Sibling of the previously encoded position: every history entry except
+    // the newest one is unchanged.
+    result = cached_planes_;
+    reused = true;
+  } else if (cacheable && cached_length_ + 1 == length &&
+             below_top == key_with_top_) {
+    // One-ply extension of the previously encoded position: cached entries
+    // shift one step into the past and are seen from the other side of the
+    // board, which mirrors every plane and swaps ours with theirs.
+    result.resize(kAuxPlaneBase + 8);
+    for (int i = entries - 2; i >= 0; --i) {
+      const InputPlane* src = &cached_planes_[i * kPlanesPerBoard];
+      InputPlane* dst = &result[(i + 1) * kPlanesPerBoard];
+      for (int j = 0; j < 6; ++j) {
+        dst[j].mask = MirrorMask(src[j + 6].mask);
+        dst[j + 6].mask = MirrorMask(src[j].mask);
+      }
+      dst[12] = src[12];
+    }
+    reused = true;
   }
 
+  if (reused) {
+    const Position& last = history.Last();
+    EncodeBoardPlanes(last.GetBoard(), last.GetRepetitions(), &result[0]);
+    EncodeAuxPlanes(last, &result[kAuxPlaneBase]);
+  } else {
+    result = lczero::EncodePositionForNN(history, history_planes);
+  }
+
+  cached_planes_ = result;
+  cached_length_ = length;
+  cached_history_planes_ = history_planes;
+  key_below_top_ = below_top;
+  key_with_top_ = HashHistoryPrefix(history, 0, entries - 1);
   return result;
 }
 
+void EncodePlanesBatch(const std::vector<InputPlanes>& batch, size_t start,
+                       size_t count, float* buffer) {
+  std::memset(buffer, 0, count * kInputPlanes * 64 * sizeof(float));
+  for (size_t i = 0; i < count; ++i) {
+    for (const InputPlane& plane : batch[start + i]) {
+      if (plane.mask == ~0ull) {
+        std::fill(buffer, buffer + 64, plane.value);
+      } else {
+        for (auto bit : IterateBits(plane.mask)) buffer[bit] = plane.value;
+      }
+      buffer += 64;
+    }
+  }
+}
+
 }  // namespace lczero
\ No newline at end of file
@@ -27,4 +27,32 @@ namespace lczero {
 InputPlanes EncodePositionForNN(const PositionHistory& history,
                                 int history_planes);
 
+// Encoder with a one-entry cache of the previous encoding. Reuses the shared
+// history planes when the position being encoded is a sibling of the
+// previously encoded one (same history up to the last move) or a one-ply
+// extension of it, which covers most leaves during batch gathering. Falls
+// back to the full encoding otherwise.
+class IncrementalEncoder {
+ public:
+  InputPlanes EncodePositionForNN(const PositionHistory& history,
+                                  int history_planes);
+
+ private:
+  InputPlanes cached_planes_;
+  int cached_length_ = -1;
+  int cached_history_planes_ = 0;
+  // Combined hashes of the encoded history positions excluding/including the
+  // newest one, for detecting reusable prefixes.
+  uint64_t key_below_top_ = 0;
+  uint64_t key_with_top_ = 0;
+};
+
+// Expands mask/value planes of @batch[@start .. @start + @count) into the
+// dense float buffer @buffer (NCHW, @count * kInputPlanes * 64 floats).
+// Zeroes the buffer in one vectorizable pass and then only writes the set
+// bits, which are sparse in typical positions. For CPU backends this is the
+// per-batch encode step.
+void EncodePlanesBatch(const std::vector<InputPlanes>& batch, size_t start,
+                       size_t count, float* buffer);
+
 }  // namespace lczero
\ No newline at end of file
@@ -0,0 +1,104 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark for position encoding: EncodePositionForNN over game
+// histories of realistic length, both the stateless version and the
+// IncrementalEncoder (whose sibling-reuse path is what batch gathering
+// hits). Built as a separate binary (meson benchmark target "Encoder");
+// the playouts are seeded, so runs are comparable.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "chess/position.h"
+#include "neural/encoder.h"
+
+namespace {
+
+using namespace lczero;
+
+// A corpus of histories from seeded random playouts, each cut at a random
+// depth so history lengths vary like they do during a search.
+std::vector<PositionHistory> GatherHistories() {
+  std::vector<PositionHistory> result;
+  std::mt19937 rng(88172);
+  for (int game = 0; game < 64; ++game) {
+    ChessBoard board;
+    board.SetFromFen(ChessBoard::kStartingFen);
+    PositionHistory history;
+    history.Reset(board, 0, 0);
+    const int plies = 8 + rng() % 100;
+    for (int ply = 0; ply < plies; ++ply) {
+      auto moves = history.Last().GetBoard().GenerateLegalMoves();
+      if (moves.empty()) break;
+      history.Append(moves[rng() % moves.size()]);
+    }
+    result.push_back(history);
+  }
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  const auto histories = GatherHistories();
+  std::cout << "Corpus: " << histories.size() << " histories" << std::endl;
+  const int kRounds = 2000;
+
+  {
+    std::uint64_t planes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+      for (const auto& history : histories) {
+        planes += EncodePositionForNN(history, 8).size();
+      }
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    std::cout << "EncodePositionForNN: "
+              << histories.size() * kRounds * 1000000ull / us
+              << " positions/sec" << std::endl;
+    (void)planes;
+  }
+
+  {
+    // The incremental encoder's fast path is consecutive encodes of related
+    // histories, so keep the rounds of one history together instead of
+    // interleaving the corpus (which would defeat its one-entry cache).
+    IncrementalEncoder encoder;
+    std::uint64_t planes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& history : histories) {
+      for (int round = 0; round < kRounds; ++round) {
+        planes += encoder.EncodePositionForNN(history, 8).size();
+      }
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    std::cout << "IncrementalEncoder: "
+              << histories.size() * kRounds * 1000000ull / us
+              << " positions/sec" << std::endl;
+    (void)planes;
+  }
+  return 0;
+}
@@ -0,0 +1,299 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "neural/evaluator.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "chess/position.h"
+#include "neural/encoder.h"
+#include "neural/factory.h"
+#include "neural/loader.h"
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+const char* kNetFileStr = "Network weights file path";
+const char* kNnBackendStr = "NN backend to use";
+const char* kNnBackendOptionsStr = "NN backend parameters";
+const char* kNnBackendSpecStr = "NN backend composition spec";
+const char* kInputStr = "Input file with FEN positions, - for stdin";
+const char* kOutputStr = "Output file, - for stdout";
+const char* kBatchSizeStr = "Positions per NN batch";
+const char* kThreadsStr = "Worker threads";
+
+// Value for network autodiscover.
+const char* kAutoDiscover = "<autodiscover>";
+
+// History plane count matching what the search feeds the network.
+const int kHistoryPlanes = 8;
+
+// A slice of the input, flowing reader -> worker -> writer. Batches are
+// written back in index order, so the output lines up with the input.
+struct Batch {
+  int64_t index;
+  std::vector<std::string> fens;
+  std::vector<ChessBoard> boards;
+  std::vector<int> no_capture_ply;
+  std::vector<int> game_ply;
+  std::vector<std::string> result_lines;
+};
+
+class Pipeline {
+ public:
+  Pipeline(Network* network, int max_pending)
+      : network_(network), max_pending_(max_pending) {}
+
+  // Reader side. Blocks while the workers are more than max_pending_
+  // batches behind, bounding memory on huge inputs.
+  void Submit(std::unique_ptr<Batch> batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    reader_cv_.wait(lock,
+                    [this]() { return pending_ < max_pending_; });
+    ++pending_;
+    queue_.push_back(std::move(batch));
+    worker_cv_.notify_one();
+  }
+
+  // Reader side, after the last Submit(): @total is the number of batches
+  // ever submitted, letting the workers and the writer run to completion.
+  void Close(int64_t total) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    total_ = total;
+    worker_cv_.notify_all();
+    writer_cv_.notify_all();
+  }
+
+  void RunWorker() {
+    while (true) {
+      std::unique_ptr<Batch> batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        worker_cv_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        batch = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      Evaluate(batch.get());
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.emplace(batch->index, std::move(batch));
+        writer_cv_.notify_one();
+      }
+    }
+  }
+
+  // Returns the next batch in input order, or nullptr once every submitted
+  // batch has been handed out.
+  std::unique_ptr<Batch> NextDone() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    writer_cv_.wait(lock, [this]() {
+      return done_.count(next_to_write_) != 0 ||
+             (closed_ && next_to_write_ == total_);
+    });
+    if (done_.count(next_to_write_) == 0) return nullptr;
+    auto batch = std::move(done_[next_to_write_]);
+    done_.erase(next_to_write_);
+    ++next_to_write_;
+    --pending_;
+    reader_cv_.notify_one();
+    return batch;
+  }
+
+ private:
+  void Evaluate(Batch* batch) {
+    auto computation = network_->NewComputation();
+    PositionHistory history;
+    for (size_t i = 0; i < batch->boards.size(); ++i) {
+      history.Reset(batch->boards[i], batch->no_capture_ply[i],
+                    batch->game_ply[i]);
+      computation->AddInput(EncodePositionForNN(history, kHistoryPlanes));
+    }
+    computation->ComputeBlocking();
+
+    std::vector<uint16_t> move_ids;
+    std::vector<float> pvals;
+    for (size_t i = 0; i < batch->boards.size(); ++i) {
+      const auto moves = batch->boards[i].GenerateLegalMoves();
+      move_ids.clear();
+      for (auto move : moves) move_ids.push_back(move.as_nn_index());
+      pvals.resize(move_ids.size());
+      computation->GetPVals(i, move_ids.data(), move_ids.size(),
+                            pvals.data());
+
+      // Moves are generated from the mover's perspective; mirror them back
+      // for black so the output is in plain UCI notation.
+      const bool is_black = batch->boards[i].flipped();
+      std::ostringstream oss;
+      oss << batch->fens[i] << '\t' << computation->GetQVal(i) << '\t';
+      for (size_t m = 0; m < moves.size(); ++m) {
+        Move move = moves[m];
+        if (is_black) move.Mirror();
+        if (m) oss << ' ';
+        oss << move.as_string() << ':' << pvals[m];
+      }
+      batch->result_lines.push_back(oss.str());
+    }
+  }
+
+  Network* const network_;
+  const int max_pending_;
+
+  std::mutex mutex_;
+  std::condition_variable reader_cv_;
+  std::condition_variable worker_cv_;
+  std::condition_variable writer_cv_;
+  std::deque<std::unique_ptr<Batch>> queue_;
+  std::map<int64_t, std::unique_ptr<Batch>> done_;
+  int64_t next_to_write_ = 0;
+  int64_t total_ = -1;
+  int pending_ = 0;
+  bool closed_ = false;
+};
+}  // namespace
+
+BulkEvaluator::BulkEvaluator() {
+  options_.Add<StringOption>(kNetFileStr, "weights", 'w') = kAutoDiscover;
+  const auto backends = NetworkFactory::Get()->GetBackendsList();
+  options_.Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
+      backends.empty() ? "<none>" : backends[0];
+  options_.Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+  // When set, overrides --backend/--backend-opts with a composition spec,
+  // see NetworkFactory::CreateFromSpec.
+  options_.Add<StringOption>(kNnBackendSpecStr, "backend-spec");
+  options_.Add<StringOption>(kInputStr, "input", 'i') = "-";
+  options_.Add<StringOption>(kOutputStr, "output", 'o') = "-";
+  options_.Add<IntOption>(kBatchSizeStr, 1, 1024, "batch-size") = 256;
+  options_.Add<IntOption>(kThreadsStr, 1, 32, "threads", 't') = 2;
+}
+
+void BulkEvaluator::Run() {
+  if (!options_.ProcessAllFlags()) return;
+  const OptionsDict& option_dict = options_.GetOptionsDict();
+
+  std::string net_path = option_dict.Get<std::string>(kNetFileStr);
+  if (net_path == kAutoDiscover) net_path = DiscoverWeightsFile();
+  Weights weights = LoadWeightsFromFile(net_path);
+  std::unique_ptr<Network> network;
+  const std::string backend_spec =
+      option_dict.Get<std::string>(kNnBackendSpecStr);
+  if (!backend_spec.empty()) {
+    network = NetworkFactory::Get()->CreateFromSpec(backend_spec, weights,
+                                                    &option_dict);
+  } else {
+    OptionsDict network_options = OptionsDict::FromString(
+        option_dict.Get<std::string>(kNnBackendOptionsStr), &option_dict);
+    network = NetworkFactory::Get()->Create(
+        option_dict.Get<std::string>(kNnBackendStr), weights, network_options);
+  }
+
+  const std::string input_path = option_dict.Get<std::string>(kInputStr);
+  const std::string output_path = option_dict.Get<std::string>(kOutputStr);
+  std::ifstream input_file;
+  if (input_path != "-") {
+    input_file.open(input_path);
+    if (!input_file) throw Exception("Cannot open input: " + input_path);
+  }
+  std::istream& input = input_path == "-" ? std::cin : input_file;
+  std::ofstream output_file;
+  if (output_path != "-") {
+    output_file.open(output_path);
+    if (!output_file) throw Exception("Cannot open output: " + output_path);
+  }
+  std::ostream& output = output_path == "-" ? std::cout : output_file;
+
+  const int batch_size = option_dict.Get<int>(kBatchSizeStr);
+  const int threads = option_dict.Get<int>(kThreadsStr);
+
+  Pipeline pipeline(network.get(), threads * 4);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&pipeline]() { pipeline.RunWorker(); });
+  }
+
+  std::thread writer([&pipeline, &output]() {
+    while (auto batch = pipeline.NextDone()) {
+      for (const auto& line : batch->result_lines) output << line << '\n';
+    }
+  });
+
+  const auto start_time = std::chrono::steady_clock::now();
+  int64_t positions = 0;
+  int64_t skipped = 0;
+  int64_t batches = 0;
+  auto batch = std::make_unique<Batch>();
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    ChessBoard board;
+    int no_capture_ply;
+    int game_moves;
+    try {
+      board.SetFromFen(line, &no_capture_ply, &game_moves);
+    } catch (Exception& e) {
+      std::cerr << "Skipping unparsable position: " << line << std::endl;
+      ++skipped;
+      continue;
+    }
+    batch->fens.push_back(line);
+    batch->boards.push_back(board);
+    batch->no_capture_ply.push_back(no_capture_ply);
+    // SetFromFen mirrors the board for black, making game ply parity the
+    // only record of the side to move.
+    batch->game_ply.push_back(2 * (game_moves - 1) +
+                              (board.flipped() ? 1 : 0));
+    ++positions;
+    if (static_cast<int>(batch->fens.size()) == batch_size) {
+      batch->index = batches++;
+      pipeline.Submit(std::move(batch));
+      batch = std::make_unique<Batch>();
+    }
+  }
+  if (!batch->fens.empty()) {
+    batch->index = batches++;
+    pipeline.Submit(std::move(batch));
+  }
+  pipeline.Close(batches);
+
+  writer.join();
+  for (auto& worker : workers) worker.join();
+  output.flush();
+
+  const auto elapsed = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_time)
+                           .count();
+  std::cerr << "Evaluated " << positions << " positions in " << elapsed
+            << "s (" << (elapsed > 0 ? positions / elapsed : 0)
+            << " positions/s)";
+  if (skipped) std::cerr << ", skipped " << skipped;
+  std::cerr << std::endl;
+}
+
+}  // namespace lczero
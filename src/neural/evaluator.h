@@ -0,0 +1,41 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "utils/optionsparser.h"
+
+namespace lczero {
+
+// Bulk offline evaluation: streams FEN positions from a file (or stdin),
+// encodes and batches them, runs the batches through a backend on several
+// worker threads and streams out one result line per position (Q and the
+// policy prior of every legal move), preserving input order. Orders of
+// magnitude faster than scripting "go nodes 1" through UCI for data work.
+class BulkEvaluator {
+ public:
+  BulkEvaluator();
+
+  // Parses command line flags and runs the pipeline. Blocks.
+  void Run();
+
+ private:
+  OptionsParser options_;
+};
+
+}  // namespace lczero
@@ -19,10 +19,146 @@
 #include "neural/factory.h"
 
 #include <algorithm>
+#include <cctype>
 #include <iostream>
 
+#include "utils/exception.h"
+
 namespace lczero {
 
+namespace {
+// Shorthands accepted in composition specs for registered backend names.
+const std::pair<const char*, const char*> kSpecAliases[] = {
+    {"mux", "multiplexing"},
+};
+
+// Parses a composition spec (see NetworkFactory::CreateFromSpec) into the
+// OptionsDict form the wrapper backends already consume: child elements
+// become subdicts named "[0]", "[1]", ... with a "backend" key, so the same
+// wrappers keep working with hand-written --backend-opts configs.
+class SpecParser {
+ public:
+  SpecParser(const std::string& str) : str_(str) {}
+
+  // Parses the whole spec into @dict and returns the top-level backend name.
+  std::string Parse(OptionsDict* dict) {
+    const std::string name = ParseElement(dict);
+    SkipWhitespace();
+    if (idx_ != str_.size()) RaiseError("Trailing characters");
+    return name;
+  }
+
+ private:
+  // element := name [ '(' [ arg {',' arg} ] ')' ]
+  // arg     := key '=' value | element
+  std::string ParseElement(OptionsDict* dict) {
+    SkipWhitespace();
+    std::string name = ReadWord();
+    if (name.empty()) RaiseError("Backend name expected");
+    SkipWhitespace();
+    if (Peek() == '(') {
+      ++idx_;
+      ParseArgs(dict);
+      SkipWhitespace();
+      if (Peek() != ')') RaiseError("Expected ')'");
+      ++idx_;
+    }
+    for (const auto& alias : kSpecAliases) {
+      if (name == alias.first) name = alias.second;
+    }
+    return name;
+  }
+
+  void ParseArgs(OptionsDict* dict) {
+    int child_idx = 0;
+    SkipWhitespace();
+    if (Peek() == ')') return;
+    while (true) {
+      SkipWhitespace();
+      const size_t mark = idx_;
+      const std::string word = ReadWord();
+      SkipWhitespace();
+      if (!word.empty() && Peek() == '=') {
+        ++idx_;
+        ReadValue(dict, word);
+      } else {
+        // Not key=value, so it is a child backend element.
+        idx_ = mark;
+        OptionsDict* sub =
+            dict->AddSubdict("[" + std::to_string(child_idx++) + "]");
+        sub->Set<std::string>("backend", ParseElement(sub));
+      }
+      SkipWhitespace();
+      if (Peek() != ',') return;
+      ++idx_;
+    }
+  }
+
+  void ReadValue(OptionsDict* dict, const std::string& key) {
+    SkipWhitespace();
+    if (Peek() == '\'' || Peek() == '"') {
+      const char quote = str_[idx_++];
+      const size_t start = idx_;
+      while (idx_ < str_.size() && str_[idx_] != quote) ++idx_;
+      if (idx_ == str_.size()) RaiseError("String is not closed");
+      dict->Set<std::string>(key, str_.substr(start, idx_ - start));
+      ++idx_;
+      return;
+    }
+    const std::string word = ReadWord();
+    if (word.empty()) RaiseError("Value expected");
+    if (word == "true" || word == "false") {
+      dict->Set<bool>(key, word == "true");
+      return;
+    }
+    // A number when it parses fully as one, a plain string otherwise.
+    try {
+      size_t consumed;
+      if (word.find_first_of(".eE") != std::string::npos) {
+        const float val = std::stof(word, &consumed);
+        if (consumed == word.size()) {
+          dict->Set<float>(key, val);
+          return;
+        }
+      } else {
+        const int val = std::stoi(word, &consumed);
+        if (consumed == word.size()) {
+          dict->Set<int>(key, val);
+          return;
+        }
+      }
+    } catch (std::logic_error&) {
+    }
+    dict->Set<std::string>(key, word);
+  }
+
+  std::string ReadWord() {
+    static const std::string kAllowedPunctuation = "_-./";
+    const size_t start = idx_;
+    while (idx_ < str_.size() &&
+           (std::isalnum(str_[idx_]) ||
+            kAllowedPunctuation.find(str_[idx_]) != std::string::npos)) {
+      ++idx_;
+    }
+    return str_.substr(start, idx_ - start);
+  }
+
+  char Peek() const { return idx_ < str_.size() ? str_[idx_] : '\0'; }
+
+  void SkipWhitespace() {
+    while (idx_ < str_.size() && std::isspace(str_[idx_])) ++idx_;
+  }
+
+  void RaiseError(const std::string& message) {
+    throw Exception("Unable to parse backend spec at offset " +
+                    std::to_string(idx_) + ": " + str_ + " (" + message + ")");
+  }
+
+  const std::string str_;
+  size_t idx_ = 0;
+};
+}  // namespace
+
 NetworkFactory* NetworkFactory::Get() {
   static NetworkFactory factory;
   return &factory;
@@ -57,4 +193,12 @@ std::unique_ptr<Network> NetworkFactory::Create(const std::string& network,
   throw Exception("Unknown backend: " + network);
 }
 
+std::unique_ptr<Network> NetworkFactory::CreateFromSpec(
+    const std::string& spec, const Weights& weights,
+    const OptionsDict* parent) {
+  OptionsDict dict(parent);
+  const std::string name = SpecParser(spec).Parse(&dict);
+  return Create(name, weights, dict);
+}
+
 }  // namespace lczero
\ No newline at end of file
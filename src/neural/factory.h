@@ -49,6 +49,18 @@ class NetworkFactory {
   std::unique_ptr<Network> Create(const std::string& network, const Weights&,
                                   const OptionsDict& options);
 
+  // Creates a backend from a composition spec, so that wrapper backends can
+  // be nested without code changes. Example:
+  //   mux(opencl(gpu=0),check(opencl(gpu=1),blas),max_batch=512)
+  // Every element is a backend name with optional arguments; key=value
+  // arguments become options of that backend, other elements become its
+  // child backends (what a child means is up to the wrapper). A plain name
+  // without parentheses is equivalent to Create(name). @parent is the
+  // options dictionary to inherit unset options from, may be nullptr.
+  std::unique_ptr<Network> CreateFromSpec(const std::string& spec,
+                                          const Weights&,
+                                          const OptionsDict* parent);
+
  private:
   void RegisterNetwork(const std::string& name, FactoryFunc factory,
                        int priority);
@@ -21,10 +21,12 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include "neural/blas/batchnorm.h"
 #include "proto/net.pb.h"
 #include "utils/commandline.h"
 #include "utils/exception.h"
@@ -37,6 +39,22 @@ namespace lczero {
 namespace {
 const std::uint32_t kWeightMagic = 0x1c0;
 
+// Binary weights format: the header below, a uint64 element count per
+// vector, zero padding to a kBinaryWeightsAlignment boundary, then the raw
+// float data of all vectors back to back. Floats are stored in host byte
+// order, like in the protobuf format. The file is not compressed so that it
+// can be memory-mapped and copied into the weights structure wholesale.
+const std::uint32_t kBinaryWeightsMagic = 0x5730434c;  // "LC0W"
+const std::uint32_t kBinaryWeightsVersion = 1;
+const std::uint64_t kBinaryWeightsAlignment = 64;
+
+struct BinaryWeightsHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t vector_count;
+  std::uint32_t reserved;
+};
+
 void PopulateLastIntoVector(FloatVectors* vecs, Weights::Vec* out) {
   *out = std::move(vecs->back());
   vecs->pop_back();
@@ -74,6 +92,56 @@ std::string DecompressGzip(const std::string& filename) {
   return buffer;
 }
 
+// Offset of the float data in a binary weights file with @vector_count
+// vectors.
+std::uint64_t BinaryWeightsDataOffset(std::uint32_t vector_count) {
+  const std::uint64_t end_of_counts =
+      sizeof(BinaryWeightsHeader) + vector_count * sizeof(std::uint64_t);
+  return (end_of_counts + kBinaryWeightsAlignment - 1) /
+         kBinaryWeightsAlignment * kBinaryWeightsAlignment;
+}
+
+FloatVectors ParseBinaryWeights(const char* data, std::uint64_t size) {
+  BinaryWeightsHeader header;
+  if (size < sizeof(header))
+    throw Exception("Invalid weight file: too small.");
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != kBinaryWeightsMagic)
+    throw Exception("Invalid weight file: bad header.");
+  if (header.version != kBinaryWeightsVersion)
+    throw Exception("Invalid weight file: unsupported binary version.");
+
+  const std::uint64_t data_offset =
+      BinaryWeightsDataOffset(header.vector_count);
+  if (size < data_offset) throw Exception("Invalid weight file: truncated.");
+  std::vector<std::uint64_t> counts(header.vector_count);
+  std::memcpy(counts.data(), data + sizeof(header),
+              counts.size() * sizeof(std::uint64_t));
+  std::uint64_t total = 0;
+  for (auto count : counts) total += count;
+  if (size < data_offset + total * sizeof(float))
+    throw Exception("Invalid weight file: truncated.");
+
+  // The data offset is aligned in the file and the mapping is page aligned,
+  // so the floats can be read in place.
+  const float* floats = reinterpret_cast<const float*>(data + data_offset);
+  FloatVectors vecs;
+  vecs.reserve(counts.size());
+  for (auto count : counts) {
+    vecs.emplace_back(floats, floats + count);
+    floats += count;
+  }
+  return vecs;
+}
+
+// Checks the on-disk magic without reading the whole file.
+bool IsBinaryWeightsFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  std::uint32_t magic = 0;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  return file && magic == kBinaryWeightsMagic;
+}
+
 FloatVector DenormLayer(const pblczero::Weights_Layer& layer) {
   FloatVector vec;
   auto& buffer = layer.params();
@@ -168,18 +236,28 @@ FloatVectors LoadFloatsFromFile(std::string* buffer) {
   return result;
 }
 
-Weights LoadWeightsFromFile(const std::string& filename) {
-  FloatVectors vecs;
-  auto buffer = DecompressGzip(filename);
+namespace {
+FloatVectors LoadFloatsFromWeightsFile(const std::string& filename) {
+  // Binary files are uncompressed, so they can be memory-mapped instead of
+  // being gunzipped and parsed.
+  if (IsBinaryWeightsFile(filename)) {
+    MemoryMappedFile file(filename);
+    return ParseBinaryWeights(file.data(), file.size());
+  }
 
+  auto buffer = DecompressGzip(filename);
   if (buffer.size() < 2)
     throw Exception("Invalid weight file: too small.");
   else if (buffer[0] == '1' && buffer[1] == '\n')
     throw Exception("Invalid weight file: no longer supported.");
   else if (buffer[0] == '2' && buffer[1] == '\n')
-    vecs = LoadFloatsFromFile(&buffer);
-  else
-    vecs = LoadFloatsFromPbFile(buffer);
+    return LoadFloatsFromFile(&buffer);
+  return LoadFloatsFromPbFile(buffer);
+}
+}  // namespace
+
+Weights LoadWeightsFromFile(const std::string& filename) {
+  FloatVectors vecs = LoadFloatsFromWeightsFile(filename);
 
   Weights result;
   // Populating backwards.
@@ -205,9 +283,59 @@ Weights LoadWeightsFromFile(const std::string& filename) {
   }
 
   PopulateConvBlockWeights(&vecs, &result.input);
+
+  // Fold batch normalization into the convolution weights and biases once,
+  // so that backends do not need a separate normalization pass per layer.
+  // The folded blocks still carry no-op normalization parameters for code
+  // which applies them anyway.
+  Batchnorm::FoldBatchNorm(&result.input);
+  for (auto& residual : result.residual) {
+    Batchnorm::FoldBatchNorm(&residual.conv1);
+    Batchnorm::FoldBatchNorm(&residual.conv2);
+  }
+  Batchnorm::FoldBatchNorm(&result.policy);
+  Batchnorm::FoldBatchNorm(&result.value);
+
   return result;
 }
 
+void ConvertWeightsToBinaryFile(const std::string& input_filename,
+                                const std::string& output_filename) {
+  FloatVectors vecs = LoadFloatsFromWeightsFile(input_filename);
+
+  std::ofstream file(output_filename, std::ios::binary);
+  if (!file) throw Exception("Cannot write weights to " + output_filename);
+
+  BinaryWeightsHeader header;
+  header.magic = kBinaryWeightsMagic;
+  header.version = kBinaryWeightsVersion;
+  header.vector_count = static_cast<std::uint32_t>(vecs.size());
+  header.reserved = 0;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::uint64_t total = 0;
+  for (const auto& vec : vecs) {
+    const std::uint64_t count = vec.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    total += count;
+  }
+
+  const std::uint64_t end_of_counts =
+      sizeof(header) + vecs.size() * sizeof(std::uint64_t);
+  const std::string padding(
+      BinaryWeightsDataOffset(header.vector_count) - end_of_counts, '\0');
+  file.write(padding.data(), padding.size());
+
+  for (const auto& vec : vecs) {
+    file.write(reinterpret_cast<const char*>(vec.data()),
+               vec.size() * sizeof(float));
+  }
+
+  if (!file) throw Exception("Cannot write weights to " + output_filename);
+  std::cerr << "Wrote " << vecs.size() << " weight vectors (" << total
+            << " floats) to " << output_filename << std::endl;
+}
+
 std::string DiscoverWeightsFile() {
   const int kMinFileSize = 500000;  // 500 KB
 
@@ -247,6 +375,15 @@ std::string DiscoverWeightsFile() {
       return candidate.second;
     }
 
+    // Binary weights files are not compressed, so their magic is right at
+    // the start.
+    if (sz >= 4 &&
+        *reinterpret_cast<std::uint32_t*>(buf) == kBinaryWeightsMagic) {
+      std::cerr << "Found binary network file: " << candidate.second
+                << std::endl;
+      return candidate.second;
+    }
+
     // First byte of the protobuf stream is 0x0d for fixed32, so we ignore it as
     // our own magic should suffice.
     auto magic = reinterpret_cast<std::uint32_t*>(buf+1);
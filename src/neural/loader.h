@@ -37,6 +37,12 @@ FloatVectors LoadFloatsFromFile(std::string* buffer);
 // Read v2 weights file and fill the weights structure.
 Weights LoadWeightsFromFile(const std::string& filename);
 
+// Converts a text or protobuf weights file into the binary format, which
+// LoadWeightsFromFile() memory-maps instead of parsing. Throws exception on
+// error.
+void ConvertWeightsToBinaryFile(const std::string& input_filename,
+                                const std::string& output_filename);
+
 // Tries to find a file which looks like a weights file, and located in
 // directory of binary_name or one of subdirectories. If there are several such
 // files, returns one which has the latest modification date.
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -80,12 +82,29 @@ class NetworkComputation {
   virtual void AddInput(InputPlanes&& input) = 0;
   // Do the computation.
   virtual void ComputeBlocking() = 0;
+  // Starts the computation and calls @callback when the results are ready.
+  // The callback may run on another thread, and the computation has to stay
+  // alive until it does. Backends with their own worker threads return
+  // immediately; the default implementation just computes synchronously, so
+  // it is always correct to use this instead of ComputeBlocking().
+  virtual void ComputeAsync(std::function<void()> callback) {
+    ComputeBlocking();
+    callback();
+  }
   // Returns how many times AddInput() was called.
   virtual int GetBatchSize() const = 0;
   // Returns Q value of @sample.
   virtual float GetQVal(int sample) const = 0;
   // Returns P value @move_id of @sample.
   virtual float GetPVal(int sample, int move_id) const = 0;
+  // Copies the P values of @sample for each of @move_ids into @pvals, so
+  // that a node's policy row can be fetched in one call. Backends holding
+  // the policy head contiguously should override this to avoid one virtual
+  // call per move.
+  virtual void GetPVals(int sample, const uint16_t* move_ids, int count,
+                        float* pvals) const {
+    for (int i = 0; i < count; ++i) pvals[i] = GetPVal(sample, move_ids[i]);
+  }
   virtual ~NetworkComputation() {}
 };
 
@@ -17,6 +17,7 @@
  */
 
 #include "neural/network.h"
+#include "neural/encoder.h"
 #include "neural/blas/batchnorm.h"
 #include "neural/blas/blas.h"
 #include "neural/blas/convolution1.h"
@@ -25,14 +26,62 @@
 #include "neural/factory.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <mutex>
+#include <thread>
 
 namespace lczero {
 
+namespace {
+constexpr auto kWidth = 8;
+constexpr auto kHeight = 8;
+constexpr auto kSquares = kWidth * kHeight;
+}  // namespace
+
+// Scratch buffers for one slice of the forward pass, sized for the network
+// dimensions and the maximum slice size. Allocated once at load time and
+// reused across computations, so the forward pass itself does not allocate.
+struct TensorArena {
+  TensorArena(const Weights& weights, const size_t max_batch_size);
+
+  std::vector<float> output_val;
+  std::vector<float> output_pol;
+  std::vector<float> res_buffer1;
+  std::vector<float> res_buffer2;
+  std::vector<float> res_buffer3;
+  // Output of the fused policy+value head convolution: per sample, the
+  // policy planes followed by the value planes.
+  std::vector<float> head_buffer;
+  // Owns the Winograd V/M tile buffers.
+  WinogradConvolution3 convolve3;
+};
+
+TensorArena::TensorArena(const Weights& weights, const size_t max_batch_size)
+    : output_val(max_batch_size * weights.ip1_val_b.size()),
+      output_pol(max_batch_size * weights.ip_pol_b.size()),
+      res_buffer1(max_batch_size *
+                  std::max(weights.input.biases.size(),
+                           static_cast<size_t>(kInputPlanes)) *
+                  kSquares),
+      res_buffer2(max_batch_size * weights.input.biases.size() * kSquares),
+      res_buffer3(max_batch_size * weights.input.biases.size() * kSquares),
+      head_buffer(max_batch_size *
+                  (weights.policy.bn_means.size() +
+                   weights.value.bn_means.size()) *
+                  kSquares),
+      convolve3(max_batch_size,
+                std::max(weights.input.biases.size(),
+                         static_cast<size_t>(kInputPlanes)),
+                weights.input.biases.size()) {}
+
+class BlasNetwork;
+
 class BlasComputation : public NetworkComputation {
  public:
-  BlasComputation(const Weights& weights, const size_t max_batch_size);
+  BlasComputation(BlasNetwork* network, const Weights& weights,
+                  const size_t max_batch_size, const size_t threads);
 
   virtual ~BlasComputation() {}
 
@@ -53,15 +102,23 @@ class BlasComputation : public NetworkComputation {
     return policies_[sample][move_id];
   }
 
- private:
-  void EncodePlanes(const InputPlanes& sample, float* buffer);
+  // The policy row is contiguous, so the bulk fetch is a plain gather.
+  void GetPVals(int sample, const uint16_t* move_ids, int count,
+                float* pvals) const override {
+    const auto& policy = policies_[sample];
+    for (int i = 0; i < count; ++i) pvals[i] = policy[move_ids[i]];
+  }
 
-  static constexpr auto kWidth = 8;
-  static constexpr auto kHeight = 8;
-  static constexpr auto kSquares = kWidth * kHeight;
+ private:
+  // Runs the full forward pass for @batch_size positions starting at @start
+  // of the batch, with its own buffers, so that slices can run on separate
+  // threads. Writes policies_ and q_values_ at the slice's indices.
+  void ComputeSlice(const size_t start, const size_t batch_size);
 
+  BlasNetwork* network_;
   const Weights& weights_;
   size_t max_batch_size_;
+  size_t threads_;
   std::vector<InputPlanes> planes_;
   std::vector<std::vector<float>> policies_;
   std::vector<float> q_values_;
@@ -73,25 +130,99 @@ class BlasNetwork : public Network {
   virtual ~BlasNetwork(){};
 
   std::unique_ptr<NetworkComputation> NewComputation() override {
-    return std::make_unique<BlasComputation>(weights_, max_batch_size_);
+    return std::make_unique<BlasComputation>(this, weights_, max_batch_size_,
+                                             threads_);
   }
 
+  // Takes a preallocated arena from the pool, or allocates a fresh one if
+  // more slices run concurrently than were provisioned for.
+  std::unique_ptr<TensorArena> AcquireArena() {
+    {
+      std::lock_guard<std::mutex> lock(arena_mutex_);
+      if (!arenas_.empty()) {
+        auto arena = std::move(arenas_.back());
+        arenas_.pop_back();
+        return arena;
+      }
+    }
+    return std::make_unique<TensorArena>(weights_, max_batch_size_);
+  }
+
+  void ReleaseArena(std::unique_ptr<TensorArena> arena) {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    arenas_.emplace_back(std::move(arena));
+  }
+
+  // Policy and value head convolution weights and biases, concatenated so
+  // both heads run as a single 1x1 convolution GEMM.
+  const Weights::Vec& head_conv_weights() const { return head_conv_weights_; }
+  const Weights::Vec& head_conv_biases() const { return head_conv_biases_; }
+
  private:
   // A cap on the max batch size since it consumes a lot of memory
   static constexpr auto kHardMaxBatchSize = 2048;
 
   Weights weights_;
+  Weights::Vec head_conv_weights_;
+  Weights::Vec head_conv_biases_;
   size_t max_batch_size_;
+  size_t threads_;
+  std::mutex arena_mutex_;
+  std::vector<std::unique_ptr<TensorArena>> arenas_;
 };
 
-BlasComputation::BlasComputation(const Weights& weights,
-                                 const size_t max_batch_size)
-    : weights_(weights),
+BlasComputation::BlasComputation(BlasNetwork* network, const Weights& weights,
+                                 const size_t max_batch_size,
+                                 const size_t threads)
+    : network_(network),
+      weights_(weights),
       max_batch_size_(max_batch_size),
+      threads_(threads),
       policies_(0),
       q_values_(0) {}
 
 void BlasComputation::ComputeBlocking() {
+  const auto plane_count = planes_.size();
+  if (plane_count == 0) return;
+
+  // Outputs are written by index, so that slices can run concurrently.
+  policies_.resize(plane_count);
+  q_values_.resize(plane_count);
+
+  // Slice the batch so that all threads get work, without exceeding the
+  // maximum batch size per slice.
+  const auto slice_size =
+      std::min(max_batch_size_, (plane_count + threads_ - 1) / threads_);
+  const auto num_slices = (plane_count + slice_size - 1) / slice_size;
+  const auto num_threads = std::min(threads_, num_slices);
+
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < plane_count; i += slice_size) {
+      ComputeSlice(i, std::min(plane_count - i, slice_size));
+    }
+    return;
+  }
+
+  // Worker pool: each thread claims the next unprocessed slice. The slices
+  // share nothing but the output arrays, which they write at disjoint
+  // indices.
+  std::atomic<size_t> next_slice(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < num_threads; ++t) {
+    workers.emplace_back([&]() {
+      while (true) {
+        const size_t slice = next_slice.fetch_add(1);
+        if (slice >= num_slices) break;
+        const size_t start = slice * slice_size;
+        ComputeSlice(start, std::min(plane_count - start, slice_size));
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+}
+
+void BlasComputation::ComputeSlice(const size_t start,
+                                   const size_t batch_size) {
   // Retrieve network key dimensions from the weights structure.
   const auto num_value_channels = weights_.ip1_val_b.size();
   const auto num_value_input_planes = weights_.value.bn_means.size();
@@ -99,64 +230,37 @@ void BlasComputation::ComputeBlocking() {
   const auto num_output_policy = weights_.ip_pol_b.size();
   const auto output_channels = weights_.input.biases.size();
 
-  // max_channels is the maximum number of input channels of any
-  // convolution.
-  // Residual blocks are identical, but the first convolution might be bigger
-  // when the network has very few filters
-  const auto input_channels = static_cast<size_t>(kInputPlanes);
-  const auto max_channels = std::max(output_channels, input_channels);
-
-  // Determine the largest batch for allocations.
-  const auto plane_count = planes_.size();
-  const auto largest_batch_size = std::min(max_batch_size_, plane_count);
-
   /* Typically
    input_channels = 112
    output_channels = 192
-   max_channels = 192
    num_value_input_planes = 32
    num_policy_input_planes = 32
    num_value_channels = 128
    num_output_policy = 1858
    */
 
-  // Allocate data for the whole batch.
-  std::vector<float> output_val(largest_batch_size * num_value_channels);
-  std::vector<float> output_pol(largest_batch_size * num_output_policy);
-
-  std::vector<float> res_buffer1(largest_batch_size * max_channels * kSquares);
-  std::vector<float> res_buffer2(largest_batch_size * output_channels *
-                                 kSquares);
-  std::vector<float> res_buffer3(largest_batch_size * output_channels *
-                                 kSquares);
-
-  WinogradConvolution3 convolve3(largest_batch_size, max_channels,
-                                 output_channels);
-
-  std::vector<float> policy_buffer(largest_batch_size *
-                                   num_policy_input_planes * kSquares);
-  std::vector<float> value_buffer(largest_batch_size * num_value_input_planes *
-                                  kSquares);
+  // Check out preallocated buffers for the slice.
+  auto arena = network_->AcquireArena();
+  auto& output_val = arena->output_val;
+  auto& output_pol = arena->output_pol;
+  auto& head_buffer = arena->head_buffer;
+  auto& convolve3 = arena->convolve3;
 
   // These ones will rotate during the computation.
-  float* conv_in = res_buffer1.data();
-  float* conv_out = res_buffer2.data();
-  float* res = res_buffer3.data();
+  float* conv_in = arena->res_buffer1.data();
+  float* conv_out = arena->res_buffer2.data();
+  float* res = arena->res_buffer3.data();
 
-  for (size_t i = 0; i < plane_count; i += largest_batch_size) {
-    const auto batch_size = std::min(plane_count - i, largest_batch_size);
-    for (size_t j = 0; j < batch_size; j++) {
-      EncodePlanes(planes_[i + j], &conv_in[j * kSquares * kInputPlanes]);
-    }
+  {
+    EncodePlanesBatch(planes_, start, batch_size, conv_in);
 
     // Input convolution
 
     convolve3.Forward(batch_size, kInputPlanes, output_channels, conv_in,
                       &weights_.input.weights[0], conv_out);
 
-    Batchnorm::Apply(batch_size, output_channels, conv_out,
-                     weights_.input.bn_means.data(),
-                     weights_.input.bn_stddivs.data());
+    Batchnorm::ApplyBias(batch_size, output_channels, conv_out,
+                         weights_.input.biases.data());
 
     // Residual tower
 
@@ -169,8 +273,8 @@ void BlasComputation::ComputeBlocking() {
       convolve3.Forward(batch_size, output_channels, output_channels, conv_in,
                         &conv1.weights[0], conv_out);
 
-      Batchnorm::Apply(batch_size, output_channels, &conv_out[0],
-                       conv1.bn_means.data(), conv1.bn_stddivs.data());
+      Batchnorm::ApplyBias(batch_size, output_channels, &conv_out[0],
+                           conv1.biases.data());
 
       std::swap(conv_in, res);
       std::swap(conv_out, conv_in);
@@ -178,39 +282,36 @@ void BlasComputation::ComputeBlocking() {
       convolve3.Forward(batch_size, output_channels, output_channels, conv_in,
                         &conv2.weights[0], conv_out);
 
-      Batchnorm::Apply(batch_size, output_channels, conv_out,
-                       conv2.bn_means.data(), conv2.bn_stddivs.data(), res);
+      Batchnorm::ApplyBias(batch_size, output_channels, conv_out,
+                           conv2.biases.data(), res);
     }
 
-    Convolution1::Forward(batch_size, output_channels, num_policy_input_planes,
-                          conv_out, weights_.policy.weights.data(),
-                          policy_buffer.data());
-
-    Convolution1::Forward(batch_size, output_channels, num_value_input_planes,
-                          conv_out, weights_.value.weights.data(),
-                          value_buffer.data());
+    // Both heads in one convolution GEMM and one bias pass.
+    const auto num_head_planes =
+        num_policy_input_planes + num_value_input_planes;
 
-    Batchnorm::Apply(batch_size, num_policy_input_planes, &policy_buffer[0],
-                     weights_.policy.bn_means.data(),
-                     weights_.policy.bn_stddivs.data());
+    Convolution1::Forward(batch_size, output_channels, num_head_planes,
+                          conv_out, network_->head_conv_weights().data(),
+                          head_buffer.data());
 
-    Batchnorm::Apply(batch_size, num_value_input_planes, &value_buffer[0],
-                     weights_.value.bn_means.data(),
-                     weights_.value.bn_stddivs.data());
+    Batchnorm::ApplyBias(batch_size, num_head_planes, head_buffer.data(),
+                         network_->head_conv_biases().data());
 
+    // The head FC layers read their planes out of the shared buffer; the
+    // stride skips over the other head's planes of each sample.
     FullyConnectedLayer::Forward1D(
         batch_size, num_policy_input_planes * kSquares, num_output_policy,
-        policy_buffer.data(), weights_.ip_pol_w.data(),
+        head_buffer.data(), weights_.ip_pol_w.data(),
         weights_.ip_pol_b.data(),
         false,  // Relu Off
-        output_pol.data());
+        output_pol.data(), num_head_planes * kSquares);
 
     FullyConnectedLayer::Forward1D(
         batch_size, num_value_input_planes * kSquares, num_value_channels,
-        value_buffer.data(), weights_.ip1_val_w.data(),
-        weights_.ip1_val_b.data(),
+        head_buffer.data() + num_policy_input_planes * kSquares,
+        weights_.ip1_val_w.data(), weights_.ip1_val_b.data(),
         true,  // Relu On
-        output_val.data());
+        output_val.data(), num_head_planes * kSquares);
 
     for (size_t j = 0; j < batch_size; j++) {
       std::vector<float> policy(num_output_policy);
@@ -219,7 +320,7 @@ void BlasComputation::ComputeBlocking() {
       FullyConnectedLayer::Softmax(
           num_output_policy, &output_pol[j * num_output_policy], policy.data());
 
-      policies_.emplace_back(std::move(policy));
+      policies_[start + j] = std::move(policy);
 
       // Now get the score
       double winrate = FullyConnectedLayer::Forward0D(
@@ -227,17 +328,11 @@ void BlasComputation::ComputeBlocking() {
                            &output_val[j * num_value_channels]) +
                        weights_.ip2_val_b[0];
 
-      q_values_.emplace_back(std::tanh(winrate));
+      q_values_[start + j] = std::tanh(winrate);
     }
   }
-}
 
-void BlasComputation::EncodePlanes(const InputPlanes& sample, float* buffer) {
-  for (const InputPlane& plane : sample) {
-    const float value = plane.value;
-    for (auto i = 0; i < kSquares; i++)
-      *(buffer++) = (plane.mask & (((uint64_t)1) << i)) != 0 ? value : 0;
-  }
+  network_->ReleaseArena(std::move(arena));
 }
 
 BlasNetwork::BlasNetwork(const Weights& weights, const OptionsDict& options)
@@ -246,6 +341,8 @@ BlasNetwork::BlasNetwork(const Weights& weights, const OptionsDict& options)
   int blas_cores = options.GetOrDefault<int>("blas_cores", 1);
   max_batch_size_ =
       static_cast<size_t>(options.GetOrDefault<int>("batch_size", 256));
+  threads_ =
+      static_cast<size_t>(std::max(1, options.GetOrDefault<int>("threads", 1)));
 
   if (max_batch_size_ > kHardMaxBatchSize) {
     max_batch_size_ = kHardMaxBatchSize;
@@ -257,12 +354,11 @@ BlasNetwork::BlasNetwork(const Weights& weights, const OptionsDict& options)
   const auto channels = static_cast<int>(weights.input.biases.size());
   const auto residual_blocks = weights.residual.size();
 
+  // Batch normalization is already folded into the weights and biases at
+  // load time, so only the Winograd transform is left to do here.
   weights_.input.weights = WinogradConvolution3::TransformF(
       weights_.input.weights, channels, inputChannels);
 
-  Batchnorm::OffsetMeans(&weights_.input);
-  Batchnorm::InvertStddev(&weights_.input);
-
   // residual blocks
   for (size_t i = 0; i < residual_blocks; i++) {
     auto& residual = weights_.residual[i];
@@ -273,20 +369,8 @@ BlasNetwork::BlasNetwork(const Weights& weights, const OptionsDict& options)
         WinogradConvolution3::TransformF(conv1.weights, channels, channels);
     conv2.weights =
         WinogradConvolution3::TransformF(conv2.weights, channels, channels);
-
-    Batchnorm::OffsetMeans(&conv1);
-    Batchnorm::OffsetMeans(&conv2);
-
-    Batchnorm::InvertStddev(&conv1);
-    Batchnorm::InvertStddev(&conv2);
   }
 
-  Batchnorm::OffsetMeans(&weights_.policy);
-  Batchnorm::InvertStddev(&weights_.policy);
-
-  Batchnorm::OffsetMeans(&weights_.value);
-  Batchnorm::InvertStddev(&weights_.value);
-
 #ifdef USE_OPENBLAS
   int num_procs = openblas_get_num_procs();
   blas_cores = std::min(num_procs, blas_cores);
@@ -329,6 +413,24 @@ BlasNetwork::BlasNetwork(const Weights& weights, const OptionsDict& options)
   }
 #endif
 
+  // Concatenate the policy and value 1x1 head convolutions, so both heads
+  // are computed by a single GEMM into a shared buffer.
+  head_conv_weights_ = weights_.policy.weights;
+  head_conv_weights_.insert(head_conv_weights_.end(),
+                            weights_.value.weights.begin(),
+                            weights_.value.weights.end());
+  head_conv_biases_ = weights_.policy.biases;
+  head_conv_biases_.insert(head_conv_biases_.end(),
+                           weights_.value.biases.begin(),
+                           weights_.value.biases.end());
+
+  // Provision one set of scratch buffers per worker thread up front, so
+  // computations do not allocate.
+  for (size_t i = 0; i < threads_; ++i) {
+    arenas_.emplace_back(
+        std::make_unique<TensorArena>(weights_, max_batch_size_));
+  }
+
   fprintf(stderr, "BLAS max batch size is %ld.\n", max_batch_size_);
 }
 
@@ -0,0 +1,304 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2018 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "neural/network.h"
+#include "neural/encoder.h"
+#include "neural/blas/batchnorm.h"
+#include "neural/blas/blas.h"
+#include "neural/blas/convolution1.h"
+#include "neural/blas/fully_connected_layer.h"
+#include "neural/blas/int8_convolution3.h"
+#include "neural/factory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace lczero {
+
+namespace {
+constexpr auto kWidth = 8;
+constexpr auto kHeight = 8;
+constexpr auto kSquares = kWidth * kHeight;
+}  // namespace
+
+// The residual tower quantized to int8 at load time. The heads stay in
+// float; they are a small fraction of the work and the policy output is
+// sensitive to quantization noise.
+struct Int8TowerWeights {
+  struct Residual {
+    Int8ConvWeights conv1;
+    Int8ConvWeights conv2;
+  };
+
+  Int8ConvWeights input;
+  std::vector<Residual> residual;
+};
+
+class Int8BlasNetwork;
+
+class Int8BlasComputation : public NetworkComputation {
+ public:
+  Int8BlasComputation(const Int8TowerWeights& tower, const Weights& weights,
+                      const size_t max_batch_size);
+
+  virtual ~Int8BlasComputation() {}
+
+  // Adds a sample to the batch.
+  void AddInput(InputPlanes&& input) override { planes_.emplace_back(input); }
+
+  // Do the computation.
+  void ComputeBlocking() override;
+
+  // Returns how many times AddInput() was called.
+  int GetBatchSize() const override { return static_cast<int>(planes_.size()); }
+
+  // Returns Q value of @sample.
+  float GetQVal(int sample) const override { return q_values_[sample]; }
+
+  // Returns P value @move_id of @sample.
+  float GetPVal(int sample, int move_id) const override {
+    return policies_[sample][move_id];
+  }
+
+ private:
+  void ComputeBatch(const size_t start, const size_t batch_size);
+
+  const Int8TowerWeights& tower_;
+  const Weights& weights_;
+  size_t max_batch_size_;
+  std::vector<InputPlanes> planes_;
+  std::vector<std::vector<float>> policies_;
+  std::vector<float> q_values_;
+
+  // Scratch buffers, allocated once in ComputeBlocking().
+  Int8Convolution3 convolve3_;
+  std::vector<float> res_buffer1_;
+  std::vector<float> res_buffer2_;
+  std::vector<float> res_buffer3_;
+  std::vector<float> policy_buffer_;
+  std::vector<float> value_buffer_;
+  std::vector<float> output_pol_;
+  std::vector<float> output_val_;
+};
+
+class Int8BlasNetwork : public Network {
+ public:
+  Int8BlasNetwork(const Weights& weights, const OptionsDict& options);
+  virtual ~Int8BlasNetwork(){};
+
+  std::unique_ptr<NetworkComputation> NewComputation() override {
+    return std::make_unique<Int8BlasComputation>(tower_, weights_,
+                                                 max_batch_size_);
+  }
+
+ private:
+  // A cap on the max batch size since it consumes a lot of memory
+  static constexpr auto kHardMaxBatchSize = 2048;
+
+  Weights weights_;
+  Int8TowerWeights tower_;
+  size_t max_batch_size_;
+};
+
+Int8BlasComputation::Int8BlasComputation(const Int8TowerWeights& tower,
+                                         const Weights& weights,
+                                         const size_t max_batch_size)
+    : tower_(tower),
+      weights_(weights),
+      max_batch_size_(max_batch_size),
+      policies_(0),
+      q_values_(0),
+      convolve3_(std::max(weights.input.biases.size(),
+                          static_cast<size_t>(kInputPlanes)),
+                 weights.input.biases.size()) {}
+
+void Int8BlasComputation::ComputeBlocking() {
+  const auto plane_count = planes_.size();
+  if (plane_count == 0) return;
+
+  const auto num_value_channels = weights_.ip1_val_b.size();
+  const auto num_value_input_planes = weights_.value.bn_means.size();
+  const auto num_policy_input_planes = weights_.policy.bn_means.size();
+  const auto num_output_policy = weights_.ip_pol_b.size();
+  const auto output_channels = weights_.input.biases.size();
+  const auto max_channels = std::max(output_channels,
+                                     static_cast<size_t>(kInputPlanes));
+
+  const auto largest_batch = std::min(max_batch_size_, plane_count);
+
+  res_buffer1_.resize(largest_batch * max_channels * kSquares);
+  res_buffer2_.resize(largest_batch * output_channels * kSquares);
+  res_buffer3_.resize(largest_batch * output_channels * kSquares);
+  policy_buffer_.resize(largest_batch * num_policy_input_planes * kSquares);
+  value_buffer_.resize(largest_batch * num_value_input_planes * kSquares);
+  output_pol_.resize(largest_batch * num_output_policy);
+  output_val_.resize(largest_batch * num_value_channels);
+
+  for (size_t i = 0; i < plane_count; i += largest_batch) {
+    const auto batch_size = std::min(plane_count - i, largest_batch);
+    ComputeBatch(i, batch_size);
+  }
+}
+
+void Int8BlasComputation::ComputeBatch(const size_t start,
+                                       const size_t batch_size) {
+  const auto num_value_channels = weights_.ip1_val_b.size();
+  const auto num_value_input_planes = weights_.value.bn_means.size();
+  const auto num_policy_input_planes = weights_.policy.bn_means.size();
+  const auto num_output_policy = weights_.ip_pol_b.size();
+  const auto output_channels = weights_.input.biases.size();
+
+  // These ones will rotate during the computation.
+  float* conv_in = res_buffer1_.data();
+  float* conv_out = res_buffer2_.data();
+  float* res = res_buffer3_.data();
+
+  EncodePlanesBatch(planes_, start, batch_size, conv_in);
+
+  // Input convolution
+
+  convolve3_.Forward(batch_size, kInputPlanes, output_channels, conv_in,
+                     tower_.input, conv_out);
+
+  Batchnorm::ApplyBias(batch_size, output_channels, conv_out,
+                       weights_.input.biases.data());
+
+  // Residual tower
+
+  for (size_t block = 0; block < weights_.residual.size(); block++) {
+    auto& residual = weights_.residual[block];
+    auto& quantized = tower_.residual[block];
+
+    std::swap(conv_out, conv_in);
+
+    convolve3_.Forward(batch_size, output_channels, output_channels, conv_in,
+                       quantized.conv1, conv_out);
+
+    Batchnorm::ApplyBias(batch_size, output_channels, conv_out,
+                         residual.conv1.biases.data());
+
+    std::swap(conv_in, res);
+    std::swap(conv_out, conv_in);
+
+    convolve3_.Forward(batch_size, output_channels, output_channels, conv_in,
+                       quantized.conv2, conv_out);
+
+    Batchnorm::ApplyBias(batch_size, output_channels, conv_out,
+                         residual.conv2.biases.data(), res);
+  }
+
+  // Heads, in float.
+
+  Convolution1::Forward(batch_size, output_channels, num_policy_input_planes,
+                        conv_out, weights_.policy.weights.data(),
+                        policy_buffer_.data());
+
+  Batchnorm::ApplyBias(batch_size, num_policy_input_planes,
+                       policy_buffer_.data(), weights_.policy.biases.data());
+
+  Convolution1::Forward(batch_size, output_channels, num_value_input_planes,
+                        conv_out, weights_.value.weights.data(),
+                        value_buffer_.data());
+
+  Batchnorm::ApplyBias(batch_size, num_value_input_planes,
+                       value_buffer_.data(), weights_.value.biases.data());
+
+  FullyConnectedLayer::Forward1D(
+      batch_size, num_policy_input_planes * kSquares, num_output_policy,
+      policy_buffer_.data(), weights_.ip_pol_w.data(),
+      weights_.ip_pol_b.data(),
+      false,  // Relu Off
+      output_pol_.data());
+
+  FullyConnectedLayer::Forward1D(
+      batch_size, num_value_input_planes * kSquares, num_value_channels,
+      value_buffer_.data(), weights_.ip1_val_w.data(),
+      weights_.ip1_val_b.data(),
+      true,  // Relu On
+      output_val_.data());
+
+  for (size_t j = 0; j < batch_size; j++) {
+    std::vector<float> policy(num_output_policy);
+
+    // Get the moves
+    FullyConnectedLayer::Softmax(
+        num_output_policy, &output_pol_[j * num_output_policy], policy.data());
+
+    policies_.emplace_back(std::move(policy));
+
+    // Now get the score
+    double winrate = FullyConnectedLayer::Forward0D(
+                         num_value_channels, weights_.ip2_val_w.data(),
+                         &output_val_[j * num_value_channels]) +
+                     weights_.ip2_val_b[0];
+
+    q_values_.emplace_back(std::tanh(winrate));
+  }
+}
+
+Int8BlasNetwork::Int8BlasNetwork(const Weights& weights,
+                                 const OptionsDict& options)
+    : weights_(weights) {
+  bool verbose = options.GetOrDefault<bool>("verbose", true);
+  int blas_cores = options.GetOrDefault<int>("blas_cores", 1);
+  max_batch_size_ =
+      static_cast<size_t>(options.GetOrDefault<int>("batch_size", 256));
+
+  if (max_batch_size_ > kHardMaxBatchSize) {
+    max_batch_size_ = kHardMaxBatchSize;
+    fprintf(stderr, "BLAS warning, maximum batch size set to %ld.",
+            max_batch_size_);
+  }
+
+  const auto channels = weights.input.biases.size();
+
+  // Batch normalization is already folded into the weights and biases at
+  // load time, so the tower convolutions quantize directly. The direct 3x3
+  // convolution does not use the Winograd transform: the transformed tiles
+  // have a much wider dynamic range, which costs int8 precision.
+  tower_.input = Int8Convolution3::QuantizeWeights(
+      weights_.input.weights, channels, kInputPlanes);
+
+  tower_.residual.resize(weights_.residual.size());
+  for (size_t i = 0; i < weights_.residual.size(); i++) {
+    tower_.residual[i].conv1 = Int8Convolution3::QuantizeWeights(
+        weights_.residual[i].conv1.weights, channels, channels);
+    tower_.residual[i].conv2 = Int8Convolution3::QuantizeWeights(
+        weights_.residual[i].conv2.weights, channels, channels);
+  }
+
+#ifdef USE_OPENBLAS
+  blas_cores = std::min(openblas_get_num_procs(), blas_cores);
+  openblas_set_num_threads(blas_cores);
+#endif
+
+#ifdef USE_MKL
+  blas_cores = std::min(mkl_get_max_threads(), blas_cores);
+  mkl_set_num_threads(blas_cores);
+#endif
+
+  if (verbose) {
+    fprintf(stderr, "Int8 BLAS backend: quantized tower, float heads.\n");
+    fprintf(stderr, "Int8 BLAS max batch size is %ld.\n", max_batch_size_);
+  }
+}
+
+REGISTER_NETWORK("blas-int8", Int8BlasNetwork, 45)
+
+}  // namespace lczero
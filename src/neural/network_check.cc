@@ -25,7 +25,9 @@
 #include <condition_variable>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "utils/exception.h"
 #include "utils/random.h"
@@ -36,24 +38,75 @@ namespace {
 
 static constexpr int NUM_OUTPUT_POLICY = 1858;
 
-class CheckNetwork;
+// Agreement statistics accumulated over the life of the backend, so that
+// always-on checking reports drift trends instead of one line per batch.
+// Shared between computations, which may finish on different threads.
+struct CheckStats {
+  void Add(int values, int policies, double value_abs_sum,
+           float value_abs_max, double policy_abs_sum, float policy_abs_max,
+           bool failed, int report_every) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++batches_checked;
+    values_compared += values;
+    policies_compared += policies;
+    this->value_abs_sum += value_abs_sum;
+    this->policy_abs_sum += policy_abs_sum;
+    this->value_abs_max = std::max(this->value_abs_max, value_abs_max);
+    this->policy_abs_max = std::max(this->policy_abs_max, policy_abs_max);
+    if (failed) ++failures;
+    if (report_every > 0 && batches_checked % report_every == 0) Report();
+  }
+
+  // Requires mutex to be held.
+  void Report() const {
+    std::cerr << "Check: " << batches_checked << " batches, "
+              << values_compared << " values (mean dev "
+              << (values_compared ? value_abs_sum / values_compared : 0.0)
+              << ", max " << value_abs_max << "), " << policies_compared
+              << " policies (mean dev "
+              << (policies_compared ? policy_abs_sum / policies_compared : 0.0)
+              << ", max " << policy_abs_max << "), " << failures
+              << " failures" << std::endl;
+  }
+
+  std::mutex mutex;
+  int64_t batches_checked = 0;
+  int64_t values_compared = 0;
+  int64_t policies_compared = 0;
+  int64_t failures = 0;
+  double value_abs_sum = 0.0;
+  double policy_abs_sum = 0.0;
+  float value_abs_max = 0.0f;
+  float policy_abs_max = 0.0f;
+};
 
 class CheckComputation : public NetworkComputation {
  public:
   CheckComputation(std::unique_ptr<NetworkComputation> refComp,
-                   std::unique_ptr<NetworkComputation> checkComp)
-      : refComp_(std::move(refComp)), checkComp_(std::move(checkComp)) {}
+                   Network* checkNet, CheckStats* stats, int maxSamples,
+                   int maxPolicySamples, int reportEvery)
+      : refComp_(std::move(refComp)),
+        checkNet_(checkNet),
+        stats_(stats),
+        maxSamples_(maxSamples),
+        maxPolicySamples_(maxPolicySamples),
+        reportEvery_(reportEvery) {}
 
   void AddInput(InputPlanes&& input) override {
-    InputPlanes x = input;
-    InputPlanes y = input;
-    refComp_->AddInput(std::move(x));
-    checkComp_->AddInput(std::move(y));
+    const int index = size_++;
+    // Reservoir sampling keeps up to maxSamples_ positions (or all of them
+    // when 0), uniformly over the batch, so only those are paid for twice.
+    if (maxSamples_ <= 0 || static_cast<int>(reservoir_.size()) < maxSamples_) {
+      reservoir_.push_back({index, input});
+    } else {
+      const int slot = Random::Get().GetInt(0, index);
+      if (slot < maxSamples_) reservoir_[slot] = {index, input};
+    }
+    refComp_->AddInput(std::move(input));
   }
 
   void ComputeBlocking() override {
     refComp_->ComputeBlocking();
-    checkComp_->ComputeBlocking();
     Check();
   }
 
@@ -65,51 +118,69 @@ class CheckComputation : public NetworkComputation {
     return refComp_->GetPVal(sample, move_id);
   }
 
+  void GetPVals(int sample, const uint16_t* move_ids, int count,
+                float* pvals) const override {
+    refComp_->GetPVals(sample, move_ids, count, pvals);
+  }
+
  private:
+  struct Sample {
+    int index;          // Position in the reference batch.
+    InputPlanes input;  // Copy fed to the checking backend.
+  };
+
   void Check() {
-    bool valueAlmostEqual = true;
-    int size = GetBatchSize();
-    for (int i = 0; i < size && valueAlmostEqual; i++) {
-      float v1 = refComp_->GetQVal(i);
-      float v2 = checkComp_->GetQVal(i);
-      valueAlmostEqual &= IsAlmostEqual(v1, v2);
+    if (reservoir_.empty()) return;
+    auto checkComp = checkNet_->NewComputation();
+    for (auto& sample : reservoir_) {
+      checkComp->AddInput(std::move(sample.input));
     }
-
-    bool policyAlmostEqual = true;
-    for (int i = 0; i < size && policyAlmostEqual; i++) {
-      for (int j = 0; j < NUM_OUTPUT_POLICY; j++) {
-        float v1 = refComp_->GetPVal(i, j);
-        float v2 = checkComp_->GetPVal(i, j);
-        policyAlmostEqual &= IsAlmostEqual(v1, v2);
+    checkComp->ComputeBlocking();
+
+    bool failed = false;
+    double valueAbsSum = 0.0;
+    double policyAbsSum = 0.0;
+    float valueAbsMax = 0.0f;
+    float policyAbsMax = 0.0f;
+    int policiesCompared = 0;
+    for (size_t i = 0; i < reservoir_.size(); ++i) {
+      const int index = reservoir_[i].index;
+      const float dv =
+          std::abs(refComp_->GetQVal(index) - checkComp->GetQVal(i));
+      valueAbsSum += dv;
+      valueAbsMax = std::max(valueAbsMax, dv);
+      if (!IsAlmostEqual(refComp_->GetQVal(index), checkComp->GetQVal(i))) {
+        failed = true;
       }
-    }
-
-    // We could also print on standard output using the uci info string
-    // example:
-    //
-    // info string Check passed
-    // info string ***** error check failed
-    //
-
-    if (valueAlmostEqual && policyAlmostEqual) {
-      std::cerr << "Check passed for a batch of " << size << std::endl;
-      return;
-    }
 
-    if (!valueAlmostEqual && !policyAlmostEqual) {
-      std::cerr << "*** ERROR check failed for a batch of " << size
-                << " both value and policy incorrect" << std::endl;
-      return;
+      // A random contiguous stripe of the policy head (or all of it when
+      // maxPolicySamples_ is 0); over many batches every output is covered.
+      int from = 0;
+      int count = NUM_OUTPUT_POLICY;
+      if (maxPolicySamples_ > 0 && maxPolicySamples_ < NUM_OUTPUT_POLICY) {
+        count = maxPolicySamples_;
+        from = Random::Get().GetInt(0, NUM_OUTPUT_POLICY - count);
+      }
+      for (int j = from; j < from + count; ++j) {
+        const float dp =
+            std::abs(refComp_->GetPVal(index, j) - checkComp->GetPVal(i, j));
+        policyAbsSum += dp;
+        policyAbsMax = std::max(policyAbsMax, dp);
+        if (!IsAlmostEqual(refComp_->GetPVal(index, j),
+                           checkComp->GetPVal(i, j))) {
+          failed = true;
+        }
+      }
+      policiesCompared += count;
     }
 
-    if (!valueAlmostEqual) {
-      std::cerr << "*** ERROR check failed for a batch of " << size
-                << " value incorrect (but policy ok)" << std::endl;
-      return;
+    if (failed) {
+      std::cerr << "*** ERROR check failed for a batch of " << GetBatchSize()
+                << " (value dev max " << valueAbsMax << ", policy dev max "
+                << policyAbsMax << ")" << std::endl;
     }
-
-    std::cerr << "*** ERROR check failed for a batch of " << size
-              << " policy incorrect (but value ok)" << std::endl;
+    stats_->Add(reservoir_.size(), policiesCompared, valueAbsSum, valueAbsMax,
+                policyAbsSum, policyAbsMax, failed, reportEvery_);
   }
 
   static bool IsAlmostEqual(float a, float b) {
@@ -122,40 +193,76 @@ class CheckComputation : public NetworkComputation {
   }
 
   std::unique_ptr<NetworkComputation> refComp_;
-  std::unique_ptr<NetworkComputation> checkComp_;
+  Network* const checkNet_;
+  CheckStats* const stats_;
+  const int maxSamples_;
+  const int maxPolicySamples_;
+  const int reportEvery_;
+  int size_ = 0;
+  std::vector<Sample> reservoir_;
 };
 
 class CheckNetwork : public Network {
  public:
-  CheckNetwork(const Weights& weights, const OptionsDict& options) {
-    // TODO:
-    //
-    // Parse the option string and create backends on demand.
-    //
-    // For now, only checking opencl against blas.
-
-    OptionsDict dict1;
-    refNet_ = NetworkFactory::Get()->Create("opencl", weights, dict1);
-
-    OptionsDict dict;
-    checkNet_ = NetworkFactory::Get()->Create("blas", weights, options);
+  CheckNetwork(const Weights& weights, const OptionsDict& options)
+      // Fraction of batches to check; within a checked batch only
+      // check_samples positions and check_policy_samples policy outputs per
+      // position are compared (0 means all), so checking can stay on in
+      // production at a tunable cost.
+      : checkFrequency_(options.GetOrDefault<float>("check_frequency", 0.2f)),
+        maxSamples_(options.GetOrDefault<int>("check_samples", 4)),
+        maxPolicySamples_(
+            options.GetOrDefault<int>("check_policy_samples", 64)),
+        reportEvery_(options.GetOrDefault<int>("report_every", 100)) {
+    const auto children = options.ListSubdicts();
+    if (children.empty()) {
+      // Nothing configured: keep the historical default of serving from
+      // opencl and checking against blas.
+      OptionsDict dict1;
+      refNet_ = NetworkFactory::Get()->Create("opencl", weights, dict1);
+      checkNet_ = NetworkFactory::Get()->Create("blas", weights, options);
+      return;
+    }
+    // Composed form, e.g. check(opencl(gpu=1),blas): the first child serves
+    // the evaluations, the second one is only consulted for checking.
+    if (children.size() != 2) {
+      throw Exception(
+          "The check backend takes two children: the serving backend and the "
+          "checking one.");
+    }
+    refNet_ = CreateChild(weights, options, children[0]);
+    checkNet_ = CreateChild(weights, options, children[1]);
   }
 
-  static constexpr int CHECK_PROBABILITY = 5;
+  ~CheckNetwork() {
+    std::lock_guard<std::mutex> lock(stats_.mutex);
+    if (stats_.batches_checked > 0) stats_.Report();
+  }
 
   std::unique_ptr<NetworkComputation> NewComputation() override {
-    bool check = Random::Get().GetInt(0, CHECK_PROBABILITY) == 0;
+    const bool check = Random::Get().GetFloat(1.0f) < checkFrequency_;
     if (check) {
-      std::unique_ptr<NetworkComputation> refComp = refNet_->NewComputation();
-      std::unique_ptr<NetworkComputation> checkComp =
-          checkNet_->NewComputation();
-      return std::make_unique<CheckComputation>(std::move(refComp),
-                                                std::move(checkComp));
+      return std::make_unique<CheckComputation>(
+          refNet_->NewComputation(), checkNet_.get(), &stats_, maxSamples_,
+          maxPolicySamples_, reportEvery_);
     }
     return refNet_->NewComputation();
   }
 
  private:
+  static std::unique_ptr<Network> CreateChild(const Weights& weights,
+                                              const OptionsDict& options,
+                                              const std::string& name) {
+    const auto& opts = options.GetSubdict(name);
+    return NetworkFactory::Get()->Create(
+        opts.GetOrDefault<std::string>("backend", name), weights, opts);
+  }
+
+  const float checkFrequency_;
+  const int maxSamples_;
+  const int maxPolicySamples_;
+  const int reportEvery_;
+  CheckStats stats_;
   std::unique_ptr<Network> refNet_;
   std::unique_ptr<Network> checkNet_;
 };
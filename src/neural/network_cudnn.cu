@@ -979,7 +979,7 @@ class CudnnNetwork : public Network {
     if (std::is_same<half, DataType>::value) {
       // Check if the GPU support fp16 (Volta+).
       cudaDeviceProp deviceProp = {};
-      cudaGetDeviceProperties(&deviceProp, gpu_id_);
+      ReportCUDAErrors(cudaGetDeviceProperties(&deviceProp, gpu_id_));
       if (deviceProp.major >= 7) {
         // Enable Tensor cores!
         ReportCUBLASErrors(cublasSetMathMode(cublas_, CUBLAS_TENSOR_OP_MATH));
@@ -1335,7 +1335,7 @@ class CudnnNetwork : public Network {
     }
 
     // Get rid of the BN layer by adjusting weights and biases of the
-    // convolution idea proposed by Henrik Forst�n and first implemented in
+    // convolution idea proposed by Henrik Forst�n and first implemented in
     // leela go zero.
     if (foldBNLayer) {
       const int outputs = block.biases.size();
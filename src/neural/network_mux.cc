@@ -18,10 +18,15 @@
 
 #include "neural/factory.h"
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <queue>
 #include <thread>
+#include "utils/affinity.h"
 #include "utils/exception.h"
+#include "utils/trace.h"
 
 namespace lczero {
 namespace {
@@ -35,6 +40,8 @@ class MuxingComputation : public NetworkComputation {
 
   void ComputeBlocking() override;
 
+  void ComputeAsync(std::function<void()> callback) override;
+
   int GetBatchSize() const override { return planes_.size(); }
 
   float GetQVal(int sample) const override {
@@ -53,11 +60,16 @@ class MuxingComputation : public NetworkComputation {
   }
 
   void NotifyReady() {
+    std::function<void()> callback;
     {
       std::unique_lock<std::mutex> lock(mutex_);
       dataready_ = true;
+      callback = std::move(callback_);
+      callback_ = nullptr;
     }
     dataready_cv_.notify_one();
+    // The callback runs on the worker thread which computed the batch.
+    if (callback) callback();
   }
 
  private:
@@ -69,6 +81,20 @@ class MuxingComputation : public NetworkComputation {
   std::mutex mutex_;
   std::condition_variable dataready_cv_;
   bool dataready_ = false;
+  std::function<void()> callback_;
+};
+
+// One queue per upstream backend. All queues share the network's mutex and
+// condition variable; workers serve their own queue first and steal from the
+// most loaded queue when theirs is empty, so no device idles while another
+// has a backlog.
+struct BackendQueue {
+  std::queue<MuxingComputation*> queue;
+  // Total number of positions sitting in queue.
+  int queued_positions = 0;
+  // Measured speed of the backend in positions per second, exponentially
+  // smoothed. Zero until the first batch completes.
+  float throughput = 0.0f;
 };
 
 class MuxingNetwork : public Network {
@@ -94,15 +120,29 @@ class MuxingNetwork : public Network {
                   const OptionsDict& opts) {
     const int nn_threads = opts.GetOrDefault<int>("threads", 1);
     const int max_batch = opts.GetOrDefault<int>("max_batch", 256);
+    // Under light load, wait up to @wait_us microseconds for at least
+    // @min_batch positions before running a batch. The defaults keep the
+    // old behavior of computing immediately.
+    const int min_batch = opts.GetOrDefault<int>("min_batch", 1);
+    const int wait_us = opts.GetOrDefault<int>("wait_us", 0);
+    // CPUs to pin this backend's worker threads to, e.g. the cores of the
+    // NUMA node its GPU hangs off ("0-7,16-23"). Empty means no pinning.
+    const std::string cpus = opts.GetOrDefault<std::string>("cpus", "");
     const std::string backend = opts.GetOrDefault<std::string>("backend", name);
 
     networks_.emplace_back(
         NetworkFactory::Get()->Create(backend, weights, opts));
     Network* net = networks_.back().get();
 
+    queues_.emplace_back(std::make_unique<BackendQueue>());
+    BackendQueue* bq = queues_.back().get();
+
     for (int i = 0; i < nn_threads; ++i) {
       threads_.emplace_back(
-          [this, net, max_batch]() { Worker(net, max_batch); });
+          [this, net, bq, max_batch, min_batch, wait_us, cpus]() {
+            if (!cpus.empty()) BindThisThreadToCpus(cpus);
+            Worker(net, bq, max_batch, min_batch, wait_us);
+          });
     }
   }
 
@@ -112,7 +152,28 @@ class MuxingNetwork : public Network {
 
   void Enqueue(MuxingComputation* computation) {
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push(computation);
+    // Dispatch to the queue with the shortest expected completion time,
+    // based on the measured throughput of each backend. Queues without a
+    // measurement yet are assumed to run at the speed of the fastest one,
+    // so every device gets measured soon after startup.
+    auto max_rate = 1.0f;
+    for (const auto& q : queues_) {
+      max_rate = std::max(max_rate, q->throughput);
+    }
+    BackendQueue* best = nullptr;
+    auto best_eta = 0.0f;
+    for (const auto& q : queues_) {
+      const auto rate = q->throughput > 0.0f ? q->throughput : max_rate;
+      const auto eta =
+          (q->queued_positions + computation->GetBatchSize()) / rate;
+      if (!best || eta < best_eta) {
+        best = q.get();
+        best_eta = eta;
+      }
+    }
+    best->queue.push(computation);
+    best->queued_positions += computation->GetBatchSize();
+    total_queued_ += computation->GetBatchSize();
     cv_.notify_one();
   }
 
@@ -120,13 +181,29 @@ class MuxingNetwork : public Network {
     Abort();
     Wait();
     // Unstuck waiting computations.
-    while (!queue_.empty()) {
-      queue_.front()->NotifyReady();
-      queue_.pop();
+    for (auto& bq : queues_) {
+      while (!bq->queue.empty()) {
+        bq->queue.front()->NotifyReady();
+        bq->queue.pop();
+      }
+    }
+  }
+
+  // Returns the non-empty queue with the largest backlog, or nullptr when
+  // everything is empty. Called with mutex_ held.
+  BackendQueue* MostLoadedQueue() {
+    BackendQueue* best = nullptr;
+    for (const auto& q : queues_) {
+      if (q->queue.empty()) continue;
+      if (!best || q->queued_positions > best->queued_positions) {
+        best = q.get();
+      }
     }
+    return best;
   }
 
-  void Worker(Network* network, const int max_batch) {
+  void Worker(Network* network, BackendQueue* own, const int max_batch,
+              const int min_batch, const int wait_us) {
     // While Abort() is not called (and it can only be called from destructor).
     while (!abort_) {
       std::vector<MuxingComputation*> children;
@@ -134,31 +211,75 @@ class MuxingNetwork : public Network {
       // there.
       std::shared_ptr<NetworkComputation> parent(network->NewComputation());
       {
+        TRACE_SCOPE("mux_assemble");
         std::unique_lock<std::mutex> lock(mutex_);
         // Wait until there's come work to compute.
-        cv_.wait(lock, [&] { return abort_ || !queue_.empty(); });
+        cv_.wait(lock, [&] { return abort_ || total_queued_ > 0; });
         if (abort_) break;
 
+        // Micro-batching window: hold off briefly until there are at least
+        // @min_batch positions queued, so the device does not run tiny
+        // batches the instant anything arrives. Single position requests
+        // bypass the window, as those are latency critical (e.g. "go"
+        // commands during a game).
+        if (wait_us > 0 && !own->queue.empty() &&
+            own->queued_positions < min_batch &&
+            own->queue.front()->GetBatchSize() > 1) {
+          const auto deadline = std::chrono::steady_clock::now() +
+                                std::chrono::microseconds(wait_us);
+          cv_.wait_until(lock, deadline, [&] {
+            return abort_ || own->queued_positions >= min_batch;
+          });
+          if (abort_) break;
+        }
+
+        // Serve our own queue; when it is empty, steal from the backend
+        // with the largest backlog. Another worker may have drained
+        // everything while we waited.
+        BackendQueue* source = own->queue.empty() ? MostLoadedQueue() : own;
+        if (!source) continue;
+
         // While there is a work in queue, add it.
-        while (!queue_.empty()) {
+        while (!source->queue.empty()) {
           // If we are reaching batch size limit, stop adding.
           // However, if a single input batch is larger than output batch limit,
           // we still have to add it.
           if (parent->GetBatchSize() != 0 &&
-              parent->GetBatchSize() + queue_.front()->GetBatchSize() >
+              parent->GetBatchSize() + source->queue.front()->GetBatchSize() >
                   max_batch) {
             break;
           }
           // Remember which of "input" computations we serve.
-          children.push_back(queue_.front());
-          queue_.pop();
+          children.push_back(source->queue.front());
+          source->queued_positions -= source->queue.front()->GetBatchSize();
+          total_queued_ -= source->queue.front()->GetBatchSize();
+          source->queue.pop();
           // Make "input" computation populate data into output batch.
           children.back()->PopulateToParent(parent);
         }
       }
+      if (children.empty()) continue;
 
       // Compute.
-      parent->ComputeBlocking();
+      const auto started = std::chrono::steady_clock::now();
+      {
+        TRACE_SCOPE("mux_compute");
+        parent->ComputeBlocking();
+      }
+      const auto seconds =
+          std::chrono::duration<float>(std::chrono::steady_clock::now() -
+                                       started)
+              .count();
+
+      // Update the measured throughput which Enqueue() dispatches by.
+      if (seconds > 0.0f) {
+        const auto rate = parent->GetBatchSize() / seconds;
+        std::lock_guard<std::mutex> lock(mutex_);
+        own->throughput = own->throughput > 0.0f
+                              ? 0.9f * own->throughput + 0.1f * rate
+                              : rate;
+      }
+
       // Notify children that data is ready!
       for (auto child : children) child->NotifyReady();
     }
@@ -181,7 +302,9 @@ class MuxingNetwork : public Network {
 
  private:
   std::vector<std::unique_ptr<Network>> networks_;
-  std::queue<MuxingComputation*> queue_;
+  std::vector<std::unique_ptr<BackendQueue>> queues_;
+  // Total number of positions sitting in all queues.
+  int total_queued_ = 0;
   bool abort_ = false;
 
   std::mutex mutex_;
@@ -196,6 +319,17 @@ void MuxingComputation::ComputeBlocking() {
   dataready_cv_.wait(lock, [this]() { return dataready_; });
 }
 
+void MuxingComputation::ComputeAsync(std::function<void()> callback) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    dataready_ = false;
+    callback_ = std::move(callback);
+  }
+  // The worker thread which picks this up runs the callback via
+  // NotifyReady(), so the caller's thread is free to gather more batches.
+  network_->Enqueue(this);
+}
+
 }  // namespace
 
 REGISTER_NETWORK("multiplexing", MuxingNetwork, -1000)
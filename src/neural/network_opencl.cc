@@ -61,7 +61,8 @@ class OpenCLComputation : public NetworkComputation {
                     const OpenCLWeights& weights)
       : opencl_net_(opencl_net),
         weights_(weights),
-        input_data_(kInputPlanes * 64),
+        masks_(kInputPlanes),
+        values_(kInputPlanes),
         value_data_(weights_.num_value_channels),
         policy_data_(),
         q_value_(0) {}
@@ -78,16 +79,14 @@ class OpenCLComputation : public NetworkComputation {
   }
 
   void ComputeBlocking(const InputPlanes& sample) {
-    int index = 0;
-    for (const InputPlane& plane : sample) {
-      float value = plane.value;
-      const uint64_t one = 1;
-      for (int i = 0; i < 64; i++)
-        input_data_[index++] = (plane.mask & (one << i)) != 0 ? value : 0;
+    // The planes stay bit-packed; they are expanded on the device.
+    for (size_t c = 0; c < sample.size(); ++c) {
+      masks_[c] = sample[c].mask;
+      values_[c] = sample[c].value;
     }
 
     std::vector<float> policy_data(weights_.num_output_policies);
-    opencl_net_.forward(input_data_, policy_data, value_data_);
+    opencl_net_.forward(masks_, values_, policy_data, value_data_);
 
     // Get the moves
     FullyConnectedLayer::Softmax(weights_.num_output_policies,
@@ -118,7 +117,8 @@ class OpenCLComputation : public NetworkComputation {
   const OpenCLWeights& weights_;
 
   std::vector<InputPlanes> planes_;
-  std::vector<float> input_data_;
+  std::vector<uint64_t> masks_;
+  std::vector<float> values_;
   std::vector<float> value_data_;
 
   std::vector<std::vector<float>> policy_data_;
@@ -133,10 +133,12 @@ class OpenCLNetwork : public Network {
       : weights_(weights), params_(), opencl_(), opencl_net_(opencl_) {
     params_.gpuId = options.GetOrDefault<int>("gpu", -1);
     params_.verbose = options.GetOrDefault<bool>("verbose", true);
+    params_.fp16 = options.GetOrDefault<bool>("fp16", false);
     params_.force_tune = options.GetOrDefault<bool>("force_tune", false);
     params_.tune_only = options.GetOrDefault<bool>("tune_only", false);
     params_.tune_exhaustive =
         options.GetOrDefault<bool>("tune_exhaustive", false);
+    params_.tune_fast = options.GetOrDefault<bool>("tune_fast", false);
 
     const auto inputChannels = static_cast<size_t>(kInputPlanes);
     const auto channels = weights.input.biases.size();
@@ -0,0 +1,520 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "neural/network_shm.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "neural/factory.h"
+#include "neural/loader.h"
+#include "utils/exception.h"
+#include "utils/optionsparser.h"
+
+namespace lczero {
+namespace {
+
+// Shared memory NN serving.
+//
+// One server process ("lc0 backendserver") owns the weights and the real
+// backend; any number of client processes on the same host use the "shm"
+// backend, which forwards batches through a shared memory segment instead of
+// evaluating anything itself. The server merges the requests of all clients
+// into common batches, the same way MuxingNetwork merges the requests of
+// in-process threads, so N selfplay workers on one GPU cost one context and
+// one copy of the weights instead of N.
+//
+// The segment holds a fixed number of request slots. A client claims a free
+// slot, copies its input planes in, marks it ready and blocks; the server
+// gathers every ready slot into one batch, evaluates, writes Q/policy back
+// and marks the slots done. Synchronization is a process-shared (and robust,
+// so a died server wakes clients with an error instead of hanging them)
+// mutex plus two condition variables in the segment header. A client that
+// dies mid-request leaks its slot; restarting the server reclaims them.
+
+const char* kDefaultShmName = "lc0";
+
+constexpr uint32_t kShmMagic = 0x4c433053;  // "LC0S"
+constexpr uint32_t kShmVersion = 1;
+
+enum SlotState : uint32_t {
+  kFree = 0,       // Available for a client to claim.
+  kFilling = 1,    // Claimed, input planes being copied in.
+  kReady = 2,      // Input complete, waiting for the server.
+  kComputing = 3,  // Picked into the current server batch.
+  kDone = 4,       // Results written, waiting for the client to collect.
+};
+
+struct ShmHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_slots;
+  uint32_t max_batch;    // Max positions per slot.
+  uint32_t policy_size;  // Policy outputs per position.
+  uint32_t shutdown;     // Set by the server on orderly exit.
+  pthread_mutex_t mutex;
+  pthread_cond_t request_cv;   // Signalled by clients: a slot became ready.
+  pthread_cond_t response_cv;  // Broadcast by the server/clients: a slot
+                               // became done or free.
+};
+
+struct ShmSlot {
+  uint32_t state;
+  uint32_t batch_size;
+  // Followed in the segment by:
+  //   InputPlane inputs[max_batch * kInputPlanes];
+  //   float q[max_batch];
+  //   float policy[max_batch * policy_size];
+};
+
+// View over a mapped segment, computing slot offsets from the header. Used
+// by both sides; Create()d by the server, Open()ed by clients.
+class ShmSegment {
+ public:
+  ~ShmSegment() {
+    if (base_) munmap(base_, size_);
+    if (owner_) shm_unlink(path_.c_str());
+  }
+
+  static std::unique_ptr<ShmSegment> Create(const std::string& name,
+                                            int num_slots, int max_batch,
+                                            int policy_size) {
+    auto segment = std::unique_ptr<ShmSegment>(new ShmSegment);
+    segment->path_ = "/" + name;
+    segment->owner_ = true;
+    // Remove a leftover segment from a previous run, then map a fresh one.
+    shm_unlink(segment->path_.c_str());
+    const int fd = shm_open(segment->path_.c_str(), O_CREAT | O_EXCL | O_RDWR,
+                            0600);
+    if (fd < 0) {
+      throw Exception("Cannot create shared memory " + segment->path_ + ": " +
+                      strerror(errno));
+    }
+    segment->size_ =
+        sizeof(ShmHeader) +
+        static_cast<size_t>(num_slots) *
+            SlotStride(max_batch, policy_size);
+    if (ftruncate(fd, segment->size_) < 0) {
+      close(fd);
+      throw Exception("Cannot size shared memory " + segment->path_ + ": " +
+                      strerror(errno));
+    }
+    segment->Map(fd);
+
+    ShmHeader* header = segment->header();
+    std::memset(header, 0, sizeof(ShmHeader));
+    header->num_slots = num_slots;
+    header->max_batch = max_batch;
+    header->policy_size = policy_size;
+
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&header->request_cv, &cond_attr);
+    pthread_cond_init(&header->response_cv, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    for (uint32_t i = 0; i < header->num_slots; ++i) {
+      segment->slot(i)->state = kFree;
+    }
+    // Publish the magic last: clients check it after mapping.
+    header->version = kShmVersion;
+    header->magic = kShmMagic;
+    return segment;
+  }
+
+  static std::unique_ptr<ShmSegment> Open(const std::string& name) {
+    auto segment = std::unique_ptr<ShmSegment>(new ShmSegment);
+    segment->path_ = "/" + name;
+    const int fd = shm_open(segment->path_.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      throw Exception("Cannot open shared memory " + segment->path_ +
+                      " (is \"lc0 backendserver\" running?): " +
+                      strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      close(fd);
+      throw Exception("Cannot stat shared memory " + segment->path_ + ": " +
+                      strerror(errno));
+    }
+    segment->size_ = st.st_size;
+    segment->Map(fd);
+    const ShmHeader* header = segment->header();
+    if (segment->size_ < sizeof(ShmHeader) || header->magic != kShmMagic ||
+        header->version != kShmVersion) {
+      throw Exception("Shared memory " + segment->path_ +
+                      " is not an lc0 NN serving segment of this version.");
+    }
+    return segment;
+  }
+
+  ShmHeader* header() const { return reinterpret_cast<ShmHeader*>(base_); }
+  ShmSlot* slot(int idx) const {
+    return reinterpret_cast<ShmSlot*>(
+        base_ + sizeof(ShmHeader) +
+        idx * SlotStride(header()->max_batch, header()->policy_size));
+  }
+  InputPlane* inputs(int idx) const {
+    return reinterpret_cast<InputPlane*>(
+        reinterpret_cast<char*>(slot(idx)) + sizeof(ShmSlot));
+  }
+  float* q(int idx) const {
+    return reinterpret_cast<float*>(inputs(idx) +
+                                    header()->max_batch * kInputPlanes);
+  }
+  float* policy(int idx) const { return q(idx) + header()->max_batch; }
+
+ private:
+  ShmSegment() = default;
+
+  static size_t SlotStride(int max_batch, int policy_size) {
+    return sizeof(ShmSlot) +
+           static_cast<size_t>(max_batch) * kInputPlanes * sizeof(InputPlane) +
+           static_cast<size_t>(max_batch) * sizeof(float) +
+           static_cast<size_t>(max_batch) * policy_size * sizeof(float);
+  }
+
+  void Map(int fd) {
+    void* mapping =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      throw Exception("Cannot map shared memory " + path_ + ": " +
+                      strerror(errno));
+    }
+    base_ = static_cast<char*>(mapping);
+  }
+
+  std::string path_;
+  char* base_ = nullptr;
+  size_t size_ = 0;
+  bool owner_ = false;
+};
+
+// Locks the segment mutex; recovers it when the previous owner died so that
+// waiters get a clean error instead of a hang.
+class SegmentLock {
+ public:
+  explicit SegmentLock(ShmHeader* header) : header_(header) {
+    const int err = pthread_mutex_lock(&header_->mutex);
+    if (err == EOWNERDEAD) {
+      pthread_mutex_consistent(&header_->mutex);
+      header_->shutdown = 1;
+    } else if (err != 0) {
+      throw Exception("Shared memory mutex failed: " +
+                      std::string(strerror(err)));
+    }
+  }
+  ~SegmentLock() { pthread_mutex_unlock(&header_->mutex); }
+
+  void Wait(pthread_cond_t* cv) {
+    if (pthread_cond_wait(cv, &header_->mutex) == EOWNERDEAD) {
+      pthread_mutex_consistent(&header_->mutex);
+      header_->shutdown = 1;
+    }
+  }
+
+  // Waits up to @ms milliseconds; used by the server to poll its stop flag.
+  void WaitFor(pthread_cond_t* cv, int ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += ms * 1000000ll;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000ll;
+    deadline.tv_nsec %= 1000000000ll;
+    if (pthread_cond_timedwait(cv, &header_->mutex, &deadline) == EOWNERDEAD) {
+      pthread_mutex_consistent(&header_->mutex);
+      header_->shutdown = 1;
+    }
+  }
+
+ private:
+  ShmHeader* header_;
+};
+
+class ShmClientNetwork;
+
+class ShmClientComputation : public NetworkComputation {
+ public:
+  ShmClientComputation(ShmSegment* segment) : segment_(segment) {}
+
+  void AddInput(InputPlanes&& input) override {
+    planes_.emplace_back(std::move(input));
+  }
+  void ComputeBlocking() override;
+
+  int GetBatchSize() const override { return planes_.size(); }
+  float GetQVal(int sample) const override { return q_[sample]; }
+  float GetPVal(int sample, int move_id) const override {
+    return policy_[sample * segment_->header()->policy_size + move_id];
+  }
+
+ private:
+  // Sends planes_[@offset, @offset + @count) through one slot and appends
+  // the results to q_/policy_.
+  void ComputeChunk(int offset, int count);
+
+  ShmSegment* segment_;
+  std::vector<InputPlanes> planes_;
+  std::vector<float> q_;
+  std::vector<float> policy_;
+};
+
+class ShmClientNetwork : public Network {
+ public:
+  ShmClientNetwork(const Weights& /* weights */, const OptionsDict& options)
+      : segment_(ShmSegment::Open(options.GetOrDefault<std::string>(
+            "name", kDefaultShmName))) {}
+
+  std::unique_ptr<NetworkComputation> NewComputation() override {
+    return std::make_unique<ShmClientComputation>(segment_.get());
+  }
+
+ private:
+  std::unique_ptr<ShmSegment> segment_;
+};
+
+void ShmClientComputation::ComputeBlocking() {
+  const int max_batch = segment_->header()->max_batch;
+  q_.reserve(planes_.size());
+  policy_.reserve(planes_.size() * segment_->header()->policy_size);
+  for (int offset = 0; offset < static_cast<int>(planes_.size());
+       offset += max_batch) {
+    ComputeChunk(offset, std::min<int>(max_batch, planes_.size() - offset));
+  }
+}
+
+void ShmClientComputation::ComputeChunk(int offset, int count) {
+  ShmHeader* header = segment_->header();
+  int idx = -1;
+  {
+    SegmentLock lock(header);
+    for (;;) {
+      if (header->shutdown) throw Exception("NN serving process went away.");
+      for (uint32_t i = 0; i < header->num_slots; ++i) {
+        if (segment_->slot(i)->state == kFree) {
+          idx = i;
+          break;
+        }
+      }
+      if (idx >= 0) break;
+      lock.Wait(&header->response_cv);
+    }
+    segment_->slot(idx)->state = kFilling;
+  }
+
+  // Copy the inputs outside the lock; only the state transitions contend.
+  InputPlane* inputs = segment_->inputs(idx);
+  for (int i = 0; i < count; ++i) {
+    std::memcpy(inputs + i * kInputPlanes, planes_[offset + i].data(),
+                kInputPlanes * sizeof(InputPlane));
+  }
+  segment_->slot(idx)->batch_size = count;
+
+  {
+    SegmentLock lock(header);
+    segment_->slot(idx)->state = kReady;
+    pthread_cond_signal(&header->request_cv);
+    while (segment_->slot(idx)->state != kDone) {
+      if (header->shutdown) throw Exception("NN serving process went away.");
+      lock.Wait(&header->response_cv);
+    }
+  }
+
+  const float* q = segment_->q(idx);
+  const float* policy = segment_->policy(idx);
+  q_.insert(q_.end(), q, q + count);
+  policy_.insert(policy_.end(), policy,
+                 policy + static_cast<size_t>(count) * header->policy_size);
+
+  SegmentLock lock(header);
+  segment_->slot(idx)->state = kFree;
+  // Wake clients waiting for a free slot.
+  pthread_cond_broadcast(&header->response_cv);
+}
+
+REGISTER_NETWORK("shm", ShmClientNetwork, -950)
+
+//////////////////////////////////////////////////////////////////////////////
+// Server side.
+//////////////////////////////////////////////////////////////////////////////
+
+std::atomic<bool> g_server_stop{false};
+void ServerSignalHandler(int) { g_server_stop = true; }
+
+class ShmServer {
+ public:
+  ShmServer(Network* network, const std::string& name, int num_slots,
+            int max_batch, int policy_size)
+      : network_(network),
+        segment_(ShmSegment::Create(name, num_slots, max_batch, policy_size)) {
+  }
+
+  ~ShmServer() {
+    ShmHeader* header = segment_->header();
+    SegmentLock lock(header);
+    header->shutdown = 1;
+    pthread_cond_broadcast(&header->response_cv);
+  }
+
+  // Serves until g_server_stop is set. Every pass gathers all slots that are
+  // ready at that moment into a single backend batch, so concurrent clients
+  // coalesce naturally, like queued threads do in MuxingNetwork.
+  void Run() {
+    ShmHeader* header = segment_->header();
+    auto last_report = std::chrono::steady_clock::now();
+    while (!g_server_stop) {
+      std::vector<int> gathered;
+      {
+        SegmentLock lock(header);
+        while (!g_server_stop) {
+          for (uint32_t i = 0; i < header->num_slots; ++i) {
+            if (segment_->slot(i)->state == kReady) {
+              segment_->slot(i)->state = kComputing;
+              gathered.push_back(i);
+            }
+          }
+          if (!gathered.empty()) break;
+          lock.WaitFor(&header->request_cv, 100);
+        }
+      }
+      if (gathered.empty()) break;
+
+      auto computation = network_->NewComputation();
+      for (const int idx : gathered) {
+        const InputPlane* inputs = segment_->inputs(idx);
+        const int count = segment_->slot(idx)->batch_size;
+        for (int i = 0; i < count; ++i) {
+          InputPlanes planes(inputs + i * kInputPlanes,
+                             inputs + (i + 1) * kInputPlanes);
+          computation->AddInput(std::move(planes));
+        }
+      }
+      computation->ComputeBlocking();
+
+      int sample = 0;
+      for (const int idx : gathered) {
+        const int count = segment_->slot(idx)->batch_size;
+        float* q = segment_->q(idx);
+        float* policy = segment_->policy(idx);
+        for (int i = 0; i < count; ++i, ++sample) {
+          q[i] = computation->GetQVal(sample);
+          for (uint32_t p = 0; p < header->policy_size; ++p) {
+            policy[i * header->policy_size + p] =
+                computation->GetPVal(sample, p);
+          }
+        }
+      }
+      total_evals_ += sample;
+      ++total_batches_;
+
+      {
+        SegmentLock lock(header);
+        for (const int idx : gathered) segment_->slot(idx)->state = kDone;
+        pthread_cond_broadcast(&header->response_cv);
+      }
+
+      const auto now = std::chrono::steady_clock::now();
+      if (now - last_report >= std::chrono::seconds(60)) {
+        PrintStats();
+        last_report = now;
+      }
+    }
+    PrintStats();
+  }
+
+ private:
+  void PrintStats() const {
+    if (total_batches_ == 0) return;
+    std::cerr << "Served " << total_evals_ << " evals in " << total_batches_
+              << " batches (avg "
+              << static_cast<float>(total_evals_) / total_batches_ << ")."
+              << std::endl;
+  }
+
+  Network* network_;
+  std::unique_ptr<ShmSegment> segment_;
+  int64_t total_evals_ = 0;
+  int64_t total_batches_ = 0;
+};
+
+const char* kNetFileStr = "Network weights file path";
+const char* kNnBackendStr = "NN backend to use";
+const char* kNnBackendOptionsStr = "NN backend parameters";
+const char* kShmNameStr = "Shared memory segment name";
+const char* kSlotsStr = "Parallel client request slots";
+const char* kMaxBatchStr = "Max positions per client request";
+
+// Value for network autodiscover.
+const char* kAutoDiscover = "<autodiscover>";
+
+}  // namespace
+
+void RunBackendServer() {
+  OptionsParser options;
+  options.Add<StringOption>(kNetFileStr, "weights", 'w') = kAutoDiscover;
+  const auto backends = NetworkFactory::Get()->GetBackendsList();
+  options.Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
+      backends.empty() ? "<none>" : backends[0];
+  options.Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+  options.Add<StringOption>(kShmNameStr, "shm-name") = kDefaultShmName;
+  options.Add<IntOption>(kSlotsStr, 1, 256, "slots") = 16;
+  options.Add<IntOption>(kMaxBatchStr, 1, 1024, "max-batch") = 256;
+  if (!options.ProcessAllFlags()) return;
+  const OptionsDict& option_dict = options.GetOptionsDict();
+
+  std::string net_path = option_dict.Get<std::string>(kNetFileStr);
+  if (net_path == kAutoDiscover) net_path = DiscoverWeightsFile();
+  const Weights weights = LoadWeightsFromFile(net_path);
+  OptionsDict network_options = OptionsDict::FromString(
+      option_dict.Get<std::string>(kNnBackendOptionsStr), &option_dict);
+  auto network = NetworkFactory::Get()->Create(
+      option_dict.Get<std::string>(kNnBackendStr), weights, network_options);
+
+  ShmServer server(network.get(),
+                   option_dict.Get<std::string>(kShmNameStr),
+                   option_dict.Get<int>(kSlotsStr),
+                   option_dict.Get<int>(kMaxBatchStr),
+                   weights.ip_pol_b.size());
+  std::signal(SIGINT, ServerSignalHandler);
+  std::signal(SIGTERM, ServerSignalHandler);
+  std::cerr << "Serving NN evals over shared memory \""
+            << option_dict.Get<std::string>(kShmNameStr) << "\"." << std::endl;
+  server.Run();
+}
+
+}  // namespace lczero
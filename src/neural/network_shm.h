@@ -0,0 +1,30 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace lczero {
+
+// Runs the "backendserver" mode: loads the weights once, creates the real
+// backend, and serves NN evaluations to local "shm" client processes over a
+// POSIX shared memory segment. Requests from all clients are merged into
+// common batches, so one GPU (and one copy of the weights) can feed many
+// selfplay worker processes. Returns when interrupted (SIGINT/SIGTERM).
+void RunBackendServer();
+
+}  // namespace lczero
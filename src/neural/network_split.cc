@@ -0,0 +1,130 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+#include <vector>
+
+#include "neural/factory.h"
+#include "neural/network.h"
+#include "utils/exception.h"
+
+namespace lczero {
+namespace {
+
+// Routes each computation by its batch size: batches of up to @threshold
+// positions go to the first child backend, larger ones to the second. GPU
+// backends are poor at the batch-of-1 evaluations which dominate the start
+// of every search and prefetch speculation, while blas answers them at
+// microsecond latency, so the typical setup is
+//   split(blas,opencl(gpu=0),threshold=4)
+// with both children built from the same weights.
+class SplitNetwork;
+
+// The batch size is only known at compute time, so inputs are buffered
+// here and the child computation is created in ComputeBlocking().
+class SplitComputation : public NetworkComputation {
+ public:
+  SplitComputation(Network* small_net, Network* large_net, int threshold)
+      : small_net_(small_net), large_net_(large_net), threshold_(threshold) {}
+
+  void AddInput(InputPlanes&& input) override {
+    planes_.emplace_back(std::move(input));
+  }
+
+  void ComputeBlocking() override {
+    Network* net = static_cast<int>(planes_.size()) <= threshold_ ? small_net_
+                                                                  : large_net_;
+    computation_ = net->NewComputation();
+    for (auto& planes : planes_) computation_->AddInput(std::move(planes));
+    planes_.clear();
+    computation_->ComputeBlocking();
+  }
+
+  int GetBatchSize() const override {
+    return computation_ ? computation_->GetBatchSize()
+                        : static_cast<int>(planes_.size());
+  }
+
+  float GetQVal(int sample) const override {
+    return computation_->GetQVal(sample);
+  }
+
+  float GetPVal(int sample, int move_id) const override {
+    return computation_->GetPVal(sample, move_id);
+  }
+
+  void GetPVals(int sample, const uint16_t* move_ids, int count,
+                float* pvals) const override {
+    computation_->GetPVals(sample, move_ids, count, pvals);
+  }
+
+ private:
+  Network* const small_net_;
+  Network* const large_net_;
+  const int threshold_;
+  std::vector<InputPlanes> planes_;
+  std::unique_ptr<NetworkComputation> computation_;
+};
+
+class SplitNetwork : public Network {
+ public:
+  SplitNetwork(const Weights& weights, const OptionsDict& options)
+      : threshold_(options.GetOrDefault<int>("threshold", 4)) {
+    const auto children = options.ListSubdicts();
+    if (children.empty()) {
+      // Nothing configured: blas for the small batches, the default backend
+      // for the rest.
+      OptionsDict dict;
+      small_net_ = NetworkFactory::Get()->Create("blas", weights, dict);
+      const auto backends = NetworkFactory::Get()->GetBackendsList();
+      large_net_ = NetworkFactory::Get()->Create(backends[0], weights, dict);
+      return;
+    }
+    if (children.size() != 2) {
+      throw Exception(
+          "The split backend takes two children: the small batch backend and "
+          "the large batch one.");
+    }
+    small_net_ = CreateChild(weights, options, children[0]);
+    large_net_ = CreateChild(weights, options, children[1]);
+  }
+
+  std::unique_ptr<NetworkComputation> NewComputation() override {
+    return std::make_unique<SplitComputation>(small_net_.get(),
+                                              large_net_.get(), threshold_);
+  }
+
+ private:
+  static std::unique_ptr<Network> CreateChild(const Weights& weights,
+                                              const OptionsDict& options,
+                                              const std::string& name) {
+    const auto& opts = options.GetSubdict(name);
+    return NetworkFactory::Get()->Create(
+        opts.GetOrDefault<std::string>("backend", name), weights, opts);
+  }
+
+  const int threshold_;
+  std::unique_ptr<Network> small_net_;
+  std::unique_ptr<Network> large_net_;
+};
+
+}  // namespace
+
+REGISTER_NETWORK("split", SplitNetwork, -850)
+
+}  // namespace lczero
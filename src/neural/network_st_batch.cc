@@ -63,4 +63,107 @@ float SingleThreadBatchingNetworkComputation::GetPVal(int sample,
   return network_->parent_computation_->GetPVal(sample - start_idx_, move_id);
 }
 
+PipelinedBatchingNetwork::PipelinedBatchingNetwork(
+    std::unique_ptr<Network> parent, int dispatch_threshold)
+    : parent_(std::move(parent)), dispatch_threshold_(dispatch_threshold) {
+  worker_ = std::thread(&PipelinedBatchingNetwork::Worker, this);
+}
+
+PipelinedBatchingNetwork::~PipelinedBatchingNetwork() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    abort_ = true;
+  }
+  dispatch_cv_.notify_one();
+  worker_.join();
+}
+
+std::unique_ptr<NetworkComputation>
+PipelinedBatchingNetwork::NewComputation() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Chunks are only cut between computations, so that every computation's
+  // samples end up in a single chunk.
+  if (current_chunk_ &&
+      current_chunk_->computation->GetBatchSize() >= dispatch_threshold_) {
+    DispatchChunk();
+  }
+  ++computations_pending_;
+  return std::make_unique<PipelinedBatchingNetworkComputation>(this);
+}
+
+void PipelinedBatchingNetwork::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  assert(computations_pending_ == 0);
+  // The last ComputeBlocking() flushed the partial chunk, so there is
+  // nothing to carry over; chunks are created lazily on first AddInput().
+  assert(!current_chunk_);
+}
+
+void PipelinedBatchingNetwork::DispatchChunk() {
+  queue_.push_back(std::move(current_chunk_));
+  current_chunk_.reset();
+  dispatch_cv_.notify_one();
+}
+
+void PipelinedBatchingNetwork::Worker() {
+  while (true) {
+    std::shared_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      dispatch_cv_.wait(lock, [this]() { return abort_ || !queue_.empty(); });
+      // Drain the queue before exiting so that dispatched chunks always
+      // complete.
+      if (queue_.empty()) return;
+      chunk = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    chunk->computation->ComputeBlocking();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      chunk->done = true;
+    }
+    done_cv_.notify_all();
+  }
+}
+
+PipelinedBatchingNetworkComputation::PipelinedBatchingNetworkComputation(
+    PipelinedBatchingNetwork* network)
+    : network_(network) {}
+
+void PipelinedBatchingNetworkComputation::AddInput(InputPlanes&& input) {
+  std::lock_guard<std::mutex> lock(network_->mutex_);
+  if (!network_->current_chunk_) {
+    network_->current_chunk_ = std::make_shared<PipelinedBatchingNetwork::Chunk>();
+    network_->current_chunk_->computation = network_->parent_->NewComputation();
+  }
+  if (!chunk_) {
+    chunk_ = network_->current_chunk_;
+    start_idx_ = chunk_->computation->GetBatchSize();
+  }
+  assert(chunk_ == network_->current_chunk_);
+  assert(start_idx_ + batch_size_ == chunk_->computation->GetBatchSize());
+  ++batch_size_;
+  chunk_->computation->AddInput(std::move(input));
+}
+
+void PipelinedBatchingNetworkComputation::ComputeBlocking() {
+  std::unique_lock<std::mutex> lock(network_->mutex_);
+  --network_->computations_pending_;
+  if (!chunk_) return;
+  // If this computation's samples are in the chunk still being gathered,
+  // flush it now: all ComputeBlocking() calls happen on the gathering
+  // thread, so nobody else could cut it and waiting would deadlock.
+  if (chunk_ == network_->current_chunk_) network_->DispatchChunk();
+  network_->done_cv_.wait(lock, [this]() { return chunk_->done; });
+}
+
+float PipelinedBatchingNetworkComputation::GetQVal(int sample) const {
+  return chunk_->computation->GetQVal(start_idx_ + sample);
+}
+
+float PipelinedBatchingNetworkComputation::GetPVal(int sample,
+                                                   int move_id) const {
+  return chunk_->computation->GetPVal(start_idx_ + sample, move_id);
+}
+
 }  // namespace lczero
\ No newline at end of file
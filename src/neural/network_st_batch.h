@@ -18,6 +18,12 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include "neural/network.h"
 
 namespace lczero {
@@ -76,4 +82,79 @@ class SingleThreadBatchingNetworkComputation : public NetworkComputation {
   int batch_size_ = 0;
 };
 
+// Pipelined variant of SingleThreadBatchingNetwork, same usage protocol.
+// Instead of computing once on the last ComputeBlocking() call, the
+// aggregated batch is cut into chunks: whenever a new computation starts
+// and the chunk being gathered has reached @dispatch_threshold samples, it
+// is handed to a worker thread and evaluated while the caller keeps
+// gathering the next chunk. ComputeBlocking() then only waits for the
+// chunk holding that computation's samples, so the device is busy during
+// the gather phase instead of idling until the whole batch is assembled.
+// Gathering and reading results still have to happen on one thread.
+class PipelinedBatchingNetwork : public Network {
+ public:
+  PipelinedBatchingNetwork(std::unique_ptr<Network> parent,
+                           int dispatch_threshold);
+  ~PipelinedBatchingNetwork();
+  std::unique_ptr<NetworkComputation> NewComputation() override;
+
+  // Start a fresh batch. Must not be called with computations pending.
+  void Reset();
+
+ private:
+  // One dispatched (or being gathered) slice of the batch. Shared by the
+  // computations whose samples it holds and by the worker queue.
+  struct Chunk {
+    std::unique_ptr<NetworkComputation> computation;
+    bool done = false;
+  };
+
+  // Moves the chunk being gathered to the worker queue. Called with the
+  // mutex held.
+  void DispatchChunk();
+  void Worker();
+
+  std::unique_ptr<Network> parent_;
+  const int dispatch_threshold_;
+
+  std::mutex mutex_;
+  // Signalled when a chunk is queued (or on shutdown).
+  std::condition_variable dispatch_cv_;
+  // Signalled when the worker finishes a chunk.
+  std::condition_variable done_cv_;
+  std::deque<std::shared_ptr<Chunk>> queue_;
+  std::shared_ptr<Chunk> current_chunk_;
+  int computations_pending_ = 0;
+  bool abort_ = false;
+  std::thread worker_;
+
+  friend class PipelinedBatchingNetworkComputation;
+};
+
+class PipelinedBatchingNetworkComputation : public NetworkComputation {
+ public:
+  PipelinedBatchingNetworkComputation(PipelinedBatchingNetwork* network);
+
+  // Adds a sample to the chunk currently being gathered.
+  void AddInput(InputPlanes&& input) override;
+  // Waits until the chunk holding this computation's samples is evaluated;
+  // the last pending computation also flushes the partial chunk.
+  void ComputeBlocking() override;
+  // Returns how many times AddInput() was called.
+  int GetBatchSize() const override { return batch_size_; }
+  // Returns Q value of @sample.
+  float GetQVal(int sample) const override;
+  // Returns P value @move_id of @sample.
+  float GetPVal(int sample, int move_id) const override;
+
+ private:
+  PipelinedBatchingNetwork* const network_;
+  // The chunk holding this computation's samples; null until the first
+  // AddInput(). All samples of one computation go into the same chunk, as
+  // chunks are only cut between computations.
+  std::shared_ptr<PipelinedBatchingNetwork::Chunk> chunk_;
+  int start_idx_ = 0;
+  int batch_size_ = 0;
+};
+
 }  // namespace lczero
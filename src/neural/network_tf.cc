@@ -21,9 +21,10 @@
 #include "utils/optionsdict.h"
 #include "utils/transpose.h"
 
-#include <tensorflow/cc/client/client_session.h>
 #include <tensorflow/cc/ops/standard_ops.h>
 #include <tensorflow/core/framework/tensor.h>
+#include <tensorflow/core/protobuf/rewriter_config.pb.h>
+#include <tensorflow/core/public/session.h>
 
 namespace lczero {
 
@@ -32,6 +33,25 @@ using namespace tensorflow::ops;
 
 namespace {
 
+// Names of the graph endpoints, for feeding/fetching through the session.
+const char* kInputName = "input";
+const char* kPolicyHeadName = "policy_head";
+const char* kValueHeadName = "value_head";
+
+// Fixed batch-size buckets. Batches are zero-padded up to the nearest
+// bucket, so the session only ever sees these shapes: every kernel gets
+// selected (and, with XLA, compiled) once per bucket instead of
+// re-specializing for each distinct batch size the search produces.
+constexpr int kBatchBuckets[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+
+int BucketedBatchSize(int batch_size) {
+  for (int bucket : kBatchBuckets) {
+    if (batch_size <= bucket) return bucket;
+  }
+  // Larger than the largest bucket; run unpadded.
+  return batch_size;
+}
+
 Output MakeConst(const Scope& scope, TensorShape shape,
                  const std::vector<float>& values,
                  const std::vector<int>& order = {}) {
@@ -134,7 +154,7 @@ std::pair<Output, Output> MakeNetwork(const Scope& scope, Input input,
   ip_pol_w = Reshape(scope, ip_pol_w, Const(scope, {32 * 8 * 8, 1858}));
   auto ip_pol_b = MakeConst(scope, {1858}, weights.ip_pol_b);
   auto policy_fc = Add(scope, MatMul(scope, conv_pol, ip_pol_w), ip_pol_b);
-  auto policy_head = Softmax(scope, policy_fc);
+  auto policy_head = Softmax(scope.WithOpName(kPolicyHeadName), policy_fc);
 
   // Value head
   auto conv_val =
@@ -151,7 +171,8 @@ std::pair<Output, Output> MakeNetwork(const Scope& scope, Input input,
   auto ip2_val_w = MakeConst(scope, {128, 1}, weights.ip2_val_w);
   auto ip2_val_b = MakeConst(scope, {1}, weights.ip2_val_b);
   auto value_head =
-      Tanh(scope, Add(scope, MatMul(scope, value_flow, ip2_val_w), ip2_val_b));
+      Tanh(scope.WithOpName(kValueHeadName),
+           Add(scope, MatMul(scope, value_flow, ip2_val_w), ip2_val_b));
 
   return {policy_head, value_head};
 }
@@ -164,18 +185,17 @@ class TFNetwork : public Network {
  public:
   TFNetwork(const Weights& weights, const OptionsDict& options);
 
+  ~TFNetwork() {
+    if (session_) session_->Close().IgnoreError();
+  }
+
   std::unique_ptr<NetworkComputation> NewComputation() override;
 
   tensorflow::Status Compute(tensorflow::Tensor& input,
                              std::vector<tensorflow::Tensor>* outputs) const;
 
  private:
-  tensorflow::Scope scope_;
-  std::unique_ptr<tensorflow::ClientSession> session_;
-
-  std::unique_ptr<tensorflow::ops::Placeholder> input_;
-  std::unique_ptr<tensorflow::Output> policy_head_;
-  std::unique_ptr<tensorflow::Output> value_head_;
+  std::unique_ptr<tensorflow::Session> session_;
 };
 
 template <bool CPU>
@@ -213,9 +233,10 @@ class TFNetworkComputation : public NetworkComputation {
 // Version for GPU.
 template <>
 void TFNetworkComputation<false>::PrepareInput() {
+  // Padding rows stay zero and their outputs are never read.
   input_ = tensorflow::Tensor(
       tensorflow::DataType::DT_FLOAT,
-      {static_cast<int>(raw_input_.size()), kInputPlanes, 8, 8});
+      {BucketedBatchSize(raw_input_.size()), kInputPlanes, 8, 8});
 
   auto flat = input_.flat<float>();
   memset(flat.data(), 0, flat.size() * sizeof(*flat.data()));
@@ -234,9 +255,10 @@ void TFNetworkComputation<false>::PrepareInput() {
 // Version for CPU.
 template <>
 void TFNetworkComputation<true>::PrepareInput() {
+  // Padding rows stay zero and their outputs are never read.
   input_ = tensorflow::Tensor(
       tensorflow::DataType::DT_FLOAT,
-      {static_cast<int>(raw_input_.size()), 8, 8, kInputPlanes});
+      {BucketedBatchSize(raw_input_.size()), 8, 8, kInputPlanes});
 
   auto flat = input_.flat<float>();
   memset(flat.data(), 0, flat.size() * sizeof(*flat.data()));
@@ -256,42 +278,54 @@ void TFNetworkComputation<true>::PrepareInput() {
 }  // namespace
 
 template <bool CPU>
-TFNetwork<CPU>::TFNetwork(const Weights& weights,
-                          const OptionsDict& /*options*/)
-    : scope_(Scope::NewRootScope()) {
+TFNetwork<CPU>::TFNetwork(const Weights& weights, const OptionsDict& options) {
+  // Build the graph once. All weights are constants, so serializing the
+  // scope yields an already frozen GraphDef which the session's optimizer
+  // passes (and XLA) can fold and rewrite freely.
+  auto scope = Scope::NewRootScope();
+  auto input = Placeholder(
+      scope.WithOpName(kInputName), DataType::DT_FLOAT,
+      CPU ? Placeholder::Shape({-1, 8, 8, kInputPlanes})
+          : Placeholder::Shape({-1, kInputPlanes, 8, 8}));
+  MakeNetwork<CPU>(scope, input, weights);
+  CHECK(scope.ok()) << scope.status().ToString();
+
+  GraphDef graph_def;
+  TF_CHECK_OK(scope.ToGraphDef(&graph_def));
+
   tensorflow::SessionOptions session_options;
   if (CPU) (*session_options.config.mutable_device_count())["GPU"] = 0;
-  session_ =
-      std::make_unique<tensorflow::ClientSession>(scope_, session_options);
-
-  if (CPU) {
-    input_ = std::make_unique<Placeholder>(
-        scope_, DataType::DT_FLOAT,
-        Placeholder::Shape({-1, 8, 8, kInputPlanes}));
-  } else {
-    input_ = std::make_unique<Placeholder>(
-        scope_, DataType::DT_FLOAT,
-        Placeholder::Shape({-1, kInputPlanes, 8, 8}));
+  auto* graph_options = session_options.config.mutable_graph_options();
+  auto* optimizer_options = graph_options->mutable_optimizer_options();
+  optimizer_options->set_opt_level(OptimizerOptions::L1);
+  optimizer_options->set_do_function_inlining(true);
+  if (options.GetOrDefault<bool>("xla", !CPU)) {
+    optimizer_options->set_global_jit_level(OptimizerOptions::ON_1);
+  }
+  auto* rewriter_options = graph_options->mutable_rewrite_options();
+  rewriter_options->set_constant_folding(RewriterConfig::ON);
+  rewriter_options->set_arithmetic_optimization(RewriterConfig::ON);
+  rewriter_options->set_layout_optimizer(RewriterConfig::ON);
+
+  session_.reset(NewSession(session_options));
+  TF_CHECK_OK(session_->Create(graph_def));
+
+  // The first request at each shape is slow (kernel selection, XLA
+  // compilation), so preheat every bucket now rather than mid-search.
+  for (int bucket : kBatchBuckets) {
+    auto fake_request = NewComputation();
+    for (int i = 0; i < bucket; ++i) {
+      fake_request->AddInput(InputPlanes(kInputPlanes));
+    }
+    fake_request->ComputeBlocking();
   }
-
-  auto output = MakeNetwork<CPU>(scope_, *input_, weights);
-  CHECK(scope_.ok()) << scope_.status().ToString();
-
-  policy_head_ = std::make_unique<Output>(output.first);
-  value_head_ = std::make_unique<Output>(output.second);
-
-  // First request to tensorflow is slow (0.6s), so doing an empty request for
-  // preheating.
-  auto fake_request = NewComputation();
-  fake_request->AddInput(InputPlanes(kInputPlanes));
-  fake_request->ComputeBlocking();
 }
 
 template <bool CPU>
 tensorflow::Status TFNetwork<CPU>::Compute(tensorflow::Tensor& input,
                                            std::vector<Tensor>* outputs) const {
-  return session_->Run({{*input_, input}}, {*value_head_, *policy_head_},
-                       outputs);
+  return session_->Run({{kInputName, input}},
+                       {kValueHeadName, kPolicyHeadName}, {}, outputs);
 }
 
 template <bool CPU>
@@ -23,6 +23,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -34,6 +35,9 @@
 #include "neural/opencl/OpenCLParams.h"
 #include "neural/opencl/OpenCLTuner.h"
 
+#include "utils/fp16_utils.h"
+#include "utils/trace.h"
+
 
 static std::string cl_args =
     "-cl-mad-enable -cl-fast-relaxed-math -cl-no-signed-zeros "
@@ -51,6 +55,10 @@ const std::string sourceCode_convolve3 =
 #include "clsource/convolve3.opencl"
     ;
 
+const std::string sourceCode_expand_planes =
+#include "clsource/expand_planes.opencl"
+    ;
+
 const std::string sourceCode_blast_level3_common =
 #include "clblast_level3/common.opencl"
     ;
@@ -90,6 +98,8 @@ void OpenCL::ensure_thread_initialized() {
     opencl_thread_data.m_merge_kernel = cl::Kernel(m_program, "merge_bn");
     opencl_thread_data.m_in_transform_kernel =
         cl::Kernel(m_program, "in_transform");
+    opencl_thread_data.m_in_transform_expand_kernel =
+        cl::Kernel(m_program, "in_transform_expand");
     opencl_thread_data.m_sgemm_kernel = cl::Kernel(m_program, "XgemmBatched");
     opencl_thread_data.m_out_transform_bn_kernel =
         cl::Kernel(m_program, "out_transform_fused_bn");
@@ -97,6 +107,7 @@ void OpenCL::ensure_thread_initialized() {
         cl::Kernel(m_program, "out_transform_fused_bn_in");
     opencl_thread_data.m_sgemv_kernel = cl::Kernel(m_program, "Xgemv");
     opencl_thread_data.m_commandqueue = cl::CommandQueue(m_context, m_device);
+    opencl_thread_data.m_dma_queue = cl::CommandQueue(m_context, m_device);
     opencl_thread_data.m_is_initialized = true;
   }
 }
@@ -107,6 +118,17 @@ void OpenCL_Network::add_weights(size_t layer, size_t size,
     m_layers.push_back(Layer());
   }
 
+  if (m_opencl.m_fp16) {
+    auto converted_weights = std::vector<uint16_t>();
+    for (auto i = size_t{0}; i < size; i++) {
+      converted_weights.emplace_back(lczero::FP32toFP16(weights[i]));
+    }
+    m_layers.back().weights.emplace_back(
+        m_opencl.m_context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY,
+        size * sizeof(uint16_t), converted_weights.data());
+    return;
+  }
+
   auto converted_weights = std::vector<net_t>();
   for (auto i = size_t{0}; i < size; i++) {
     converted_weights.emplace_back(weights[i]);
@@ -118,14 +140,18 @@ void OpenCL_Network::add_weights(size_t layer, size_t size,
       const_cast<net_t*>(converted_weights.data()));
 }
 
-void OpenCL_Network::forward(const std::vector<net_t>& input,
+void OpenCL_Network::forward(const std::vector<uint64_t>& masks,
+                             const std::vector<float>& values,
                              std::vector<net_t>& output_pol,
                              std::vector<net_t>& output_val) const {
   constexpr auto tiles = WINOGRAD_P;
+  // The nested "opencl_wait" slice below separates device wait time from
+  // enqueueing; their difference is the host-side enqueue cost.
+  TRACE_SCOPE("opencl_forward");
 
-  auto finalSize_pol =
-      m_layers[m_layers.size() - 2].ip_out_size * sizeof(net_t);
-  auto finalSize_val = m_layers.back().ip_out_size * sizeof(net_t);
+  const auto elem_size = m_opencl.net_t_size();
+  auto finalSize_pol = m_layers[m_layers.size() - 2].ip_out_size * elem_size;
+  auto finalSize_val = m_layers.back().ip_out_size * elem_size;
 
   if (m_layers.back().is_policy) {
     std::swap(finalSize_pol, finalSize_val);
@@ -148,8 +174,8 @@ void OpenCL_Network::forward(const std::vector<net_t>& input,
     const auto m_ceil = ceilMultiple(ceilMultiple(max_channels, mwg), vwm);
     const auto n_ceil = ceilMultiple(ceilMultiple(tiles, nwg), vwn);
 
-    const auto alloc_inSize = m_ceil * m_ceil * max_channels * sizeof(net_t);
-    const auto alloc_vm_size = WINOGRAD_TILE * m_ceil * n_ceil * sizeof(net_t);
+    const auto alloc_inSize = m_ceil * m_ceil * max_channels * elem_size;
+    const auto alloc_vm_size = WINOGRAD_TILE * m_ceil * n_ceil * elem_size;
 
     auto v_zeros = std::vector<float>(alloc_vm_size);
 
@@ -165,6 +191,22 @@ void OpenCL_Network::forward(const std::vector<net_t>& input,
         cl::Buffer(m_opencl.m_context,
                    CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, alloc_vm_size);
 
+    opencl_thread_data.m_outBuffer_pol =
+        cl::Buffer(m_opencl.m_context, CL_MEM_READ_WRITE, finalSize_pol);
+    opencl_thread_data.m_outBuffer_val =
+        cl::Buffer(m_opencl.m_context, CL_MEM_READ_WRITE, finalSize_val);
+
+    const auto input_channels = m_layers[0].channels;
+    const auto alloc_packedSize =
+        input_channels * (sizeof(uint64_t) + sizeof(float));
+    opencl_thread_data.m_packedInBuffer =
+        cl::Buffer(m_opencl.m_context, CL_MEM_READ_ONLY, alloc_packedSize);
+
+    // Pinned staging memory for transfers, mapped once and kept mapped;
+    // DMA from and to pinned pages overlaps with kernels on the main queue.
+    opencl_thread_data.m_pinnedInBuffer =
+        cl::Buffer(m_opencl.m_context,
+                   CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, alloc_packedSize);
     opencl_thread_data.m_pinnedOutBuffer_pol =
         cl::Buffer(m_opencl.m_context,
                    CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, finalSize_pol);
@@ -172,6 +214,17 @@ void OpenCL_Network::forward(const std::vector<net_t>& input,
         cl::Buffer(m_opencl.m_context,
                    CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, finalSize_val);
 
+    auto& map_queue = opencl_thread_data.m_dma_queue;
+    opencl_thread_data.m_pinnedInHost =
+        map_queue.enqueueMapBuffer(opencl_thread_data.m_pinnedInBuffer,
+                                   CL_TRUE, CL_MAP_WRITE, 0, alloc_packedSize);
+    opencl_thread_data.m_pinnedOutHost_pol =
+        map_queue.enqueueMapBuffer(opencl_thread_data.m_pinnedOutBuffer_pol,
+                                   CL_TRUE, CL_MAP_READ, 0, finalSize_pol);
+    opencl_thread_data.m_pinnedOutHost_val =
+        map_queue.enqueueMapBuffer(opencl_thread_data.m_pinnedOutBuffer_val,
+                                   CL_TRUE, CL_MAP_READ, 0, finalSize_val);
+
     opencl_thread_data.m_buffers_allocated = true;
   }
 
@@ -180,11 +233,57 @@ void OpenCL_Network::forward(const std::vector<net_t>& input,
   cl::Buffer& VBuffer = opencl_thread_data.m_VBuffer;
   cl::Buffer& MBuffer = opencl_thread_data.m_MBuffer;
   cl::CommandQueue& queue = opencl_thread_data.m_commandqueue;
+  cl::CommandQueue& dma_queue = opencl_thread_data.m_dma_queue;
+
+  // Stage the bit-packed planes in pinned memory and upload them on the
+  // transfer queue; the compute queue only waits for the upload, not the
+  // host. Expansion to net_t happens on the device (which also does the
+  // fp16 conversion), so the transfer is a small fraction of the expanded
+  // tensor.
+  const auto mask_bytes = masks.size() * sizeof(uint64_t);
+  const auto packed_size = mask_bytes + values.size() * sizeof(float);
+  auto pinned_in = static_cast<char*>(opencl_thread_data.m_pinnedInHost);
+  std::memcpy(pinned_in, masks.data(), mask_bytes);
+  std::memcpy(pinned_in + mask_bytes, values.data(),
+              values.size() * sizeof(float));
+  auto input_done = cl::Event();
+  dma_queue.enqueueWriteBuffer(opencl_thread_data.m_packedInBuffer, CL_FALSE, 0,
+                               packed_size, pinned_in, nullptr, &input_done);
+  const auto input_wait = std::vector<cl::Event>{input_done};
+  queue.enqueueBarrierWithWaitList(&input_wait, nullptr);
+
+  // Expand the packed planes and Winograd-transform the input convolution
+  // in one kernel, straight from the masks into V; the expanded input
+  // tensor never materializes. The input convolution below then skips its
+  // own in_transform.
+  auto& expand_kernel = opencl_thread_data.m_in_transform_expand_kernel;
+  try {
+    const auto input_channels = static_cast<int>(m_layers[0].channels);
+    const auto kwg = m_opencl.m_sgemm_tuners.kwg;
+    const auto vwm = m_opencl.m_sgemm_tuners.vwm;
+    const auto nwg = m_opencl.m_sgemm_tuners.nwg;
+    const auto vwn = m_opencl.m_sgemm_tuners.vwn;
+    const auto k_ceil =
+        int(ceilMultiple(ceilMultiple(input_channels, kwg), vwm));
+    const auto n_ceil = int(ceilMultiple(ceilMultiple(tiles, nwg), vwn));
+    const auto wgs = ceilMultiple(tiles, m_opencl.m_wavefront_size);
+
+    expand_kernel.setArg(0, opencl_thread_data.m_packedInBuffer);
+    expand_kernel.setArg(1, VBuffer);
+    expand_kernel.setArg(2, input_channels);
+    expand_kernel.setArg(3, k_ceil);
+    expand_kernel.setArg(4, n_ceil);
+
+    queue.enqueueNDRangeKernel(expand_kernel, cl::NullRange,
+                               cl::NDRange(wgs, input_channels));
+  } catch (const cl::Error& e) {
+    std::cerr << "Error in in_transform_expand: " << e.what() << ": "
+              << e.err() << std::endl;
+    throw;
+  }
 
-  const auto inSize = sizeof(net_t) * input.size();
-  queue.enqueueWriteBuffer(inBuffer, CL_FALSE, 0, inSize, input.data());
-
-  auto skip_in_trans = false;
+  // V for the input convolution is already filled above.
+  auto skip_in_trans = true;
   for (auto iter = cbegin(m_layers); iter != cend(m_layers); iter++) {
     const auto& layer = *iter;
     const auto niter = std::next(iter);
@@ -224,10 +323,16 @@ void OpenCL_Network::forward(const std::vector<net_t>& input,
       assert(layer.is_value || layer.is_policy);
 
       cl::Buffer out_buffer;
+      void* staging_host;
+      size_t out_size;
       if (layer.is_policy) {
-        out_buffer = opencl_thread_data.m_pinnedOutBuffer_pol;
+        out_buffer = opencl_thread_data.m_outBuffer_pol;
+        staging_host = opencl_thread_data.m_pinnedOutHost_pol;
+        out_size = finalSize_pol;
       } else {
-        out_buffer = opencl_thread_data.m_pinnedOutBuffer_val;
+        out_buffer = opencl_thread_data.m_outBuffer_val;
+        staging_host = opencl_thread_data.m_pinnedOutHost_val;
+        out_size = finalSize_val;
       }
 
       auto ip_w = begin(layer.weights) + 3;
@@ -238,30 +343,44 @@ void OpenCL_Network::forward(const std::vector<net_t>& input,
 
       innerproduct(inBuffer2, ip_w, ip_b, out_buffer, layer.ip_in_size,
                    layer.ip_out_size, layer.is_value);
+
+      // Kick off the download on the transfer queue as soon as this head
+      // completes; the first head's download overlaps the second head's
+      // compute.
+      auto head_done = cl::Event();
+      queue.enqueueMarkerWithWaitList(nullptr, &head_done);
+      const auto head_wait = std::vector<cl::Event>{head_done};
+      dma_queue.enqueueReadBuffer(out_buffer, CL_FALSE, 0, out_size,
+                                  staging_host, &head_wait, nullptr);
     }
   }
 
-  auto pinnedOutBufferHost_pol =
-      queue.enqueueMapBuffer(opencl_thread_data.m_pinnedOutBuffer_pol, CL_FALSE,
-                             CL_MAP_READ, 0, finalSize_pol);
-  auto pinnedOutBufferHost_val =
-      queue.enqueueMapBuffer(opencl_thread_data.m_pinnedOutBuffer_val, CL_FALSE,
-                             CL_MAP_READ, 0, finalSize_val);
-
   {
     // Finish call is usually a busy wait. When using multiple threads
     // use the lock to avoid busy waiting with all threads.
+    TRACE_SCOPE("opencl_wait");
     std::lock_guard<std::mutex> lock(m_queue_finish_mutex);
-    queue.finish();
+    queue.flush();
+    dma_queue.finish();
   }
 
-  std::memcpy(output_pol.data(), pinnedOutBufferHost_pol, finalSize_pol);
-  std::memcpy(output_val.data(), pinnedOutBufferHost_val, finalSize_val);
-
-  queue.enqueueUnmapMemObject(opencl_thread_data.m_pinnedOutBuffer_pol,
-                              pinnedOutBufferHost_pol);
-  queue.enqueueUnmapMemObject(opencl_thread_data.m_pinnedOutBuffer_val,
-                              pinnedOutBufferHost_val);
+  if (m_opencl.m_fp16) {
+    const auto half_pol =
+        static_cast<const uint16_t*>(opencl_thread_data.m_pinnedOutHost_pol);
+    const auto half_val =
+        static_cast<const uint16_t*>(opencl_thread_data.m_pinnedOutHost_val);
+    for (auto i = size_t{0}; i < output_pol.size(); i++) {
+      output_pol[i] = lczero::FP16toFP32(half_pol[i]);
+    }
+    for (auto i = size_t{0}; i < output_val.size(); i++) {
+      output_val[i] = lczero::FP16toFP32(half_val[i]);
+    }
+  } else {
+    std::memcpy(output_pol.data(), opencl_thread_data.m_pinnedOutHost_pol,
+                finalSize_pol);
+    std::memcpy(output_val.data(), opencl_thread_data.m_pinnedOutHost_val,
+                finalSize_val);
+  }
 }
 
 void OpenCL_Network::convolve3(int channels, int outputs, cl::Buffer& bufferIn,
@@ -420,7 +539,7 @@ void OpenCL_Network::convolve1(int channels, int outputs,
 
 #ifndef NDEBUG
   // Total output size after reducing
-  size_t outSize = width * height * outputs * sizeof(net_t);
+  size_t outSize = width * height * outputs * m_opencl.net_t_size();
 
   // Produce channel * output planes and merge them at the end
   size_t mergeSize = (channels >> channelShift) * outSize;
@@ -739,26 +858,43 @@ void OpenCL::initialize(const int channels, const OpenCLParams& params) {
   m_context = context;
   m_device = best_device;
 
+  m_fp16 = params.fp16;
+  if (m_fp16) {
+    auto extensions = best_device.getInfo<CL_DEVICE_EXTENSIONS>();
+    if (extensions.find("cl_khr_fp16") == std::string::npos) {
+      fprintf(stderr,
+              "Device does not support half precision (cl_khr_fp16), "
+              "falling back to single precision.\n");
+      m_fp16 = false;
+    } else if (verbose) {
+      fprintf(stderr, "Using half precision storage.\n");
+    }
+  }
+
+  m_cl_args = cl_args;
+  if (m_fp16) {
+    m_cl_args += " -DUSE_HALF -DPRECISION=16";
+  }
+
   // Make program of the source code in the context
   try {
     m_program =
         cl::Program(m_context, sourceCode_config + sourceCode_convolve1 +
-                                   sourceCode_convolve3 + sourceCode_sgemm +
+                                   sourceCode_convolve3 +
+                                   sourceCode_expand_planes + sourceCode_sgemm +
                                    sourceCode_sgemv);
   } catch (const cl::Error& e) {
     fprintf(stderr, "Error getting kernels: %s: %d", e.what(), e.err());
     throw std::runtime_error("Error getting OpenCL kernels.");
   }
 
-  m_cl_args = cl_args;
-
   auto t = Tuner(*this, params, m_context, m_device);
   auto sgemm_tuners =
       t.load_sgemm_tuners(channels, WINOGRAD_P, channels, WINOGRAD_TILE);
 
   // Build program for these specific devices
   try {
-    std::string args = cl_args;
+    std::string args = m_cl_args;
     args += sgemm_tuners;
     m_program.build(args.c_str());
   } catch (const cl::Error&) {
@@ -792,6 +928,10 @@ void OpenCL::initialize(const int channels, const OpenCLParams& params) {
   m_init_ok = true;
 }
 
+std::string OpenCL::get_driver_version() {
+  return m_device.getInfo<CL_DRIVER_VERSION>();
+}
+
 std::string OpenCL::get_device_name() {
   std::stringstream ss;
 
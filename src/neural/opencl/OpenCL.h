@@ -65,19 +65,34 @@ class ThreadData {
  private:
   bool m_is_initialized{false};
   cl::CommandQueue m_commandqueue;
+  // Separate queue for host-device transfers, so uploads and downloads can
+  // overlap with compute on the main queue.
+  cl::CommandQueue m_dma_queue;
   cl::Kernel m_convolve1_kernel;
   cl::Kernel m_merge_kernel;
   cl::Kernel m_in_transform_kernel;
+  cl::Kernel m_in_transform_expand_kernel;
   cl::Kernel m_sgemm_kernel;
   cl::Kernel m_sgemv_kernel;
   cl::Kernel m_out_transform_bn_kernel;
   cl::Kernel m_out_transform_bn_in_kernel;
   cl::Buffer m_inBuffer;
   cl::Buffer m_inBuffer2;
+  // Bit-packed input planes as uploaded; in_transform_expand reads them
+  // directly when transforming the input convolution into m_VBuffer.
+  cl::Buffer m_packedInBuffer;
   cl::Buffer m_VBuffer;
   cl::Buffer m_MBuffer;
+  cl::Buffer m_outBuffer_pol;
+  cl::Buffer m_outBuffer_val;
+  // Pinned staging buffers, mapped once at allocation; the host pointers
+  // stay valid for the thread's lifetime.
+  cl::Buffer m_pinnedInBuffer;
   cl::Buffer m_pinnedOutBuffer_pol;
   cl::Buffer m_pinnedOutBuffer_val;
+  void* m_pinnedInHost{nullptr};
+  void* m_pinnedOutHost_pol{nullptr};
+  void* m_pinnedOutHost_val{nullptr};
   bool m_buffers_allocated{false};
 };
 
@@ -163,7 +178,11 @@ class OpenCL_Network {
 
   size_t get_layer_count() const { return m_layers.size(); }
 
-  void forward(const std::vector<net_t>& input, std::vector<net_t>& output_pol,
+  // Takes the input position in bit-packed form: one 64-bit occupancy mask
+  // and one fill value per plane. Expansion to the input tensor happens on
+  // the device, so only ~12 bytes per plane cross the bus.
+  void forward(const std::vector<uint64_t>& masks,
+               const std::vector<float>& values, std::vector<net_t>& output_pol,
                std::vector<net_t>& output_val) const;
 
  private:
@@ -207,6 +226,12 @@ class OpenCL {
   void initialize(const int channels, const OpenCLParams& params);
   void ensure_thread_initialized(void);
   std::string get_device_name();
+  std::string get_driver_version();
+
+  // True when tensors are stored on the device in half precision.
+  bool fp16() const { return m_fp16; }
+  // Size in bytes of one tensor element on the device.
+  size_t net_t_size() const { return m_fp16 ? 2 : sizeof(float); }
 
   std::vector<size_t> get_sgemm_tuners(void);
 
@@ -226,6 +251,7 @@ class OpenCL {
     size_t mdimc, ndimc;
   };
   sgemm_tuners m_sgemm_tuners;
+  bool m_fp16{false};
   size_t m_wavefront_size{0};
   size_t m_max_workgroup_size{0};
   std::vector<size_t> m_max_workgroup_dims;
@@ -22,7 +22,9 @@ struct OpenCLParams {
   int gpuId = -1;
 
   bool verbose = false;
+  bool fp16 = false;
   bool tune_only = false;
   bool force_tune = false;
   bool tune_exhaustive = false;
+  bool tune_fast = false;
 };
@@ -31,9 +31,13 @@
 #include "neural/opencl/OpenCLTuner.h"
 
 #include "neural/blas/blas.h"
+#include "utils/fp16_utils.h"
 
 const auto TUNER_FILE_LOCAL = std::string("leelaz_opencl_tuning");
 constexpr auto MAX_ERROR = 1e-4f;
+// Half precision accumulates in fp16 in the kernel, so allow a much larger
+// error; broken configurations are off by many orders of magnitude.
+constexpr auto MAX_ERROR_HALF = 1e-1f;
 
 static void sgemmBatched_ref(const std::vector<float>& a,
                              const std::vector<float>& b, std::vector<float>& c,
@@ -181,6 +185,17 @@ std::string Tuner::tune_sgemm(const int m, const int n, const int k,
         {"VWN", {1, 2, 4, 8}},  {"STRM", {0, 1}},       {"STRN", {0, 1}},
         {"SA", {0, 1}},         {"SB", {0, 1}},
     };
+  } else if (m_params.tune_fast) {
+    // A small set of configurations that are reasonable on most devices.
+    // Worse worst case than the full tune, but an order of magnitude fewer
+    // kernels to benchmark.
+    opts = {
+        {"MWG", {16, 32}},  {"NWG", {16, 32}},  {"KWG", {32}},
+        {"MDIMC", {8, 16}}, {"NDIMC", {8, 16}}, {"MDIMA", {8, 16}},
+        {"NDIMB", {8, 16}}, {"KWI", {2}},       {"VWM", {2, 4}},
+        {"VWN", {2, 4}},    {"STRM", {0}},      {"STRN", {0}},
+        {"SA", {1}},        {"SB", {1}},
+    };
   } else {
     opts = {
         {"MWG", {16, 32, 64}},  {"NWG", {16, 32, 64}},  {"KWG", {32}},
@@ -210,17 +225,26 @@ std::string Tuner::tune_sgemm(const int m, const int n, const int k,
   auto c = std::vector<float>(c_size);
   auto c_ref = std::vector<float>(c_size);
 
+  // In half precision mode the kernel operates on fp16 buffers, so data is
+  // converted on the way in and out.
+  const auto fp16 = m_opencl.m_fp16;
+  const auto elem_size = m_opencl.net_t_size();
+  auto at_half = std::vector<uint16_t>(fp16 ? at_size : 0);
+  auto b_half = std::vector<uint16_t>(fp16 ? b_size : 0);
+  auto c_half = std::vector<uint16_t>(fp16 ? c_size : 0);
+  const auto max_allowed_error = fp16 ? MAX_ERROR_HALF : MAX_ERROR;
+
   sgemm_generate_data(at, k, m, batch_size, k, m);
   sgemm_generate_data(b, n, k, batch_size, n, k);
 
   sgemmBatched_ref(at, b, c_ref, m, n, k, batch_size);
 
   auto aBuffer = cl::Buffer(m_context, CL_MEM_READ_WRITE,
-                            sizeof(float) * at_size, nullptr, nullptr);
+                            elem_size * at_size, nullptr, nullptr);
   auto bBuffer = cl::Buffer(m_context, CL_MEM_READ_WRITE,
-                            sizeof(float) * b_size, nullptr, nullptr);
+                            elem_size * b_size, nullptr, nullptr);
   auto cBuffer = cl::Buffer(m_context, CL_MEM_READ_WRITE,
-                            sizeof(float) * c_size, nullptr, nullptr);
+                            elem_size * c_size, nullptr, nullptr);
 
   fprintf(stderr, "\nStarted OpenCL SGEMM tuner.\n");
 
@@ -285,10 +309,23 @@ std::string Tuner::tune_sgemm(const int m, const int n, const int k,
       sgemm_generate_data(at, k, m, batch_size, k_ceil, m_ceil);
       sgemm_generate_data(b, n, k, batch_size, n_ceil, k_ceil);
 
-      queue.enqueueWriteBuffer(aBuffer, CL_FALSE, 0, at_size * sizeof(float),
-                               at.data());
-      queue.enqueueWriteBuffer(bBuffer, CL_FALSE, 0, b_size * sizeof(float),
-                               b.data());
+      if (fp16) {
+        for (auto idx = size_t{0}; idx < at_size; idx++) {
+          at_half[idx] = lczero::FP32toFP16(at[idx]);
+        }
+        for (auto idx = size_t{0}; idx < b_size; idx++) {
+          b_half[idx] = lczero::FP32toFP16(b[idx]);
+        }
+        queue.enqueueWriteBuffer(aBuffer, CL_FALSE, 0, at_size * elem_size,
+                                 at_half.data());
+        queue.enqueueWriteBuffer(bBuffer, CL_FALSE, 0, b_size * elem_size,
+                                 b_half.data());
+      } else {
+        queue.enqueueWriteBuffer(aBuffer, CL_FALSE, 0, at_size * elem_size,
+                                 at.data());
+        queue.enqueueWriteBuffer(bBuffer, CL_FALSE, 0, b_size * elem_size,
+                                 b.data());
+      }
       queue.finish();
     }
 
@@ -314,9 +351,18 @@ std::string Tuner::tune_sgemm(const int m, const int n, const int k,
         queue.finish();
         event.wait();
 
-        queue.enqueueReadBuffer(cBuffer, CL_FALSE, 0, c_size * sizeof(float),
-                                c.data());
-        queue.finish();
+        if (fp16) {
+          queue.enqueueReadBuffer(cBuffer, CL_FALSE, 0, c_size * elem_size,
+                                  c_half.data());
+          queue.finish();
+          for (auto idx = size_t{0}; idx < c_size; idx++) {
+            c[idx] = lczero::FP16toFP32(c_half[idx]);
+          }
+        } else {
+          queue.enqueueReadBuffer(cBuffer, CL_FALSE, 0, c_size * elem_size,
+                                  c.data());
+          queue.finish();
+        }
 
         auto this_error =
             compare_ref(c, c_ref, n, m, batch_size, n_ceil, m_ceil);
@@ -328,11 +374,12 @@ std::string Tuner::tune_sgemm(const int m, const int n, const int k,
         sum += elapsed;
       } catch (const cl::Error&) {
         // Failed to enqueue kernel. Set error to max.
-        max_error = MAX_ERROR;
+        max_error = max_allowed_error;
         break;
       }
     }
-    if (max_error < MAX_ERROR && (best_time == 0 || sum < best_time)) {
+    if (max_error < max_allowed_error &&
+        (best_time == 0 || sum < best_time)) {
       auto param_str = parameters_to_string(p);
       auto kernel_ms = 1e-6f * (sum / runs);
       // Timing is in nanoseconds (10^-9), Giga = 10^9, so this works out
@@ -369,11 +416,13 @@ void Tuner::store_sgemm_tuners(const int m, const int n, const int k,
 
   auto device_name = m_opencl.get_device_name();
   auto tuning_params = std::stringstream{};
-  tuning_params << m << ";" << n << ";" << k << ";" << batch_size;
+  tuning_params << (m_opencl.m_fp16 ? 16 : 32) << ";" << m << ";" << n << ";"
+                << k << ";" << batch_size;
 
   auto tuning_line_prefix = std::to_string(TUNER_VERSION) + ";XgemmBatched;" +
                             tuning_params.str() + ";";
-  auto tuning_line = tuning_line_prefix + tuners + ";" + device_name;
+  auto tuning_line = tuning_line_prefix + tuners + ";" + device_name + ";" +
+                     m_opencl.get_driver_version();
 
   // Write back previous data as long as it's not the device and
   // tuning we just tuned
@@ -404,7 +453,7 @@ std::string Tuner::sgemm_tuners_from_line(std::string line, const int m,
     s.emplace_back(item);
   }
 
-  if (s.size() != 8) {
+  if (s.size() != 10) {
     return "";
   }
 
@@ -416,27 +465,35 @@ std::string Tuner::sgemm_tuners_from_line(std::string line, const int m,
     return "";
   }
 
-  if (s[2] != std::to_string(m)) {
+  if (s[2] != std::to_string(m_opencl.m_fp16 ? 16 : 32)) {
+    return "";
+  }
+
+  if (s[3] != std::to_string(m)) {
+    return "";
+  }
+
+  if (s[4] != std::to_string(n)) {
     return "";
   }
 
-  if (s[3] != std::to_string(n)) {
+  if (s[5] != std::to_string(k)) {
     return "";
   }
 
-  if (s[4] != std::to_string(k)) {
+  if (s[6] != std::to_string(batch_size)) {
     return "";
   }
 
-  if (s[5] != std::to_string(batch_size)) {
+  if (s[8] != m_opencl.get_device_name()) {
     return "";
   }
 
-  if (s[7] != m_opencl.get_device_name()) {
+  if (s[9] != m_opencl.get_driver_version()) {
     return "";
   }
 
-  return s[6];
+  return s[7];
 }
 
 std::string Tuner::load_sgemm_tuners(const int m, const int n, const int k,
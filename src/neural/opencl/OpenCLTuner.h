@@ -41,7 +41,8 @@ class Tuner {
   std::string load_sgemm_tuners(const int m, const int n, const int k,
                                 const int batch_size);
 
-  static constexpr auto TUNER_VERSION = 0;
+  // Version 1: tuning lines carry the precision and the driver version.
+  static constexpr auto TUNER_VERSION = 1;
   Tuner(OpenCL& opencl, const OpenCLParams& params, cl::Context context,
         cl::Device device)
       : m_opencl(opencl),
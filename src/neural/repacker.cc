@@ -0,0 +1,256 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "neural/repacker.h"
+
+#include <zlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "neural/writer.h"
+#include "utils/exception.h"
+#include "utils/filesystem.h"
+#include "utils/hashcat.h"
+
+namespace lczero {
+
+namespace {
+const char* kInputDirStr = "Directory with .gz training chunks";
+const char* kOutputDirStr = "Directory to write shards into";
+const char* kShardSizeStr = "Target shard size, MB";
+const char* kThreadsStr = "Worker threads";
+const char* kDedupStr = "Drop duplicate positions";
+
+// Hash of everything that identifies the position (not the targets), so two
+// records of the same position with different search outcomes still count as
+// duplicates.
+uint64_t PositionHash(const V3TrainingData& data) {
+  uint64_t hash = 0;
+  for (uint64_t plane : data.planes) hash = HashCat(hash, plane);
+  hash = HashCat(hash, data.castling_us_ooo | (data.castling_us_oo << 1) |
+                           (data.castling_them_ooo << 2) |
+                           (data.castling_them_oo << 3) |
+                           (data.side_to_move << 4));
+  return HashCat(hash, data.rule50_count);
+}
+
+// Cheap structural sanity checks; a corrupted or truncated chunk shows up
+// as nonsense in these fixed fields long before the float targets do.
+bool IsValidRecord(const V3TrainingData& data) {
+  if (data.version != 3) return false;
+  if (data.side_to_move > 1) return false;
+  if (data.result < -1 || data.result > 1) return false;
+  if (data.castling_us_ooo > 1 || data.castling_us_oo > 1 ||
+      data.castling_them_ooo > 1 || data.castling_them_oo > 1) {
+    return false;
+  }
+  return true;
+}
+
+// The dedup set is sharded by hash so that worker threads mostly take
+// different locks, the same way the NN cache shards its key space.
+class DedupSet {
+ public:
+  // Returns true if @hash was not seen before.
+  bool Insert(uint64_t hash) {
+    Shard& shard = shards_[hash % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.hashes.insert(hash).second;
+  }
+
+ private:
+  static constexpr int kShards = 256;
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_set<uint64_t> hashes;
+  };
+  Shard shards_[kShards];
+};
+
+// Writes records into @dir/shard-NNNN.bin files of @records_per_shard raw
+// records each. One mutex around the stream; workers hand in whole buffers,
+// so the lock is taken once per few hundred records.
+class ShardWriter {
+ public:
+  ShardWriter(const std::string& dir, int64_t records_per_shard)
+      : dir_(dir), records_per_shard_(records_per_shard) {}
+
+  void Append(const std::vector<V3TrainingData>& records) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& record : records) {
+      if (!out_.is_open()) OpenNextShard();
+      out_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+      if (!out_) throw Exception("Cannot write shard in: " + dir_);
+      if (++records_in_shard_ == records_per_shard_) {
+        out_.close();
+        records_in_shard_ = 0;
+      }
+    }
+  }
+
+  int ShardsWritten() const { return shards_; }
+
+ private:
+  void OpenNextShard() {
+    char name[32];
+    std::snprintf(name, sizeof(name), "shard-%04d.bin", shards_++);
+    out_.open(dir_ + "/" + name, std::ios::binary | std::ios::trunc);
+    if (!out_) throw Exception("Cannot create shard: " + dir_ + "/" + name);
+  }
+
+  const std::string dir_;
+  const int64_t records_per_shard_;
+  std::mutex mutex_;
+  std::ofstream out_;
+  int64_t records_in_shard_ = 0;
+  int shards_ = 0;
+};
+
+// Counters accumulated across workers; relaxed is fine, they are only read
+// after the workers join.
+struct Stats {
+  std::atomic<int64_t> files{0};
+  std::atomic<int64_t> bad_files{0};
+  std::atomic<int64_t> records{0};
+  std::atomic<int64_t> invalid{0};
+  std::atomic<int64_t> duplicates{0};
+  std::atomic<int64_t> kept{0};
+};
+
+// How many deduplicated records a worker buffers before handing them to the
+// writer in one locked append.
+const int kFlushRecords = 256;
+
+void ProcessFile(const std::string& filename, bool dedup, DedupSet* seen,
+                 ShardWriter* writer, Stats* stats) {
+  gzFile file = gzopen(filename.c_str(), "rb");
+  if (!file) {
+    ++stats->bad_files;
+    return;
+  }
+  std::vector<V3TrainingData> keep;
+  keep.reserve(kFlushRecords);
+  V3TrainingData record;
+  bool truncated = false;
+  while (true) {
+    const int read = gzread(file, &record, sizeof(record));
+    if (read == 0) break;
+    if (read != sizeof(record)) {
+      // Short or failed read: the tail of the file is unusable, but
+      // everything before it has been validated record by record.
+      truncated = true;
+      break;
+    }
+    ++stats->records;
+    if (!IsValidRecord(record)) {
+      ++stats->invalid;
+      continue;
+    }
+    if (dedup && !seen->Insert(PositionHash(record))) {
+      ++stats->duplicates;
+      continue;
+    }
+    keep.push_back(record);
+    if (static_cast<int>(keep.size()) == kFlushRecords) {
+      writer->Append(keep);
+      stats->kept += keep.size();
+      keep.clear();
+    }
+  }
+  gzclose(file);
+  if (!keep.empty()) {
+    writer->Append(keep);
+    stats->kept += keep.size();
+  }
+  ++stats->files;
+  if (truncated) {
+    ++stats->bad_files;
+    std::cerr << "Truncated chunk: " << filename << std::endl;
+  }
+}
+}  // namespace
+
+ChunkRepacker::ChunkRepacker() {
+  options_.Add<StringOption>(kInputDirStr, "input", 'i');
+  options_.Add<StringOption>(kOutputDirStr, "output", 'o');
+  options_.Add<IntOption>(kShardSizeStr, 1, 65536, "shard-mb") = 1024;
+  options_.Add<IntOption>(kThreadsStr, 1, 128, "threads", 't') = 4;
+  options_.Add<BoolOption>(kDedupStr, "dedup") = true;
+}
+
+void ChunkRepacker::Run() {
+  if (!options_.ProcessAllFlags()) return;
+  const OptionsDict& option_dict = options_.GetOptionsDict();
+
+  const std::string input_dir = option_dict.Get<std::string>(kInputDirStr);
+  const std::string output_dir = option_dict.Get<std::string>(kOutputDirStr);
+  if (input_dir.empty() || output_dir.empty()) {
+    throw Exception("Both --input and --output directories are required.");
+  }
+  std::vector<std::string> files = GetFileList(input_dir);
+  if (files.empty()) throw Exception("No chunk files in: " + input_dir);
+  for (auto& file : files) file = input_dir + "/" + file;
+  CreateDirectory(output_dir);
+
+  const bool dedup = option_dict.Get<bool>(kDedupStr);
+  const int64_t records_per_shard =
+      option_dict.Get<int>(kShardSizeStr) * (1LL << 20) /
+      sizeof(V3TrainingData);
+  ShardWriter writer(output_dir, std::max<int64_t>(records_per_shard, 1));
+  DedupSet seen;
+  Stats stats;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  // Workers claim whole files from a shared cursor: chunks are small and
+  // numerous, so files are the natural unit of parallelism.
+  std::atomic<size_t> next_file{0};
+  std::vector<std::thread> workers;
+  const int threads = option_dict.Get<int>(kThreadsStr);
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&]() {
+      while (true) {
+        const size_t idx = next_file.fetch_add(1);
+        if (idx >= files.size()) return;
+        ProcessFile(files[idx], dedup, &seen, &writer, &stats);
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  const auto elapsed = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_time)
+                           .count();
+  std::cerr << "Repacked " << stats.files << " chunks (" << stats.bad_files
+            << " bad), " << stats.records << " records: " << stats.invalid
+            << " invalid, " << stats.duplicates << " duplicates, "
+            << stats.kept << " kept in " << writer.ShardsWritten()
+            << " shards, " << elapsed << "s ("
+            << static_cast<int64_t>(
+                   elapsed > 0 ? stats.records / elapsed : 0)
+            << " records/s)" << std::endl;
+}
+
+}  // namespace lczero
@@ -0,0 +1,42 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "utils/optionsparser.h"
+
+namespace lczero {
+
+// Training-data post-processing: scans a directory of per-game .gz chunk
+// files of V3TrainingData records (see neural/writer.h) on several threads,
+// validates record structure, drops duplicate positions, and repacks the
+// survivors into large raw shards of contiguous records which a trainer can
+// memory map and read sequentially. Replaces hours of scripted per-file
+// decompression with one parallel pass.
+class ChunkRepacker {
+ public:
+  ChunkRepacker();
+
+  // Parses command line flags and runs the repack. Blocks.
+  void Run();
+
+ private:
+  OptionsParser options_;
+};
+
+}  // namespace lczero
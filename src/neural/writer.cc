@@ -18,41 +18,188 @@
 
 #include "neural/writer.h"
 
+#include <zlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <iomanip>
+#include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include "utils/commandline.h"
 #include "utils/exception.h"
 #include "utils/filesystem.h"
 #include "utils/random.h"
+#include "utils/trace.h"
 
 namespace lczero {
 
-TrainingDataWriter::TrainingDataWriter(int game_id) {
+namespace {
+
+// Upper bound on games buffered for writing, ~8 MB of training data each at
+// the extreme. If the disk falls this far behind, Finalize() blocks rather
+// than buffering without limit.
+const size_t kMaxQueuedGames = 64;
+
+// Process-wide writer configuration, set through TrainingDataWriter before
+// selfplay starts.
+TrainingDataWriter::Compression g_compression =
+    TrainingDataWriter::Compression::kGzip;
+int g_games_per_file = 1;
+
+// Mirror of the writer queue depth, readable without instantiating the
+// writer (and its thread) from telemetry code.
+std::atomic<int> g_queued_games{0};
+
+// Compresses and writes finished games from a single background thread, so
+// that the game threads only ever touch in-memory buffers and never stall on
+// disk (or NFS) latency. Write errors are reported to stderr, as the game
+// which produced the data is long gone by the time they surface.
+class BackgroundWriter {
+ public:
+  static BackgroundWriter& Get() {
+    static BackgroundWriter writer;
+    return writer;
+  }
+
+  // Queues the game for writing and returns the name of the file it will
+  // land in.
+  std::string Schedule(const std::string& directory, int game_id,
+                      std::vector<V3TrainingData> data) {
+    std::string filename;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_full_cv_.wait(
+          lock, [this]() { return queue_.size() < kMaxQueuedGames; });
+      filename = NextFileName(directory, game_id);
+      queue_.emplace_back(filename, std::move(data));
+      g_queued_games = queue_.size();
+    }
+    data_ready_cv_.notify_one();
+    return filename;
+  }
+
+ private:
+  BackgroundWriter() : thread_([this]() { Worker(); }) {}
+
+  ~BackgroundWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    data_ready_cv_.notify_all();
+    // Worker drains the queue before exiting, so no games are lost.
+    thread_.join();
+  }
+
+  using Job = std::pair<std::string, std::vector<V3TrainingData>>;
+
+  // In rolling mode consecutive games share one file, named after the first
+  // game in it; the worker appends, so a file never has concurrent writers.
+  std::string NextFileName(const std::string& directory, int game_id)
+      REQUIRES(mutex_) {
+    if (games_in_current_file_ == 0 ||
+        games_in_current_file_ >= g_games_per_file) {
+      std::ostringstream oss;
+      oss << directory << '/' << "game_" << std::setfill('0') << std::setw(6)
+          << game_id
+          << (g_compression == TrainingDataWriter::Compression::kNone
+                  ? ".bin"
+                  : ".gz");
+      current_filename_ = oss.str();
+      games_in_current_file_ = 1;
+    } else {
+      ++games_in_current_file_;
+    }
+    return current_filename_;
+  }
+
+  void Worker() {
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        data_ready_cv_.wait(lock,
+                            [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        job = std::move(queue_.front());
+        queue_.pop_front();
+        g_queued_games = queue_.size();
+      }
+      queue_full_cv_.notify_one();
+      WriteGame(job);
+    }
+  }
+
+  static void WriteGame(const Job& job) {
+    TRACE_SCOPE("training_write");
+    const char* data = reinterpret_cast<const char*>(job.second.data());
+    const size_t size = job.second.size() * sizeof(V3TrainingData);
+    if (g_compression == TrainingDataWriter::Compression::kNone) {
+      std::ofstream fout(job.first,
+                         std::ios::binary | std::ios::out | std::ios::app);
+      if (!fout.write(data, size)) {
+        std::cerr << "Unable to write into " << job.first << std::endl;
+      }
+      return;
+    }
+    // Append mode: every game is its own gzip member, and concatenated
+    // members form a valid stream. The whole game is compressed in one call
+    // instead of a deflate per record.
+    const char* mode =
+        g_compression == TrainingDataWriter::Compression::kFastGzip ? "ab1"
+                                                                    : "ab";
+    gzFile fout = gzopen(job.first.c_str(), mode);
+    if (!fout) {
+      std::cerr << "Cannot create gzip file " << job.first << std::endl;
+      return;
+    }
+    if (gzwrite(fout, data, size) != static_cast<int>(size)) {
+      std::cerr << "Unable to write into " << job.first << std::endl;
+    }
+    gzclose(fout);
+  }
+
+  std::mutex mutex_;
+  std::condition_variable data_ready_cv_;
+  std::condition_variable queue_full_cv_;
+  std::deque<Job> queue_ GUARDED_BY(mutex_);
+  std::string current_filename_ GUARDED_BY(mutex_);
+  int games_in_current_file_ GUARDED_BY(mutex_) = 0;
+  bool stop_ GUARDED_BY(mutex_) = false;
+  std::thread thread_;
+};
+
+}  // namespace
+
+int TrainingDataWriter::GetQueuedGames() { return g_queued_games; }
+
+void TrainingDataWriter::ConfigureCompression(Compression compression) {
+  g_compression = compression;
+}
+
+void TrainingDataWriter::ConfigureGamesPerFile(int games_per_file) {
+  g_games_per_file = games_per_file;
+}
+
+TrainingDataWriter::TrainingDataWriter(int game_id) : game_id_(game_id) {
   static std::string directory =
       CommandLine::BinaryDirectory() + "/data-" + Random::Get().GetString(12);
   // It's fine if it already exists.
   CreateDirectory(directory.c_str());
-
-  std::ostringstream oss;
-  oss << directory << '/' << "game_" << std::setfill('0') << std::setw(6)
-      << game_id << ".gz";
-
-  filename_ = oss.str();
-  fout_ = gzopen(filename_.c_str(), "wb");
-  if (!fout_) throw Exception("Cannot create gzip file " + filename_);
+  filename_ = directory;
 }
 
 void TrainingDataWriter::WriteChunk(const V3TrainingData& data) {
-  auto bytes_written =
-      gzwrite(fout_, reinterpret_cast<const char*>(&data), sizeof(data));
-  if (bytes_written != sizeof(data)) {
-    throw Exception("Unable to write into " + filename_);
-  }
+  game_data_.push_back(data);
 }
 
 void TrainingDataWriter::Finalize() {
-  gzclose(fout_);
-  fout_ = nullptr;
+  filename_ = BackgroundWriter::Get().Schedule(filename_, game_id_,
+                                               std::move(game_data_));
+  finalized_ = true;
 }
 
 }  // namespace lczero
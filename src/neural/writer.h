@@ -16,8 +16,8 @@
   along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <zlib.h>
-#include <fstream>
+#include <string>
+#include <vector>
 #include "utils/cppattributes.h"
 
 #pragma once
@@ -45,26 +45,49 @@ static_assert(sizeof(V3TrainingData) == 8276, "Wrong struct size");
 
 class TrainingDataWriter {
  public:
+  enum class Compression {
+    kGzip,      // Default zlib level, best ratio.
+    kFastGzip,  // Z_BEST_SPEED, when compression competes with inference.
+    kNone,      // Raw records.
+  };
+
+  // Process-wide writer configuration. Not thread safe, call before the
+  // first game finishes.
+  static void ConfigureCompression(Compression compression);
+  // 1 (default) writes one file per game. Larger values append that many
+  // games into one rolling file, named after the first game in it. V3
+  // records are fixed size, and gzip members concatenate into a valid
+  // stream, so readers need no extra framing.
+  static void ConfigureGamesPerFile(int games_per_file);
+
   // Creates a new file to write in data directory. It will has @game_id
   // somewhere in the filename.
   TrainingDataWriter(int game_id);
 
   ~TrainingDataWriter() {
-    if (fout_) Finalize();
+    if (!finalized_) Finalize();
   }
 
-  // Writes a chunk.
+  // Writes a chunk. Only appends to an in-memory buffer; nothing touches the
+  // disk until Finalize().
   void WriteChunk(const V3TrainingData& data);
 
-  // Flushes file and closes it.
+  // Hands the buffered game over to a background thread which compresses it
+  // and writes the file, so game threads never block on disk. The file may
+  // not exist yet when this returns; pending games are flushed at exit.
   void Finalize();
 
-  // Gets full filename of the file written.
+  // Gets full filename of the file written. Only valid after Finalize().
   std::string GetFileName() const { return filename_; }
 
+  // Number of finished games queued behind the background writer thread.
+  static int GetQueuedGames();
+
  private:
+  int game_id_;
   std::string filename_;
-  gzFile fout_;
+  std::vector<V3TrainingData> game_data_;
+  bool finalized_ = false;
 };
 
 }  // namespace lczero
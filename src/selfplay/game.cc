@@ -18,6 +18,7 @@
 
 #include "selfplay/game.h"
 #include <algorithm>
+#include <cmath>
 
 #include "neural/writer.h"
 
@@ -26,12 +27,28 @@ namespace lczero {
 namespace {
 const char* kReuseTreeStr = "Reuse the node statistics between moves";
 const char* kResignPercentageStr = "Resign when win percentage drops below n";
+const char* kAdjudicateWinPctStr = "Adjudicate win when win percentage is above n";
+const char* kAdjudicateDrawPctStr =
+    "Adjudicate draw when win percentage is within n of 50";
+const char* kAdjudicateMovesStr = "Number of consecutive plies to adjudicate";
+const char* kAdjudicateDrawEarliestStr = "Earliest move to adjudicate draw";
 }  // namespace
 
 void SelfPlayGame::PopulateUciParams(OptionsParser* options) {
   options->Add<BoolOption>(kReuseTreeStr, "reuse-tree") = false;
   options->Add<FloatOption>(kResignPercentageStr, 0.0f, 100.0f,
                             "resign-percentage", 'r') = 0.0f;
+  // Adjudication ends games whose outcome the players agree on for
+  // @adjudicate-moves consecutive plies, 0 disables. Like resign it is
+  // skipped in the calibration games (--resign-playthrough), and the
+  // adjudicated result goes into the training data as if played out.
+  options->Add<FloatOption>(kAdjudicateWinPctStr, 0.0f, 100.0f,
+                            "adjudicate-win-percentage") = 0.0f;
+  options->Add<FloatOption>(kAdjudicateDrawPctStr, 0.0f, 50.0f,
+                            "adjudicate-draw-percentage") = 0.0f;
+  options->Add<IntOption>(kAdjudicateMovesStr, 1, 100, "adjudicate-moves") = 8;
+  options->Add<IntOption>(kAdjudicateDrawEarliestStr, 0, 999,
+                          "adjudicate-draw-earliest") = 40;
 }
 
 SelfPlayGame::SelfPlayGame(PlayerOptions player1, PlayerOptions player2,
@@ -75,6 +92,7 @@ void SelfPlayGame::Play(int white_threads, int black_threads,
 
     // Do search.
     search_->RunBlocking(blacks_move ? black_threads : white_threads);
+    UpdatePerfCounters(idx);
     if (abort_) break;
 
     // Append training data. The GameResult is later overwritten.
@@ -84,15 +102,7 @@ void SelfPlayGame::Play(int white_threads, int black_threads,
     float eval = search_->GetBestEval();
     eval = (eval + 1) / 2;
     if (eval < min_eval_[idx]) min_eval_[idx] = eval;
-    if (enable_resign) {
-      const float resignpct =
-          options_[idx].uci_options->Get<float>(kResignPercentageStr) / 100;
-      if (eval < resignpct) {  // always false when resignpct == 0
-        game_result_ =
-            blacks_move ? GameResult::WHITE_WON : GameResult::BLACK_WON;
-        break;
-      }
-    }
+    if (MaybeEndGameEarly(idx, eval, enable_resign)) break;
 
     // Add best move to the tree.
     Move move = search_->GetBestMove().first;
@@ -102,6 +112,124 @@ void SelfPlayGame::Play(int white_threads, int black_threads,
   }
 }
 
+bool SelfPlayGame::StartStep(bool enable_resign,
+                             std::function<void()> on_ready) {
+  if (!worker_) {
+    // No move is being searched: the previous one finished (or this is the
+    // first call). Set up the search for the next move, unless the game is
+    // over. Mirrors the per-move preamble of Play().
+    if (game_result_ != GameResult::UNDECIDED) return false;
+    game_result_ = tree_[0]->GetPositionHistory().ComputeGameResult();
+    if (game_result_ != GameResult::UNDECIDED) return false;
+
+    enable_resign_ = enable_resign;
+    const int idx = blacks_move_ ? 1 : 0;
+    if (!options_[idx].uci_options->Get<bool>(kReuseTreeStr)) {
+      tree_[idx]->TrimTreeAtHead();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (abort_) return false;
+      search_ = std::make_unique<Search>(
+          *tree_[idx], options_[idx].network, options_[idx].best_move_callback,
+          options_[idx].info_callback, options_[idx].search_limits,
+          *options_[idx].uci_options, options_[idx].cache);
+    }
+    worker_ = std::make_unique<SearchWorker>(search_.get());
+  }
+  worker_->BeginAsyncIteration(std::move(on_ready));
+  return true;
+}
+
+void SelfPlayGame::FinishStep() {
+  worker_->CompleteAsyncIteration();
+  // More iterations of the same move to go?
+  if (worker_->IsSearchActive()) return;
+
+  // The search is done: play the move. Mirrors the per-move tail of Play().
+  worker_.reset();
+  const int idx = blacks_move_ ? 1 : 0;
+  UpdatePerfCounters(idx);
+  if (!abort_) {
+    training_data_.push_back(tree_[idx]->GetCurrentHead()->GetV3TrainingData(
+        GameResult::UNDECIDED, tree_[idx]->GetPositionHistory()));
+
+    float eval = search_->GetBestEval();
+    eval = (eval + 1) / 2;
+    if (eval < min_eval_[idx]) min_eval_[idx] = eval;
+    MaybeEndGameEarly(idx, eval, enable_resign_);
+    if (game_result_ == GameResult::UNDECIDED) {
+      Move move = search_->GetBestMove().first;
+      tree_[0]->MakeMove(move);
+      if (tree_[0] != tree_[1]) tree_[1]->MakeMove(move);
+      blacks_move_ = !blacks_move_;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  search_.reset();
+}
+
+bool SelfPlayGame::MaybeEndGameEarly(int idx, float eval, bool enable_resign) {
+  // Calibration games play to the end, so resign false positive rates stay
+  // measurable.
+  if (!enable_resign) return false;
+  const OptionsDict& opts = *options_[idx].uci_options;
+
+  const float resignpct = opts.Get<float>(kResignPercentageStr) / 100;
+  if (eval < resignpct) {  // always false when resignpct == 0
+    game_result_ = idx == 1 ? GameResult::WHITE_WON : GameResult::BLACK_WON;
+    termination_ = "resign";
+    return true;
+  }
+
+  const int plies_needed = opts.Get<int>(kAdjudicateMovesStr);
+  const float winpct = opts.Get<float>(kAdjudicateWinPctStr) / 100;
+  if (winpct > 0.0f) {
+    // The expected winner as seen by the player to move, -1 when the eval is
+    // not decisive. Both players must keep naming the same winner.
+    int winner = -1;
+    if (eval >= winpct) {
+      winner = idx;
+    } else if (eval <= 1.0f - winpct) {
+      winner = 1 - idx;
+    }
+    if (winner >= 0 && winner == adjudication_winner_) {
+      if (++win_streak_ >= plies_needed) {
+        game_result_ =
+            winner == 0 ? GameResult::WHITE_WON : GameResult::BLACK_WON;
+        termination_ = "win_adjudication";
+        return true;
+      }
+    } else {
+      adjudication_winner_ = winner;
+      win_streak_ = winner >= 0 ? 1 : 0;
+    }
+  }
+
+  const float drawpct = opts.Get<float>(kAdjudicateDrawPctStr) / 100;
+  if (drawpct > 0.0f && std::abs(eval - 0.5f) <= drawpct) {
+    const int move_number = tree_[0]->GetPositionHistory().GetLength() / 2;
+    if (++draw_streak_ >= plies_needed &&
+        move_number >= opts.Get<int>(kAdjudicateDrawEarliestStr)) {
+      game_result_ = GameResult::DRAW;
+      termination_ = "draw_adjudication";
+      return true;
+    }
+  } else {
+    draw_streak_ = 0;
+  }
+  return false;
+}
+
+void SelfPlayGame::UpdatePerfCounters(int idx) {
+  SelfPlayPerfCounters* counters = options_[idx].counters;
+  if (!counters) return;
+  counters->moves.fetch_add(1, std::memory_order_relaxed);
+  const WorkerStats stats = search_->GetWorkerStats();
+  counters->nn_evals.fetch_add(stats.cache_misses, std::memory_order_relaxed);
+  counters->nn_batches.fetch_add(stats.batches, std::memory_order_relaxed);
+}
+
 std::vector<Move> SelfPlayGame::GetMoves() const {
   std::vector<Move> moves;
   bool flip = !tree_[0]->IsBlackToMove();
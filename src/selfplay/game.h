@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <atomic>
 #include "chess/position.h"
 #include "chess/uciloop.h"
 #include "mcts/search.h"
@@ -27,6 +28,16 @@
 
 namespace lczero {
 
+// Tournament-wide counters behind the periodic performance samples. Updated
+// by games after every move, read by the tournament's sampler thread.
+struct SelfPlayPerfCounters {
+  std::atomic<int64_t> moves{0};
+  // Positions actually evaluated by the NN (cache misses), and the batches
+  // they were submitted in.
+  std::atomic<int64_t> nn_evals{0};
+  std::atomic<int64_t> nn_batches{0};
+};
+
 struct PlayerOptions {
   // Network to use by the player.
   Network* network;
@@ -40,6 +51,8 @@ struct PlayerOptions {
   const OptionsDict* uci_options;
   // Limits to use for every move.
   SearchLimits search_limits;
+  // Sink for performance counters, may be nullptr.
+  SelfPlayPerfCounters* counters = nullptr;
 };
 
 // Plays a single game vs itself.
@@ -56,6 +69,16 @@ class SelfPlayGame {
 
   // Starts the game and blocks until the game is finished.
   void Play(int white_threads, int black_threads, bool enable_resign=true);
+
+  // Batched stepping interface, the non-blocking alternative to Play().
+  // StartStep() issues one search iteration of the current move; @on_ready
+  // fires (on a backend thread) when its NN results are in, after which the
+  // owner calls FinishStep() from a thread of its own. One thread can thus
+  // interleave steps of many games, and their concurrent NN requests
+  // coalesce into large batches in the backend. Returns false, issuing
+  // nothing, once the game is over (or aborted).
+  bool StartStep(bool enable_resign, std::function<void()> on_ready);
+  void FinishStep();
   // Aborts the game currently played, doesn't matter if it's synchronous or
   // not.
   void Abort();
@@ -64,12 +87,23 @@ class SelfPlayGame {
   void WriteTrainingData(TrainingDataWriter* writer) const;
 
   GameResult GetGameResult() const { return game_result_; }
+  // How the game ended early: "resign", "win_adjudication",
+  // "draw_adjudication", or empty when it was played out.
+  const std::string& GetTermination() const { return termination_; }
   std::vector<Move> GetMoves() const;
   // Gets the eval which required the biggest swing up to get the final outcome.
   // Eval is the expected outcome in the range 0<->1.
   float GetWorstEvalForWinnerOrDraw() const;
 
  private:
+  // Resigns or adjudicates on behalf of player @idx, whose search just ended
+  // with expected score @eval (0..1). Returns true, with game_result_ and
+  // termination_ set, when the game ends early. No-op in calibration games
+  // (@enable_resign false).
+  bool MaybeEndGameEarly(int idx, float eval, bool enable_resign);
+  // Adds the just-finished move's search counters to the perf counter sink.
+  void UpdatePerfCounters(int idx);
+
   // options_[0] is for white player, [1] for black.
   PlayerOptions options_[2];
   // Node tree for player1 and player2. If the tree is shared between players,
@@ -79,8 +113,22 @@ class SelfPlayGame {
   // Search that is currently in progress. Stored in members so that Abort()
   // can stop it.
   std::unique_ptr<Search> search_;
+  // Worker stepping search_, when the game is driven through StartStep().
+  // Doubles as the "a move is being searched" flag of the step state machine.
+  std::unique_ptr<SearchWorker> worker_;
+  // Whose move the stepped game is at.
+  bool blacks_move_ = false;
   bool abort_ = false;
   GameResult game_result_ = GameResult::UNDECIDED;
+  // Whether resign is honored in the stepped game.
+  bool enable_resign_ = true;
+  // Adjudication state: the winner both players most recently agreed on
+  // (0 white, 1 black, -1 none), and for how many consecutive plies.
+  int adjudication_winner_ = -1;
+  int win_streak_ = 0;
+  int draw_streak_ = 0;
+  // See GetTermination().
+  std::string termination_;
   // Track minimum eval for each player so that GetWorstEvalForWinnerOrDraw()
   // can be calculated after end of game.
   float min_eval_[2] = {1.0f, 1.0f};
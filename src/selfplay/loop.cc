@@ -17,6 +17,8 @@
 */
 
 #include "selfplay/loop.h"
+#include <iomanip>
+#include <sstream>
 #include "selfplay/tournament.h"
 
 namespace lczero {
@@ -48,7 +50,8 @@ void SelfPlayLoop::RunLoop() {
         std::bind(&UciLoop::SendBestMove, this, std::placeholders::_1),
         std::bind(&UciLoop::SendInfo, this, std::placeholders::_1),
         std::bind(&SelfPlayLoop::SendGameInfo, this, std::placeholders::_1),
-        std::bind(&SelfPlayLoop::SendTournament, this, std::placeholders::_1));
+        std::bind(&SelfPlayLoop::SendTournament, this, std::placeholders::_1),
+        std::bind(&SelfPlayLoop::SendPerfInfo, this, std::placeholders::_1));
     tournament.RunBlocking();
   }
 }
@@ -69,7 +72,8 @@ void SelfPlayLoop::CmdStart() {
       std::bind(&UciLoop::SendBestMove, this, std::placeholders::_1),
       std::bind(&UciLoop::SendInfo, this, std::placeholders::_1),
       std::bind(&SelfPlayLoop::SendGameInfo, this, std::placeholders::_1),
-      std::bind(&SelfPlayLoop::SendTournament, this, std::placeholders::_1));
+      std::bind(&SelfPlayLoop::SendTournament, this, std::placeholders::_1),
+      std::bind(&SelfPlayLoop::SendPerfInfo, this, std::placeholders::_1));
   thread_ =
       std::make_unique<std::thread>([this]() { tournament_->RunBlocking(); });
 }
@@ -89,6 +93,7 @@ void SelfPlayLoop::SendGameInfo(const GameInfo& info) {
   if (!info.training_filename.empty())
     res += " trainingfile " + info.training_filename;
   if (info.game_id != -1) res += " gameid " + std::to_string(info.game_id);
+  if (!info.termination.empty()) res += " termination " + info.termination;
   if (info.is_black)
     res += " player1 " + std::string(*info.is_black ? "black" : "white");
   if (info.game_result != GameResult::UNDECIDED) {
@@ -112,6 +117,20 @@ void SelfPlayLoop::CmdSetOption(const std::string& name,
   options_.SetOption(name, value, context);
 }
 
+void SelfPlayLoop::SendPerfInfo(const SelfPlayPerfInfo& info) {
+  std::ostringstream oss;
+  oss << "perfstatus";
+  oss << " interval " << std::fixed << std::setprecision(1)
+      << info.interval_seconds;
+  oss << " games_in_flight " << info.games_in_flight;
+  oss << " games " << info.games_finished;
+  oss << " moves_per_sec " << info.moves_per_sec;
+  oss << " nn_evals_per_sec " << info.nn_evals_per_sec;
+  oss << " avg_batch_size " << info.avg_batch_size;
+  oss << " writer_backlog " << info.writer_backlog;
+  SendResponse(oss.str());
+}
+
 void SelfPlayLoop::SendTournament(const TournamentInfo& info) {
   std::string res = "tournamentstatus";
   if (info.finished) res += " final";
@@ -39,6 +39,7 @@ class SelfPlayLoop : public UciLoop {
  private:
   void SendGameInfo(const GameInfo& move);
   void SendTournament(const TournamentInfo& info);
+  void SendPerfInfo(const SelfPlayPerfInfo& info);
 
   void EnsureOptionsSent();
   OptionsParser options_;
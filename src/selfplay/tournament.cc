@@ -17,12 +17,16 @@
 */
 
 #include "selfplay/tournament.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include "mcts/search.h"
 #include "neural/factory.h"
 #include "neural/loader.h"
 #include "selfplay/game.h"
 #include "utils/optionsparser.h"
 #include "utils/random.h"
+#include "utils/slabpool.h"
 
 namespace lczero {
 
@@ -31,17 +35,23 @@ const char* kShareTreesStr = "Share game trees for two players";
 const char* kTotalGamesStr = "Number of games to play";
 const char* kParallelGamesStr = "Number of games to play in parallel";
 const char* kThreadsStr = "Number of CPU threads for every game";
-const char* kNnCacheSizeStr = "NNCache size";
+const char* kGameThreadsStr = "Number of threads stepping batched games";
+const char* kNnCacheSizeStr = "NNCache size MB";
 const char* kNetFileStr = "Network weights file path";
 const char* kPlayoutsStr = "Number of playouts per move to search";
 const char* kVisitsStr = "Number of visits per move to search";
 const char* kTimeMsStr = "Time per move, in milliseconds";
 const char* kTrainingStr = "Write training data";
+const char* kTrainingCompressionStr = "Training data compression";
+const char* kTrainingGamesPerFileStr = "Games per training data file";
 const char* kNnBackendStr = "NN backend to use";
 const char* kNnBackendOptionsStr = "NN backend parameters";
+const char* kNnBackendSpecStr = "NN backend composition spec";
 const char* kVerboseThinkingStr = "Show verbose thinking messages";
 const char* kResignPlaythroughStr =
               "The percentage of games which ignore resign";
+const char* kPerfReportPeriodStr = "Performance report period";
+const char* kTreeMemModeStr = "Memory backing the search tree";
 
 // Value for network autodiscover.
 const char* kAutoDiscover = "<autodiscover>";
@@ -54,21 +64,48 @@ void SelfPlayTournament::PopulateOptions(OptionsParser* options) {
 
   options->Add<BoolOption>(kShareTreesStr, "share-trees") = true;
   options->Add<IntOption>(kTotalGamesStr, -1, 999999, "games") = -1;
-  options->Add<IntOption>(kParallelGamesStr, 1, 256, "parallelism") = 8;
+  options->Add<IntOption>(kParallelGamesStr, 1, 2048, "parallelism") = 8;
   options->Add<IntOption>(kThreadsStr, 1, 8, "threads", 't') = 1;
-  options->Add<IntOption>(kNnCacheSizeStr, 0, 999999999, "nncache") = 200000;
+  // 0 = classic mode, one thread per parallel game. With game-threads set,
+  // that many threads cooperatively step all parallel games instead
+  // (--threads is then ignored), which scales to hundreds of games whose
+  // NN batches aggregate in the backend.
+  options->Add<IntOption>(kGameThreadsStr, 0, 32, "game-threads") = 0;
+  options->Add<IntOption>(kNnCacheSizeStr, 0, 65536, "nncache") = 48;
   options->Add<StringOption>(kNetFileStr, "weights", 'w') = kAutoDiscover;
   options->Add<IntOption>(kPlayoutsStr, -1, 999999999, "playouts", 'p') = -1;
   options->Add<IntOption>(kVisitsStr, -1, 999999999, "visits", 'v') = -1;
   options->Add<IntOption>(kTimeMsStr, -1, 999999999, "movetime") = -1;
   options->Add<BoolOption>(kTrainingStr, "training") = false;
+  // "fast" trades compression ratio for CPU that would otherwise compete
+  // with NN inference; "none" writes raw records.
+  options->Add<ChoiceOption>(kTrainingCompressionStr,
+                             std::vector<std::string>{"gzip", "fast", "none"},
+                             "training-compression") = "gzip";
+  // Values above 1 append that many games into one rolling file, for
+  // filesystems where millions of tiny files hurt metadata performance.
+  options->Add<IntOption>(kTrainingGamesPerFileStr, 1, 999999,
+                          "training-games-per-file") = 1;
   const auto backends = NetworkFactory::Get()->GetBackendsList();
   options->Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
       "multiplexing";
   options->Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+  // When set, overrides --backend/--backend-opts with a composition spec,
+  // see NetworkFactory::CreateFromSpec.
+  options->Add<StringOption>(kNnBackendSpecStr, "backend-spec");
   options->Add<BoolOption>(kVerboseThinkingStr, "verbose-thinking") = false;
   options->Add<FloatOption>(kResignPlaythroughStr, 0.0f, 100.0f,
                             "resign-playthrough") = 0.0f;
+  // Emit a machine readable performance sample (moves/s, NN evals/s, batch
+  // size, writer backlog) every that many seconds; 0 turns them off.
+  options->Add<IntOption>(kPerfReportPeriodStr, 0, 3600,
+                          "perf-report-period") = 0;
+  // How node/edge slabs are allocated, see SlabPool::MemoryMode. The
+  // huge-page modes help on NUMA machines; Linux only.
+  options->Add<ChoiceOption>(
+      kTreeMemModeStr,
+      std::vector<std::string>{"malloc", "huge-pages", "huge-pages-interleave"},
+      "tree-mem-mode", '\0', SlabPool::SetMemoryModeByName) = "malloc";
 
   Search::PopulateUciParams(options);
   SelfPlayGame::PopulateUciParams(options);
@@ -84,13 +121,15 @@ SelfPlayTournament::SelfPlayTournament(const OptionsDict& options,
                                        BestMoveInfo::Callback best_move_info,
                                        ThinkingInfo::Callback thinking_info,
                                        GameInfo::Callback game_info,
-                                       TournamentInfo::Callback tournament_info)
+                                       TournamentInfo::Callback tournament_info,
+                                       SelfPlayPerfInfo::Callback perf_info)
     : player_options_{options.GetSubdict("player1"),
                       options.GetSubdict("player2")},
       best_move_callback_(best_move_info),
       info_callback_(thinking_info),
       game_callback_(game_info),
       tournament_callback_(tournament_info),
+      perf_callback_(perf_info),
       kThreads{
           options.GetSubdict("player1").Get<int>(kThreadsStr),
           options.GetSubdict("player2").Get<int>(kThreadsStr),
@@ -98,13 +137,30 @@ SelfPlayTournament::SelfPlayTournament(const OptionsDict& options,
       kTotalGames(options.Get<int>(kTotalGamesStr)),
       kShareTree(options.Get<bool>(kShareTreesStr)),
       kParallelism(options.Get<int>(kParallelGamesStr)),
+      kGameThreads(options.Get<int>(kGameThreadsStr)),
       kTraining(options.Get<bool>(kTrainingStr)),
-      kResignPlaythrough(options.Get<float>(kResignPlaythroughStr)) {
+      kResignPlaythrough(options.Get<float>(kResignPlaythroughStr)),
+      kPerfReportPeriod(options.Get<int>(kPerfReportPeriodStr)) {
+  if (kPerfReportPeriod > 0 && perf_callback_) {
+    perf_thread_ = std::thread([this]() { PerfSampler(); });
+  }
   // If playing just one game, the player1 is white, otherwise randomize.
   if (kTotalGames != 1) {
     next_game_black_ = Random::Get().GetBool();
   }
 
+  if (kTraining) {
+    const std::string compression =
+        options.Get<std::string>(kTrainingCompressionStr);
+    TrainingDataWriter::ConfigureCompression(
+        compression == "none"
+            ? TrainingDataWriter::Compression::kNone
+            : compression == "fast" ? TrainingDataWriter::Compression::kFastGzip
+                                    : TrainingDataWriter::Compression::kGzip);
+    TrainingDataWriter::ConfigureGamesPerFile(
+        options.Get<int>(kTrainingGamesPerFileStr));
+  }
+
   static const char* kPlayerNames[2] = {"player1", "player2"};
   // Initializing networks.
   for (int idx : {0, 1}) {
@@ -112,7 +168,8 @@ SelfPlayTournament::SelfPlayTournament(const OptionsDict& options,
     if (idx == 1) {
       bool network_identical = true;
       for (const auto& option_str :
-           {kNetFileStr, kNnBackendStr, kNnBackendOptionsStr}) {
+           {kNetFileStr, kNnBackendStr, kNnBackendOptionsStr,
+            kNnBackendSpecStr}) {
         if (options.GetSubdict("player1").Get<std::string>(option_str) !=
             options.GetSubdict("player2").Get<std::string>(option_str)) {
           network_identical = false;
@@ -136,21 +193,35 @@ SelfPlayTournament::SelfPlayTournament(const OptionsDict& options,
     std::string backend_options = options.GetSubdict(kPlayerNames[idx])
                                       .Get<std::string>(kNnBackendOptionsStr);
 
-    OptionsDict network_options = OptionsDict::FromString(
-        backend_options, &options.GetSubdict(kPlayerNames[idx]));
-
-    networks_[idx] =
-        NetworkFactory::Get()->Create(backend, weights, network_options);
+    const std::string backend_spec =
+        options.GetSubdict(kPlayerNames[idx]).Get<std::string>(kNnBackendSpecStr);
+    if (!backend_spec.empty()) {
+      networks_[idx] = NetworkFactory::Get()->CreateFromSpec(
+          backend_spec, weights, &options.GetSubdict(kPlayerNames[idx]));
+    } else {
+      OptionsDict network_options = OptionsDict::FromString(
+          backend_options, &options.GetSubdict(kPlayerNames[idx]));
+
+      networks_[idx] =
+          NetworkFactory::Get()->Create(backend, weights, network_options);
+    }
   }
 
-  // Initializing cache.
+  // Initializing cache. The cache spans the whole tournament, so openings
+  // replayed across games hit it; when both players run the same network
+  // (the usual Elo match setup) they also share one cache, as their
+  // evaluations are interchangeable.
   cache_[0] = std::make_shared<NNCache>(
-      options.GetSubdict("player1").Get<int>(kNnCacheSizeStr));
-  if (kShareTree) {
+      static_cast<int64_t>(
+          options.GetSubdict("player1").Get<int>(kNnCacheSizeStr)) *
+      1024 * 1024);
+  if (kShareTree || networks_[0] == networks_[1]) {
     cache_[1] = cache_[0];
   } else {
     cache_[1] = std::make_shared<NNCache>(
-        options.GetSubdict("player2").Get<int>(kNnCacheSizeStr));
+        static_cast<int64_t>(
+            options.GetSubdict("player2").Get<int>(kNnCacheSizeStr)) *
+        1024 * 1024);
   }
 
   // SearchLimits.
@@ -193,6 +264,7 @@ void SelfPlayTournament::PlayOneGame(int game_number) {
     opt.cache = cache_[pl_idx].get();
     opt.uci_options = &player_options_[pl_idx];
     opt.search_limits = search_limits_[pl_idx];
+    opt.counters = &perf_counters_;
 
     // "bestmove" callback.
     opt.best_move_callback = [this, game_number, pl_idx, player1_black,
@@ -252,6 +324,7 @@ void SelfPlayTournament::PlayOneGame(int game_number) {
     game_info.is_black = player1_black;
     game_info.game_id = game_number;
     game_info.moves = game.GetMoves();
+    game_info.termination = game.GetTermination();
     if (!enable_resign) {
       game_info.min_false_positive_threshold =
           game.GetWorstEvalForWinnerOrDraw();
@@ -282,6 +355,191 @@ void SelfPlayTournament::PlayOneGame(int game_number) {
   }
 }
 
+void SelfPlayTournament::RunBatched() {
+  // One slot per concurrent game. Slot addresses are stable: the info
+  // callbacks buffer into them, and the backend requeues them by pointer.
+  struct Slot {
+    std::list<std::unique_ptr<SelfPlayGame>>::iterator game_iter;
+    bool has_game = false;
+    // Set (under the queue mutex) when the slot's NN results arrived and
+    // FinishStep() is due.
+    bool step_in_flight = false;
+    int game_number;
+    bool player1_black;
+    bool enable_resign;
+    PlayerOptions options[2];
+    ThinkingInfo last_thinking_info;
+  };
+
+  std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  std::deque<Slot*> ready;
+  size_t live_slots = 0;
+
+  // Starts a new game in @slot. Mirrors the setup part of PlayOneGame().
+  auto start_game = [this](Slot* slot) {
+    {
+      Mutex::Lock lock(mutex_);
+      slot->game_number = games_count_++;
+      slot->player1_black = next_game_black_;
+      next_game_black_ = !next_game_black_;
+    }
+    const bool player1_black = slot->player1_black;
+    const int game_number = slot->game_number;
+    const int color_idx[2] = {player1_black ? 1 : 0, player1_black ? 0 : 1};
+    slot->last_thinking_info.depth = -1;
+
+    for (int pl_idx : {0, 1}) {
+      const bool verbose_thinking =
+          player_options_[pl_idx].Get<bool>(kVerboseThinkingStr);
+      PlayerOptions& opt = slot->options[color_idx[pl_idx]];
+      opt.network = networks_[pl_idx].get();
+      opt.cache = cache_[pl_idx].get();
+      opt.uci_options = &player_options_[pl_idx];
+      opt.search_limits = search_limits_[pl_idx];
+      opt.counters = &perf_counters_;
+      opt.best_move_callback = [this, game_number, pl_idx, player1_black,
+                                verbose_thinking, slot](const BestMoveInfo& info) {
+        if (!verbose_thinking && slot->last_thinking_info.depth >= 0) {
+          info_callback_(slot->last_thinking_info);
+          slot->last_thinking_info.depth = -1;
+        }
+        BestMoveInfo rich_info = info;
+        rich_info.player = pl_idx + 1;
+        rich_info.is_black = player1_black ? pl_idx == 0 : pl_idx != 0;
+        rich_info.game_id = game_number;
+        best_move_callback_(rich_info);
+      };
+      opt.info_callback = [this, game_number, pl_idx, player1_black,
+                           verbose_thinking, slot](const ThinkingInfo& info) {
+        ThinkingInfo rich_info = info;
+        rich_info.player = pl_idx + 1;
+        rich_info.is_black = player1_black ? pl_idx == 0 : pl_idx != 0;
+        rich_info.game_id = game_number;
+        if (verbose_thinking) {
+          info_callback_(rich_info);
+        } else {
+          slot->last_thinking_info = rich_info;
+        }
+      };
+    }
+
+    {
+      Mutex::Lock lock(mutex_);
+      games_.emplace_front(std::make_unique<SelfPlayGame>(
+          slot->options[0], slot->options[1], kShareTree));
+      slot->game_iter = games_.begin();
+    }
+    slot->enable_resign =
+        Random::Get().GetFloat(100.0f) >= kResignPlaythrough;
+    slot->has_game = true;
+  };
+
+  // Reports a finished game and releases it. Mirrors the tail of
+  // PlayOneGame().
+  auto finish_game = [this](Slot* slot) {
+    auto& game = **slot->game_iter;
+    if (game.GetGameResult() != GameResult::UNDECIDED) {
+      GameInfo game_info;
+      game_info.game_result = game.GetGameResult();
+      game_info.is_black = slot->player1_black;
+      game_info.game_id = slot->game_number;
+      game_info.moves = game.GetMoves();
+      game_info.termination = game.GetTermination();
+      if (!slot->enable_resign) {
+        game_info.min_false_positive_threshold =
+            game.GetWorstEvalForWinnerOrDraw();
+      }
+      if (kTraining) {
+        TrainingDataWriter writer(slot->game_number);
+        game.WriteTrainingData(&writer);
+        writer.Finalize();
+        game_info.training_filename = writer.GetFileName();
+      }
+      game_callback_(game_info);
+
+      Mutex::Lock lock(mutex_);
+      int result = game.GetGameResult() == GameResult::DRAW
+                       ? 1
+                       : game.GetGameResult() == GameResult::WHITE_WON ? 0 : 2;
+      if (slot->player1_black) result = 2 - result;
+      ++tournament_info_.results[result][slot->player1_black ? 1 : 0];
+      tournament_callback_(tournament_info_);
+    }
+    {
+      Mutex::Lock lock(mutex_);
+      games_.erase(slot->game_iter);
+    }
+    slot->has_game = false;
+  };
+
+  auto stepper = [&]() {
+    while (true) {
+      Slot* slot;
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_cv.wait(lock, [&] { return !ready.empty() || live_slots == 0; });
+        if (ready.empty()) return;
+        slot = ready.front();
+        ready.pop_front();
+      }
+
+      if (!slot->has_game) {
+        bool start_new;
+        {
+          Mutex::Lock lock(mutex_);
+          start_new =
+              !abort_ && (kTotalGames == -1 || games_count_ < kTotalGames);
+        }
+        if (!start_new) {
+          // Retire the slot; the last one going wakes everybody to exit.
+          std::lock_guard<std::mutex> lock(queue_mutex);
+          if (--live_slots == 0) queue_cv.notify_all();
+          continue;
+        }
+        start_game(slot);
+      } else if (slot->step_in_flight) {
+        slot->step_in_flight = false;
+        (*slot->game_iter)->FinishStep();
+      }
+
+      if ((*slot->game_iter)
+              ->StartStep(slot->enable_resign, [&queue_mutex, &queue_cv,
+                                                &ready, slot]() {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                slot->step_in_flight = true;
+                ready.push_back(slot);
+                queue_cv.notify_one();
+              })) {
+        // NN request in flight; the callback requeues the slot.
+        continue;
+      }
+
+      // Game over. Report it and requeue the slot for a fresh game.
+      finish_game(slot);
+      {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        ready.push_back(slot);
+        queue_cv.notify_one();
+      }
+    }
+  };
+
+  std::vector<std::unique_ptr<Slot>> slots;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    for (size_t i = 0; i < kParallelism; ++i) {
+      slots.push_back(std::make_unique<Slot>());
+      ready.push_back(slots.back().get());
+    }
+    live_slots = kParallelism;
+  }
+
+  std::vector<std::thread> steppers;
+  for (int i = 0; i < kGameThreads; ++i) steppers.emplace_back(stepper);
+  for (auto& thread : steppers) thread.join();
+}
+
 void SelfPlayTournament::Worker() {
   // Play games while game limit is not reached (or while not aborted).
   while (true) {
@@ -298,13 +556,18 @@ void SelfPlayTournament::Worker() {
 
 void SelfPlayTournament::StartAsync() {
   Mutex::Lock lock(threads_mutex_);
+  if (kGameThreads > 0) {
+    // Batched mode: a single coordinator thread runs the whole tournament.
+    if (threads_.empty()) threads_.emplace_back([&]() { RunBatched(); });
+    return;
+  }
   while (threads_.size() < kParallelism) {
     threads_.emplace_back([&]() { Worker(); });
   }
 }
 
 void SelfPlayTournament::RunBlocking() {
-  if (kParallelism == 1) {
+  if (kParallelism == 1 && kGameThreads == 0) {
     // No need for multiple threads if there is one worker.
     Worker();
     Mutex::Lock lock(mutex_);
@@ -335,6 +598,54 @@ void SelfPlayTournament::Wait() {
   }
 }
 
+void SelfPlayTournament::PerfSampler() {
+  auto last_sample = std::chrono::steady_clock::now();
+  int64_t last_moves = 0;
+  int64_t last_evals = 0;
+  int64_t last_batches = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(perf_mutex_);
+      perf_cv_.wait_for(lock, std::chrono::seconds(kPerfReportPeriod),
+                        [this]() { return perf_stop_; });
+      if (perf_stop_) return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const float seconds =
+        std::chrono::duration<float>(now - last_sample).count();
+    last_sample = now;
+    const int64_t moves = perf_counters_.moves.load(std::memory_order_relaxed);
+    const int64_t evals =
+        perf_counters_.nn_evals.load(std::memory_order_relaxed);
+    const int64_t batches =
+        perf_counters_.nn_batches.load(std::memory_order_relaxed);
+
+    SelfPlayPerfInfo info;
+    info.interval_seconds = seconds;
+    if (seconds > 0.0f) {
+      info.moves_per_sec = (moves - last_moves) / seconds;
+      info.nn_evals_per_sec = (evals - last_evals) / seconds;
+    }
+    if (batches > last_batches) {
+      info.avg_batch_size =
+          static_cast<float>(evals - last_evals) / (batches - last_batches);
+    }
+    info.writer_backlog = TrainingDataWriter::GetQueuedGames();
+    {
+      Mutex::Lock lock(mutex_);
+      info.games_in_flight = games_.size();
+      for (const auto& row : tournament_info_.results) {
+        info.games_finished += row[0] + row[1];
+      }
+    }
+    last_moves = moves;
+    last_evals = evals;
+    last_batches = batches;
+    perf_callback_(info);
+  }
+}
+
 void SelfPlayTournament::Abort() {
   Mutex::Lock lock(mutex_);
   abort_ = true;
@@ -345,6 +656,14 @@ void SelfPlayTournament::Abort() {
 SelfPlayTournament::~SelfPlayTournament() {
   Abort();
   Wait();
+  if (perf_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(perf_mutex_);
+      perf_stop_ = true;
+    }
+    perf_cv_.notify_all();
+    perf_thread_.join();
+  }
 }
 
 }  // namespace lczero
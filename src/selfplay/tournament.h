@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <list>
 #include "selfplay/game.h"
 #include "utils/mutex.h"
@@ -33,7 +34,8 @@ class SelfPlayTournament {
                      BestMoveInfo::Callback best_move_info,
                      ThinkingInfo::Callback thinking_info,
                      GameInfo::Callback game_info,
-                     TournamentInfo::Callback tournament_info);
+                     TournamentInfo::Callback tournament_info,
+                     SelfPlayPerfInfo::Callback perf_info = {});
 
   // Populate command line options that it uses.
   static void PopulateOptions(OptionsParser* options);
@@ -56,6 +58,14 @@ class SelfPlayTournament {
  private:
   void Worker();
   void PlayOneGame(int game_id);
+  // Batched mode (game-threads > 0): steps kParallelism concurrent games
+  // from kGameThreads threads through SelfPlayGame::StartStep/FinishStep,
+  // so that the games' NN requests coalesce into large backend batches.
+  // Runs on a single coordinator thread and blocks until all games finish.
+  void RunBatched();
+  // Periodically samples the perf counters and publishes the deltas through
+  // perf_callback_. Runs on its own thread when a report period is set.
+  void PerfSampler();
 
   Mutex mutex_;
   // Whether next game will be black for player1.
@@ -84,12 +94,24 @@ class SelfPlayTournament {
   ThinkingInfo::Callback info_callback_;
   GameInfo::Callback game_callback_;
   TournamentInfo::Callback tournament_callback_;
+  SelfPlayPerfInfo::Callback perf_callback_;
+
+  // Performance telemetry. The counters are fed by all games; the sampler
+  // thread turns them into periodic rate reports.
+  SelfPlayPerfCounters perf_counters_;
+  std::mutex perf_mutex_;
+  std::condition_variable perf_cv_;
+  bool perf_stop_ = false;
+  std::thread perf_thread_;
   const int kThreads[2];
   const int kTotalGames;
   const bool kShareTree;
   const size_t kParallelism;
+  const int kGameThreads;
   const bool kTraining;
   const float kResignPlaythrough;
+  // Seconds between performance samples, 0 disables them.
+  const int kPerfReportPeriod;
 };
 
 }  // namespace lczero
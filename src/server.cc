@@ -0,0 +1,161 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server.h"
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "neural/autotune.h"
+#include "neural/cache.h"
+#include "neural/factory.h"
+#include "neural/loader.h"
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+const char* kNetFileStr = "Network weights file path";
+const char* kNnBackendStr = "NN backend to use";
+const char* kNnBackendOptionsStr = "NN backend parameters";
+const char* kNnBackendSpecStr = "NN backend composition spec";
+const char* kNnCacheSizeStr = "Shared NNCache size MB";
+const char* kMiniBatchSizeStr = "Minibatch size for NN inference";
+
+// Value for network autodiscover.
+const char* kAutoDiscover = "<autodiscover>";
+
+// One user's engine, reading nothing itself: the server feeds it parsed
+// lines through ProcessCommand() and its output goes through the usual
+// UciLoop path with the session id prepended. Searches run on their own
+// threads; the output mutex inside UciLoop keeps lines from different
+// sessions from interleaving.
+class Session : public EngineLoop {
+ public:
+  Session(const std::string& id, Network* network, NNCache* cache,
+          int minibatch_size)
+      : id_(id) {
+    engine_.SetSharedContext(network, cache, minibatch_size);
+  }
+
+  void SendResponses(const std::vector<std::string>& responses) override {
+    std::vector<std::string> prefixed;
+    prefixed.reserve(responses.size());
+    for (const auto& response : responses) {
+      prefixed.push_back(id_ + " " + response);
+    }
+    UciLoop::SendResponses(prefixed);
+  }
+
+ private:
+  const std::string id_;
+};
+}  // namespace
+
+AnalysisServer::AnalysisServer() {
+  options_.Add<StringOption>(kNetFileStr, "weights", 'w') = kAutoDiscover;
+  const auto backends = NetworkFactory::Get()->GetBackendsList();
+  options_.Add<ChoiceOption>(kNnBackendStr, backends, "backend") =
+      backends.empty() ? "<none>" : backends[0];
+  options_.Add<StringOption>(kNnBackendOptionsStr, "backend-opts");
+  // When set, overrides --backend/--backend-opts with a composition spec,
+  // see NetworkFactory::CreateFromSpec.
+  options_.Add<StringOption>(kNnBackendSpecStr, "backend-spec");
+  // The cache is shared by every session, so the single-engine default
+  // would be tight for an analysis box full of users.
+  options_.Add<IntOption>(kNnCacheSizeStr, 0, 65536, "nncache") = 256;
+  // 0 means autotune against the shared backend at startup; the result is
+  // injected into every session.
+  options_.Add<IntOption>(kMiniBatchSizeStr, 0, 1024, "minibatch-size") = 0;
+}
+
+void AnalysisServer::RunLoop() {
+  std::cout.setf(std::ios::unitbuf);
+  if (!options_.ProcessAllFlags()) return;
+  const OptionsDict& option_dict = options_.GetOptionsDict();
+
+  std::string net_path = option_dict.Get<std::string>(kNetFileStr);
+  if (net_path == kAutoDiscover) net_path = DiscoverWeightsFile();
+  Weights weights = LoadWeightsFromFile(net_path);
+
+  // Sessions search concurrently against the one backend, so unless the
+  // user composed their own spec, wrap the chosen backend in the
+  // multiplexer to batch and serialize their requests properly.
+  std::string backend_spec = option_dict.Get<std::string>(kNnBackendSpecStr);
+  if (backend_spec.empty()) {
+    const std::string backend_options =
+        option_dict.Get<std::string>(kNnBackendOptionsStr);
+    backend_spec = "mux(" + option_dict.Get<std::string>(kNnBackendStr) +
+                   (backend_options.empty() ? "" : "(" + backend_options + ")") +
+                   ")";
+  }
+  std::unique_ptr<Network> network =
+      NetworkFactory::Get()->CreateFromSpec(backend_spec, weights, &option_dict);
+
+  // Warm up and (optionally) probe the batch size once, for all sessions.
+  {
+    auto computation = network->NewComputation();
+    computation->AddInput(InputPlanes(kInputPlanes));
+    computation->ComputeBlocking();
+  }
+  int minibatch_size = option_dict.Get<int>(kMiniBatchSizeStr);
+  if (minibatch_size == 0) {
+    minibatch_size = AutotuneMiniBatchSize(network.get());
+    std::cerr << "Autotuned minibatch size " << minibatch_size << "."
+              << std::endl;
+  }
+
+  NNCache cache;
+  cache.SetCapacity(static_cast<int64_t>(option_dict.Get<int>(kNnCacheSizeStr)) *
+                    1024 * 1024);
+
+  // Declared after the network and the cache so that every session (and any
+  // search it still owns) is destroyed before the resources it borrows.
+  std::map<std::string, std::unique_ptr<Session>> sessions;
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream iss(line);
+    std::string id;
+    iss >> id >> std::ws;
+    if (id.empty()) continue;
+    if (id == "quit") break;
+    std::string command;
+    std::getline(iss, command);
+    // An id alone is not worth creating a session over.
+    if (command.empty()) continue;
+
+    auto iter = sessions.find(id);
+    if (iter == sessions.end()) {
+      iter = sessions
+                 .emplace(id, std::make_unique<Session>(
+                                  id, network.get(), &cache, minibatch_size))
+                 .first;
+    }
+    // ProcessCommand returns false after "quit": for a session that only
+    // means this session is done.
+    if (!iter->second->ProcessCommand(command)) sessions.erase(iter);
+  }
+}
+
+}  // namespace lczero
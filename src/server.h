@@ -0,0 +1,49 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "utils/optionsparser.h"
+
+namespace lczero {
+
+// Hosts several independent UCI engine sessions in one process, all sharing
+// one set of loaded weights, one (muxed) backend and one NN cache. N users
+// analyzing through N engine processes pay N times for weights, GPU context
+// and cache; here they pay once, and popular openings hit the shared cache
+// across users.
+//
+// The wire protocol multiplexes plain UCI over stdin/stdout: every input
+// line is "<session-id> <uci command>", where the id is any token without
+// whitespace, and every output line is prefixed with the id of the session
+// that produced it. A session is created the first time its id is seen;
+// "<session-id> quit" destroys that session, a bare "quit" stops the
+// server.
+class AnalysisServer {
+ public:
+  AnalysisServer();
+
+  // Parses command line flags, loads the shared network and serves
+  // sessions. Blocks until "quit".
+  void RunLoop();
+
+ private:
+  OptionsParser options_;
+};
+
+}  // namespace lczero
@@ -0,0 +1,1197 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The table format and probing algorithm follow Ronald de Man's tbcore
+// reference code (https://github.com/syzygy1/tb). Positions are mapped to
+// a dense index (kings first with symmetry folding, then like pieces as
+// combinations), and the index is looked up in a canonical-Huffman-coded
+// stream of (recursively paired) symbols. Comments below mostly explain
+// how the structures map onto the file layout; for the why, see the
+// reference code and its documentation.
+
+#include "syzygy/syzygy.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "utils/hashcat.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lczero {
+namespace {
+
+const uint8_t kWdlMagic[4] = {0x71, 0xe8, 0x23, 0x5d};
+
+// Piece codes as used inside table files. Black pieces are code|8.
+enum : int {
+  kPawn = 1,
+  kKnight = 2,
+  kBishop = 3,
+  kRook = 4,
+  kQueen = 5,
+  kKing = 6,
+};
+
+// ---------------------------------------------------------------------------
+// Static index tables.
+// ---------------------------------------------------------------------------
+
+// Folds a king square into one of 10 classes of the a1-d1-d4 triangle
+// (values 0-5 off the a1-h8 diagonal, 6-9 on it).
+const uint8_t kTriangle[64] = {
+    6, 0, 1, 2, 2, 1, 0, 6,  //
+    0, 7, 3, 4, 4, 3, 7, 0,  //
+    1, 3, 8, 5, 5, 8, 3, 1,  //
+    2, 4, 5, 9, 9, 5, 4, 2,  //
+    2, 4, 5, 9, 9, 5, 4, 2,  //
+    1, 3, 8, 5, 5, 8, 3, 1,  //
+    0, 7, 3, 4, 4, 3, 7, 0,  //
+    6, 0, 1, 2, 2, 1, 0, 6,
+};
+
+// Representative square for each triangle class.
+const uint8_t kInvTriangle[10] = {1, 2, 3, 10, 11, 19, 0, 9, 18, 27};
+
+// Index along the a1-h8 diagonal (0-7); 8-15 are the a8-h1 diagonal.
+const uint8_t kDiag[64] = {
+    0,  0, 0,  0,  0,  0,  0,  8,  //
+    0,  1, 0,  0,  0,  0,  9,  0,  //
+    0,  0, 2,  0,  0,  10, 0,  0,  //
+    0,  0, 0,  3,  11, 0,  0,  0,  //
+    0,  0, 0,  12, 4,  0,  0,  0,  //
+    0,  0, 13, 0,  0,  5,  0,  0,  //
+    0,  14, 0, 0,  0,  0,  6,  0,  //
+    15, 0, 0,  0,  0,  0,  0,  7,
+};
+
+// Sign of (rank - file): 0 on the a1-h8 diagonal, positive below-left of it.
+const int8_t kOffDiag[64] = {
+    0, -1, -1, -1, -1, -1, -1, -1,  //
+    1, 0,  -1, -1, -1, -1, -1, -1,  //
+    1, 1,  0,  -1, -1, -1, -1, -1,  //
+    1, 1,  1,  0,  -1, -1, -1, -1,  //
+    1, 1,  1,  1,  0,  -1, -1, -1,  //
+    1, 1,  1,  1,  1,  0,  -1, -1,  //
+    1, 1,  1,  1,  1,  1,  0,  -1,  //
+    1, 1,  1,  1,  1,  1,  1,  0,
+};
+
+// Dense index of the diagonal-and-below triangle (28 + rank on the
+// diagonal, 0-27 column-major off it).
+const uint8_t kLower[64] = {
+    28, 0,  1,  2,  3,  4,  5,  6,   //
+    0,  29, 7,  8,  9,  10, 11, 12,  //
+    1,  7,  30, 13, 14, 15, 16, 17,  //
+    2,  8,  13, 31, 18, 19, 20, 21,  //
+    3,  9,  14, 18, 32, 22, 23, 24,  //
+    4,  10, 15, 19, 22, 33, 25, 26,  //
+    5,  11, 16, 20, 23, 25, 34, 27,  //
+    6,  12, 17, 21, 24, 26, 27, 35,
+};
+
+// Index of a leading pawn folded to files a-d, file-major (a2=0 .. d7=23).
+const uint8_t kFlap[64] = {
+    0, 0,  0,  0,  0,  0,  0,  0,  //
+    0, 6,  12, 18, 18, 12, 6,  0,  //
+    1, 7,  13, 19, 19, 13, 7,  1,  //
+    2, 8,  14, 20, 20, 14, 8,  2,  //
+    3, 9,  15, 21, 21, 15, 9,  3,  //
+    4, 10, 16, 22, 22, 16, 10, 4,  //
+    5, 11, 17, 23, 23, 17, 11, 5,  //
+    0, 0,  0,  0,  0,  0,  0,  0,
+};
+
+// Ordering of pawn squares for the non-leading pawns of the leading color
+// (higher value = "earlier" pawn; advanced central pawns come last).
+const uint8_t kPtwist[64] = {
+    0,  0,  0,  0,  0,  0,  0,  0,   //
+    47, 35, 23, 11, 10, 22, 34, 46,  //
+    45, 33, 21, 9,  8,  20, 32, 44,  //
+    43, 31, 19, 7,  6,  18, 30, 42,  //
+    41, 29, 17, 5,  4,  16, 28, 40,  //
+    39, 27, 15, 3,  2,  14, 26, 38,  //
+    37, 25, 13, 1,  0,  12, 24, 36,  //
+    0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+// Inverse of kFlap for files a-d.
+const uint8_t kInvFlap[24] = {
+    8,  16, 24, 32, 40, 48,  //
+    9,  17, 25, 33, 41, 49,  //
+    10, 18, 26, 34, 42, 50,  //
+    11, 19, 27, 35, 43, 51,
+};
+
+const uint8_t kFileToFile[8] = {0, 1, 2, 3, 3, 2, 1, 0};
+
+// Computed once at startup (first SyzygyTablebase construction).
+uint8_t kFlipDiag[64];
+// kBinomial[k][n] = C(n, k+1).
+int kBinomial[5][64];
+// For t+1 leading pawns: index of the first position with the lead pawn on
+// the given kFlap square, and the position count per lead-pawn file.
+int kPawnIdx[5][24];
+int kPFactor[5][4];
+// Index of the two-kings arrangement: kKkIdx[kTriangle[wk]][bk], -1 for
+// arrangements that are illegal or canonicalized away. 462 valid entries.
+int16_t kKkIdx[10][64];
+
+bool KingsAdjacent(int a, int b) {
+  const int rank_diff = std::abs((a >> 3) - (b >> 3));
+  const int file_diff = std::abs((a & 7) - (b & 7));
+  return rank_diff <= 1 && file_diff <= 1;
+}
+
+void InitIndices() {
+  for (int sq = 0; sq < 64; ++sq) {
+    kFlipDiag[sq] = ((sq >> 3) | (sq << 3)) & 0x3f;
+  }
+
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 64; ++j) {
+      int64_t numerator = j;
+      int64_t denominator = 1;
+      for (int k = 1; k <= i; ++k) {
+        numerator *= j - k;
+        denominator *= k + 1;
+      }
+      kBinomial[i][j] = static_cast<int>(numerator / denominator);
+    }
+  }
+
+  for (int i = 0; i < 5; ++i) {
+    int j = 0;
+    for (int file = 0; file < 4; ++file) {
+      int s = 0;
+      for (; j < 6 * (file + 1); ++j) {
+        kPawnIdx[i][j] = s;
+        s += (i == 0) ? 1 : kBinomial[i - 1][kPtwist[kInvFlap[j]]];
+      }
+      kPFactor[i][file] = s;
+    }
+  }
+
+  // Number the valid king pairs sequentially, white king running through
+  // the 10 triangle representatives, black king through all squares. When
+  // the white king is on the diagonal, the black king is canonicalized to
+  // the diagonal-or-below half.
+  int count = 0;
+  for (int i = 0; i < 10; ++i) {
+    const int wk = kInvTriangle[i];
+    for (int bk = 0; bk < 64; ++bk) {
+      if (KingsAdjacent(wk, bk) || (i >= 6 && kOffDiag[bk] > 0)) {
+        kKkIdx[i][bk] = -1;
+      } else {
+        kKkIdx[i][bk] = count++;
+      }
+    }
+  }
+}
+
+std::once_flag indices_once;
+
+// ---------------------------------------------------------------------------
+// Low-level helpers. Table data is memory-mapped, so all multi-byte reads
+// go through memcpy (no alignment guarantees).
+// ---------------------------------------------------------------------------
+
+uint16_t ReadLe16(const uint8_t* p) {
+  uint16_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+  uint32_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+// The Huffman code stream is stored big-endian.
+uint64_t ReadBe64(const uint8_t* p) {
+  uint64_t x;
+  std::memcpy(&x, p, sizeof(x));
+#ifdef _MSC_VER
+  return _byteswap_uint64(x);
+#else
+  return __builtin_bswap64(x);
+#endif
+}
+
+uint32_t ReadBe32(const uint8_t* p) {
+  uint32_t x;
+  std::memcpy(&x, p, sizeof(x));
+#ifdef _MSC_VER
+  return _byteswap_ulong(x);
+#else
+  return __builtin_bswap32(x);
+#endif
+}
+
+// C(n, k).
+uint64_t Subfactor(int k, int n) {
+  uint64_t numerator = n;
+  uint64_t denominator = 1;
+  for (int i = 1; i < k; ++i) {
+    numerator *= n - i;
+    denominator *= i + 1;
+  }
+  return numerator / denominator;
+}
+
+// Material keys. The board is always probed from the side to move's
+// perspective ("ours" plays white); colors are swapped via the second key.
+uint64_t MaterialKey(const int* pcs) {
+  uint64_t key = 0;
+  for (int i = 1; i < 16; ++i) {
+    key = HashCat(key, static_cast<uint64_t>((i << 8) | pcs[i]));
+  }
+  return key;
+}
+
+BitBoard PiecesByType(const ChessBoard& board, int type, bool black) {
+  const BitBoard side = black ? board.theirs() : board.ours();
+  switch (type) {
+    case kPawn:
+      return board.pawns() * side;
+    case kKnight:
+      return black ? board.their_knights() : board.our_knights();
+    case kBishop:
+      return board.bishops() * side;
+    case kRook:
+      return board.rooks() * side;
+    case kQueen:
+      return board.queens() * side;
+    case kKing:
+      return black ? board.their_king() : board.our_king();
+  }
+  return BitBoard();
+}
+
+void CountsFromBoard(const ChessBoard& board, int* pcs) {
+  for (int black = 0; black < 2; ++black) {
+    for (int type = kPawn; type <= kKing; ++type) {
+      pcs[type + (black ? 8 : 0)] = PiecesByType(board, type, black).count();
+    }
+  }
+}
+
+int PieceCodeFromChar(char c) {
+  switch (c) {
+    case 'P':
+      return kPawn;
+    case 'N':
+      return kKnight;
+    case 'B':
+      return kBishop;
+    case 'R':
+      return kRook;
+    case 'Q':
+      return kQueen;
+    case 'K':
+      return kKing;
+  }
+  return 0;
+}
+
+// Parses a table name like "KQvKR" into per-piece counts (second side gets
+// codes |8).
+void CountsFromName(const std::string& name, int* pcs) {
+  int color = 0;
+  for (char c : name) {
+    if (c == 'v') {
+      color = 8;
+      continue;
+    }
+    ++pcs[PieceCodeFromChar(c) + color];
+  }
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Decoding structures, mirroring the file layout.
+// ---------------------------------------------------------------------------
+
+// One compressed value stream: canonical Huffman code over symbols which
+// recursively expand into pairs, plus a sparse block index. At namespace
+// scope (it is a member of the entry structs below, which the header
+// forward-declares).
+struct PairsData {
+  const uint8_t* indextable = nullptr;  // 6 bytes per index: block + offset.
+  const uint8_t* sizetable = nullptr;   // uint16 per block: bytes used - 1.
+  const uint8_t* data = nullptr;        // Compressed blocks.
+  const uint8_t* offset = nullptr;      // uint16 per code length.
+  const uint8_t* sympat = nullptr;      // 3 bytes per symbol: expansion.
+  std::vector<uint8_t> symlen;          // Expanded length of symbol - 1.
+  std::vector<uint64_t> base;           // Huffman base code per length.
+  int blocksize = 0;                    // log2 of the block size in bytes.
+  int idxbits = 0;  // Values per index entry = 2^idxbits. 0: constant table.
+  int min_len = 0;  // Shortest code length (or the constant value).
+};
+
+namespace {
+
+// Computes the number of positions each symbol expands to (minus one).
+// Returns false on a malformed file (out-of-range or cyclic references).
+bool CalcSymlen(PairsData* d, int s, std::vector<char>* done) {
+  (*done)[s] = 1;
+  const uint8_t* w = d->sympat + 3 * s;
+  const int s2 = (w[2] << 4) | (w[1] >> 4);
+  if (s2 == 0xfff) {
+    d->symlen[s] = 0;
+    return true;
+  }
+  const int s1 = ((w[1] & 0xf) << 8) | w[0];
+  const int num_syms = static_cast<int>(d->symlen.size());
+  if (s1 >= num_syms || s2 >= num_syms) return false;
+  if (!(*done)[s1] && !CalcSymlen(d, s1, done)) return false;
+  if (!(*done)[s2] && !CalcSymlen(d, s2, done)) return false;
+  const int len = d->symlen[s1] + d->symlen[s2] + 1;
+  if (len > 255) return false;
+  d->symlen[s] = static_cast<uint8_t>(len);
+  return true;
+}
+
+// Parses one value stream header at @data. @size receives the byte sizes
+// of the stream's index table, size table and data area; @next is set past
+// the header.
+bool SetupPairs(const uint8_t* data, uint64_t tb_size, uint64_t* size,
+                const uint8_t** next, PairsData* d) {
+  if (data[0] & 0x80) {
+    // Single-valued table; the value is stored in place of min_len.
+    d->idxbits = 0;
+    d->min_len = data[1];
+    *next = data + 2;
+    size[0] = size[1] = size[2] = 0;
+    return true;
+  }
+
+  d->blocksize = data[1];
+  d->idxbits = data[2];
+  const uint32_t real_num_blocks = ReadLe32(data + 4);
+  const uint32_t num_blocks = real_num_blocks + data[3];
+  const int max_len = data[8];
+  const int min_len = data[9];
+  if (max_len < min_len || d->idxbits < 1 || d->idxbits > 32) return false;
+  const int h = max_len - min_len + 1;
+  const int num_syms = ReadLe16(data + 10 + 2 * h);
+  d->offset = data + 10;
+  d->sympat = data + 12 + 2 * h;
+  d->min_len = min_len;
+  *next = data + 12 + 2 * h + 3 * num_syms + (num_syms & 1);
+
+  const uint64_t num_indices =
+      (tb_size + (uint64_t{1} << d->idxbits) - 1) >> d->idxbits;
+  size[0] = 6 * num_indices;
+  size[1] = 2 * num_blocks;
+  size[2] = (uint64_t{1} << d->blocksize) * real_num_blocks;
+
+  d->symlen.assign(num_syms, 0);
+  std::vector<char> done(num_syms, 0);
+  for (int s = 0; s < num_syms; ++s) {
+    if (!done[s] && !CalcSymlen(d, s, &done)) return false;
+  }
+
+  d->base.assign(h, 0);
+  for (int i = h - 2; i >= 0; --i) {
+    d->base[i] = (d->base[i + 1] + ReadLe16(d->offset + 2 * i) -
+                  ReadLe16(d->offset + 2 * (i + 1))) /
+                 2;
+  }
+  for (int i = 0; i < h; ++i) d->base[i] <<= 64 - (min_len + i);
+  return true;
+}
+
+// Extracts the value at position @idx from the stream.
+int DecompressPairs(const PairsData& d, uint64_t idx) {
+  if (!d.idxbits) return d.min_len;
+
+  // Locate the block, correcting the coarse index entry by walking the
+  // size table.
+  const uint64_t mainidx = idx >> d.idxbits;
+  int64_t litidx = (idx & ((uint64_t{1} << d.idxbits) - 1)) -
+                   (uint64_t{1} << (d.idxbits - 1));
+  uint32_t block = ReadLe32(d.indextable + 6 * mainidx);
+  litidx += ReadLe16(d.indextable + 6 * mainidx + 4);
+  if (litidx < 0) {
+    do {
+      litidx += ReadLe16(d.sizetable + 2 * --block) + 1;
+    } while (litidx < 0);
+  } else {
+    while (litidx > ReadLe16(d.sizetable + 2 * block)) {
+      litidx -= ReadLe16(d.sizetable + 2 * block++) + 1;
+    }
+  }
+
+  // Decode symbols until the litidx-th value of the block is reached.
+  const uint8_t* ptr = d.data + (uint64_t{block} << d.blocksize);
+  const int m = d.min_len;
+  uint64_t code = ReadBe64(ptr);
+  ptr += 8;
+  int bitcnt = 0;
+  int sym;
+  for (;;) {
+    int l = m;
+    while (code < d.base[l - m]) ++l;
+    sym = ReadLe16(d.offset + 2 * (l - m)) +
+          static_cast<int>((code - d.base[l - m]) >> (64 - l));
+    if (litidx < d.symlen[sym] + 1) break;
+    litidx -= d.symlen[sym] + 1;
+    code <<= l;
+    bitcnt += l;
+    if (bitcnt >= 32) {
+      bitcnt -= 32;
+      code |= uint64_t{ReadBe32(ptr)} << bitcnt;
+      ptr += 4;
+    }
+  }
+
+  // Expand the symbol pairwise down to the value.
+  while (d.symlen[sym] != 0) {
+    const uint8_t* w = d.sympat + 3 * sym;
+    const int s1 = ((w[1] & 0xf) << 8) | w[0];
+    if (litidx < d.symlen[s1] + 1) {
+      sym = s1;
+    } else {
+      litidx -= d.symlen[s1] + 1;
+      sym = (w[2] << 4) | (w[1] >> 4);
+    }
+  }
+  return d.sympat[3 * sym];
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Table entries.
+// ---------------------------------------------------------------------------
+
+struct SyzygyTablebase::BaseEntry {
+  virtual ~BaseEntry();
+
+  std::string path;
+  uint64_t key = 0;  // Material key with the file's first side as white.
+  int num = 0;       // Total number of men.
+  bool symmetric = false;
+  bool has_pawns = false;
+  bool split = false;  // Separate streams per side to move.
+  // Lazy initialization: set (under the tablebase's ready_mutex_) once the
+  // file has been mapped and parsed; invalid tracks a failed parse.
+  std::atomic<bool> ready{false};
+  bool invalid = false;
+  const uint8_t* map = nullptr;
+  size_t map_size = 0;
+#ifdef _WIN32
+  HANDLE mapping = nullptr;
+#endif
+};
+
+SyzygyTablebase::BaseEntry::~BaseEntry() {
+#ifdef _WIN32
+  if (map) UnmapViewOfFile(const_cast<uint8_t*>(map));
+  if (mapping) CloseHandle(mapping);
+#else
+  if (map) munmap(const_cast<uint8_t*>(map), map_size);
+#endif
+}
+
+struct SyzygyTablebase::PieceEntry : public SyzygyTablebase::BaseEntry {
+  uint8_t enc_type = 0;  // 0: three singleton pieces lead; 2: the two kings.
+  PairsData precomp[2];  // Indexed by side to move (when split).
+  uint64_t factor[2][6];
+  uint8_t pieces[2][6];
+  uint8_t norm[2][6];
+};
+
+struct SyzygyTablebase::PawnEntry : public SyzygyTablebase::BaseEntry {
+  uint8_t pawns[2];  // Leading color's pawn count first.
+  // One sub-table per leading pawn file a-d.
+  struct FileData {
+    PairsData precomp[2];
+    uint64_t factor[2][6];
+    uint8_t pieces[2][6];
+    uint8_t norm[2][6];
+  } file[4];
+};
+
+namespace {
+
+using PieceEntryImpl = SyzygyTablebase::PieceEntry;
+using PawnEntryImpl = SyzygyTablebase::PawnEntry;
+
+void SetNormPiece(const PieceEntryImpl* e, uint8_t* norm,
+                  const uint8_t* pieces) {
+  for (int i = 0; i < e->num; ++i) norm[i] = 0;
+  norm[0] = e->enc_type == 0 ? 3 : 2;
+  for (int i = norm[0]; i < e->num; i += norm[i]) {
+    for (int j = i; j < e->num && pieces[j] == pieces[i]; ++j) ++norm[i];
+  }
+}
+
+void SetNormPawn(const PawnEntryImpl* e, uint8_t* norm,
+                 const uint8_t* pieces) {
+  for (int i = 0; i < e->num; ++i) norm[i] = 0;
+  norm[0] = e->pawns[0];
+  if (e->pawns[1]) norm[e->pawns[0]] = e->pawns[1];
+  for (int i = e->pawns[0] + e->pawns[1]; i < e->num; i += norm[i]) {
+    for (int j = i; j < e->num && pieces[j] == pieces[i]; ++j) ++norm[i];
+  }
+}
+
+// Computes the mixed-radix factors of the piece groups: group @order is
+// the leading kings/pieces arrangement, the others are combinations of
+// like pieces over the remaining squares. Returns the total index space.
+uint64_t CalcFactorsPiece(uint64_t* factor, int num, int order,
+                          const uint8_t* norm, int enc_type) {
+  static const int kPivFac[3] = {31332, 28056, 462};
+  int n = 64 - norm[0];
+  uint64_t f = 1;
+  for (int i = norm[0], k = 0; i < num || k == order; ++k) {
+    if (k == order) {
+      factor[0] = f;
+      f *= kPivFac[enc_type];
+    } else {
+      factor[i] = f;
+      f *= Subfactor(norm[i], n);
+      n -= norm[i];
+      i += norm[i];
+    }
+  }
+  return f;
+}
+
+uint64_t CalcFactorsPawn(uint64_t* factor, int num, int order, int order2,
+                         const uint8_t* norm, int file) {
+  int i = norm[0];
+  if (order2 < 0x0f) i += norm[i];
+  int n = 64 - i;
+  uint64_t f = 1;
+  for (int k = 0; i < num || k == order || k == order2; ++k) {
+    if (k == order) {
+      factor[0] = f;
+      f *= kPFactor[norm[0] - 1][file];
+    } else if (k == order2) {
+      factor[norm[0]] = f;
+      f *= Subfactor(norm[norm[0]], 48 - norm[0]);
+    } else {
+      factor[i] = f;
+      f *= Subfactor(norm[i], n);
+      n -= norm[i];
+      i += norm[i];
+    }
+  }
+  return f;
+}
+
+// Parses the piece list and computes factors for both sides to move.
+// @tb_size gets the index space per side.
+void SetupPiecesPiece(PieceEntryImpl* e, const uint8_t* data,
+                      uint64_t* tb_size) {
+  for (int side = 0; side < 2; ++side) {
+    for (int i = 0; i < e->num; ++i) {
+      e->pieces[side][i] = side ? data[i + 1] >> 4 : data[i + 1] & 0x0f;
+    }
+    const int order = side ? data[0] >> 4 : data[0] & 0x0f;
+    SetNormPiece(e, e->norm[side], e->pieces[side]);
+    tb_size[side] = CalcFactorsPiece(e->factor[side], e->num, order,
+                                     e->norm[side], e->enc_type);
+  }
+}
+
+void SetupPiecesPawn(PawnEntryImpl* e, const uint8_t* data, uint64_t* tb_size,
+                     int f) {
+  const int j = 1 + (e->pawns[1] > 0);
+  for (int side = 0; side < 2; ++side) {
+    const int order = side ? data[0] >> 4 : data[0] & 0x0f;
+    const int order2 =
+        e->pawns[1] ? (side ? data[1] >> 4 : data[1] & 0x0f) : 0x0f;
+    for (int i = 0; i < e->num; ++i) {
+      e->file[f].pieces[side][i] = side ? data[i + j] >> 4 : data[i + j] & 0x0f;
+    }
+    SetNormPawn(e, e->file[f].norm[side], e->file[f].pieces[side]);
+    tb_size[side] = CalcFactorsPawn(e->file[f].factor[side], e->num, order,
+                                    order2, e->file[f].norm[side], f);
+  }
+}
+
+// Maps a piece configuration (squares in @pos, grouped as described by
+// @norm, kings/leading group first) to its index. Mutates @pos while
+// canonicalizing.
+uint64_t EncodePiece(const PieceEntryImpl* e, const uint8_t* norm, int* pos,
+                     const uint64_t* factor) {
+  const int n = e->num;
+
+  // Fold the leading piece into the a1-d1-d4 triangle: flip files, ranks
+  // and finally the diagonal as needed.
+  if (pos[0] & 0x04) {
+    for (int i = 0; i < n; ++i) pos[i] ^= 0x07;
+  }
+  if (pos[0] & 0x20) {
+    for (int i = 0; i < n; ++i) pos[i] ^= 0x38;
+  }
+  int i = 0;
+  while (i < n && !kOffDiag[pos[i]]) ++i;
+  if (i < (e->enc_type == 0 ? 3 : 2) && kOffDiag[pos[i]] > 0) {
+    for (int j = 0; j < n; ++j) pos[j] = kFlipDiag[pos[j]];
+  }
+
+  uint64_t idx;
+  if (e->enc_type == 0) {
+    // Three singleton pieces lead; the layout depends on how many of them
+    // sit on the diagonal.
+    const int s1 = (pos[1] > pos[0]);
+    const int s2 = (pos[2] > pos[0]) + (pos[2] > pos[1]);
+    if (kOffDiag[pos[0]]) {
+      idx = kTriangle[pos[0]] * 63 * 62 + (pos[1] - s1) * 62 + (pos[2] - s2);
+    } else if (kOffDiag[pos[1]]) {
+      idx = 6 * 63 * 62 + kDiag[pos[0]] * 28 * 62 + kLower[pos[1]] * 62 +
+            pos[2] - s2;
+    } else if (kOffDiag[pos[2]]) {
+      idx = 6 * 63 * 62 + 4 * 28 * 62 + kDiag[pos[0]] * 7 * 28 +
+            (kDiag[pos[1]] - s1) * 28 + kLower[pos[2]];
+    } else {
+      idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + kDiag[pos[0]] * 7 * 6 +
+            (kDiag[pos[1]] - s1) * 6 + (kDiag[pos[2]] - s2);
+    }
+    i = 3;
+  } else {
+    idx = kKkIdx[kTriangle[pos[0]]][pos[1]];
+    i = 2;
+  }
+  idx *= factor[0];
+
+  // Remaining groups of like pieces: sort and count combinations, skipping
+  // over squares taken by earlier pieces.
+  while (i < n) {
+    const int t = norm[i];
+    for (int j = i; j < i + t; ++j) {
+      for (int k = j + 1; k < i + t; ++k) {
+        if (pos[j] > pos[k]) std::swap(pos[j], pos[k]);
+      }
+    }
+    uint64_t s = 0;
+    for (int m = i; m < i + t; ++m) {
+      const int p = pos[m];
+      int j = 0;
+      for (int l = 0; l < i; ++l) j += (p > pos[l]);
+      s += kBinomial[m - i][p - j];
+    }
+    idx += s * factor[i];
+    i += t;
+  }
+  return idx;
+}
+
+// Picks the sub-table: the leading pawn (smallest kFlap value) determines
+// the file, folded to a-d.
+int PawnFile(const PawnEntryImpl* e, int* pos) {
+  for (int i = 1; i < e->pawns[0]; ++i) {
+    if (kFlap[pos[0]] > kFlap[pos[i]]) std::swap(pos[0], pos[i]);
+  }
+  return kFileToFile[pos[0] & 0x07];
+}
+
+uint64_t EncodePawn(const PawnEntryImpl* e, const uint8_t* norm, int* pos,
+                    const uint64_t* factor) {
+  const int n = e->num;
+
+  // Fold the leading pawn to files a-d.
+  if (pos[0] & 0x04) {
+    for (int i = 0; i < n; ++i) pos[i] ^= 0x07;
+  }
+  // Leading-color pawns, ordered by kPtwist.
+  for (int i = 1; i < e->pawns[0]; ++i) {
+    for (int j = i + 1; j < e->pawns[0]; ++j) {
+      if (kPtwist[pos[i]] < kPtwist[pos[j]]) std::swap(pos[i], pos[j]);
+    }
+  }
+  const int t = e->pawns[0] - 1;
+  uint64_t idx = kPawnIdx[t][kFlap[pos[0]]];
+  for (int i = t; i > 0; --i) idx += kBinomial[t - i][kPtwist[pos[i]]];
+  idx *= factor[0];
+
+  // Other color's pawns are a plain combination over the 48 pawn squares.
+  int i = e->pawns[0];
+  const int t2 = i + e->pawns[1];
+  if (t2 > i) {
+    for (int j = i; j < t2; ++j) {
+      for (int k = j + 1; k < t2; ++k) {
+        if (pos[j] > pos[k]) std::swap(pos[j], pos[k]);
+      }
+    }
+    uint64_t s = 0;
+    for (int m = i; m < t2; ++m) {
+      const int p = pos[m];
+      int j = 0;
+      for (int k = 0; k < i; ++k) j += (p > pos[k]);
+      s += kBinomial[m - i][p - j - 8];
+    }
+    idx += s * factor[i];
+    i = t2;
+  }
+
+  // Remaining groups of like pieces, as in EncodePiece.
+  while (i < n) {
+    const int t3 = norm[i];
+    for (int j = i; j < i + t3; ++j) {
+      for (int k = j + 1; k < i + t3; ++k) {
+        if (pos[j] > pos[k]) std::swap(pos[j], pos[k]);
+      }
+    }
+    uint64_t s = 0;
+    for (int m = i; m < i + t3; ++m) {
+      const int p = pos[m];
+      int j = 0;
+      for (int k = 0; k < i; ++k) j += (p > pos[k]);
+      s += kBinomial[m - i][p - j];
+    }
+    idx += s * factor[i];
+    i += t3;
+  }
+  return idx;
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// SyzygyTablebase.
+// ---------------------------------------------------------------------------
+
+namespace {
+// 128k probe cache slots (1MB). Each slot packs the top 56 bits of the
+// position hash with the WDL value; a lost race on a slot or a (cosmically
+// unlikely) 56-bit collision only costs/saves a re-probe.
+const size_t kProbeCacheSize = 1 << 17;
+}  // namespace
+
+SyzygyTablebase::SyzygyTablebase() : probe_cache_(kProbeCacheSize) {
+  std::call_once(indices_once, InitIndices);
+}
+
+SyzygyTablebase::~SyzygyTablebase() = default;
+
+void SyzygyTablebase::Clear() {
+  max_cardinality_ = 0;
+  entry_map_.clear();
+  entries_.clear();
+  for (auto& slot : probe_cache_) {
+    slot.store(0, std::memory_order_relaxed);
+  }
+}
+
+void SyzygyTablebase::RegisterTable(const std::vector<std::string>& paths,
+                                    const std::string& name) {
+  int pcs[16] = {0};
+  CountsFromName(name, pcs);
+  const uint64_t key = MaterialKey(pcs);
+  if (entry_map_.count(key)) return;
+
+  std::string filename;
+  for (const auto& dir : paths) {
+    const std::string candidate = dir + "/" + name + ".rtbw";
+#ifdef _WIN32
+    const DWORD attrs = GetFileAttributesA(candidate.c_str());
+    const bool exists = attrs != INVALID_FILE_ATTRIBUTES &&
+                        !(attrs & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    const bool exists = stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+#endif
+    if (exists) {
+      filename = candidate;
+      break;
+    }
+  }
+  if (filename.empty()) return;
+
+  int swapped[16] = {0};
+  for (int i = 1; i < 8; ++i) {
+    swapped[i] = pcs[i + 8];
+    swapped[i + 8] = pcs[i];
+  }
+  const uint64_t key2 = MaterialKey(swapped);
+
+  std::unique_ptr<BaseEntry> entry;
+  const bool has_pawns = pcs[kPawn] || pcs[kPawn + 8];
+  if (has_pawns) {
+    auto pawn_entry = std::make_unique<PawnEntry>();
+    pawn_entry->pawns[0] = pcs[kPawn];
+    pawn_entry->pawns[1] = pcs[kPawn + 8];
+    if (pcs[kPawn + 8] > 0 &&
+        (pcs[kPawn] == 0 || pcs[kPawn + 8] < pcs[kPawn])) {
+      std::swap(pawn_entry->pawns[0], pawn_entry->pawns[1]);
+    }
+    entry = std::move(pawn_entry);
+  } else {
+    auto piece_entry = std::make_unique<PieceEntry>();
+    int singles = 0;
+    for (int i = 1; i < 16; ++i) singles += (pcs[i] == 1);
+    piece_entry->enc_type = singles >= 3 ? 0 : 2;
+    entry = std::move(piece_entry);
+  }
+  entry->path = filename;
+  entry->key = key;
+  entry->symmetric = key == key2;
+  entry->has_pawns = has_pawns;
+  for (int i = 1; i < 16; ++i) entry->num += pcs[i];
+
+  if (entry->num > max_cardinality_) max_cardinality_ = entry->num;
+  entry_map_[key] = entry.get();
+  if (key2 != key) entry_map_[key2] = entry.get();
+  entries_.push_back(std::move(entry));
+}
+
+bool SyzygyTablebase::Init(const std::string& paths) {
+  Clear();
+  std::vector<std::string> dirs;
+  std::string dir;
+  for (char c : paths + ':') {
+    if (c == ':' || c == ';') {
+      if (!dir.empty()) dirs.push_back(dir);
+      dir.clear();
+    } else {
+      dir += c;
+    }
+  }
+  if (dirs.empty()) return false;
+
+  // Enumerate every possible 3- to 6-man material division and register
+  // the ones which have a file. Names list the pieces of each side in
+  // decreasing order, stronger side first.
+  const std::string p = "QRBNP";
+  std::vector<std::string> names;
+  for (int i = 0; i < 5; ++i) {
+    names.push_back(std::string("K") + p[i] + "vK");
+  }
+  for (int i = 0; i < 5; ++i) {
+    for (int j = i; j < 5; ++j) {
+      names.push_back(std::string("K") + p[i] + "vK" + p[j]);
+      names.push_back(std::string("K") + p[i] + p[j] + "vK");
+    }
+  }
+  for (int i = 0; i < 5; ++i) {
+    for (int j = i; j < 5; ++j) {
+      for (int k = 0; k < 5; ++k) {
+        names.push_back(std::string("K") + p[i] + p[j] + "vK" + p[k]);
+      }
+      for (int k = j; k < 5; ++k) {
+        names.push_back(std::string("K") + p[i] + p[j] + p[k] + "vK");
+      }
+    }
+  }
+  for (int i = 0; i < 5; ++i) {
+    for (int j = i; j < 5; ++j) {
+      for (int k = j; k < 5; ++k) {
+        for (int l = 0; l < 5; ++l) {
+          names.push_back(std::string("K") + p[i] + p[j] + p[k] + "vK" + p[l]);
+        }
+        for (int l = k; l < 5; ++l) {
+          names.push_back(std::string("K") + p[i] + p[j] + p[k] + p[l] + "vK");
+        }
+      }
+      for (int k = i; k < 5; ++k) {
+        for (int l = (i == k ? j : k); l < 5; ++l) {
+          names.push_back(std::string("K") + p[i] + p[j] + "vK" + p[k] + p[l]);
+        }
+      }
+    }
+  }
+  for (const auto& name : names) RegisterTable(dirs, name);
+
+  if (entries_.empty()) return false;
+  std::cerr << "Found " << entries_.size() << " WDL tablebases, up to "
+            << max_cardinality_ << " men." << std::endl;
+  return true;
+}
+
+bool SyzygyTablebase::InitTable(BaseEntry* entry) {
+#ifdef _WIN32
+  const HANDLE file =
+      CreateFileA(entry->path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                  OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  DWORD size_high;
+  const DWORD size_low = GetFileSize(file, &size_high);
+  entry->mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, size_high,
+                                     size_low, nullptr);
+  CloseHandle(file);
+  if (!entry->mapping) return false;
+  entry->map = static_cast<const uint8_t*>(
+      MapViewOfFile(entry->mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!entry->map) return false;
+  entry->map_size = (static_cast<size_t>(size_high) << 32) | size_low;
+#else
+  const int fd = open(entry->path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 16) {
+    close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  entry->map = static_cast<const uint8_t*>(map);
+  entry->map_size = st.st_size;
+#endif
+
+  const uint8_t* data = entry->map;
+  if (std::memcmp(data, kWdlMagic, 4) != 0) return false;
+  entry->split = data[4] & 0x01;
+  const bool four_files = data[4] & 0x02;
+  if (four_files != entry->has_pawns) return false;
+  if (entry->symmetric && entry->split) return false;
+  data += 5;
+
+  uint64_t tb_size[8];
+  uint64_t size[8 * 3];
+  const uint8_t* next = nullptr;
+
+  if (!entry->has_pawns) {
+    auto* e = static_cast<PieceEntry*>(entry);
+    SetupPiecesPiece(e, data, tb_size);
+    data += e->num + 1;
+    data += reinterpret_cast<uintptr_t>(data) & 0x01;
+
+    for (int s = 0; s < (entry->split ? 2 : 1); ++s) {
+      if (!SetupPairs(data, tb_size[s], &size[3 * s], &next, &e->precomp[s])) {
+        return false;
+      }
+      data = next;
+    }
+    for (int s = 0; s < (entry->split ? 2 : 1); ++s) {
+      e->precomp[s].indextable = data;
+      data += size[3 * s];
+    }
+    for (int s = 0; s < (entry->split ? 2 : 1); ++s) {
+      e->precomp[s].sizetable = data;
+      data += size[3 * s + 1];
+    }
+    for (int s = 0; s < (entry->split ? 2 : 1); ++s) {
+      data = reinterpret_cast<const uint8_t*>(
+          (reinterpret_cast<uintptr_t>(data) + 0x3f) & ~uintptr_t{0x3f});
+      e->precomp[s].data = data;
+      data += size[3 * s + 2];
+    }
+  } else {
+    auto* e = static_cast<PawnEntry*>(entry);
+    const int s = 1 + (e->pawns[1] > 0);
+    for (int f = 0; f < 4; ++f) {
+      SetupPiecesPawn(e, data, &tb_size[2 * f], f);
+      data += e->num + s;
+    }
+    data += reinterpret_cast<uintptr_t>(data) & 0x01;
+
+    for (int f = 0; f < 4; ++f) {
+      for (int side = 0; side < (entry->split ? 2 : 1); ++side) {
+        if (!SetupPairs(data, tb_size[2 * f + side], &size[6 * f + 3 * side],
+                        &next, &e->file[f].precomp[side])) {
+          return false;
+        }
+        data = next;
+      }
+    }
+    for (int f = 0; f < 4; ++f) {
+      for (int side = 0; side < (entry->split ? 2 : 1); ++side) {
+        e->file[f].precomp[side].indextable = data;
+        data += size[6 * f + 3 * side];
+      }
+    }
+    for (int f = 0; f < 4; ++f) {
+      for (int side = 0; side < (entry->split ? 2 : 1); ++side) {
+        e->file[f].precomp[side].sizetable = data;
+        data += size[6 * f + 3 * side + 1];
+      }
+    }
+    for (int f = 0; f < 4; ++f) {
+      for (int side = 0; side < (entry->split ? 2 : 1); ++side) {
+        data = reinterpret_cast<const uint8_t*>(
+            (reinterpret_cast<uintptr_t>(data) + 0x3f) & ~uintptr_t{0x3f});
+        e->file[f].precomp[side].data = data;
+        data += size[6 * f + 3 * side + 2];
+      }
+    }
+  }
+  // All offsets must have stayed within the file.
+  return data <= entry->map + entry->map_size;
+}
+
+int SyzygyTablebase::ProbeWdlTable(const ChessBoard& board, bool* ok) {
+  int pcs[16] = {0};
+  CountsFromBoard(board, pcs);
+  const uint64_t key = MaterialKey(pcs);
+
+  const auto iter = entry_map_.find(key);
+  if (iter == entry_map_.end()) {
+    *ok = false;
+    return 0;
+  }
+  BaseEntry* entry = iter->second;
+
+  if (!entry->ready.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    if (!entry->ready.load(std::memory_order_relaxed)) {
+      if (!InitTable(entry)) {
+        std::cerr << "Bad tablebase file " << entry->path << std::endl;
+        entry->invalid = true;
+      }
+      entry->ready.store(true, std::memory_order_release);
+    }
+  }
+  if (entry->invalid) {
+    *ok = false;
+    return 0;
+  }
+
+  // The board is canonical ("ours" to move, playing up). When the material
+  // matches the file's first side with colors swapped, look the position up
+  // with colors (and for pawn tables, ranks) mirrored, using the second
+  // side's stream.
+  int cmirror, mirror, bside;
+  if (entry->symmetric || key == entry->key) {
+    cmirror = mirror = bside = 0;
+  } else {
+    cmirror = 8;
+    mirror = 0x38;
+    bside = 1;
+  }
+
+  int p[6];
+  int res;
+  if (!entry->has_pawns) {
+    const auto* e = static_cast<const PieceEntry*>(entry);
+    int i = 0;
+    while (i < e->num) {
+      const int pc = e->pieces[bside][i] ^ cmirror;
+      for (BoardSquare sq : PiecesByType(board, pc & 0x07, pc >> 3)) {
+        p[i++] = sq.as_int();
+      }
+    }
+    const uint64_t idx = EncodePiece(e, e->norm[bside], p, e->factor[bside]);
+    res = DecompressPairs(e->precomp[entry->split ? bside : 0], idx);
+  } else {
+    const auto* e = static_cast<const PawnEntry*>(entry);
+    // The leading pawns pick the sub-table, so place them first.
+    int pc = e->file[0].pieces[0][0] ^ cmirror;
+    int i = 0;
+    for (BoardSquare sq : PiecesByType(board, pc & 0x07, pc >> 3)) {
+      p[i++] = sq.as_int() ^ mirror;
+    }
+    const int f = PawnFile(e, p);
+    while (i < e->num) {
+      pc = e->file[f].pieces[bside][i] ^ cmirror;
+      for (BoardSquare sq : PiecesByType(board, pc & 0x07, pc >> 3)) {
+        p[i++] = sq.as_int() ^ mirror;
+      }
+    }
+    const uint64_t idx =
+        EncodePawn(e, e->file[f].norm[bside], p, e->file[f].factor[bside]);
+    res = DecompressPairs(e->file[f].precomp[entry->split ? bside : 0], idx);
+  }
+  return res - 2;
+}
+
+int SyzygyTablebase::ProbeAb(const ChessBoard& board, int alpha, int beta,
+                             bool* ok) {
+  // The tables are only guaranteed for the position itself after captures
+  // have been resolved, so search them first. En passant is excluded here;
+  // ProbeWdl handles it.
+  for (const Move& move : board.GenerateLegalMoves()) {
+    if (!board.theirs().get(move.to())) continue;
+    ChessBoard after = board;
+    after.ApplyMove(move);
+    after.Mirror();
+    const int v = -ProbeAb(after, -beta, -alpha, ok);
+    if (!*ok) return 0;
+    if (v > alpha) {
+      if (v >= beta) return v;
+      alpha = v;
+    }
+  }
+  const int v = ProbeWdlTable(board, ok);
+  if (!*ok) return 0;
+  return alpha >= v ? alpha : v;
+}
+
+bool SyzygyTablebase::ProbeWdl(const ChessBoard& board, int* wdl) {
+  if (max_cardinality_ == 0) return false;
+  // The tables assume no castling rights.
+  if (board.castlings().as_int() != 0) return false;
+
+  const uint64_t hash = board.Hash();
+  auto& slot = probe_cache_[hash & (kProbeCacheSize - 1)];
+  const uint64_t cached = slot.load(std::memory_order_relaxed);
+  if (cached != 0 && ((cached ^ hash) & ~uint64_t{0xff}) == 0) {
+    *wdl = static_cast<int>(cached & 0xff) - 3;
+    return true;
+  }
+
+  bool ok = true;
+  int v = ProbeAb(board, -2, 2, &ok);
+  if (!ok) return false;
+
+  // En passant captures are not reflected in the tables; if one exists, it
+  // may improve the value, and if it is the only legal move it decides it.
+  const BitBoard our_pawns = board.pawns() * board.ours();
+  if (!(our_pawns * BitBoard(0xff00000000ull)).empty()) {
+    int v1 = -3;
+    bool has_other_moves = false;
+    for (const Move& move : board.GenerateLegalMoves()) {
+      const bool is_ep = our_pawns.get(move.from()) &&
+                         move.from().col() != move.to().col() &&
+                         !board.theirs().get(move.to());
+      if (!is_ep) {
+        has_other_moves = true;
+        continue;
+      }
+      ChessBoard after = board;
+      after.ApplyMove(move);
+      after.Mirror();
+      ok = true;
+      const int v0 = -ProbeAb(after, -2, 2, &ok);
+      if (!ok) return false;
+      if (v0 > v1) v1 = v0;
+    }
+    if (v1 > -3) {
+      if (v1 >= v) {
+        v = v1;
+      } else if (v == 0 && !has_other_moves) {
+        // Stalemate except for en passant: the capture is forced.
+        v = v1;
+      }
+    }
+  }
+
+  slot.store((hash & ~uint64_t{0xff}) | static_cast<uint64_t>(v + 3),
+             std::memory_order_relaxed);
+  *wdl = v;
+  return true;
+}
+
+}  // namespace lczero
@@ -0,0 +1,92 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chess/board.h"
+
+namespace lczero {
+
+// Syzygy WDL (win/draw/loss) tablebase prober, following Ronald de Man's
+// table format and probing algorithm. Only the .rtbw files are used; they
+// give the game-theoretical result under the 50-move rule for positions
+// with up to 6 men and no castling rights.
+//
+// Table files are memory-mapped lazily on first probe and stay mapped; a
+// small lock-free cache keyed by position hash short-circuits repeated
+// probes of the same position. Init() and probing are thread-safe.
+class SyzygyTablebase {
+ public:
+  SyzygyTablebase();
+  ~SyzygyTablebase();
+
+  // Scans the given directories (separated by ':', or ';' on Windows) for
+  // .rtbw files and registers what's found. May be called again to rescan;
+  // previously mapped tables are dropped. Returns false when no usable
+  // tables were found.
+  bool Init(const std::string& paths);
+
+  // Maximum number of men (both sides, kings included) covered by the
+  // registered tables; 0 when none are.
+  int max_cardinality() const { return max_cardinality_; }
+
+  // Probes the WDL value of the position from the side to move's
+  // perspective: -2 loss, -1 blessed loss, 0 draw, 1 cursed win, 2 win.
+  // The probe is only exact when the 50-move counter is zero (i.e. right
+  // after a capture or pawn move); the caller enforces that. Returns false
+  // when the position cannot be probed (castling rights, missing table).
+  bool ProbeWdl(const ChessBoard& board, int* wdl);
+
+  // Implementation detail, public only so that file-local helpers in
+  // syzygy.cc can take them as parameters.
+  struct BaseEntry;
+  struct PieceEntry;
+  struct PawnEntry;
+
+ private:
+  void Clear();
+  // Registers the table @name (e.g. "KQvK") if the file exists in any of
+  // the directories in @paths.
+  void RegisterTable(const std::vector<std::string>& paths,
+                     const std::string& name);
+  // Maps the file and parses the header. Called once per entry, under
+  // ready_mutex_. Returns false (and logs) on a malformed file.
+  bool InitTable(BaseEntry* entry);
+  // Looks up the table and extracts the WDL value for the position.
+  int ProbeWdlTable(const ChessBoard& board, bool* ok);
+  // WDL probe with capture resolution (captures may be better than the
+  // stored positional value). En passant is handled by the caller.
+  int ProbeAb(const ChessBoard& board, int alpha, int beta, bool* ok);
+
+  int max_cardinality_ = 0;
+  std::vector<std::unique_ptr<BaseEntry>> entries_;
+  std::unordered_map<uint64_t, BaseEntry*> entry_map_;
+  // Serializes lazy per-table initialization.
+  std::mutex ready_mutex_;
+  // Probe cache: packed (hash, wdl) per slot, empty slots are 0.
+  std::vector<std::atomic<uint64_t>> probe_cache_;
+};
+
+}  // namespace lczero
@@ -0,0 +1,86 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/affinity.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "utils/exception.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace lczero {
+
+namespace {
+
+// Parses "0-7,16,18" into {0,1,...,7,16,18}.
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < cpu_list.size()) {
+    size_t consumed;
+    int from = std::stoi(cpu_list.substr(pos), &consumed);
+    pos += consumed;
+    int to = from;
+    if (pos < cpu_list.size() && cpu_list[pos] == '-') {
+      to = std::stoi(cpu_list.substr(pos + 1), &consumed);
+      pos += consumed + 1;
+    }
+    if (from < 0 || to < from) {
+      throw Exception("Bad CPU list: " + cpu_list);
+    }
+    for (int cpu = from; cpu <= to; ++cpu) cpus.push_back(cpu);
+    if (pos < cpu_list.size()) {
+      if (cpu_list[pos] != ',') throw Exception("Bad CPU list: " + cpu_list);
+      ++pos;
+    }
+  }
+  if (cpus.empty()) throw Exception("Bad CPU list: " + cpu_list);
+  return cpus;
+}
+
+}  // namespace
+
+void BindThisThreadToCpus(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  try {
+    cpus = ParseCpuList(cpu_list);
+  } catch (std::exception&) {
+    throw Exception("Bad CPU list: " + cpu_list);
+  }
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= CPU_SETSIZE) throw Exception("Bad CPU list: " + cpu_list);
+    CPU_SET(cpu, &set);
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    std::cerr << "Cannot bind thread to CPUs " << cpu_list << std::endl;
+  }
+#else
+  std::cerr << "Thread affinity is not supported on this platform."
+            << std::endl;
+#endif
+}
+
+}  // namespace lczero
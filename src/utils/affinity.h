@@ -0,0 +1,32 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+namespace lczero {
+
+// Pins the calling thread to the given CPUs, e.g. to keep a backend's worker
+// threads on the NUMA node its GPU hangs off. @cpu_list is a comma separated
+// list of CPU numbers and ranges, e.g. "0-7,16,18". Throws Exception when the
+// list doesn't parse; prints a warning when the platform doesn't support
+// thread affinity.
+void BindThisThreadToCpus(const std::string& cpu_list);
+
+}  // namespace lczero
@@ -21,9 +21,43 @@
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
+#ifdef __BMI__
+#include <immintrin.h>
+#endif
 
 namespace lczero {
 
+// Returns the index of the lowest set bit. Undefined for zero.
+inline int GetLowestBit(std::uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long result;
+  _BitScanForward64(&result, value);
+  return result;
+#elif defined(__BMI__)
+  return _tzcnt_u64(value);
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+// Returns the value with the lowest set bit reset.
+inline std::uint64_t ResetLowestBit(std::uint64_t value) {
+#ifdef __BMI__
+  return _blsr_u64(value);
+#else
+  return value & (value - 1);
+#endif
+}
+
+// Returns the number of set bits.
+inline int CountSetBits(std::uint64_t value) {
+#ifdef _MSC_VER
+  return static_cast<int>(_mm_popcnt_u64(value));
+#else
+  return __builtin_popcountll(value);
+#endif
+}
+
 // Iterates over all set bits of the value, lower to upper. The value of
 // dereferenced iterator is bit number (lower to upper, 0 bazed)
 template <typename T>
@@ -32,16 +66,8 @@ class BitIterator {
   BitIterator(std::uint64_t value) : value_(value){};
   bool operator!=(const BitIterator& other) { return value_ != other.value_; }
 
-  void operator++() { value_ &= (value_ - 1); }
-  T operator*() const {
-#ifdef _MSC_VER
-    unsigned long result;
-    _BitScanForward64(&result, value_);
-    return result;
-#else
-    return __builtin_ctzll(value_);
-#endif
-  }
+  void operator++() { value_ = ResetLowestBit(value_); }
+  T operator*() const { return GetLowestBit(value_); }
 
  private:
   std::uint64_t value_;
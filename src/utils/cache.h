@@ -19,9 +19,12 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 #include "utils/mutex.h"
 
 namespace lczero {
@@ -30,59 +33,81 @@ namespace lczero {
 // deleted upon eviction; thus, using values stored requires pinning them, which
 // in turn requires Unpin()ing them after use. The use of LruCacheLock is
 // recommend to automate this element-memory management.
+//
+// Capacity is a budget of "charge": with the default charge of 1 per insert
+// it is an entry count, while passing an allocation size as the charge turns
+// it into a byte budget.
+//
+// Entries live in a contiguous slab and are linked (LRU order, free list,
+// evicted list) by slab index, so a lookup is one probe sequence in a flat
+// open-addressing table plus one slab access — no per-entry heap nodes and
+// no pointer chasing through cold memory. The slab doubles when full; since
+// all links are indices, growth moves no links. Deletion backward-shifts the
+// probe table, so probe sequences stay short with no tombstones.
 template <class K, class V>
 class LruCache {
-  static const double constexpr kLoadFactor = 1.33;
-
  public:
-  LruCache(int capacity = 128)
-      : capacity_(capacity),
-        hash_(static_cast<size_t>(capacity * kLoadFactor + 1)) {
-    std::memset(&hash_[0], 0, sizeof(hash_[0]) * hash_.size());
+  LruCache(int64_t capacity = 128) : capacity_(capacity) {
+    // The charge of an entry (and so the number of entries the capacity
+    // holds) isn't known until insertion, so preallocate modestly and
+    // double; entries never move on growth.
+    GrowSlab(static_cast<size_t>(
+        std::max<int64_t>(1, std::min<int64_t>(capacity, 128))));
+    size_t table_size = 16;
+    while (table_size < 2 * slab_.size()) table_size *= 2;
+    table_.assign(table_size, -1);
   }
 
   ~LruCache() {
-    ShrinkToCapacity(0);
+    std::vector<std::unique_ptr<V>> trash;
+    ShrinkToCapacity(0, &trash);
     assert(size_ == 0);
     assert(allocated_ == 0);
   }
 
-  // Inserts the element under key @key with value @val.
+  // Inserts the element under key @key with value @val, charging @charge
+  // against the capacity (1 to count entries, the allocation size to budget
+  // bytes).
   // If the element is pinned, old value is still kept (until fully unpinned),
   // but new lookups will return updated value.
   // If @pinned, pins inserted element, Unpin has to be called to unpin.
   // In any case, puts element to front of the queue (makes it last to evict).
-  V* Insert(K key, std::unique_ptr<V> val, bool pinned = false) {
-    Mutex::Lock lock(mutex_);
-
-    auto hash = hasher_(key) % hash_.size();
-    auto& hash_head = hash_[hash];
-    for (Item* iter = hash_head; iter; iter = iter->next_in_hash) {
-      if (key == iter->key) {
-        EvictItem(iter);
-        break;
-      }
+  V* Insert(K key, std::unique_ptr<V> val, size_t charge = 1,
+            bool pinned = false) {
+    // Evicted values are only unlinked under the lock; they are destroyed
+    // here after release so value destructors do not stall other users.
+    std::vector<std::unique_ptr<V>> trash;
+    V* result = nullptr;
+    {
+      Mutex::Lock lock(mutex_);
+
+      const int64_t slot = FindTableSlot(key);
+      if (slot >= 0) EvictItem(slot, &trash);
+
+      ShrinkToCapacity(capacity_ - static_cast<int64_t>(charge), &trash);
+      ++size_;
+      ++allocated_;
+      charge_ += charge;
+      MaybeGrowTable();
+
+      const int idx = AllocateSlabEntry();
+      Item& item = slab_[idx];
+      item.key = key;
+      item.value = std::move(val);
+      item.charge = charge;
+      item.pins = pinned ? 1 : 0;
+      InsertIntoTable(idx);
+      InsertIntoLru(idx);
+      result = item.value.get();
     }
-
-    ShrinkToCapacity(capacity_ - 1);
-    ++size_;
-    ++allocated_;
-    Item* new_item = new Item(key, std::move(val), pinned ? 1 : 0);
-    new_item->next_in_hash = hash_head;
-    hash_head = new_item;
-    InsertIntoLru(new_item);
-    return new_item->value.get();
+    return result;
   }
 
   // Checks whether a key exists. Doesn't lock. Of course the next moment the
   // key may be evicted.
   bool ContainsKey(K key) {
     Mutex::Lock lock(mutex_);
-    auto hash = hasher_(key) % hash_.size();
-    for (Item* iter = hash_[hash]; iter; iter = iter->next_in_hash) {
-      if (key == iter->key) return true;
-    }
-    return false;
+    return FindTableSlot(key) >= 0;
   }
 
   // Looks up and pins the element by key. Returns nullptr if not found.
@@ -92,191 +117,374 @@ class LruCache {
   V* LookupAndPin(K key) {
     Mutex::Lock lock(mutex_);
 
-    auto hash = hasher_(key) % hash_.size();
-    for (Item* iter = hash_[hash]; iter; iter = iter->next_in_hash) {
-      if (key == iter->key) {
-        // BringToFront(iter);
-        ++iter->pins;
-        return iter->value.get();
-      }
-    }
-    return nullptr;
+    const int64_t slot = FindTableSlot(key);
+    if (slot < 0) return nullptr;
+    Item& item = slab_[table_[slot]];
+    // BringToFront(table_[slot]);
+    ++item.pins;
+    return item.value.get();
   }
 
   // Unpins the element given key and value. Use of LruCacheLock is recommended
   // to automate this pin management.
   void Unpin(K key, V* value) {
-    Mutex::Lock lock(mutex_);
-
-    // Checking evicted list first.
-    Item** cur = &evicted_head_;
-    for (Item* el = evicted_head_; el; el = el->next_in_hash) {
-      if (key == el->key && value == el->value.get()) {
-        if (--el->pins == 0) {
-          *cur = el->next_in_hash;
-          --allocated_;
-          delete el;
+    // Destroyed after the lock is released.
+    std::unique_ptr<V> trash;
+    {
+      Mutex::Lock lock(mutex_);
+
+      // Checking evicted list first.
+      bool unpinned = false;
+      int* cur = &evicted_head_;
+      for (int el = evicted_head_; el >= 0; el = slab_[el].next) {
+        Item& item = slab_[el];
+        if (key == item.key && value == item.value.get()) {
+          if (--item.pins == 0) {
+            *cur = item.next;
+            --allocated_;
+            trash = std::move(item.value);
+            FreeSlabEntry(el);
+          }
+          unpinned = true;
+          break;
         }
-        return;
+        cur = &item.next;
       }
-      cur = &el->next_in_hash;
-    }
 
-    // Now lookup in active list.
-    auto hash = hasher_(key) % hash_.size();
-    for (Item* iter = hash_[hash]; iter; iter = iter->next_in_hash) {
-      if (key == iter->key && value == iter->value.get()) {
-        assert(iter->pins > 0);
-        --iter->pins;
-        return;
+      // Now lookup in the table.
+      if (!unpinned) {
+        const int64_t slot = FindTableSlot(key);
+        if (slot >= 0 && slab_[table_[slot]].value.get() == value) {
+          Item& item = slab_[table_[slot]];
+          assert(item.pins > 0);
+          --item.pins;
+          unpinned = true;
+        }
+        assert(unpinned);
+        (void)unpinned;
       }
     }
-    assert(false);
   }
 
-  // Sets the capacity of the cache. If new capacity is less than current size
-  // of the cache, oldest entries are evicted. In any case the hashtable is
-  // rehashed.
-  void SetCapacity(int capacity) {
-    Mutex::Lock lock(mutex_);
-
-    if (capacity_ == capacity) return;
-    ShrinkToCapacity(capacity);
-    capacity_ = capacity;
-
-    std::vector<Item*> new_hash(
-        static_cast<size_t>(capacity * kLoadFactor + 1));
-    std::memset(&new_hash[0], 0, sizeof(new_hash[0]) * new_hash.size());
-
-    if (size_ != 0) {
-      for (Item* head : hash_) {
-        for (Item* iter = head; head; head = head->next_in_hash) {
-          auto& new_hash_head = new_hash[hasher_(iter->key) % new_hash.size()];
-          iter->next_in_hash = new_hash_head;
-          new_hash_head = iter;
-        }
-      }
+  // Sets the capacity of the cache. If the used charge exceeds the new
+  // capacity, oldest entries are evicted. The slab and probe table only ever
+  // grow, as they are sized from the number of entries and not from the
+  // capacity.
+  void SetCapacity(int64_t capacity) {
+    std::vector<std::unique_ptr<V>> trash;
+    {
+      Mutex::Lock lock(mutex_);
+      if (capacity_ == capacity) return;
+      ShrinkToCapacity(capacity, &trash);
+      capacity_ = capacity;
     }
-    hash_.swap(new_hash);
   }
 
   // Clears the cache;
   void Clear() {
+    std::vector<std::unique_ptr<V>> trash;
+    {
+      Mutex::Lock lock(mutex_);
+      ShrinkToCapacity(0, &trash);
+    }
+  }
+
+  // Calls @visit(key, const value&) for every element, oldest first, so
+  // that replaying the sequence into another cache recreates the LRU order.
+  // The lock is held for the whole scan; do not touch the cache from @visit.
+  template <typename F>
+  void ForEach(F visit) const {
     Mutex::Lock lock(mutex_);
-    ShrinkToCapacity(0);
+    for (int idx = lru_tail_; idx >= 0; idx = slab_[idx].prev) {
+      visit(slab_[idx].key, static_cast<const V&>(*slab_[idx].value));
+    }
   }
 
-  int GetSize() const {
+  // Returns the total charge held, which with the default charge of 1 per
+  // insert is the number of entries.
+  int64_t GetSize() const {
     Mutex::Lock lock(mutex_);
-    return size_;
+    return charge_;
   }
-  int GetCapacity() const {
+  int64_t GetCapacity() const {
     Mutex::Lock lock(mutex_);
     return capacity_;
   }
 
  private:
   struct Item {
-    Item(K key, std::unique_ptr<V> value, int pins)
-        : key(key), value(std::move(value)), pins(pins) {}
     K key;
     std::unique_ptr<V> value;
+    size_t charge = 0;
     int pins = 0;
-    Item* next_in_hash = nullptr;
-    Item* prev_in_queue = nullptr;
-    Item* next_in_queue = nullptr;
+    // LRU links (towards newer/older) while active; the next free or next
+    // evicted entry while on the free or evicted list.
+    int prev = -1;
+    int next = -1;
   };
 
-  void EvictItem(Item* iter) REQUIRES(mutex_) {
+  // std::hash of an integer is typically the identity, which clusters badly
+  // in an open-addressing table; finalize it (splitmix64) first.
+  static size_t MixHash(size_t h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+  }
+
+  size_t IdealSlot(const K& key) const REQUIRES(mutex_) {
+    return MixHash(hasher_(key)) & (table_.size() - 1);
+  }
+
+  // Returns the probe table slot holding the active entry for @key, or -1.
+  int64_t FindTableSlot(const K& key) const REQUIRES(mutex_) {
+    const size_t mask = table_.size() - 1;
+    for (size_t slot = IdealSlot(key); table_[slot] >= 0;
+         slot = (slot + 1) & mask) {
+      if (slab_[table_[slot]].key == key) return slot;
+    }
+    return -1;
+  }
+
+  // Returns the probe table slot pointing at slab entry @idx; it must exist.
+  size_t FindTableSlotOfEntry(int idx) const REQUIRES(mutex_) {
+    const size_t mask = table_.size() - 1;
+    size_t slot = IdealSlot(slab_[idx].key);
+    while (table_[slot] != idx) slot = (slot + 1) & mask;
+    return slot;
+  }
+
+  void InsertIntoTable(int idx) REQUIRES(mutex_) {
+    const size_t mask = table_.size() - 1;
+    size_t slot = IdealSlot(slab_[idx].key);
+    while (table_[slot] >= 0) slot = (slot + 1) & mask;
+    table_[slot] = idx;
+  }
+
+  // Empties @slot, backward-shifting the following probe run so that linear
+  // probing needs no tombstones.
+  void EraseTableSlot(size_t slot) REQUIRES(mutex_) {
+    const size_t mask = table_.size() - 1;
+    table_[slot] = -1;
+    for (size_t next = (slot + 1) & mask; table_[next] >= 0;
+         next = (next + 1) & mask) {
+      const size_t ideal = IdealSlot(slab_[table_[next]].key);
+      // Leave the entry if its ideal slot lies cyclically in (slot, next];
+      // otherwise it belongs no later than @slot, so shift it back.
+      const bool in_place = (next > slot) ? (ideal > slot && ideal <= next)
+                                          : (ideal > slot || ideal <= next);
+      if (!in_place) {
+        table_[slot] = table_[next];
+        table_[next] = -1;
+        slot = next;
+      }
+    }
+  }
+
+  // Doubles the probe table when half full, reinserting all active entries.
+  void MaybeGrowTable() REQUIRES(mutex_) {
+    if (2 * static_cast<size_t>(size_) <= table_.size()) return;
+    size_t table_size = table_.size();
+    while (2 * static_cast<size_t>(size_) > table_size) table_size *= 2;
+    table_.assign(table_size, -1);
+    for (int idx = lru_head_; idx >= 0; idx = slab_[idx].next) {
+      InsertIntoTable(idx);
+    }
+  }
+
+  // Appends fresh slab entries (up to @new_size) to the free list.
+  void GrowSlab(size_t new_size) REQUIRES(mutex_) {
+    const size_t old_size = slab_.size();
+    slab_.resize(new_size);
+    for (size_t i = slab_.size(); i-- > old_size;) {
+      slab_[i].next = free_head_;
+      free_head_ = i;
+    }
+  }
+
+  int AllocateSlabEntry() REQUIRES(mutex_) {
+    if (free_head_ < 0) GrowSlab(slab_.size() * 2);
+    const int idx = free_head_;
+    free_head_ = slab_[idx].next;
+    return idx;
+  }
+
+  void FreeSlabEntry(int idx) REQUIRES(mutex_) {
+    slab_[idx].next = free_head_;
+    free_head_ = idx;
+  }
+
+  // Unlinks the entry in probe table slot @slot from the cache. Unpinned
+  // values go to @trash for the caller to destroy once the lock is released;
+  // pinned entries move to the evicted list and keep their slab slot.
+  void EvictItem(size_t slot, std::vector<std::unique_ptr<V>>* trash)
+      REQUIRES(mutex_) {
+    const int idx = table_[slot];
+    Item& item = slab_[idx];
     --size_;
+    charge_ -= item.charge;
+    EraseTableSlot(slot);
 
     // Remove from LRU list.
-    if (lru_head_ == iter) {
-      lru_head_ = iter->next_in_queue;
+    if (lru_head_ == idx) {
+      lru_head_ = item.next;
     } else {
-      iter->prev_in_queue->next_in_queue = iter->next_in_queue;
+      slab_[item.prev].next = item.next;
     }
-    if (lru_tail_ == iter) {
-      lru_tail_ = iter->prev_in_queue;
+    if (lru_tail_ == idx) {
+      lru_tail_ = item.prev;
     } else {
-      iter->next_in_queue->prev_in_queue = iter->prev_in_queue;
+      slab_[item.next].prev = item.prev;
     }
 
-    // Destroy or move into evicted list depending on whether it's pinned.
-    Item** cur = &hash_[hasher_(iter->key) % hash_.size()];
-    for (Item* el = *cur; el; el = el->next_in_hash) {
-      if (el == iter) {
-        *cur = el->next_in_hash;
-        if (el->pins == 0) {
-          --allocated_;
-          delete el;
-        } else {
-          el->next_in_hash = evicted_head_;
-          evicted_head_ = el;
-        }
-        return;
-      }
-      cur = &el->next_in_hash;
+    // Trash or move into evicted list depending on whether it's pinned.
+    if (item.pins == 0) {
+      --allocated_;
+      trash->push_back(std::move(item.value));
+      FreeSlabEntry(idx);
+    } else {
+      item.next = evicted_head_;
+      evicted_head_ = idx;
     }
-
-    assert(false);
   }
 
-  void ShrinkToCapacity(int capacity) REQUIRES(mutex_) {
+  void ShrinkToCapacity(int64_t capacity,
+                        std::vector<std::unique_ptr<V>>* trash)
+      REQUIRES(mutex_) {
     if (capacity < 0) capacity = 0;
-    while (lru_tail_ && size_ > capacity) {
-      EvictItem(lru_tail_);
+    while (lru_tail_ >= 0 && charge_ > capacity) {
+      EvictItem(FindTableSlotOfEntry(lru_tail_), trash);
     }
   }
 
-  void BringToFront(Item* iter) REQUIRES(mutex_) {
-    if (lru_head_ == iter) {
+  void BringToFront(int idx) REQUIRES(mutex_) {
+    Item& item = slab_[idx];
+    if (lru_head_ == idx) {
       return;
     } else {
-      iter->prev_in_queue->next_in_queue = iter->next_in_queue;
+      slab_[item.prev].next = item.next;
     }
-    if (lru_tail_ == iter) {
-      lru_tail_ = iter->prev_in_queue;
+    if (lru_tail_ == idx) {
+      lru_tail_ = item.prev;
     } else {
-      iter->next_in_queue->prev_in_queue = iter->prev_in_queue;
+      slab_[item.next].prev = item.prev;
     }
 
-    InsertIntoLru(iter);
+    InsertIntoLru(idx);
   }
 
-  void InsertIntoLru(Item* iter) REQUIRES(mutex_) {
-    iter->next_in_queue = lru_head_;
-    iter->prev_in_queue = nullptr;
+  void InsertIntoLru(int idx) REQUIRES(mutex_) {
+    Item& item = slab_[idx];
+    item.next = lru_head_;
+    item.prev = -1;
 
-    if (lru_head_) {
-      lru_head_->prev_in_queue = iter;
+    if (lru_head_ >= 0) {
+      slab_[lru_head_].prev = idx;
     }
-    lru_head_ = iter;
-    if (lru_tail_ == nullptr) {
-      lru_tail_ = iter;
+    lru_head_ = idx;
+    if (lru_tail_ < 0) {
+      lru_tail_ = idx;
     }
   }
 
-  // Fresh in front, stale on back.
-  int capacity_ GUARDED_BY(mutex_);
+  int64_t capacity_ GUARDED_BY(mutex_);
+  int64_t charge_ GUARDED_BY(mutex_) = 0;
   int size_ GUARDED_BY(mutex_) = 0;
   int allocated_ GUARDED_BY(mutex_) = 0;
-  Item* lru_head_ GUARDED_BY(mutex_) = nullptr;  // Newest elements.
-  Item* lru_tail_ GUARDED_BY(mutex_) = nullptr;  // Oldest elements.
-  Item* evicted_head_ GUARDED_BY(mutex_) =
-      nullptr;  // Evicted but pinned elements.
-  std::vector<Item*> hash_ GUARDED_BY(mutex_);
+  // Fresh in front, stale on back.
+  int lru_head_ GUARDED_BY(mutex_) = -1;  // Newest elements.
+  int lru_tail_ GUARDED_BY(mutex_) = -1;  // Oldest elements.
+  int free_head_ GUARDED_BY(mutex_) = -1;
+  int evicted_head_ GUARDED_BY(mutex_) =
+      -1;  // Evicted but pinned elements.
+  // All entries, active or not; links between them are slab indices.
+  std::vector<Item> slab_ GUARDED_BY(mutex_);
+  // Open-addressing (linear probing) table of slab indices, -1 when empty.
+  // Power-of-two sized, kept at most half full.
+  std::vector<int> table_ GUARDED_BY(mutex_);
   std::hash<K> hasher_ GUARDED_BY(mutex_);
 
   mutable Mutex mutex_;
 };
 
-// Convenience class for pinning cache items.
+// Sharded version of LruCache: the key space is split by hash over
+// independently locked shards, so that concurrent operations from many
+// threads mostly take different locks. LRU ordering is only kept within
+// each shard; with keys spread evenly over the shards that is a close
+// approximation of a global LRU at a fraction of the contention.
 template <class K, class V>
+class ShardedLruCache {
+ public:
+  ShardedLruCache(int64_t capacity = 128, int shards = 8) {
+    shards_.reserve(shards);
+    for (int i = 0; i < shards; ++i) {
+      shards_.emplace_back(
+          std::make_unique<LruCache<K, V>>(ShardCapacity(capacity, shards, i)));
+    }
+  }
+
+  // The methods below forward to the shard owning @key; see LruCache for
+  // their semantics.
+  V* Insert(K key, std::unique_ptr<V> val, size_t charge = 1,
+            bool pinned = false) {
+    return Shard(key)->Insert(key, std::move(val), charge, pinned);
+  }
+  bool ContainsKey(K key) { return Shard(key)->ContainsKey(key); }
+  V* LookupAndPin(K key) { return Shard(key)->LookupAndPin(key); }
+  void Unpin(K key, V* value) { Shard(key)->Unpin(key, value); }
+
+  void SetCapacity(int64_t capacity) {
+    const int shards = static_cast<int>(shards_.size());
+    for (int i = 0; i < shards; ++i) {
+      shards_[i]->SetCapacity(ShardCapacity(capacity, shards, i));
+    }
+  }
+
+  void Clear() {
+    for (auto& shard : shards_) shard->Clear();
+  }
+
+  // Visits every element, oldest first within each shard; see
+  // LruCache::ForEach.
+  template <typename F>
+  void ForEach(F visit) const {
+    for (const auto& shard : shards_) shard->ForEach(visit);
+  }
+
+  int64_t GetSize() const {
+    int64_t size = 0;
+    for (const auto& shard : shards_) size += shard->GetSize();
+    return size;
+  }
+
+  int64_t GetCapacity() const {
+    int64_t capacity = 0;
+    for (const auto& shard : shards_) capacity += shard->GetCapacity();
+    return capacity;
+  }
+
+ private:
+  // Distributes @capacity over the shards so the total is exact.
+  static int64_t ShardCapacity(int64_t capacity, int shards, int shard_idx) {
+    return capacity / shards + (shard_idx < capacity % shards ? 1 : 0);
+  }
+
+  LruCache<K, V>* Shard(K key) {
+    return shards_[hasher_(key) % shards_.size()].get();
+  }
+
+  std::vector<std::unique_ptr<LruCache<K, V>>> shards_;
+  std::hash<K> hasher_;
+};
+
+// Convenience class for pinning cache items.
+template <class K, class V, class C = LruCache<K, V>>
 class LruCacheLock {
  public:
   // Looks up the value in @cache by @key and pins it if found.
-  LruCacheLock(LruCache<K, V>* cache, K key)
+  LruCacheLock(C* cache, K key)
       : cache_(cache), key_(key), value_(cache->LookupAndPin(key_)) {}
 
   // Unpins the cache entry (if holds).
@@ -306,7 +514,7 @@ class LruCacheLock {
   }
 
  private:
-  LruCache<K, V>* cache_ = nullptr;
+  C* cache_ = nullptr;
   K key_;
   V* value_ = nullptr;
 };
@@ -0,0 +1,72 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace lczero {
+
+// Fast approximate log2/exp2/pow. Branch-free and built only from
+// arithmetic and bit operations, so loops over arrays of them
+// auto-vectorize, unlike libm calls. Good to ~1.5e-3 absolute in log2 and
+// ~2e-4 relative in exp2 (cubic fits), which is far below network output
+// noise; do not use where exact libm semantics matter.
+
+// Valid for finite positive @x; no error handling for zero, negatives,
+// infinities or NaN.
+inline float FastLog2(const float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  const int exponent = static_cast<int>(bits >> 23) - 127;
+  // Mantissa in [1, 2).
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float m;
+  std::memcpy(&m, &bits, sizeof(m));
+  return exponent +
+         (-2.13388867f + (3.01085106f + (-1.02955843f + 0.15392465f * m) * m) *
+                             m);
+}
+
+// Valid for @x up to roughly 127; no overflow handling. Arguments below
+// -126 flush to zero (the exponent is clamped so underflow cannot wander
+// into the inf/NaN bit patterns).
+inline float FastExp2(const float x) {
+  // floor(x), as a conversion (truncation of a shifted positive value)
+  // rather than std::floor, which the vectorizer refuses.
+  const int integral = std::max(static_cast<int>(x + 383.0f) - 383, -127);
+  const float frac = x - integral;
+  // 2^frac on [0, 1).
+  const float factor =
+      0.99981246f +
+      (0.69683624f + (0.22412837f + 0.07902041f * frac) * frac) * frac;
+  uint32_t bits = static_cast<uint32_t>(integral + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return scale * factor;
+}
+
+// pow(base, exponent) for finite positive @base.
+inline float FastPow(const float base, const float exponent) {
+  return FastExp2(exponent * FastLog2(base));
+}
+
+}  // namespace lczero
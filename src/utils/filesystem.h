@@ -39,4 +39,23 @@ uint64_t GetFileSize(const std::string& filename);
 // Returns modification time of a file. Throws exception if file doesn't exist.
 time_t GetFileTime(const std::string& filename);
 
+// Read-only view of a whole file mapped into memory. The mapping stays valid
+// for the lifetime of the object.
+class MemoryMappedFile {
+ public:
+  // Maps @filename. Throws exception if the file cannot be opened or mapped.
+  explicit MemoryMappedFile(const std::string& filename);
+  ~MemoryMappedFile();
+
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+  const char* data() const { return static_cast<const char*>(data_); }
+  uint64_t size() const { return size_; }
+
+ private:
+  void* data_ = nullptr;
+  uint64_t size_ = 0;
+};
+
 }  // namespace lczero
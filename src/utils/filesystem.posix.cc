@@ -21,7 +21,10 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 namespace lczero {
 
@@ -75,4 +78,24 @@ time_t GetFileTime(const std::string& filename) {
 #endif
 }
 
+MemoryMappedFile::MemoryMappedFile(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw Exception("Cannot open file: " + filename);
+  struct stat s;
+  if (fstat(fd, &s) < 0 || s.st_size == 0) {
+    close(fd);
+    throw Exception("Cannot stat file: " + filename);
+  }
+  void* data = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (data == MAP_FAILED) throw Exception("Cannot map file: " + filename);
+  data_ = data;
+  size_ = s.st_size;
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (data_) munmap(data_, size_);
+}
+
 }  // namespace lczero
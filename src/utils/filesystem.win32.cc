@@ -62,4 +62,32 @@ time_t GetFileTime(const std::string& filename) {
          << 32) + s.ftLastWriteTime.dwLowDateTime;
 }
 
+MemoryMappedFile::MemoryMappedFile(const std::string& filename) {
+  HANDLE file =
+      CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw Exception("Cannot open file: " + filename);
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    throw Exception("Cannot stat file: " + filename);
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  // The view keeps its own references to the file and the mapping.
+  CloseHandle(file);
+  if (!mapping) throw Exception("Cannot map file: " + filename);
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data) throw Exception("Cannot map file: " + filename);
+  data_ = data;
+  size_ = size.QuadPart;
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (data_) UnmapViewOfFile(data_);
+}
+
 }  // namespace lczero
\ No newline at end of file
@@ -0,0 +1,94 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstring>
+
+#pragma once
+namespace lczero {
+
+// Software conversions between single precision and IEEE 754 half precision,
+// for backends which store tensors in fp16 on the device. Rounds to nearest
+// even, and preserves infinities, NaNs and subnormals.
+
+inline uint16_t FP32toFP16(float f32) {
+  uint32_t f;
+  std::memcpy(&f, &f32, sizeof(f));
+
+  const uint16_t sign = (f >> 16) & 0x8000;
+  const uint32_t exp = (f >> 23) & 0xff;
+  uint32_t mant = f & 0x7fffff;
+
+  if (exp == 0xff) {
+    // Infinity or NaN. Keep a payload bit set for NaNs.
+    return sign | 0x7c00 | (mant ? 0x200 | (mant >> 13) : 0);
+  }
+
+  const int32_t new_exp = static_cast<int32_t>(exp) - 127 + 15;
+  if (new_exp >= 31) {
+    // Overflows half precision range, becomes infinity.
+    return sign | 0x7c00;
+  }
+
+  uint32_t shift = 13;
+  if (new_exp <= 0) {
+    // Subnormal in half precision (or underflow to zero).
+    if (new_exp < -10) return sign;
+    mant |= 0x800000;
+    shift = 14 - new_exp;
+  }
+
+  uint16_t h = (new_exp > 0 ? new_exp << 10 : 0) | (mant >> shift);
+  // Round to nearest, ties to even. The carry may propagate into the
+  // exponent; that is the correct result in every case.
+  const uint32_t rest = mant & ((1u << shift) - 1);
+  const uint32_t halfway = 1u << (shift - 1);
+  if (rest > halfway || (rest == halfway && (h & 1))) h++;
+  return sign | h;
+}
+
+inline float FP16toFP32(uint16_t f16) {
+  const uint32_t sign = static_cast<uint32_t>(f16 & 0x8000) << 16;
+  uint32_t exp = (f16 >> 10) & 0x1f;
+  uint32_t mant = f16 & 0x3ff;
+
+  uint32_t f;
+  if (exp == 0) {
+    if (mant == 0) {
+      f = sign;
+    } else {
+      // Subnormal, renormalize.
+      exp = 127 - 15 + 1;
+      while (!(mant & 0x400)) {
+        mant <<= 1;
+        exp--;
+      }
+      f = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+  } else if (exp == 0x1f) {
+    f = sign | 0x7f800000 | (mant << 13);
+  } else {
+    f = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+  }
+
+  float f32;
+  std::memcpy(&f32, &f, sizeof(f32));
+  return f32;
+}
+
+}  // namespace lczero
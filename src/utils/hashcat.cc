@@ -0,0 +1,102 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/hashcat.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define USE_AESNI_HASHCAT
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace lczero {
+namespace {
+
+uint64_t HashCatScalar(std::initializer_list<uint64_t> args) {
+  uint64_t hash = 0;
+  for (uint64_t x : args) hash = HashCat(hash, x);
+  return hash;
+}
+
+#ifdef USE_AESNI_HASHCAT
+
+#if defined(_MSC_VER)
+#define AESNI_TARGET
+#else
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
+// One aesenc per 128 input bits, two finalization rounds. A single AES round
+// already diffuses every input bit into every output byte, which the
+// multiply-rotate chain needs several iterations for, and the hardware does
+// it in a couple of cycles.
+AESNI_TARGET uint64_t HashCatAesni(std::initializer_list<uint64_t> args) {
+  __m128i state = _mm_set_epi64x(0x9e3779b97f4a7c15ll, 0x6a09e667f3bcc909ll);
+  const __m128i key = _mm_set_epi64x(0xbb67ae8584caa73bll, 0xc2b2ae3d27d4eb4fll);
+  const uint64_t* it = args.begin();
+  size_t remaining = args.size();
+  for (; remaining >= 2; it += 2, remaining -= 2) {
+    const __m128i block =
+        _mm_set_epi64x(static_cast<long long>(it[1]),
+                       static_cast<long long>(it[0]));
+    state = _mm_aesenc_si128(_mm_xor_si128(state, block), key);
+  }
+  if (remaining) {
+    // Pad the odd word with the length so it cannot alias a two-word block.
+    const __m128i block =
+        _mm_set_epi64x(static_cast<long long>(args.size()),
+                       static_cast<long long>(*it));
+    state = _mm_aesenc_si128(_mm_xor_si128(state, block), key);
+  }
+  state = _mm_aesenc_si128(state, key);
+  state = _mm_aesenc_si128(state, key);
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(state)) ^
+         static_cast<uint64_t>(
+             _mm_cvtsi128_si64(_mm_unpackhi_epi64(state, state)));
+}
+
+bool HasAesni() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 25)) != 0;
+#else
+  return __builtin_cpu_supports("aes");
+#endif
+}
+
+#endif  // USE_AESNI_HASHCAT
+
+uint64_t (*ChooseHashCat())(std::initializer_list<uint64_t>) {
+#ifdef USE_AESNI_HASHCAT
+  if (HasAesni()) return HashCatAesni;
+#endif
+  return HashCatScalar;
+}
+
+}  // namespace
+
+uint64_t HashCat(std::initializer_list<uint64_t> args) {
+  static const auto impl = ChooseHashCat();
+  return impl(args);
+}
+
+}  // namespace lczero
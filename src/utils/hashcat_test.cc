@@ -18,6 +18,8 @@
 
 #include "utils/hashcat.h"
 #include <gtest/gtest.h>
+#include <random>
+#include <unordered_set>
 
 namespace lczero {
 
@@ -29,6 +31,52 @@ TEST(HashCat, TestCollision) {
   EXPECT_NE(hash1, hash2);
 }
 
+TEST(HashCat, DistinctInputs) {
+  std::mt19937_64 rng(123);
+  std::unordered_set<uint64_t> seen;
+  for (int i = 0; i < 200000; ++i) {
+    uint64_t hash = HashCat({rng(), rng(), rng(), rng(), rng()});
+    EXPECT_TRUE(seen.insert(hash).second) << "at input " << i;
+  }
+}
+
+TEST(HashCat, Avalanche) {
+  // Flipping one input bit should flip about half of the 64 output bits.
+  std::mt19937_64 rng(7);
+  double flipped_total = 0.0;
+  int cases = 0;
+  for (int trial = 0; trial < 20; ++trial) {
+    uint64_t words[5];
+    for (auto& word : words) word = rng();
+    const uint64_t base =
+        HashCat({words[0], words[1], words[2], words[3], words[4]});
+    for (int word = 0; word < 5; ++word) {
+      for (int bit = 0; bit < 64; bit += 7) {
+        words[word] ^= 1ull << bit;
+        const uint64_t changed =
+            HashCat({words[0], words[1], words[2], words[3], words[4]});
+        words[word] ^= 1ull << bit;
+        uint64_t diff = base ^ changed;
+        int flipped = 0;
+        while (diff) {
+          diff &= diff - 1;
+          ++flipped;
+        }
+        flipped_total += flipped;
+        ++cases;
+      }
+    }
+  }
+  const double average = flipped_total / cases;
+  EXPECT_GT(average, 24.0);
+  EXPECT_LT(average, 40.0);
+}
+
+TEST(HashCat, LengthMatters) {
+  EXPECT_NE(HashCat({1}), HashCat({1, 0}));
+  EXPECT_NE(HashCat({}), HashCat({0}));
+}
+
 }  // namespace lczero
 
 int main(int argc, char** argv) {
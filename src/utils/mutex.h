@@ -18,13 +18,78 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <shared_mutex>
+#include <string>
 #include "utils/cppattributes.h"
 
+#ifdef MUTEX_STATS
+#include <chrono>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace lczero {
 
+// Per-mutex contention counters, collected when compiled with -DMUTEX_STATS
+// (meson option "mutex_stats"). Counting costs atomic increments on every
+// acquisition, so it's off by default; enable it to find out which locks are
+// worth optimizing before reaching for lock-free structures.
+struct MutexStats {
+  std::atomic<std::uint64_t> acquisitions{0};
+  // Acquisitions which found the mutex taken.
+  std::atomic<std::uint64_t> contended{0};
+  // Total time contended acquisitions spent waiting.
+  std::atomic<std::uint64_t> wait_ns{0};
+
+  std::string ToString(const char* name) const {
+    return std::string(name) + ": " + std::to_string(acquisitions.load()) +
+           " acquisitions, " + std::to_string(contended.load()) +
+           " contended, " + std::to_string(wait_ns.load() / 1000) +
+           "us waited";
+  }
+};
+
+#ifdef MUTEX_STATS
+// Times one contended acquisition into @stats.
+class MutexStatsTimer {
+ public:
+  MutexStatsTimer(MutexStats* stats) : stats_(stats) {
+    stats_->contended.fetch_add(1, std::memory_order_relaxed);
+    start_ = std::chrono::steady_clock::now();
+  }
+  ~MutexStatsTimer() {
+    stats_->wait_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_)
+            .count(),
+        std::memory_order_relaxed);
+  }
+
+ private:
+  MutexStats* stats_;
+  std::chrono::steady_clock::time_point start_;
+};
+#define MUTEX_STATS_ACQUISITION() \
+  stats_.acquisitions.fetch_add(1, std::memory_order_relaxed)
+#define MUTEX_STATS_CONTENDED() MutexStatsTimer stats_timer_(&stats_)
+#define MUTEX_STATS_MEMBERS()                              \
+ public:                                                   \
+  const MutexStats& stats() const { return stats_; }       \
+                                                           \
+ private:                                                  \
+  MutexStats stats_;
+#else
+#define MUTEX_STATS_ACQUISITION()
+#define MUTEX_STATS_CONTENDED()
+#define MUTEX_STATS_MEMBERS()
+#endif
+
 // Implementation of reader-preferenced shared mutex. Based on fair shared
 // mutex.
 class CAPABILITY("mutex") RpSharedMutex {
@@ -54,58 +119,261 @@ class CAPABILITY("mutex") RpSharedMutex {
 };
 
 // std::mutex wrapper for clang thread safety annotation.
-class CAPABILITY("mutex") Mutex {
+class CAPABILITY("mutex") StdMutex {
  public:
   // std::unique_lock<std::mutex> wrapper.
   class SCOPED_CAPABILITY Lock {
    public:
-    Lock(Mutex& m) ACQUIRE(m) : lock_(m.get_raw()) {}
-    ~Lock() RELEASE() {}
+    Lock(StdMutex& m) ACQUIRE(m) : m_(m) { m_.lock(); }
+    ~Lock() RELEASE() { m_.unlock(); }
 
    private:
-    std::unique_lock<std::mutex> lock_;
+    StdMutex& m_;
   };
 
-  void lock() ACQUIRE() { mutex_.lock(); }
+  void lock() ACQUIRE() {
+    MUTEX_STATS_ACQUISITION();
+#ifdef MUTEX_STATS
+    if (mutex_.try_lock()) return;
+    MUTEX_STATS_CONTENDED();
+#endif
+    mutex_.lock();
+  }
   void unlock() RELEASE() { mutex_.unlock(); }
   std::mutex& get_raw() { return mutex_; }
 
  private:
   std::mutex mutex_;
+  MUTEX_STATS_MEMBERS()
 };
 
 // std::shared_mutex wrapper for clang thread safety annotation.
-class CAPABILITY("mutex") SharedMutex {
+class CAPABILITY("mutex") StdSharedMutex {
  public:
   // std::unique_lock<std::shared_mutex> wrapper.
   class SCOPED_CAPABILITY Lock {
    public:
-    Lock(SharedMutex& m) ACQUIRE(m) : lock_(m.get_raw()) {}
-    ~Lock() RELEASE() {}
+    Lock(StdSharedMutex& m) ACQUIRE(m) : m_(m) { m_.lock(); }
+    ~Lock() RELEASE() { m_.unlock(); }
 
    private:
-    std::unique_lock<std::shared_timed_mutex> lock_;
+    StdSharedMutex& m_;
   };
 
   // std::shared_lock<std::shared_mutex> wrapper.
   class SCOPED_CAPABILITY SharedLock {
    public:
-    SharedLock(SharedMutex& m) ACQUIRE_SHARED(m) : lock_(m.get_raw()) {}
-    ~SharedLock() RELEASE() {}
+    SharedLock(StdSharedMutex& m) ACQUIRE_SHARED(m) : m_(m) {
+      m_.lock_shared();
+    }
+    ~SharedLock() RELEASE() { m_.unlock_shared(); }
 
    private:
-    std::shared_lock<std::shared_timed_mutex> lock_;
+    StdSharedMutex& m_;
   };
 
-  void lock() ACQUIRE() { mutex_.lock(); }
+  void lock() ACQUIRE() {
+    MUTEX_STATS_ACQUISITION();
+#ifdef MUTEX_STATS
+    if (mutex_.try_lock()) return;
+    MUTEX_STATS_CONTENDED();
+#endif
+    mutex_.lock();
+  }
   void unlock() RELEASE() { mutex_.unlock(); }
-  void lock_shared() ACQUIRE_SHARED() { mutex_.lock_shared(); }
+  void lock_shared() ACQUIRE_SHARED() {
+    MUTEX_STATS_ACQUISITION();
+#ifdef MUTEX_STATS
+    if (mutex_.try_lock_shared()) return;
+    MUTEX_STATS_CONTENDED();
+#endif
+    mutex_.lock_shared();
+  }
   void unlock_shared() RELEASE_SHARED() { mutex_.unlock_shared(); }
 
   std::shared_timed_mutex& get_raw() { return mutex_; }
 
  private:
   std::shared_timed_mutex mutex_;
+  MUTEX_STATS_MEMBERS()
+};
+
+// How long contended lock attempts spin in userspace before parking in the
+// kernel. The critical sections under the node/search locks are tens of
+// nanoseconds, so at this budget nearly all contended acquisitions succeed
+// while spinning and never pay the futex round-trip.
+constexpr int kSpinIterations = 1024;
+
+inline void SpinPause() {
+#if defined(_MSC_VER)
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// Spin-then-park exclusive mutex. Selected as Mutex by -DUSE_SPINLOCKS
+// (meson option "spinlocks").
+class CAPABILITY("mutex") SpinMutex {
+ public:
+  class SCOPED_CAPABILITY Lock {
+   public:
+    Lock(SpinMutex& m) ACQUIRE(m) : m_(m) { m_.lock(); }
+    ~Lock() RELEASE() { m_.unlock(); }
+
+   private:
+    SpinMutex& m_;
+  };
+
+  void lock() ACQUIRE() {
+    MUTEX_STATS_ACQUISITION();
+    int expected = kFree;
+    if (state_.compare_exchange_strong(expected, kLocked,
+                                       std::memory_order_acquire)) {
+      return;
+    }
+    LockSlow();
+  }
+
+  void unlock() RELEASE() {
+    if (state_.exchange(kFree, std::memory_order_release) == kLockedWaiters) {
+      std::lock_guard<std::mutex> guard(parking_mutex_);
+      cv_.notify_one();
+    }
+  }
+
+ private:
+  enum : int { kFree = 0, kLocked = 1, kLockedWaiters = 2 };
+
+  void LockSlow() {
+    MUTEX_STATS_CONTENDED();
+    for (int i = 0; i < kSpinIterations; ++i) {
+      if (state_.load(std::memory_order_relaxed) == kFree) {
+        int expected = kFree;
+        if (state_.compare_exchange_strong(expected, kLocked,
+                                           std::memory_order_acquire)) {
+          return;
+        }
+      }
+      SpinPause();
+    }
+    // Park. Acquiring as kLockedWaiters may overstate waiters for one
+    // unlock, which then just does a spurious notify.
+    std::unique_lock<std::mutex> parking_lock(parking_mutex_);
+    while (state_.exchange(kLockedWaiters, std::memory_order_acquire) !=
+           kFree) {
+      cv_.wait(parking_lock);
+    }
+  }
+
+  std::atomic<int> state_{kFree};
+  std::mutex parking_mutex_;
+  std::condition_variable cv_;
+  MUTEX_STATS_MEMBERS()
+};
+
+// Spin-then-park shared mutex, same idea as SpinMutex. Selected as
+// SharedMutex by -DUSE_SPINLOCKS.
+class CAPABILITY("mutex") SpinSharedMutex {
+ public:
+  class SCOPED_CAPABILITY Lock {
+   public:
+    Lock(SpinSharedMutex& m) ACQUIRE(m) : m_(m) { m_.lock(); }
+    ~Lock() RELEASE() { m_.unlock(); }
+
+   private:
+    SpinSharedMutex& m_;
+  };
+
+  class SCOPED_CAPABILITY SharedLock {
+   public:
+    SharedLock(SpinSharedMutex& m) ACQUIRE_SHARED(m) : m_(m) {
+      m_.lock_shared();
+    }
+    ~SharedLock() RELEASE() { m_.unlock_shared(); }
+
+   private:
+    SpinSharedMutex& m_;
+  };
+
+  void lock() ACQUIRE() {
+    MUTEX_STATS_ACQUISITION();
+    if (TryLockExclusive()) return;
+    LockSlow(true);
+  }
+
+  void unlock() RELEASE() {
+    // Sequentially consistent so that the store is ordered against the
+    // parked_ check in WakeParked() (and a parking thread's state_ probe
+    // against its parked_ increment): one side always sees the other.
+    state_.store(0, std::memory_order_seq_cst);
+    WakeParked();
+  }
+
+  void lock_shared() ACQUIRE_SHARED() {
+    MUTEX_STATS_ACQUISITION();
+    if (TryLockShared()) return;
+    LockSlow(false);
+  }
+
+  void unlock_shared() RELEASE_SHARED() {
+    if (state_.fetch_sub(1) == 1) WakeParked();
+  }
+
+ private:
+  // state_ is the number of active readers, or -1 while a writer holds the
+  // mutex.
+  bool TryLockExclusive() {
+    int expected = 0;
+    return state_.compare_exchange_strong(expected, -1,
+                                          std::memory_order_acquire);
+  }
+  bool TryLockShared() {
+    // Always attempt the CAS: as a read-modify-write it observes the latest
+    // state_, which the parking protocol relies on.
+    int readers = std::max(0, state_.load(std::memory_order_relaxed));
+    while (true) {
+      if (state_.compare_exchange_weak(readers, readers + 1,
+                                       std::memory_order_acquire)) {
+        return true;
+      }
+      if (readers < 0) return false;
+    }
+  }
+
+  void LockSlow(bool exclusive) {
+    MUTEX_STATS_CONTENDED();
+    for (int i = 0; i < kSpinIterations; ++i) {
+      if (exclusive ? TryLockExclusive() : TryLockShared()) return;
+      SpinPause();
+    }
+    std::unique_lock<std::mutex> parking_lock(parking_mutex_);
+    ++parked_;
+    cv_.wait(parking_lock, [this, exclusive]() {
+      return exclusive ? TryLockExclusive() : TryLockShared();
+    });
+    --parked_;
+  }
+
+  void WakeParked() {
+    if (parked_.load() == 0) return;
+    std::lock_guard<std::mutex> guard(parking_mutex_);
+    cv_.notify_all();
+  }
+
+  std::atomic<int> state_{0};
+  std::atomic<int> parked_{0};
+  std::mutex parking_mutex_;
+  std::condition_variable cv_;
+  MUTEX_STATS_MEMBERS()
 };
 
-}  // namespace lczero
\ No newline at end of file
+#ifdef USE_SPINLOCKS
+using Mutex = SpinMutex;
+using SharedMutex = SpinSharedMutex;
+#else
+using Mutex = StdMutex;
+using SharedMutex = StdSharedMutex;
+#endif
+
+}  // namespace lczero
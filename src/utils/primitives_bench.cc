@@ -0,0 +1,160 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark for the utility primitives under everything else: HashCat,
+// IterateBits, TransposeTensor and the (sharded) LRU cache, the last one
+// also under thread contention. Built as a separate binary (meson benchmark
+// target "Primitives") so that changes to these can land with before/after
+// numbers from a common harness. All inputs are seeded deterministically,
+// so runs are comparable.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "utils/bititer.h"
+#include "utils/cache.h"
+#include "utils/hashcat.h"
+#include "utils/transpose.h"
+
+namespace {
+
+using namespace lczero;
+
+int64_t ElapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void Report(const char* name, std::uint64_t items, int64_t duration_us) {
+  std::cout << name << ": " << items * 1000000 / std::max<int64_t>(1, duration_us)
+            << " items/sec" << std::endl;
+}
+
+std::vector<std::uint64_t> RandomWords(size_t count, std::uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<std::uint64_t> result(count);
+  for (auto& word : result) word = rng();
+  return result;
+}
+
+void BenchHashCat() {
+  const auto words = RandomWords(1 << 16, 8893);
+  const int kRounds = 2000;
+  std::uint64_t sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    std::uint64_t hash = round;
+    for (auto word : words) hash = HashCat(hash, word);
+    sink += hash;
+  }
+  Report("HashCat (words)", static_cast<std::uint64_t>(words.size()) * kRounds,
+         ElapsedUs(start));
+  if (sink == 42) std::cout << "";  // Defeat dead code elimination.
+}
+
+void BenchIterateBits() {
+  // Mix of sparse and dense masks; board masks in the search are usually
+  // sparse.
+  auto masks = RandomWords(1 << 14, 17923);
+  for (size_t i = 0; i < masks.size(); i += 2) {
+    masks[i] &= RandomWords(1, i)[0] & masks[(i + 1) % masks.size()];
+  }
+  const int kRounds = 2000;
+  std::uint64_t bits = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (auto mask : masks) {
+      for (auto bit : IterateBits(mask)) bits += bit;
+    }
+  }
+  Report("IterateBits (bit indices summed)", bits, ElapsedUs(start));
+}
+
+void BenchTransposeTensor() {
+  // The shape of a 256x256 conv weight, the dominant transpose when loading
+  // big nets.
+  const std::vector<int> dims = {256, 256, 3, 3};
+  size_t size = 1;
+  for (int dim : dims) size *= dim;
+  std::vector<float> from(size);
+  std::mt19937 rng(433);
+  for (auto& value : from) value = rng() / 1e9f;
+  std::vector<float> to(size);
+  const int kRounds = 50;
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    TransposeTensor(dims, {3, 2, 0, 1}, from, to.data());
+  }
+  Report("TransposeTensor (elements)",
+         static_cast<std::uint64_t>(size) * kRounds, ElapsedUs(start));
+}
+
+// One thread's worth of the cache workload: a lookup-heavy mix over a key
+// space about twice the cache capacity, roughly what the NN cache sees.
+void CacheWorker(ShardedLruCache<std::uint64_t, std::uint64_t>* cache,
+                 std::uint32_t seed, int ops, std::uint64_t* hits) {
+  std::mt19937_64 rng(seed);
+  std::uint64_t local_hits = 0;
+  for (int i = 0; i < ops; ++i) {
+    const std::uint64_t key = rng() % (1 << 17);
+    auto* value = cache->LookupAndPin(key);
+    if (value) {
+      local_hits += *value;
+      cache->Unpin(key, value);
+    } else {
+      cache->Insert(key, std::make_unique<std::uint64_t>(1));
+    }
+  }
+  *hits = local_hits;
+}
+
+void BenchLruCache() {
+  for (int threads : {1, 2, 4}) {
+    ShardedLruCache<std::uint64_t, std::uint64_t> cache(1 << 16);
+    const int kOpsPerThread = 1 << 21;
+    std::vector<std::uint64_t> hits(threads);
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; ++i) {
+      workers.emplace_back(CacheWorker, &cache, 100 + i, kOpsPerThread,
+                           &hits[i]);
+    }
+    for (auto& worker : workers) worker.join();
+    const auto us = ElapsedUs(start);
+    std::string name = "ShardedLruCache lookup/insert, " +
+                       std::to_string(threads) + " thread(s)";
+    Report(name.c_str(),
+           static_cast<std::uint64_t>(kOpsPerThread) * threads, us);
+  }
+}
+
+}  // namespace
+
+int main() {
+  BenchHashCat();
+  BenchIterateBits();
+  BenchTransposeTensor();
+  BenchLruCache();
+  return 0;
+}
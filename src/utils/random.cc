@@ -17,19 +17,38 @@
 */
 
 #include "random.h"
+#include <atomic>
+#include <cstdint>
 #include <random>
 
 namespace lczero {
 
-Random::Random() : gen_(std::random_device()()) {}
+namespace {
+// Hands out a distinct, well-mixed seed per call. The base comes from
+// std::random_device once per process; increments are mixed through the
+// splitmix64 finalizer so consecutive threads get unrelated streams.
+std::uint64_t NextSeed() {
+  static std::atomic<std::uint64_t> counter{
+      static_cast<std::uint64_t>(std::random_device()())};
+  std::uint64_t seed = counter.fetch_add(0x9e3779b97f4a7c15ull);
+  seed ^= seed >> 30;
+  seed *= 0xbf58476d1ce4e5b9ull;
+  seed ^= seed >> 27;
+  seed *= 0x94d049bb133111ebull;
+  seed ^= seed >> 31;
+  return seed;
+}
+}  // namespace
+
+Random::Random()
+    : gen_(static_cast<std::mt19937::result_type>(NextSeed())) {}
 
 Random& Random::Get() {
-  static Random rand;
+  thread_local Random rand;
   return rand;
 }
 
 int Random::GetInt(int min, int max) {
-  Mutex::Lock lock(mutex_);
   std::uniform_int_distribution<> dist(min, max);
   return dist(gen_);
 }
@@ -37,13 +56,11 @@ int Random::GetInt(int min, int max) {
 bool Random::GetBool() { return GetInt(0, 1) != 0; }
 
 double Random::GetDouble(double maxval) {
-  Mutex::Lock lock(mutex_);
   std::uniform_real_distribution<> dist(0.0, maxval);
   return dist(gen_);
 }
 
 float Random::GetFloat(float maxval) {
-  Mutex::Lock lock(mutex_);
   std::uniform_real_distribution<> dist(0.0, maxval);
   return dist(gen_);
 }
@@ -57,7 +74,6 @@ std::string Random::GetString(int length) {
 }
 
 double Random::GetGamma(double alpha, double beta) {
-  Mutex::Lock lock(mutex_);
   std::gamma_distribution<double> dist(alpha, beta);
   return dist(gen_);
 }
@@ -20,10 +20,14 @@
 
 #include <random>
 #include <string>
-#include "utils/mutex.h"
 
 namespace lczero {
 
+// Thread-local random number generation: Get() returns this thread's own
+// generator, so sampling (Dirichlet noise, temperature move picks, resign
+// playthrough decisions) never takes a lock however many game threads run.
+// Each thread's generator is seeded from a process-wide sequence, giving
+// distinct streams.
 class Random {
  public:
   static Random& Get();
@@ -38,8 +42,7 @@ class Random {
  private:
   Random();
 
-  Mutex mutex_;
-  std::mt19937 gen_ GUARDED_BY(mutex_);
+  std::mt19937 gen_;
 };
 
 }  // namespace lczero
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/slabpool.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lczero {
+namespace {
+
+std::atomic<SlabPool::MemoryMode> memory_mode{SlabPool::MemoryMode::kMalloc};
+
+#ifdef __linux__
+
+// NUMA policy constants and syscalls, used directly so that there is no
+// dependency on libnuma. Kernels without NUMA support just fail the calls,
+// which we treat as "single node, nothing to interleave".
+constexpr int kMpolInterleave = 3;         // MPOL_INTERLEAVE
+constexpr int kMpolFMemsAllowed = 1 << 2;  // MPOL_F_MEMS_ALLOWED
+constexpr size_t kNodeMaskWords = 16;      // Up to 1024 NUMA nodes.
+
+// Asks the kernel to spread the (not yet touched) mapping round-robin over
+// all NUMA nodes this process may allocate on. Best effort: on single-node
+// machines or kernels without NUMA the slab simply stays first-touch.
+void InterleaveSlab(void* ptr, size_t size) {
+  static const auto nodes = []() -> std::array<unsigned long, kNodeMaskWords> {
+    std::array<unsigned long, kNodeMaskWords> mask{};
+#ifdef SYS_get_mempolicy
+    if (syscall(SYS_get_mempolicy, nullptr, mask.data(),
+                kNodeMaskWords * sizeof(unsigned long) * 8, nullptr,
+                kMpolFMemsAllowed) != 0) {
+      mask.fill(0);
+    }
+#endif
+    return mask;
+  }();
+  int node_count = 0;
+  for (unsigned long word : nodes) node_count += __builtin_popcountl(word);
+  if (node_count < 2) return;
+#ifdef SYS_mbind
+  syscall(SYS_mbind, ptr, size, kMpolInterleave, nodes.data(),
+          kNodeMaskWords * sizeof(unsigned long) * 8, 0);
+#else
+  (void)ptr;
+  (void)size;
+#endif
+}
+
+// Maps one slab with 2MB page backing: explicitly reserved huge pages when
+// available, otherwise an aligned mapping that transparent huge pages can
+// promote. Returns nullptr if even plain mmap fails.
+char* MapSlab(size_t size) {
+  const int prot = PROT_READ | PROT_WRITE;
+#ifdef MAP_HUGETLB
+  void* ptr =
+      mmap(nullptr, size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (ptr != MAP_FAILED) return static_cast<char*>(ptr);
+#endif
+  // No reserved huge pages (the common case). Map with 2MB alignment by
+  // overallocating and trimming, so that THP can use a huge page, and ask
+  // for promotion explicitly in case THP is set to madvise-only.
+  const size_t padded = size + size - 1;
+  void* raw = mmap(nullptr, padded, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) return nullptr;
+  const uintptr_t base = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t aligned = (base + size - 1) & ~(uintptr_t)(size - 1);
+  if (aligned != base) munmap(raw, aligned - base);
+  const uintptr_t end = base + padded;
+  if (aligned + size != end) {
+    munmap(reinterpret_cast<void*>(aligned + size), end - (aligned + size));
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+  return reinterpret_cast<char*>(aligned);
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+void SlabPool::SetMemoryModeByName(const std::string& name) {
+  MemoryMode mode;
+  if (name == "malloc") {
+    mode = MemoryMode::kMalloc;
+  } else if (name == "huge-pages") {
+    mode = MemoryMode::kHugePages;
+  } else if (name == "huge-pages-interleave") {
+    mode = MemoryMode::kHugePagesInterleave;
+  } else {
+    return;
+  }
+#ifndef __linux__
+  if (mode != MemoryMode::kMalloc) {
+    std::cerr << "Huge page modes are only supported on Linux, using malloc."
+              << std::endl;
+    mode = MemoryMode::kMalloc;
+  }
+#endif
+  memory_mode.store(mode, std::memory_order_relaxed);
+}
+
+SlabPool::Slab SlabPool::AllocateSlab() {
+  const MemoryMode mode = memory_mode.load(std::memory_order_relaxed);
+#ifdef __linux__
+  if (mode != MemoryMode::kMalloc) {
+    char* data = MapSlab(kSlabSize);
+    if (data) {
+      if (mode == MemoryMode::kHugePagesInterleave) {
+        InterleaveSlab(data, kSlabSize);
+      }
+      return {data, true};
+    }
+  }
+#else
+  (void)mode;
+#endif
+  return {new char[kSlabSize], false};
+}
+
+void SlabPool::FreeSlab(const Slab& slab) {
+#ifdef __linux__
+  if (slab.mapped) {
+    munmap(slab.data, kSlabSize);
+    return;
+  }
+#endif
+  delete[] slab.data;
+}
+
+}  // namespace lczero
@@ -0,0 +1,126 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils/mutex.h"
+
+namespace lczero {
+
+// Carves fixed-size blocks out of large slabs. Released blocks go onto a free
+// list rather than back to the OS, and the slabs themselves are freed only
+// when the pool is destroyed. That keeps a long search from doing tens of
+// millions of small malloc/free calls and from fragmenting the heap.
+// Thread safe, as blocks are allocated on search threads but released on the
+// node garbage collector thread.
+class SlabPool {
+ public:
+  // How slab memory is obtained (see slabpool.cc). Slabs are exactly one
+  // huge page, so in the huge-page modes a slab is one TLB entry and sits
+  // entirely on one NUMA node:
+  //  kMalloc: plain heap allocation (portable default).
+  //  kHugePages: 2MB huge pages; each slab is placed on the NUMA node of
+  //    the search worker which first touches it (which is the worker that
+  //    allocated from it, so nodes land local to the thread extending
+  //    them).
+  //  kHugePagesInterleave: 2MB huge pages interleaved round-robin over the
+  //    NUMA nodes, evening out bandwidth when many workers on both sockets
+  //    read the whole tree.
+  // Linux only; elsewhere the huge-page modes fall back to kMalloc.
+  enum class MemoryMode { kMalloc, kHugePages, kHugePagesInterleave };
+
+  // Applies to slabs allocated from this point on (existing slabs stay
+  // where they are). @name is one of "malloc", "huge-pages",
+  // "huge-pages-interleave"; unknown names are ignored.
+  static void SetMemoryModeByName(const std::string& name);
+
+  explicit SlabPool(size_t block_size) : block_size_(RoundUp(block_size)) {}
+
+  ~SlabPool() {
+    for (const Slab& slab : slabs_) FreeSlab(slab);
+  }
+
+  // Returns an uninitialized block of at least block_size bytes.
+  void* Allocate() {
+    Mutex::Lock lock(mutex_);
+    if (free_list_) {
+      Block* block = free_list_;
+      free_list_ = block->next;
+      return block;
+    }
+    if (slab_remaining_ < block_size_) {
+      slabs_.push_back(AllocateSlab());
+      slab_ptr_ = slabs_.back().data;
+      slab_remaining_ = kSlabSize;
+    }
+    char* result = slab_ptr_;
+    slab_ptr_ += block_size_;
+    slab_remaining_ -= block_size_;
+    return result;
+  }
+
+  // Returns a block to the free list. @block must have been returned by
+  // Allocate() of the same pool.
+  void Deallocate(void* block) {
+    Mutex::Lock lock(mutex_);
+    Block* head = static_cast<Block*>(block);
+    head->next = free_list_;
+    free_list_ = head;
+  }
+
+ private:
+  // Free blocks are linked through their first bytes.
+  struct Block {
+    Block* next;
+  };
+
+  // One slab and how it was obtained, so FreeSlab releases it correctly
+  // even if the mode changed in between.
+  struct Slab {
+    char* data;
+    bool mapped;  // mmap'ed (huge-page modes) vs new[].
+  };
+
+  static Slab AllocateSlab();
+  static void FreeSlab(const Slab& slab);
+
+  // A block has to be able to hold the free list pointer, and has to keep
+  // malloc-like alignment for whatever is constructed in it.
+  static size_t RoundUp(size_t size) {
+    const size_t alignment = alignof(std::max_align_t);
+    if (size < sizeof(Block)) size = sizeof(Block);
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  // One 2MB huge page.
+  static constexpr size_t kSlabSize = 2 << 20;
+
+  const size_t block_size_;
+  mutable Mutex mutex_;
+  std::vector<Slab> slabs_ GUARDED_BY(mutex_);
+  char* slab_ptr_ GUARDED_BY(mutex_) = nullptr;
+  size_t slab_remaining_ GUARDED_BY(mutex_) = 0;
+  Block* free_list_ GUARDED_BY(mutex_) = nullptr;
+};
+
+}  // namespace lczero
@@ -19,23 +19,74 @@
 #pragma once
 
 #include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace lczero {
 
-// Non resizeable array which can contain up to 255 elements.
-template <typename T>
+// Non resizeable array which can contain up to 255 elements. Sizes up to
+// @kInlineCapacity are stored in the object itself, so small arrays (e.g.
+// cached policies, typically a few dozen entries) cost no allocation and no
+// jump to a separately allocated block; larger sizes fall back to the heap.
+template <typename T, size_t kInlineCapacity = 32>
 class SmallArray {
  public:
   SmallArray() = delete;
-  SmallArray(size_t size) : size_(size), data_(std::make_unique<T[]>(size)) {}
-  SmallArray(SmallArray&&);  // TODO implement when needed
+  SmallArray(size_t size) : size_(size) {
+    if (is_inline()) {
+      data_ = reinterpret_cast<T*>(inline_);
+      for (int i = 0; i < size_; ++i) new (data_ + i) T();
+    } else {
+      data_ = new T[size]();
+    }
+  }
+  SmallArray(SmallArray&& other) { MoveFrom(std::move(other)); }
+  SmallArray& operator=(SmallArray&& other) {
+    if (this != &other) {
+      Destroy();
+      MoveFrom(std::move(other));
+    }
+    return *this;
+  }
+  SmallArray(const SmallArray&) = delete;
+  SmallArray& operator=(const SmallArray&) = delete;
+  ~SmallArray() { Destroy(); }
+
   T& operator[](int idx) { return data_[idx]; }
   const T& operator[](int idx) const { return data_[idx]; }
   int size() const { return size_; }
+  // Whether the elements live in the object itself rather than on the heap.
+  bool is_inline() const { return size_ <= kInlineCapacity; }
 
  private:
+  void MoveFrom(SmallArray&& other) {
+    size_ = other.size_;
+    if (is_inline()) {
+      // Inline elements are moved one by one; the source keeps (and later
+      // destroys) its moved-from elements.
+      data_ = reinterpret_cast<T*>(inline_);
+      for (int i = 0; i < size_; ++i) {
+        new (data_ + i) T(std::move(other.data_[i]));
+      }
+    } else {
+      data_ = other.data_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+  }
+
+  void Destroy() {
+    if (is_inline()) {
+      for (int i = 0; i < size_; ++i) data_[i].~T();
+    } else {
+      delete[] data_;
+    }
+  }
+
   unsigned char size_;
-  std::unique_ptr<T[]> data_;
+  T* data_;
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type
+      inline_[kInlineCapacity];
 };
 
 }  // namespace lczero
\ No newline at end of file
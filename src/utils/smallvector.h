@@ -0,0 +1,122 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace lczero {
+
+// Resizeable array with inline storage for the first kInlineSize elements,
+// so that the common case never allocates. Only supports trivially copyable
+// element types (enough for Move), which keeps growth and copy a memcpy.
+template <typename T, size_t kInlineSize>
+class SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SmallVector only supports trivially copyable types.");
+
+ public:
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() = default;
+  SmallVector(std::initializer_list<T> values) {
+    reserve(values.size());
+    for (const T& val : values) data()[size_++] = val;
+  }
+  SmallVector(const SmallVector& other) { *this = other; }
+  SmallVector(SmallVector&& other) { *this = std::move(other); }
+
+  SmallVector& operator=(const SmallVector& other) {
+    if (this == &other) return *this;
+    reserve(other.size_);
+    std::memcpy(data(), other.data(), other.size_ * sizeof(T));
+    size_ = other.size_;
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& other) {
+    if (this == &other) return *this;
+    if (other.heap_) {
+      heap_ = std::move(other.heap_);
+      capacity_ = other.capacity_;
+      other.capacity_ = kInlineSize;
+    } else {
+      heap_.reset();
+      capacity_ = kInlineSize;
+      std::memcpy(inline_, other.inline_, other.size_ * sizeof(T));
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+    return *this;
+  }
+
+  // Ensures capacity for at least @size elements without changing contents.
+  void reserve(size_t size) {
+    if (size > capacity_) Grow(size);
+  }
+
+  void push_back(const T& val) {
+    if (size_ == capacity_) Grow(capacity_ * 2);
+    data()[size_++] = val;
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (size_ == capacity_) Grow(capacity_ * 2);
+    data()[size_++] = T(std::forward<Args>(args)...);
+  }
+
+  void clear() { size_ = 0; }
+
+  T& operator[](size_t idx) { return data()[idx]; }
+  const T& operator[](size_t idx) const { return data()[idx]; }
+  T& back() { return data()[size_ - 1]; }
+  const T& back() const { return data()[size_ - 1]; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return capacity_; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+
+  T* data() { return heap_ ? heap_.get() : inline_; }
+  const T* data() const { return heap_ ? heap_.get() : inline_; }
+
+ private:
+  void Grow(size_t capacity) {
+    std::unique_ptr<T[]> new_heap(new T[capacity]);
+    std::memcpy(new_heap.get(), data(), size_ * sizeof(T));
+    heap_ = std::move(new_heap);
+    capacity_ = capacity;
+  }
+
+  T inline_[kInlineSize];
+  std::unique_ptr<T[]> heap_;
+  size_t size_ = 0;
+  size_t capacity_ = kInlineSize;
+};
+
+}  // namespace lczero
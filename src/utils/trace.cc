@@ -0,0 +1,132 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/trace.h"
+
+#ifdef USE_TRACE
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lczero {
+namespace trace {
+namespace {
+
+// Per-thread ring capacity; at ~32 bytes per slice that's 2MB per thread.
+// Old slices are overwritten, so the dump shows the tail of the run.
+const size_t kRingSize = 64 * 1024;
+
+struct Slice {
+  const char* name;
+  int64_t start_us;
+  int64_t end_us;
+};
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(int tid) : tid(tid), slices(kRingSize) {}
+  const int tid;
+  std::vector<Slice> slices;
+  // Total slices ever recorded; slot is count % kRingSize. Only the owning
+  // thread writes, the exit-time dump reads.
+  size_t count = 0;
+};
+
+class Tracer {
+ public:
+  static Tracer& Get() {
+    // Deliberately leaked: threads may still record while exit handlers run,
+    // so the buffers must outlive static destruction.
+    static Tracer* tracer = new Tracer();
+    return *tracer;
+  }
+
+  ThreadBuffer* RegisterThread() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(std::make_unique<ThreadBuffer>(next_tid_++));
+    return buffers_.back().get();
+  }
+
+  int64_t TimestampUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start_)
+        .count();
+  }
+
+ private:
+  Tracer() : start_(std::chrono::steady_clock::now()) {
+    std::atexit([]() { Tracer::Get().Dump(); });
+  }
+
+  void Dump() {
+    const char* filename = std::getenv("LC0_TRACE_FILE");
+    if (!filename) filename = "lc0.trace.json";
+    std::ofstream out(filename);
+    if (!out) {
+      std::cerr << "Cannot write trace to " << filename << std::endl;
+      return;
+    }
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& buffer : buffers_) {
+      const size_t count = buffer->count;
+      const size_t begin = count > kRingSize ? count - kRingSize : 0;
+      for (size_t i = begin; i < count; ++i) {
+        const Slice& slice = buffer->slices[i % kRingSize];
+        if (!first) out << ",";
+        first = false;
+        out << "{\"name\":\"" << slice.name << "\",\"ph\":\"X\",\"pid\":0"
+            << ",\"tid\":" << buffer->tid << ",\"ts\":" << slice.start_us
+            << ",\"dur\":" << (slice.end_us - slice.start_us) << "}";
+      }
+    }
+    out << "]}" << std::endl;
+    std::cerr << "Trace written to " << filename << std::endl;
+  }
+
+  const std::chrono::steady_clock::time_point start_;
+  std::mutex mutex_;
+  // Buffers are kept alive here past thread exit so the dump sees them.
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  int next_tid_ = 0;
+};
+
+ThreadBuffer* GetThreadBuffer() {
+  thread_local ThreadBuffer* buffer = Tracer::Get().RegisterThread();
+  return buffer;
+}
+
+}  // namespace
+
+int64_t TimestampUs() { return Tracer::Get().TimestampUs(); }
+
+void Record(const char* name, int64_t start_us, int64_t end_us) {
+  ThreadBuffer* buffer = GetThreadBuffer();
+  buffer->slices[buffer->count % kRingSize] = {name, start_us, end_us};
+  ++buffer->count;
+}
+
+}  // namespace trace
+}  // namespace lczero
+
+#endif  // USE_TRACE
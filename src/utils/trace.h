@@ -0,0 +1,69 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2018 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Lightweight scoped tracing, compiled in with -Dtrace=true (USE_TRACE).
+// Each thread records completed slices into its own fixed-size ring buffer
+// (the oldest slices are overwritten), so recording is a couple of clock
+// reads and stores, with no locking on the hot path. On process exit the
+// rings are dumped as Chrome trace JSON -- load the file in chrome://tracing
+// or https://ui.perfetto.dev to see the timeline. The output file is
+// "lc0.trace.json" in the working directory, overridable with the
+// LC0_TRACE_FILE environment variable. The dump is best-effort for threads
+// still running at exit.
+//
+// Usage: TRACE_SCOPE("gather"); records a slice from that point to the end
+// of the enclosing block. The name must be a string literal (only the
+// pointer is stored).
+
+#ifdef USE_TRACE
+
+#include <cstdint>
+
+namespace lczero {
+namespace trace {
+
+// Microseconds since process start (first use).
+int64_t TimestampUs();
+// Appends a completed slice to the calling thread's ring buffer.
+void Record(const char* name, int64_t start_us, int64_t end_us);
+
+class TraceScope {
+ public:
+  TraceScope(const char* name) : name_(name), start_us_(TimestampUs()) {}
+  ~TraceScope() { Record(name_, start_us_, TimestampUs()); }
+
+ private:
+  const char* name_;
+  int64_t start_us_;
+};
+
+}  // namespace trace
+}  // namespace lczero
+
+#define TRACE_SCOPE_CAT2(a, b) a##b
+#define TRACE_SCOPE_CAT(a, b) TRACE_SCOPE_CAT2(a, b)
+#define TRACE_SCOPE(name) \
+  ::lczero::trace::TraceScope TRACE_SCOPE_CAT(trace_scope_, __LINE__)(name)
+
+#else  // USE_TRACE
+
+#define TRACE_SCOPE(name)
+
+#endif  // USE_TRACE
@@ -20,12 +20,22 @@
 #include <cstddef>
 
 namespace lczero {
+
+void Transpose2D(const float* from, float* to, int rows, int cols) {
+  transpose_detail::Transpose2DImpl(from, to, rows, cols);
+}
+
 void TransposeTensor(const std::vector<int>& dims, std::vector<int> order,
                      const std::vector<float> from, float* to) {
   if (order.empty()) {
     for (size_t i = 0; i < dims.size(); ++i)
       order.push_back(dims.size() - i - 1);
   }
+  // The plain 2D transpose goes through the blocked SIMD kernel.
+  if (dims.size() == 2 && order[0] == 1 && order[1] == 0) {
+    Transpose2D(from.data(), to, dims[1], dims[0]);
+    return;
+  }
   std::vector<int> cur_idx(dims.size());
   for (size_t _ = 0; _ < from.size(); ++_) {
     size_t from_idx = 0;